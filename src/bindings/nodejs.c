@@ -10,9 +10,6 @@
 #include "../error/error.h"
 #include <time.h>
 
-// Maximum input size to prevent buffer overflows
-#define MAX_INPUT_SIZE (1024 * 1024) // 1MB limit
-
 const char* compile_ggcode_from_string(const char* source_code) {
     clock_t start_time = clock();
     if (!source_code) {
@@ -22,9 +19,6 @@ const char* compile_ggcode_from_string(const char* source_code) {
     if (input_len == 0) {
         return strdup("; EMPTY INPUT\n");
     }
-    if (input_len > MAX_INPUT_SIZE) {
-        return strdup("ERROR: Input too large (max 1MB)\n");
-    }
     init_runtime();
     Runtime* runtime = get_runtime();
     runtime->statement_count = 0;
@@ -54,16 +54,21 @@ void print_help(void) {
     printf("USAGE:\n");
     printf("    ggcode                                      # Interactive file selection menu\n");
     printf("    ggcode [OPTIONS] [FILES...]                # Compile specific files\n");
-    printf("    ggcode -e|--eval \"GGCODE_EXPRESSION\"       # Direct evaluation\n\n");
+    printf("    ggcode -e|--eval \"GGCODE_EXPRESSION\"       # Direct evaluation\n");
+    printf("    cat part.ggcode | ggcode -                  # Compile standard input to stdout\n\n");
     
     printf("ARGUMENTS:\n");
-    printf("    FILES...    GGcode source files to compile (.ggcode extension)\n\n");
+    printf("    FILES...    GGcode source files to compile (.ggcode extension), - for stdin\n\n");
     
     printf("OPTIONS:\n");
     printf("    -a, --all               Compile all .ggcode files in current directory\n");
     printf("    -o, --output FILE       Specify exact output file (single file mode only)\n");
     printf("    --output-dir DIR        Set output directory (default: ./Gcode)\n");
     printf("    -e, --eval \"CODE\"       Execute GGcode directly to terminal (no files)\n");
+    printf("    --stream                Parse and emit one statement at a time (bounded memory)\n");
+    printf("    --tree-walker           Run with the tree walker instead of the bytecode VM\n");
+    printf("    --compare-engines       Run files on both engines and report output differences\n");
+    printf("    --dump-optimized-ast    Print the syntax tree of files after constant folding\n");
     printf("    -q, --quiet             Suppress compilation reports and progress\n");
     printf("    -V, --verbose           Show detailed compilation information\n");
     printf("    -h, --help              Show this help message\n");
@@ -268,6 +273,18 @@ CLIArgs* parse_arguments(int argc, char* argv[]) {
         else if (strcmp(argv[i], "-V") == 0 || strcmp(argv[i], "--verbose") == 0) {
             args->verbose = true;
         }
+        else if (strcmp(argv[i], "--stream") == 0) {
+            args->stream_mode = true;
+        }
+        else if (strcmp(argv[i], "--tree-walker") == 0) {
+            args->tree_walker = true;
+        }
+        else if (strcmp(argv[i], "--compare-engines") == 0) {
+            args->compare_engines = true;
+        }
+        else if (strcmp(argv[i], "--dump-optimized-ast") == 0) {
+            args->dump_optimized_ast = true;
+        }
         else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
             if (i + 1 < argc) {
                 // Validate output filename length and characters
@@ -327,7 +344,7 @@ CLIArgs* parse_arguments(int argc, char* argv[]) {
                 return NULL;
             }
         }
-        else if (argv[i][0] == '-') {
+        else if (argv[i][0] == '-' && argv[i][1] != '\0') {
             fprintf(stderr, "Error: Unknown option '%s'\n", argv[i]);
             fprintf(stderr, "Use 'ggcode --help' for usage information\n");
             free_cli_args(args);
@@ -40,6 +40,10 @@ typedef struct {
     bool quiet;             /**< Suppress compilation reports */
     bool verbose;           /**< Show detailed compilation information */
     bool eval_mode;         /**< Direct evaluation mode */
+    bool stream_mode;       /**< Parse and emit one statement at a time with bounded memory */
+    bool tree_walker;       /**< Run programs with the tree walker instead of the bytecode VM */
+    bool compare_engines;   /**< Run inputs on both engines and report where their G-code differs */
+    bool dump_optimized_ast; /**< Print the tree of each input after constant folding instead of compiling */
     
     // Paths
     char* output_file;      /**< Specific output file path (single file mode) */
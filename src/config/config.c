@@ -1,6 +1,7 @@
 #include "config.h"
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "../runtime/runtime_state.h"
 
@@ -24,7 +25,17 @@ static int decimal_places = 3;  // Default decimal places for G-code coordinates
 
 // Initialize runtime state
 void init_runtime() {
+    // A new compilation starts: drop the previous compilation's interned strings and AST
+    intern_table_free(&g_runtime.strings);
+    arena_free(&g_runtime.ast_arena);
+    arena_free(&g_runtime.scratch);
+    free(g_runtime.variables);
+    free(g_runtime.bindings);
+    free(g_runtime.scope_bases);
+    free(g_runtime.function_stack.contexts);
+    free(g_runtime.function_stack.tail_args);
     memset(&g_runtime, 0, sizeof(Runtime));
+    g_runtime.last_modal_key_id = -1;  // G-code word ids die with the intern table
 
     // statement_count is now managed in runtime state
     g_runtime.var_count = 0;
@@ -33,7 +44,7 @@ void init_runtime() {
     
     // Initialize recursion protection
     g_runtime.recursion_depth = 0;
-    g_runtime.max_recursion_depth = 100;  // Default limit
+    g_runtime.max_recursion_depth = DEFAULT_MAX_RECURSION_DEPTH;  // Default limit
 }
 
 // Get runtime instance
@@ -90,7 +101,7 @@ void reset_config_state(void) {
 }
 
 const char* get_decimal_format(void) {
-    static char format[8];
-    snprintf(format, sizeof(format), "%%.%df", decimal_places);
-    return format;
+    // One entry per value set_decimal_places() accepts
+    static const char *const formats[] = {"%.0f", "%.1f", "%.2f", "%.3f", "%.4f", "%.5f", "%.6f"};
+    return formats[decimal_places];
 }
\ No newline at end of file
@@ -17,6 +17,7 @@ static int error_count = 0;
 
 jmp_buf fatal_error_jump_buffer;
 int fatal_error_triggered = 0;
+int error_source_first_line = 1;
 
 
 
@@ -28,6 +29,7 @@ const char *get_ast_type_name(int type) {
         case AST_VAR: return "AST_VAR";
         case AST_ASSIGN_INDEX: return "AST_ASSIGN_INDEX";
         case AST_ARRAY_LITERAL: return "AST_ARRAY_LITERAL";
+        case AST_MAP_LITERAL: return "AST_MAP_LITERAL";
         case AST_INDEX: return "AST_INDEX";
         case AST_FUNCTION: return "AST_FUNCTION";
         case AST_CALL: return "AST_CALL";
@@ -41,6 +43,7 @@ const char *get_ast_type_name(int type) {
         case AST_BLOCK: return "AST_BLOCK";
         case AST_NOTE: return "AST_NOTE";
         case AST_IF: return "AST_IF";
+        case AST_MATCH: return "AST_MATCH";
         case AST_UNARY: return "AST_UNARY";
         case AST_EMPTY: return "AST_EMPTY";
 
@@ -75,7 +78,7 @@ void fatal_error(const char *source, int line, int column, const char *format, .
             // Extract the source line
             const char *line_start = source;
             const char *p = source;
-            int current_line = 1;
+            int current_line = error_source_first_line;
 
             // Find the start of the target line
             while (*p && current_line < line) {
@@ -161,7 +164,7 @@ void fatal_error(const char *source, int line, int column, const char *format, .
         // Extract and print the relevant source line
         const char *line_start = source;
         const char *p = source;
-        int current_line = 1;
+        int current_line = error_source_first_line;
 
         // Go to the line
         while (*p && current_line < line) {
@@ -205,6 +208,8 @@ void fatal_error(const char *source, int line, int column, const char *format, .
     // clear_errors();
 
 
+    error_source_first_line = 1;
+
     // Set fatal error flag and jump to error handler
 fatal_error_triggered = 1;
 longjmp(fatal_error_jump_buffer, 1);
@@ -278,7 +283,7 @@ const char* get_error_messages() {
     // Calculate total length needed
     size_t total_len = 0;
     for (int i = 0; i < error_count; i++) {
-        total_len += strlen(error_messages[i]) + 15; // +15 for "; ERROR:" and formatting
+        total_len += strlen(error_messages[i]) + sizeof("\nGGcode Compiler Error:"); // separator before each message
     }
     total_len += 50; // Extra buffer for formatting
     
@@ -314,7 +319,7 @@ void report_return_error(const char *source, int line, int column, const char *c
         // Extract the source line
         const char *line_start = source;
         const char *p = source;
-        int current_line = 1;
+        int current_line = error_source_first_line;
 
         // Find the start of the target line
         while (*p && current_line < line) {
@@ -384,6 +389,7 @@ void report_return_error(const char *source, int line, int column, const char *c
     
     error_messages[error_count][511] = '\0';
     error_count++;
+    error_source_first_line = 1;
 }
 
 // Error recovery mechanism for parser
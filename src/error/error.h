@@ -17,6 +17,11 @@ extern char *global_source_buffer;
 extern jmp_buf fatal_error_jump_buffer;
 extern int fatal_error_triggered;
 
+// Line number of the first byte of the `source` passed to fatal_error()/report_return_error().
+// Streamed input only keeps a window of the file, so it may start past line 1.
+// Reset to 1 after each report.
+extern int error_source_first_line;
+
 
 void clear_fatal_state(void);
 
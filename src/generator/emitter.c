@@ -1,5 +1,6 @@
 /// emitter.c
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,43 +40,8 @@ Value *make_raw_number_value(double num)
     return val;
 }
 
-Value *make_string_value(const char *str)
+Value number_value(double num)
 {
-    Value *val = malloc(sizeof(Value));
-    if (!val)
-    {
-        report_error("[make_string_value] malloc failed for Value");
-        return NULL;
-    }
-
-    val->type = VAL_STRING;
-    if (str) {
-        val->string = strdup(str);
-        if (!val->string) {
-            report_error("[make_string_value] strdup failed for string");
-            free(val);
-            return NULL;
-        }
-    } else {
-        val->string = strdup("");
-        if (!val->string) {
-            report_error("[make_string_value] strdup failed for empty string");
-            free(val);
-            return NULL;
-        }
-    }
-    return val;
-}
-
-Value *make_number_value(double num)
-{
-    Value *val = malloc(sizeof(Value));
-    if (!val)
-    {
-        report_error("[make_number_value] malloc failed for Value");
-        return NULL;
-    }
-
     // Comprehensive floating-point precision handling
     // 1. Handle NaN and Infinity (for G-code safety)
     if (isnan(num) || isinf(num)) {
@@ -94,142 +60,120 @@ Value *make_number_value(double num)
         num = round(num * 1e6) / 1e6;
     }
 
-    val->type = VAL_NUMBER;
-    val->number = num;
+    Value val = {.type = VAL_NUMBER, .number = num};
     return val;
 }
 
-// Global flag to reset emitter state
-static int emitter_reset_flag = 0;
+Value *make_number_value(double num)
+{
+    Value *val = malloc(sizeof(Value));
+    if (!val)
+    {
+        report_error("[make_number_value] malloc failed for Value");
+        return NULL;
+    }
+
+    *val = number_value(num);
+    return val;
+}
 
 // Reset emitter state between compilations
 void reset_emitter_state()
 {
     Runtime *rt = get_runtime();
     rt->statement_count = 0;
-    emitter_reset_flag = 1;  // Set flag to reset last_code on next emit_gcode_stmt call
+    rt->last_modal_key_id = -1;  // the next G-code line writes its words again
 }
 
 
 
+/// @brief Appends formatted text to a note line, truncating at the buffer size
+static size_t append_note_text(char *buffer, size_t size, size_t used, const char *format, ...)
+{
+    if (used + 1 >= size)
+        return used;
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + used, size - used, format, args);
+    va_end(args);
+
+    if (written < 0)
+        return used;
+    return used + (size_t)written < size ? used + (size_t)written : size - 1;
+}
+
+/// @brief Appends the value of a placeholder the way notes print it
+static size_t append_note_value(char *buffer, size_t size, size_t used, const Value *val)
+{
+    if (val && val->type == VAL_NUMBER)
+        return append_note_text(buffer, size, used, get_decimal_format(), val->number);
+    if (val && val->type == VAL_STRING)
+        return append_note_text(buffer, size, used, "%s", val->string);
+    return append_note_text(buffer, size, used, "0");
+}
+
+size_t append_note_segment(char *buffer, size_t size, size_t used, const NoteSegment *segment, const Value *val)
+{
+    Runtime *rt = get_runtime();
+    switch (segment->kind)
+    {
+    case NOTE_TEXT:
+        return append_note_text(buffer, size, used, "%.*s", segment->length, segment->text);
+    case NOTE_TIME:
+        return append_note_text(buffer, size, used, "%s", rt->RUNTIME_TIME);
+    case NOTE_FILE_NAME:
+        return append_note_text(buffer, size, used, "%s", rt->RUNTIME_FILENAME);
+    case NOTE_EXPR:
+        return append_note_value(buffer, size, used, val);
+    case NOTE_VAR:
+        return append_note_value(buffer, size, used, get_var(segment->text));
+    case NOTE_LINE_END:
+    {
+        char gcode_comment[300];
+        snprintf(gcode_comment, sizeof(gcode_comment), "(%s)", buffer);
+        write_to_output(gcode_comment);
+        buffer[0] = '\0';
+        return 0;
+    }
+    }
+    return used;
+}
 //
 static void emit_note_stmt(ASTNode *node)
 {
     Runtime *rt = get_runtime();
     rt->statement_count++;
-    const char *content = node->note.content;
-    if (!content)
+    if (!node->note.content)
     {
         report_error("[Emit] NOTE content is NULL");
         return;
     }
 
+    // The template was split and its placeholders parsed along with the note
+    char parsed[256];
+    size_t used = 0;
+    parsed[0] = '\0';
 
-
-    char *copy = strdup(content);
-    if (!copy)
+    for (int i = 0; i < node->note.segment_count; i++)
     {
-        report_error("[Emit] strdup failed for note content");
-        return;
+        const NoteSegment *segment = &node->note.segments[i];
+        Value val = segment->kind == NOTE_EXPR ? eval_value(segment->expr) : number_value(0.0);
+        used = append_note_segment(parsed, sizeof(parsed), used, segment, &val);
     }
-
-    char *line = strtok(copy, "\n");
-    while (line)
+}
+/// @brief Stores the value of an ASSIGN statement, falling back to 0 if it is invalid
+void assign_checked(int slot, const char *name, Value *val)
+{
+    if (!val || (val->type != VAL_NUMBER && val->type != VAL_STRING && val->type != VAL_ARRAY && val->type != VAL_MAP))
     {
-        // Strip trailing \r if present (Windows CRLF line endings)
-        size_t len = strlen(line);
-
-        if (len > 0 && line[len - 1] == '\r')
-        {
-            line[len - 1] = ' ';
-        }
-
-        char parsed[256] = {0}, *out = parsed;
-        const char *p = line;
-
-        while (*p)
-        {
-            if (*p == '[' || *p == '{')
-            {
-                char expr_text[256] = {0};
-                char closing_char = (*p == '[') ? ']' : '}';
-                p++;
-                int ei = 0;
-                while (*p && *p != closing_char && ei < 255)
-                    expr_text[ei++] = *p++;
-                expr_text[ei] = '\0';
-                if (*p == closing_char)
-                    p++;
-
-                Runtime *rt = get_runtime();
-                const char *replacement = NULL;
-                
-                // Check for special runtime variables first
-                if (strcmp(expr_text, "time") == 0)
-                    replacement = rt->RUNTIME_TIME;
-                else if (strcmp(expr_text, "ggcode_file_name") == 0)
-                    replacement = rt->RUNTIME_FILENAME;
-
-                if (replacement)
-                {
-                    out += sprintf(out, "%s", replacement);
-                }
-                else
-                {
-                    // Parse and evaluate the expression while preserving current runtime context
-                    ASTNode *expr_ast = parse_expression_from_string(expr_text);
-                    if (expr_ast)
-                    {
-                        Value *val = eval_expr(expr_ast);
-                        if (val && val->type == VAL_NUMBER)
-                        {
-                            out += sprintf(out, get_decimal_format(), val->number);
-                        }
-                        else if (val && val->type == VAL_STRING)
-                        {
-                            out += sprintf(out, "%s", val->string);
-                        }
-                        else
-                        {
-                            out += sprintf(out, "0");
-                        }
-                        free_ast(expr_ast);
-                    }
-                    else
-                    {
-                        // Fallback: try as simple variable lookup
-                        Value *val = get_var(expr_text);
-                        if (val && val->type == VAL_NUMBER)
-                        {
-                            out += sprintf(out, get_decimal_format(), val->number);
-                        }
-                        else if (val && val->type == VAL_STRING)
-                        {
-                            out += sprintf(out, "%s", val->string);
-                        }
-                        else
-                        {
-                            out += sprintf(out, "0");
-                        }
-                    }
-                }
-            }
-            else
-            {
-                *out++ = *p++;
-            }
-        }
-        *out = '\0';
-
-        char gcode_comment[300];
-        snprintf(gcode_comment, sizeof(gcode_comment), "(%s)", parsed);
-        write_to_output(gcode_comment);
-
-        line = strtok(NULL, "\n");
+        report_error("[Emit] ASSIGN %s failed, invalid expression", name);
+        Value fallback = number_value(0);
+        set_var_slot(slot, name, &fallback);
+        return;
     }
 
-    free(copy);
-    copy = NULL;
+    set_var_slot(slot, name, val);
 }
 //
 static void emit_let_stmt(ASTNode *node)
@@ -243,18 +187,73 @@ static void emit_let_stmt(ASTNode *node)
         return;
     }
 
-    Value *val = eval(node->let_stmt.expr);
+    Value val = eval_value(node->let_stmt.expr);
+    set_var_slot(node->let_stmt.slot, node->let_stmt.name, &val);
+}
+//
+/// @brief Length of a line after snprintf() wrote `written` more bytes at `len`
+static size_t clipped_length(size_t len, int written, size_t size)
+{
+    if (written < 0)
+        return len;
+    return len + (size_t)written < size ? len + (size_t)written : size - 1;
+}
+
+/// @brief Starts a G-code line: N number, then the words unless they repeat the modal ones
+/// @return Length of the line so far
+size_t begin_gcode_line(char *line, size_t size, const char *code, int code_id, int modal_key_id)
+{
+    Runtime *rt = get_runtime();
+    size_t len = 0;
+    line[0] = '\0';
+
+    if (get_enable_n_lines())
+    {
+        len = clipped_length(0, snprintf(line, size, "N%d ", get_line_number()), size);
+        increment_line_number();
+    }
+
+    // Same words as last time are modal and not repeated. Only the first
+    // GCODE_MODAL_KEY_LENGTH bytes of the last word list are remembered.
+    if (code_id != rt->last_modal_key_id)
+    {
+        len = clipped_length(len, snprintf(line + len, size - len, "%s", code), size);
+        rt->last_modal_key_id = modal_key_id;
+    }
+    return len;
+}
 
+/// @brief Appends one " KEY<value>" word; `v` is the evaluated argument, if any
+/// @return New length of the line
+size_t append_gcode_arg(char *line, size_t size, size_t len, int i, int letter, int has_expr, const Value *v)
+{
+    double val = 0.0;
 
-    if (!val)
+    if (has_expr)
     {
-        report_error("[Emit] LET %s = NULL (defaulting to 0)", node->let_stmt.name);
-        val = make_number_value(0);
+        if (!v || v->type != VAL_NUMBER)
+        {
+            report_error("[Emit] GCODE arg[%d] is not a number", i);
+            val = 0.0;
+        }
+        else
+        {
+            val = v->number;
+        }
     }
 
-    set_var(node->let_stmt.name, val);
+    // The value is cut to 15 characters, the word to what is left of the line
+    char segment[2 + 16] = {' ', (char)('A' + letter)};
+    size_t segment_len = clipped_length(2, snprintf(segment + 2, 16, get_decimal_format(), val), sizeof(segment));
+    if (segment_len > size - 1 - len)
+        segment_len = size - 1 - len;
+
+    memcpy(line + len, segment, segment_len);
+    len += segment_len;
+    line[len] = '\0';
+    return len;
 }
-//
+
 static void emit_gcode_stmt(ASTNode *node)
 {
     Runtime *rt = get_runtime();
@@ -266,70 +265,37 @@ static void emit_gcode_stmt(ASTNode *node)
         return;
     }
 
+    char line[256];
+    size_t len = begin_gcode_line(line, sizeof(line), node->gcode_stmt.code,
+                                  node->gcode_stmt.code_id, node->gcode_stmt.modal_key_id);
 
-
-    static char last_code[16] = "";
-
-    // Reset last_code when emitter_reset_flag is set
-    if (emitter_reset_flag) {
-        memset(last_code, 0, sizeof(last_code));
-        emitter_reset_flag = 0;
-    }
-
-    char line[256] = {0};
-
-    if (get_enable_n_lines())
+    for (int i = 0; i < node->gcode_stmt.argCount; i++)
     {
-        snprintf(line, sizeof(line), "N%d ", get_line_number());
-        increment_line_number();
+        const GArg *arg = &node->gcode_stmt.args[i];
+        Value val = arg->indexExpr ? eval_value(arg->indexExpr) : number_value(0.0);
+        len = append_gcode_arg(line, sizeof(line), len, i, arg->letter, arg->indexExpr != NULL, &val);
     }
 
-    // Check if current G-code matches the last remembered one (modal behavior)
-    if (strcmp(node->gcode_stmt.code, last_code) == 0)
-        {
-        // Same G-code as last time - don't output it (modal behavior)
-        // Just keep the last_code as is
-    }
-    else
+    write_line_to_output(line, len);
+}
+/// @brief Checks a WHILE condition and the iteration cap; 0 ends the loop
+int while_continues(const Value *cond, int iteration)
+{
+    if (!cond || cond->type != VAL_NUMBER)
     {
-        // Different G-code - output it and remember it
-        size_t len = strlen(line);
-        snprintf(line + len, sizeof(line) - len, "%s", node->gcode_stmt.code);
-        strncpy(last_code, node->gcode_stmt.code, sizeof(last_code) - 1);
-        last_code[sizeof(last_code) - 1] = '\0';
+        report_error("[Emit] WHILE condition is invalid (null or not a number)");
+        return 0;
     }
 
-    for (int i = 0; i < node->gcode_stmt.argCount; i++)
-    {
-        char segment[64];
-        double val = 0.0;
-
-        if (node->gcode_stmt.args[i].indexExpr)
-        {
-            Value *v = eval_expr(node->gcode_stmt.args[i].indexExpr);
-            if (!v || v->type != VAL_NUMBER)
-            {
-                report_error("[Emit] GCODE arg[%d] is not a number", i);
-                val = 0.0;
-            }
-            else
-            {
-                val = v->number;
-            }
-        }
-
-        snprintf(segment, sizeof(segment), " %s", node->gcode_stmt.args[i].key);
-        char value_str[16];
-        snprintf(value_str, sizeof(value_str), get_decimal_format(), val);
-        strncat(segment, value_str, sizeof(segment) - strlen(segment) - 1);
+    if (cond->number == 0)
+        return 0;
 
-        size_t len = strlen(line);
-        strncat(line, segment, sizeof(line) - len - 1);
+    if (iteration >= MAX_WHILE_ITERATIONS)
+    {
+        report_error("[Emit] WHILE loop exceeded maximum iterations (%d)", MAX_WHILE_ITERATIONS);
+        return 0;
     }
-
-
-
-    write_to_output(line);
+    return 1;
 }
 //
 static void emit_while_stmt(ASTNode *node)
@@ -343,22 +309,13 @@ static void emit_while_stmt(ASTNode *node)
     int iteration = 0;
     while (1)
     {
-        Value *cond = eval_expr(node->while_stmt.condition);
-        if (!cond || cond->type != VAL_NUMBER)
-        {
-            report_error("[Emit] WHILE condition is invalid (null or not a number)");
-            break;
-        }
-
-        if (cond->number == 0)
+        // The condition's temporaries are dropped before the body runs
+        ScratchMark mark = scratch_mark();
+        Value cond = eval_value(node->while_stmt.condition);
+        scratch_release(mark);
+        if (!while_continues(&cond, iteration))
             break;
 
-        if (iteration >= MAX_WHILE_ITERATIONS)
-        {
-            report_error("[Emit] WHILE loop exceeded maximum iterations (%d)", MAX_WHILE_ITERATIONS);
-            break;
-        }
-
         emit_gcode(node->while_stmt.body);
         
         // Check if return was encountered in the loop body
@@ -370,6 +327,28 @@ static void emit_while_stmt(ASTNode *node)
     }
 
 }
+/// @brief Validates the bounds of a numeric FOR loop; 0 means do not run it
+int for_range(const Value *v_from, const Value *v_to, const Value *v_step,
+                     double *from, double *to, double *step)
+{
+    if (!v_from || !v_to || !v_step ||
+        v_from->type != VAL_NUMBER || v_to->type != VAL_NUMBER || v_step->type != VAL_NUMBER)
+    {
+        report_error("[Emit] FOR loop expects numeric values");
+        return 0;
+    }
+
+    *from = v_from->number;
+    *to = v_to->number;
+    *step = v_step->number;
+
+    if (*step == 0)
+    {
+        report_error("[Emit] FOR loop step cannot be zero");
+        return 0;
+    }
+    return 1;
+}
 //
 static void emit_for_stmt(ASTNode *node)
 {
@@ -401,13 +380,14 @@ static void emit_for_stmt(ASTNode *node)
         
         // Iterate through each character
         for (int i = 0; str[i] != '\0'; i++) {
-            // Create a single-character string for the loop variable
-            char char_str[2] = {str[i], '\0'};
-            set_var(node->for_stmt.var, make_string_value(char_str));
+            // One-character strings come from a static table, so this allocates nothing
+            Value char_val = char_value(str[i]);
+            set_var_slot(node->for_stmt.var_slot, node->for_stmt.var, &char_val);
             
             // If index variable is specified, set it too
             if (node->for_stmt.index_var) {
-                set_var(node->for_stmt.index_var, make_number_value((double)i));
+                Value index_val = number_value((double)i);
+                set_var_slot(node->for_stmt.index_slot, node->for_stmt.index_var, &index_val);
             }
             
             emit_gcode(node->for_stmt.body);
@@ -421,28 +401,15 @@ static void emit_for_stmt(ASTNode *node)
     }
 
     // Traditional numeric for loop: for i = 1..10
-    Value *v_from = eval_expr(node->for_stmt.from);
-    Value *v_to = eval_expr(node->for_stmt.to);
-    Value *v_step = node->for_stmt.step ? eval_expr(node->for_stmt.step) : make_number_value(1.0);
+    Value v_from = eval_value(node->for_stmt.from);
+    Value v_to = eval_value(node->for_stmt.to);
+    Value v_step = node->for_stmt.step ? eval_value(node->for_stmt.step) : number_value(1.0);
 
-    if (!v_from || !v_to || !v_step ||
-        v_from->type != VAL_NUMBER || v_to->type != VAL_NUMBER || v_step->type != VAL_NUMBER)
-    {
-        report_error("[Emit] FOR loop expects numeric values");
+    double from, to, step;
+    if (!for_range(&v_from, &v_to, &v_step, &from, &to, &step))
         return;
-    }
-
-    double from = v_from->number;
-    double to = v_to->number;
-    double step = v_step->number;
     int exclusive = node->for_stmt.exclusive;
 
-    if (step == 0)
-    {
-        report_error("[Emit] FOR loop step cannot be zero");
-        return;
-    }
-
     // Declare runtime_has_returned as extern since it's defined in evaluator.c
     extern int runtime_has_returned;
 
@@ -451,7 +418,8 @@ static void emit_for_stmt(ASTNode *node)
         double end = exclusive ? to : to + 1e-9;
         for (double i = from; i < end; i += step)
         {
-            set_var(node->for_stmt.var, make_number_value(i));
+            Value counter = number_value(i);
+            set_var_slot(node->for_stmt.var_slot, node->for_stmt.var, &counter);
             emit_gcode(node->for_stmt.body);
             
             // Check if return was encountered in the loop body
@@ -465,7 +433,8 @@ static void emit_for_stmt(ASTNode *node)
         double end = exclusive ? to : to - 1e-9;
         for (double i = from; i > end; i += step)
         {
-            set_var(node->for_stmt.var, make_number_value(i));
+            Value counter = number_value(i);
+            set_var_slot(node->for_stmt.var_slot, node->for_stmt.var, &counter);
             emit_gcode(node->for_stmt.body);
             
             // Check if return was encountered in the loop body
@@ -500,21 +469,15 @@ static void emit_function_stmt(ASTNode *node)
     extern void register_function(ASTNode * node);
     register_function(node);
 }
-//
-static void emit_if_stmt(ASTNode *node)
+/// @brief Reads an IF condition; 0 means it was invalid and nothing runs
+int if_condition(const Value *cond_val, double *cond)
 {
-    Runtime *rt = get_runtime();
-    rt->statement_count++;
-
-
-
-    Value *cond_val = eval_expr(node->if_stmt.condition);
     if (!cond_val)
     {
 
         report_error("[Emit] IF condition evaluated to NULL");
 
-        return; // Or exit(1) if this should be fatal
+        return 0;
     }
 
     if (cond_val->type != VAL_NUMBER)
@@ -522,10 +485,24 @@ static void emit_if_stmt(ASTNode *node)
 
         report_error("[Emit] IF condition did not return a number (type: %d)", cond_val->type);
 
-        return;
+        return 0;
     }
 
-    double cond = cond_val->number;
+    *cond = cond_val->number;
+    return 1;
+}
+//
+static void emit_if_stmt(ASTNode *node)
+{
+    Runtime *rt = get_runtime();
+    rt->statement_count++;
+
+
+
+    double cond;
+    Value cond_val = eval_value(node->if_stmt.condition);
+    if (!if_condition(&cond_val, &cond))
+        return;
 
     if (cond)
     {
@@ -545,10 +522,22 @@ static void emit_if_stmt(ASTNode *node)
 
 
 
+/// @brief Runs the arm whose label equals the subject, through the parser's tables
+static void emit_match_stmt(ASTNode *node)
+{
+    Runtime *rt = get_runtime();
+    rt->statement_count++;
 
+    Value subject = eval_value(node->match_stmt.subject);
+    int arm = match_arm(node, &subject);
+    if (arm >= 0)
+        emit_gcode(node->match_stmt.arms[arm]);
+    else if (node->match_stmt.else_branch)
+        emit_gcode(node->match_stmt.else_branch);
+}
 
-
-void emit_gcode(ASTNode *node)
+/// @brief Emits one statement; emit_gcode() wraps it to drop its temporaries
+static void emit_statement(ASTNode *node)
 {
     if (!node)
         return;
@@ -598,16 +587,8 @@ case AST_EXPR_STMT:
     {
         Runtime *rt = get_runtime();
         rt->statement_count++;
-        Value *val = eval_expr(node->assign_stmt.expr);
-        if (!val || (val->type != VAL_NUMBER && val->type != VAL_STRING && val->type != VAL_ARRAY))
-        {
-            report_error("[Emit] ASSIGN %s failed, invalid expression", node->assign_stmt.name);
-            val = make_number_value(0); // fallback
-        }
-
-        set_var(node->assign_stmt.name, val);
-
-
+        Value val = eval_value(node->assign_stmt.expr);
+        assign_checked(node->assign_stmt.slot, node->assign_stmt.name, &val);
         break;
     }
 
@@ -640,6 +621,9 @@ case AST_EXPR_STMT:
     case AST_IF:
         emit_if_stmt(node);
         break;
+    case AST_MATCH:
+        emit_match_stmt(node);
+        break;
 
 
 
@@ -675,79 +659,256 @@ case AST_CALL:
             break;
         }
 
-        Value *array = eval_expr(index_node->index_expr.array);
-        Value *index_val = eval_expr(index_node->index_expr.index);
-        Value *value = eval_expr(node->assign_index.value);
+        // Only the array being stored into is copied, and only if something else shares it
+        Value *array = eval_writable(index_node->index_expr.array);
+        Value index_val = eval_value(index_node->index_expr.index);
+        Value value = eval_value(node->assign_index.value);
 
-        if (!array || array->type != VAL_ARRAY)
+        if (array && array->type == VAL_MAP)
         {
-            report_error("[Emit] ASSIGN_INDEX: array is not valid");
+            if (!store_entry(array, &index_val, &value))
+                report_error("[Emit] ASSIGN_INDEX: map key is not a string");
             break;
         }
 
-        if (!index_val || index_val->type != VAL_NUMBER)
+        if (!array || array->type != VAL_ARRAY)
         {
-            report_error("[Emit] ASSIGN_INDEX: index is not a number");
+            report_error("[Emit] ASSIGN_INDEX: array is not valid");
             break;
         }
 
-        if (!value)
+        if (index_val.type != VAL_NUMBER)
         {
-            report_error("[Emit] ASSIGN_INDEX: value is NULL");
-            value = make_number_value(0); // fallback
+            report_error("[Emit] ASSIGN_INDEX: index is not a number");
+            break;
         }
 
-        int i = (int)(index_val->number);
+        int i = (int)(index_val.number);
         if (i < 0)
         {
             report_error("[Emit] ASSIGN_INDEX: index %d is negative", i);
             break;
         }
 
-        if ((size_t)i >= array->array.count)
-        {
-            // Expand array
-            size_t new_count = i + 1;
-            Value **new_items = realloc(array->array.items, sizeof(Value *) * new_count);
-            if (!new_items)
-            {
-                fprintf(stderr, "[ASSIGN_INDEX] realloc failed for array items\n");
-                return;
-            }
+        if (!store_item(array, (size_t)i, &value))
+            report_error("[Emit] ASSIGN_INDEX: array cannot grow");
+        break;
+    }
 
-            // Initialize new elements
-            for (size_t j = array->array.count; j < new_count; j++)
-            {
-                new_items[j] = make_number_value(0); // or NULL if you want sparse arrays
-            }
+    case AST_ARRAY_LITERAL:
+    {
+        Runtime *rt = get_runtime();
+        rt->statement_count++;
+
+        break;
+    }
+
+    default:
+
+        report_error("[Emit] Unrecognized node type: %d", node->type);
 
-            array->array.items = new_items;
-            array->array.count = new_count;
+        break;
+    }
+}
+void emit_gcode(ASTNode *node)
+{
+    // Temporaries the statement evaluated are dropped once it has run
+    ScratchMark mark = scratch_mark();
+    emit_statement(node);
+    scratch_release(mark);
+}
+/// @brief Runs a numeric FOR loop of the flat AST
+static void emit_flat_for(const FlatAst *ast, const FlatNode *node)
+{
+    Runtime *rt = get_runtime();
+    rt->statement_count++;
+
+    const char *var = ast->names[node->a];
+    const FlatIndex *parts = &ast->lists[node->b];   // index, from, to, step, iterable, slot
+    int var_slot = (int)parts[5];
+    FlatIndex body = node->c;
+
+    Value v_from = eval_flat_value(ast, parts[1]);
+    Value v_to = eval_flat_value(ast, parts[2]);
+    Value v_step = parts[3] != FLAT_NONE ? eval_flat_value(ast, parts[3]) : number_value(1.0);
+
+    double from, to, step;
+    if (!for_range(&v_from, &v_to, &v_step, &from, &to, &step))
+        return;
+
+    extern int runtime_has_returned;
+
+    if (step > 0)
+    {
+        double end = (node->flags & FLAT_FOR_EXCLUSIVE) ? to : to + 1e-9;
+        for (double i = from; i < end; i += step)
+        {
+            Value counter = number_value(i);
+            set_var_slot(var_slot, var, &counter);
+            emit_gcode_flat(ast, body);
+            if (runtime_has_returned)
+                break;
         }
+    }
+    else
+    {
+        double end = (node->flags & FLAT_FOR_EXCLUSIVE) ? to : to - 1e-9;
+        for (double i = from; i > end; i += step)
+        {
+            Value counter = number_value(i);
+            set_var_slot(var_slot, var, &counter);
+            emit_gcode_flat(ast, body);
+            if (runtime_has_returned)
+                break;
+        }
+    }
+}
+
+/// @brief emit_statement() for the flat AST
+static void emit_flat_statement(const FlatAst *ast, FlatIndex index)
+{
+    if (index == FLAT_NONE)
+        return;
+
+    const FlatNode *node = &ast->nodes[index];
+    Runtime *rt = get_runtime();
+
+    switch (node->type)
+    {
+    case AST_RETURN:
+    case AST_NOP:
+        break;
 
-        if (array->array.items[i])
+    case AST_EXPR_STMT:
+        if (node->a != FLAT_NONE)
+        {
+            emit_gcode_flat(ast, node->a);
+            rt->statement_count++;
+        }
+        else
         {
-            free_value(array->array.items[i]);
+            report_error("[Emit AST_EXPR_STMT] EXPR_STMT has NULL expr");
         }
-        array->array.items[i] = copy_value(value);
+        break;
 
+    case AST_LET:
+    {
+        rt->statement_count++;
+        const char *name = ast->names[node->a];
+        Value val = eval_flat_value(ast, node->b);
+        set_var_slot((int)node->c, name, &val);
+        break;
+    }
 
+    case AST_ASSIGN:
+    {
+        rt->statement_count++;
+        Value val = eval_flat_value(ast, node->b);
+        assign_checked((int)node->c, ast->names[node->a], &val);
+        break;
+    }
 
+    case AST_COMPOUND_ASSIGN:
+        rt->statement_count++;
+        eval_flat_expr(ast, index);
+        break;
+
+    case AST_CALL:
+        eval_flat_expr(ast, index);
+        rt->statement_count++;
+        break;
+
+    case AST_GCODE:
+    {
+        rt->statement_count++;
+        char line[256];
+        const FlatIndex *words = &ast->lists[node->b];   // code id, modal key id, then letter, value pairs
+        size_t len = begin_gcode_line(line, sizeof(line), ast->names[node->a], (int)words[0], (int)words[1]);
+
+        for (int i = 0; i < (int)node->c; i++)
+        {
+            FlatIndex expr = words[2 + 2 * i + 1];
+            Value val = expr != FLAT_NONE ? eval_flat_value(ast, expr) : number_value(0.0);
+            len = append_gcode_arg(line, sizeof(line), len, i, (int)words[2 + 2 * i], expr != FLAT_NONE, &val);
+        }
+
+        write_line_to_output(line, len);
         break;
     }
 
-    case AST_ARRAY_LITERAL:
+    case AST_BLOCK:
+        for (int i = 0; i < (int)node->b; i++)
+        {
+            FlatIndex stmt = ast->lists[node->a + i];
+            if (stmt == FLAT_NONE)
+            {
+                report_error("[Emit] NULL statement in block index %d", i);
+                continue;
+            }
+            emit_gcode_flat(ast, stmt);
+        }
+        break;
+
+    case AST_IF:
     {
-        Runtime *rt = get_runtime();
         rt->statement_count++;
+        double cond;
+        Value cond_val = eval_flat_value(ast, node->a);
+        if (!if_condition(&cond_val, &cond))
+            break;
+        if (cond)
+            emit_gcode_flat(ast, node->b);
+        else
+            emit_gcode_flat(ast, node->c);
+        break;
+    }
 
+    case AST_MATCH:
+    {
+        rt->statement_count++;
+        Value subject = eval_flat_value(ast, node->a);
+        int arm = match_arm(ast->origin[index], &subject);
+        FlatIndex branch = ast->lists[node->b + (arm >= 0 ? (uint32_t)arm : node->c)];
+        if (branch != FLAT_NONE)
+            emit_gcode_flat(ast, branch);
         break;
     }
 
-    default:
+    case AST_WHILE:
+    {
+        rt->statement_count++;
+        extern int runtime_has_returned;
+        for (int iteration = 0;; iteration++)
+        {
+            ScratchMark mark = scratch_mark();
+            Value cond = eval_flat_value(ast, node->a);
+            scratch_release(mark);
+            if (!while_continues(&cond, iteration))
+                break;
+            emit_gcode_flat(ast, node->b);
+            if (runtime_has_returned)
+                break;
+        }
+        break;
+    }
 
-        report_error("[Emit] Unrecognized node type: %d", node->type);
+    case AST_FOR:
+        if (node->a == FLAT_NONE || node->c == FLAT_NONE || (node->flags & FLAT_FOR_STRING))
+            emit_gcode(ast->origin[index]);
+        else
+            emit_flat_for(ast, node);
+        break;
 
+    default:
+        // Notes, function definitions and indexed stores run from the pointer tree
+        emit_gcode(ast->origin[index]);
         break;
     }
-}
\ No newline at end of file
+}
+
+void emit_gcode_flat(const FlatAst *ast, FlatIndex index)
+{
+    ScratchMark mark = scratch_mark();
+    emit_flat_statement(ast, index);
+    scratch_release(mark);
+}
@@ -2,16 +2,29 @@
 #define EMITTER_H
 
 #include "parser/parser.h"
+#include "parser/flat_ast.h"
+#include "runtime/evaluator.h"
 
 extern int statement_count; 
 
 
 void emit_gcode(ASTNode* node);
+void emit_gcode_flat(const FlatAst *ast, FlatIndex index);
 
 void emit_block_stmt(ASTNode* node);
 int get_statement_count();
 void reset_emitter_state(void);
 
+// Pieces of statements shared by the tree walker and the bytecode VM
+size_t begin_gcode_line(char *line, size_t size, const char *code, int code_id, int modal_key_id);
+size_t append_gcode_arg(char *line, size_t size, size_t len, int i, int letter, int has_expr, const Value *v);
+size_t append_note_segment(char *buffer, size_t size, size_t used, const NoteSegment *segment, const Value *val);
+void assign_checked(int slot, const char *name, Value *val);
+int while_continues(const Value *cond, int iteration);
+int for_range(const Value *v_from, const Value *v_to, const Value *v_step,
+              double *from, double *to, double *step);
+int if_condition(const Value *cond_val, double *cond);
+
 
 
 #endif // EMITTER_H
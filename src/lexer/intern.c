@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../error/error.h"
+#include "intern.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#define INTERN_LOCKING 1
+#endif
+
+#define INTERN_CHUNK_SIZE 16384
+#define INTERN_INITIAL_SLOTS 256
+
+// Every one-byte string, built by the compiler: shared by all tables and never written
+#define BYTE_1(b) {(char)(b), '\0'}
+#define BYTE_4(b) BYTE_1(b), BYTE_1((b) + 1), BYTE_1((b) + 2), BYTE_1((b) + 3)
+#define BYTE_16(b) BYTE_4(b), BYTE_4((b) + 4), BYTE_4((b) + 8), BYTE_4((b) + 12)
+#define BYTE_64(b) BYTE_16(b), BYTE_16((b) + 16), BYTE_16((b) + 32), BYTE_16((b) + 48)
+static const char single_bytes[256][2] = {BYTE_64(0), BYTE_64(64), BYTE_64(128), BYTE_64(192)};
+
+const char *intern_byte(unsigned char byte)
+{
+    return single_bytes[byte];
+}
+
+/// @brief FNV-1a hash over a byte slice
+static unsigned int intern_hash(const char *text, int length)
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// @brief Copies a slice into chunk storage and NUL-terminates it
+static char *intern_store(InternTable *table, const char *text, int length)
+{
+    size_t needed = (size_t)length + 1;
+
+    if (table->chunk_count == 0 || table->chunk_used + needed > table->chunk_size)
+    {
+        size_t size = needed > INTERN_CHUNK_SIZE ? needed : INTERN_CHUNK_SIZE;
+        char **chunks = realloc(table->chunks, sizeof(char *) * (table->chunk_count + 1));
+        if (!chunks)
+            return NULL;
+        table->chunks = chunks;
+
+        char *chunk = malloc(size);
+        if (!chunk)
+            return NULL;
+        table->chunks[table->chunk_count++] = chunk;
+        table->chunk_used = 0;
+        table->chunk_size = size;
+    }
+
+    char *dst = table->chunks[table->chunk_count - 1] + table->chunk_used;
+    memcpy(dst, text, length);
+    dst[length] = '\0';
+    table->chunk_used += needed;
+    table->bytes += needed;
+    return dst;
+}
+
+/// @brief Rebuilds the slot index with a new power-of-two capacity
+static int intern_rehash(InternTable *table, int new_capacity)
+{
+    int *slots = calloc(new_capacity, sizeof(int));
+    if (!slots)
+        return 0;
+
+    for (int id = 0; id < table->count; id++)
+    {
+        int mask = new_capacity - 1;
+        int slot = (int)(table->hashes[id] & (unsigned int)mask);
+        while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        slots[slot] = id + 1;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->slot_capacity = new_capacity;
+    return 1;
+}
+
+/// @brief Takes the table's lock while a lexer thread interns into it too
+static void intern_lock(InternTable *table)
+{
+#ifdef INTERN_LOCKING
+    if (table->lock)
+        pthread_mutex_lock(table->lock);
+#else
+    (void)table;
+#endif
+}
+
+static void intern_unlock(InternTable *table)
+{
+#ifdef INTERN_LOCKING
+    if (table->lock)
+        pthread_mutex_unlock(table->lock);
+#else
+    (void)table;
+#endif
+}
+
+static int intern_id_locked(InternTable *table, const char *text, int length)
+{
+
+    if (table->slot_capacity == 0 && !intern_rehash(table, INTERN_INITIAL_SLOTS))
+    {
+        report_error("[Intern] ERROR: malloc failed for intern index");
+        return -1;
+    }
+
+    unsigned int hash = intern_hash(text, length);
+    int mask = table->slot_capacity - 1;
+    int slot = (int)(hash & (unsigned int)mask);
+
+    while (table->slots[slot] != 0)
+    {
+        int id = table->slots[slot] - 1;
+        if (table->hashes[id] == hash && table->lengths[id] == length &&
+            memcmp(table->texts[id], text, length) == 0)
+            return id;
+        slot = (slot + 1) & mask;
+    }
+
+    // Not present: append a new entry
+    if (table->count >= table->capacity)
+    {
+        int new_capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+        const char **texts = realloc((void *)table->texts, sizeof(char *) * new_capacity);
+        if (texts)
+            table->texts = texts;
+        int *lengths = realloc(table->lengths, sizeof(int) * new_capacity);
+        if (lengths)
+            table->lengths = lengths;
+        unsigned int *hashes = realloc(table->hashes, sizeof(unsigned int) * new_capacity);
+        if (hashes)
+            table->hashes = hashes;
+        if (!texts || !lengths || !hashes)
+        {
+            report_error("[Intern] ERROR: realloc failed for intern entries");
+            return -1;
+        }
+        table->capacity = new_capacity;
+    }
+
+    const char *stored = length <= 1 ? intern_byte(length ? (unsigned char)text[0] : 0)
+                                     : intern_store(table, text, length);
+    if (!stored)
+    {
+        report_error("[Intern] ERROR: malloc failed for interned text");
+        return -1;
+    }
+
+    int id = table->count++;
+    table->texts[id] = stored;
+    table->lengths[id] = length;
+    table->hashes[id] = hash;
+    table->slots[slot] = id + 1;
+
+    // Keep the load factor under 1/2 so probe chains stay short
+    if (table->count * 2 > table->slot_capacity)
+        intern_rehash(table, table->slot_capacity * 2);
+
+    return id;
+}
+
+int intern_id(InternTable *table, const char *text, int length)
+{
+    if (!table || !text || length < 0)
+        return -1;
+
+    intern_lock(table);
+    int id = intern_id_locked(table, text, length);
+    intern_unlock(table);
+    return id;
+}
+
+int intern_find(InternTable *table, const char *text, int length)
+{
+    if (!table || !text || length < 0)
+        return -1;
+
+    intern_lock(table);
+    int found = -1;
+    if (table->slot_capacity > 0)
+    {
+        unsigned int hash = intern_hash(text, length);
+        int mask = table->slot_capacity - 1;
+        for (int slot = (int)(hash & (unsigned int)mask); table->slots[slot] != 0; slot = (slot + 1) & mask)
+        {
+            int id = table->slots[slot] - 1;
+            if (table->hashes[id] == hash && table->lengths[id] == length &&
+                memcmp(table->texts[id], text, length) == 0)
+            {
+                found = id;
+                break;
+            }
+        }
+    }
+    intern_unlock(table);
+    return found;
+}
+
+const char *intern_slice(InternTable *table, const char *text, int length)
+{
+    return intern_text(table, intern_id(table, text, length));
+}
+
+const char *intern_text(const InternTable *table, int id)
+{
+    if (!table || id < 0)
+        return NULL;
+
+    // `texts` moves when the table grows
+    InternTable *shared = (InternTable *)table;
+    intern_lock(shared);
+    const char *text = id < table->count ? table->texts[id] : NULL;
+    intern_unlock(shared);
+    return text;
+}
+
+void intern_table_free(InternTable *table)
+{
+    if (!table)
+        return;
+
+    for (int i = 0; i < table->chunk_count; i++)
+        free(table->chunks[i]);
+    free(table->chunks);
+    free((void *)table->texts);
+    free(table->lengths);
+    free(table->hashes);
+    free(table->slots);
+    memset(table, 0, sizeof(InternTable));
+}
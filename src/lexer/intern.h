@@ -0,0 +1,83 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Per-compilation string interning table.
+ *
+ * Every distinct identifier, G-code word and literal seen by the lexer is
+ * stored exactly once and given a stable integer id. The returned text is
+ * NUL-terminated and stays valid until the table is freed, so AST nodes can
+ * keep the pointer instead of owning a copy.
+ */
+typedef struct {
+    char **chunks;          // text storage, never moved once allocated
+    int chunk_count;
+    size_t chunk_used;      // bytes used in the last chunk
+    size_t chunk_size;      // size of the last chunk
+
+    const char **texts;     // id -> interned text
+    int *lengths;           // id -> text length
+    unsigned int *hashes;   // id -> cached hash
+    int count;
+    int capacity;
+
+    int *slots;             // open-addressing index, stores id + 1 (0 = empty)
+    int slot_capacity;      // always a power of two
+
+    size_t bytes;           // total text bytes interned
+
+    void *lock;             // pthread mutex while a lexer thread shares the table, else NULL
+} InternTable;
+
+/**
+ * @brief Intern a byte slice and return its stable id.
+ * @param table The table to intern into.
+ * @param text Start of the text (does not need to be NUL-terminated).
+ * @param length Number of bytes to intern.
+ * @return The id of the interned text, or -1 on allocation failure.
+ */
+int intern_id(InternTable *table, const char *text, int length);
+
+/**
+ * @brief Look up a byte slice without interning it.
+ * @return The id of the text, or -1 if it has never been interned.
+ */
+int intern_find(InternTable *table, const char *text, int length);
+
+/**
+ * @brief The static one-byte string for `byte`, "" for byte 0.
+ *
+ * Interning a slice of at most one byte returns this text rather than a copy,
+ * so a string taken apart character by character needs no storage and still
+ * compares by pointer with interned literals.
+ */
+const char *intern_byte(unsigned char byte);
+
+/**
+ * @brief Intern a byte slice and return the stable interned text.
+ * @return NUL-terminated interned copy, or NULL on allocation failure.
+ */
+const char *intern_slice(InternTable *table, const char *text, int length);
+
+/**
+ * @brief Look up the interned text for an id.
+ * @return The interned text, or NULL for an invalid id.
+ */
+const char *intern_text(const InternTable *table, int id);
+
+/**
+ * @brief Release all storage owned by the table and reset it to empty.
+ */
+void intern_table_free(InternTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INTERN_H
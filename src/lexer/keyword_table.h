@@ -12,7 +12,8 @@
     X("function", TOKEN_FUNCTION) \
     X("return", TOKEN_RETURN) \
     X("step",    TOKEN_STEP) \
-    X("in",      TOKEN_IN)
+    X("in",      TOKEN_IN) \
+    X("match",   TOKEN_MATCH)
 
 #define TOKEN_OPERATOR_LIST \
     X("==", TOKEN_EQUAL_EQUAL, "==", 0) \
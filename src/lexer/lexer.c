@@ -2,13 +2,22 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
-#include "../utils/compat.h"
+#include <stdint.h>
+#include <stdarg.h>
 #include "../error/error.h"
+#include "../config/config.h"
 #include "lexer.h"
 #include "token_utils.h"
 
+static void init_lexer_tables(void);
 
 
+
+#define LEXER_CHUNK_SIZE 65536
+#define LEXER_LOOKBEHIND 256
+
+/// @brief Creates a lexer over `source`
+/// @param source NUL-terminated text; borrowed, so it must outlive the lexer
 Lexer *lexer_new(const char *source) {
      //printf("[lexer_new]\n");
     if (!source) {
@@ -16,61 +25,231 @@ Lexer *lexer_new(const char *source) {
         return NULL;
     }
 
-    // Safe defensive copy
-    char *copy = strdup(source);
-    if (!copy) {
-        report_error("[Lexer] ERROR: strdup failed");
-        return NULL;
-    }
-
-    //printf("[Lexer] Copied string to internal buffer:\n---\n%s\n---\n", copy);
-
-    Lexer *lexer = (Lexer *)malloc(sizeof(Lexer));
+    Lexer *lexer = (Lexer *)calloc(1, sizeof(Lexer));
     if (!lexer) {
         report_error("[Lexer] ERROR: malloc failed for lexer struct");
-        free(copy);
         return NULL;
     }
 
-    lexer->source = copy;
+    lexer->source = source;
     lexer->pos = 0;
     lexer->line = 1;
     lexer->column = 1;
+    lexer->strings = &get_runtime()->strings;
+    lexer->window_line = 1;
+    init_lexer_tables();
 
     //printf("[Lexer] Lexer successfully created. Starting at line 1, column 1\n");
 
     return lexer;
 }
 
+/// @brief Creates a lexer that pulls its input in chunks from `read`
+/// @note Only a sliding window around the current token is kept in memory
+Lexer *lexer_new_stream(LexerReadFn read, void *context)
+{
+    if (!read) {
+        report_error("[Lexer] ERROR: stream reader is NULL!");
+        return NULL;
+    }
+
+    Lexer *lexer = (Lexer *)calloc(1, sizeof(Lexer));
+    char *window = malloc(LEXER_CHUNK_SIZE + 1);
+    if (!lexer || !window) {
+        report_error("[Lexer] ERROR: malloc failed for stream lexer");
+        free(lexer);
+        free(window);
+        return NULL;
+    }
+
+    window[0] = '\0';
+    lexer->source = window;
+    lexer->window = window;
+    lexer->window_capacity = LEXER_CHUNK_SIZE + 1;
+    lexer->line = 1;
+    lexer->column = 1;
+    lexer->strings = &get_runtime()->strings;
+    lexer->read = read;
+    lexer->read_context = context;
+    lexer->window_line = 1;
+    init_lexer_tables();
+    return lexer;
+}
+
 /// @brief Frees the memory for a lexer
 /// @param lexer The lexer to free
+/// @note The source text is borrowed and is not freed here
 void lexer_free(Lexer *lexer)
 {
     if (lexer) {
-        if (lexer->source) {
-            free((char*)lexer->source);
-            lexer->source = NULL;
-        }
+        free(lexer->scratch);
+        free(lexer->window);
+        for (int i = 0; i < LEXER_NUMBER_RING; i++)
+            free(lexer->numbers[i]);
         free(lexer);
     }
 }
 
+/// @brief Slides the stream window forward and reads until `source[pos + ahead]` exists
+/// @return 1 if the byte is available, 0 at end of input or on allocation failure
+static int lexer_fill(Lexer *lexer, int64_t ahead)
+{
+    // Drop bytes before the current token, keeping a little lookbehind for
+    // the unary-minus check
+    int64_t drop = lexer->keep - LEXER_LOOKBEHIND - lexer->window_offset;
+    if (drop > lexer->pos)
+        drop = lexer->pos;
+
+    if (drop > 0) {
+        for (int64_t i = 0; i < drop; i++)
+            if (lexer->window[i] == '\n')
+                lexer->window_line++;
+        memmove(lexer->window, lexer->window + drop, (size_t)(lexer->window_length - drop) + 1);
+        lexer->window_length -= drop;
+        lexer->window_offset += drop;
+        lexer->pos -= drop;
+    }
+
+    while (!lexer->at_end && lexer->pos + ahead >= lexer->window_length) {
+        if (lexer->window_capacity - (size_t)lexer->window_length - 1 < LEXER_CHUNK_SIZE) {
+            size_t capacity = lexer->window_capacity * 2;
+            char *window = realloc(lexer->window, capacity);
+            if (!window) {
+                report_error("[Lexer] ERROR: realloc failed for stream window");
+                lexer->at_end = 1;
+                break;
+            }
+            lexer->window = window;
+            lexer->window_capacity = capacity;
+        }
+
+        size_t space = lexer->window_capacity - (size_t)lexer->window_length - 1;
+        size_t n = lexer->read(lexer->read_context, lexer->window + lexer->window_length, space);
+        if (n == 0)
+            lexer->at_end = 1;
+        lexer->window_length += (int64_t)n;
+        lexer->window[lexer->window_length] = '\0';
+    }
+
+    lexer->source = lexer->window;
+    return lexer->pos + ahead < lexer->window_length;
+}
+
+/// @brief Returns `source[pos + ahead]`, refilling the stream window when it runs out
+static char char_at(Lexer *lexer, int64_t ahead)
+{
+    char c = lexer->source[lexer->pos + ahead];
+    if (c == '\0' && lexer->read && lexer->pos + ahead >= lexer->window_length && !lexer->at_end) {
+        lexer_fill(lexer, ahead);
+        c = lexer->source[lexer->pos + ahead];
+    }
+    return c;
+}
+
+/// @brief Absolute input offset of the next unread byte
+static int64_t lexer_offset(const Lexer *lexer)
+{
+    return lexer->window_offset + lexer->pos;
+}
+
+/// @brief Pointer to the byte at an absolute input offset still held in the window
+static const char *lexer_text_at(const Lexer *lexer, int64_t offset)
+{
+    return lexer->source + (offset - lexer->window_offset);
+}
+
+/// @brief Reports a lexical error, or holds it for the token array to report in order
+static void lexer_error(Lexer *lexer, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    if (lexer->defer_errors)
+        vsnprintf(lexer->error, sizeof(lexer->error), format, args);
+    else
+    {
+        char message[sizeof(lexer->error)];
+        vsnprintf(message, sizeof(message), format, args);
+        report_error("%s", message);
+    }
+    va_end(args);
+}
+
+/// @brief Builds a token that borrows `value` and records its source slice
+/// @param start Absolute input offset of the first byte of the token
+static Token slice_token(Lexer *lexer, Token_Type type, const char *value, int id, int64_t start, int line, int column)
+{
+    Token token = make_token(type, value, line, column);
+    token.id = id;
+    token.offset = start;
+    token.length = (int)(lexer->window_offset + lexer->pos - start);
+    return token;
+}
+
+/// @brief Interns a source slice and builds a token for it
+static Token interned_token(Lexer *lexer, Token_Type type, const char *text, int len, int64_t start, int line, int column)
+{
+    int id = intern_id(lexer->strings, text, len);
+    return slice_token(lexer, type, intern_text(lexer->strings, id), id, start, line, column);
+}
+
+/// @brief Builds a number token; streamed input copies the text into a small ring instead of interning it
+static Token number_token(Lexer *lexer, const char *text, int len, int64_t start, int line, int column)
+{
+    if (!lexer->read)
+        return interned_token(lexer, TOKEN_NUMBER, text, len, start, line, column);
+
+    // The parser only looks at the current and previous token, so a short ring is enough
+    int slot = lexer->number_next;
+    lexer->number_next = (slot + 1) % LEXER_NUMBER_RING;
+    if (lexer->number_capacity[slot] < len + 1) {
+        int capacity = len + 1 < 32 ? 32 : len + 1;
+        char *buffer = realloc(lexer->numbers[slot], capacity);
+        if (!buffer) {
+            lexer_error(lexer, "[Lexer] ERROR: Memory allocation failed for number literal");
+            return slice_token(lexer, TOKEN_UNKNOWN, "", -1, start, line, column);
+        }
+        lexer->numbers[slot] = buffer;
+        lexer->number_capacity[slot] = capacity;
+    }
+    memcpy(lexer->numbers[slot], text, len);
+    lexer->numbers[slot][len] = '\0';
+    return slice_token(lexer, TOKEN_NUMBER, lexer->numbers[slot], -1, start, line, column);
+}
+
+/// @brief Ensures the scratch buffer can hold `needed` bytes
+static int reserve_scratch(Lexer *lexer, int needed)
+{
+    if (needed <= lexer->scratch_capacity)
+        return 1;
+
+    int capacity = lexer->scratch_capacity == 0 ? 64 : lexer->scratch_capacity;
+    while (capacity < needed)
+        capacity *= 2;
+
+    char *buffer = realloc(lexer->scratch, capacity);
+    if (!buffer)
+        return 0;
+    lexer->scratch = buffer;
+    lexer->scratch_capacity = capacity;
+    return 1;
+}
+
 /// @brief Peeks at the current character
 static char peek(Lexer *lexer)
 {
     if (!lexer || !lexer->source)
         return '\0';
 
-    return lexer->source[lexer->pos];
+    return char_at(lexer, 0);
 }
 
 /// @brief Peeks at the next character
 static char peek_next(Lexer *lexer)
 {
-    if (!lexer || !lexer->source)
+    if (!lexer || !lexer->source || peek(lexer) == '\0')
         return '\0';
 
-    return lexer->source[lexer->pos + 1];
+    return char_at(lexer, 1);
 }
 
 /// @brief Peeks ahead by a fixed offset
@@ -79,8 +258,7 @@ static char peek_ahead(Lexer *lexer, int offset)
     if (!lexer || !lexer->source)
         return '\0';
 
-    int pos = lexer->pos + offset;
-    return lexer->source[pos] != '\0' ? lexer->source[pos] : '\0';
+    return char_at(lexer, offset);
 }
 
 /// @brief Advances the lexer by one character
@@ -111,6 +289,8 @@ static void skip_whitespace(Lexer *lexer)
 {
     while (1)
     {
+        // Everything before this point may be dropped from a stream window
+        lexer->keep = lexer->window_offset + lexer->pos;
         char c = peek(lexer);
 
  if (c == '\n') {
@@ -126,7 +306,10 @@ static void skip_whitespace(Lexer *lexer)
         else if (c == '/' && peek_next(lexer) == '/')
         {
             while (peek(lexer) != '\n' && peek(lexer) != '\0')
+            {
                 advance(lexer);
+                lexer->keep = lexer->window_offset + lexer->pos;
+            }
         }
         else if (c == '/' && peek_next(lexer) == '*')
         {
@@ -140,6 +323,7 @@ static void skip_whitespace(Lexer *lexer)
                     lexer->column = 1;
                 }
                 advance(lexer);
+                lexer->keep = lexer->window_offset + lexer->pos;
             }
             if (peek(lexer) == '*' && peek_next(lexer) == '/')
             {
@@ -154,18 +338,233 @@ static void skip_whitespace(Lexer *lexer)
     }
 }
 
-/// @brief Lookup keyword and return its token type
-static Token_Type keyword_lookup(const char *word)
-{
-#define X(name, type) if (strcmp(word, name) == 0) return type;
+// Keywords and built-in names, generated from the X-macro tables
+typedef struct {
+    const char *text;
+    int length;
+    Token_Type type;
+} KeywordEntry;
+
+static const KeywordEntry keyword_entries[] = {
+#define X(name, type) { name, (int)sizeof(name) - 1, type },
     KEYWORD_LIST
     TOKEN_FUNCTION_LIST
 #undef X
+};
+
+#define KEYWORD_COUNT ((int)(sizeof(keyword_entries) / sizeof(keyword_entries[0])))
+#define KEYWORD_SLOTS 256
+#define KEYWORD_MAX_SEED 100000
+
+// Perfect hash over keyword_entries: slot -> entry index + 1 (0 = empty)
+static unsigned char keyword_slots[KEYWORD_SLOTS];
+static unsigned int keyword_seed;
+static int keyword_max_length;
+static int keyword_hashed;
+
+/// @brief Multiplicative hash over the length and three sample characters of a word
+static unsigned int keyword_hash(const char *word, int len, unsigned int seed)
+{
+    unsigned int h = (unsigned int)len
+                   ^ ((unsigned int)(unsigned char)word[0] << 8)
+                   ^ ((unsigned int)(unsigned char)word[len / 2] << 16)
+                   ^ ((unsigned int)(unsigned char)word[len - 1] << 24);
+    h *= seed;
+    return h >> 24;
+}
+
+/// @brief Searches for a seed that places every keyword in its own slot
+static int build_keyword_hash(void)
+{
+    keyword_max_length = 0;
+    for (int i = 0; i < KEYWORD_COUNT; i++)
+        if (keyword_entries[i].length > keyword_max_length)
+            keyword_max_length = keyword_entries[i].length;
+
+    for (unsigned int seed = 0x9E3779B1u; seed < 0x9E3779B1u + 2 * KEYWORD_MAX_SEED; seed += 2)
+    {
+        memset(keyword_slots, 0, sizeof(keyword_slots));
+        int ok = 1;
+        for (int i = 0; i < KEYWORD_COUNT && ok; i++)
+        {
+            unsigned int slot = keyword_hash(keyword_entries[i].text, keyword_entries[i].length, seed);
+            if (keyword_slots[slot])
+                ok = 0;
+            else
+                keyword_slots[slot] = (unsigned char)(i + 1);
+        }
+        if (ok)
+        {
+            keyword_seed = seed;
+            return 1;
+        }
+    }
+    memset(keyword_slots, 0, sizeof(keyword_slots));
+    return 0;
+}
+
+// Operators, delimiters and dot patterns grouped by their first character.
+// Each group keeps the X-macro order so longer matches still win first.
+typedef struct {
+    const char *text;
+    int length;
+    Token_Type type;
+} OperatorEntry;
+
+static const OperatorEntry operator_entries[] = {
+#define X(text, type, str, ch) { text, (int)sizeof(text) - 1, type },
+    TOKEN_OPERATOR_LIST
+    TOKEN_DELIMITER_LIST
+    TOKEN_DOT_LIST
+#undef X
+};
+
+#define OPERATOR_COUNT ((int)(sizeof(operator_entries) / sizeof(operator_entries[0])))
+
+static unsigned char operator_order[OPERATOR_COUNT];
+static unsigned char operator_start[256];
+static unsigned char operator_group_size[256];
+
+/// @brief Stable counting sort of operator entries by first character
+static void build_operator_dispatch(void)
+{
+    memset(operator_group_size, 0, sizeof(operator_group_size));
+    for (int i = 0; i < OPERATOR_COUNT; i++)
+        operator_group_size[(unsigned char)operator_entries[i].text[0]]++;
+
+    int next = 0;
+    for (int ch = 0; ch < 256; ch++)
+    {
+        operator_start[ch] = (unsigned char)next;
+        next += operator_group_size[ch];
+    }
+
+    unsigned char filled[256] = {0};
+    for (int i = 0; i < OPERATOR_COUNT; i++)
+    {
+        unsigned char first = (unsigned char)operator_entries[i].text[0];
+        operator_order[operator_start[first] + filled[first]++] = (unsigned char)i;
+    }
+}
+
+static int lexer_tables_ready;
+
+/// @brief Builds the keyword hash and operator dispatch tables once
+static void init_lexer_tables(void)
+{
+    if (lexer_tables_ready)
+        return;
+
+    // Without a seed keyword_lookup falls back to a linear scan
+    keyword_hashed = build_keyword_hash();
+    build_operator_dispatch();
+    lexer_tables_ready = 1;
+}
+
+/// @brief Compares two short strings with overlapping fixed-width loads
+/// @note Keywords are at most 16 bytes, so this avoids a memcmp call per identifier
+static int short_equals(const char *a, const char *b, int len)
+{
+    if (len >= 8)
+    {
+        uint64_t a0, a1, b0, b1;
+        memcpy(&a0, a, 8); memcpy(&a1, a + len - 8, 8);
+        memcpy(&b0, b, 8); memcpy(&b1, b + len - 8, 8);
+        return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+    }
+    if (len >= 4)
+    {
+        uint32_t a0, a1, b0, b1;
+        memcpy(&a0, a, 4); memcpy(&a1, a + len - 4, 4);
+        memcpy(&b0, b, 4); memcpy(&b1, b + len - 4, 4);
+        return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+    }
+    if (len >= 2)
+    {
+        uint16_t a0, a1, b0, b1;
+        memcpy(&a0, a, 2); memcpy(&a1, a + len - 2, 2);
+        memcpy(&b0, b, 2); memcpy(&b1, b + len - 2, 2);
+        return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+    }
+    return len == 0 || a[0] == b[0];
+}
+
+/// @brief Linear fallback used only if no perfect hash seed was found
+static Token_Type keyword_scan(const char *word, int len, const char **text)
+{
+    for (int i = 0; i < KEYWORD_COUNT; i++)
+    {
+        if (keyword_entries[i].length == len && memcmp(word, keyword_entries[i].text, len) == 0)
+        {
+            *text = keyword_entries[i].text;
+            return keyword_entries[i].type;
+        }
+    }
     return TOKEN_IDENTIFIER;
 }
 
-/// @brief Main lexer function to get the next token
-Token lexer_next_token(Lexer *lexer)
+/// @brief Lookup keyword and return its token type
+/// @param text Output: static keyword text when a keyword matches
+static Token_Type keyword_lookup(const char *word, int len, const char **text)
+{
+    if (len > keyword_max_length)
+        return TOKEN_IDENTIFIER;
+
+    // Slots stay empty if no seed was found, which routes every lookup to the scan
+    int index = keyword_slots[keyword_hash(word, len, keyword_seed)];
+    if (index == 0)
+        return keyword_hashed ? TOKEN_IDENTIFIER : keyword_scan(word, len, text);
+
+    const KeywordEntry *entry = &keyword_entries[index - 1];
+    if (entry->length != len || !short_equals(word, entry->text, len))
+        return TOKEN_IDENTIFIER;
+
+    *text = entry->text;
+    return entry->type;
+}
+
+/// @brief Whether the bytes after the current one spell out the rest of operator `op`
+/// @note Each byte is read only once the one before it matched, so the scan stops at the
+///       terminating NUL instead of reading past it (or past the end of an mmap view)
+static int operator_follows(Lexer *lexer, const OperatorEntry *op)
+{
+    for (int k = 1; k < op->length; k++)
+    {
+        if (peek_ahead(lexer, k) != op->text[k])
+            return 0;
+    }
+    return 1;
+}
+
+Token_Type lexer_keyword_type(const char *word, int length)
+{
+    init_lexer_tables();
+    const char *text = NULL;
+    return keyword_lookup(word, length, &text);
+}
+
+Token_Type lexer_operator_type(const char *text, int *length)
+{
+    init_lexer_tables();
+    unsigned char first = (unsigned char)text[0];
+    for (int i = 0; i < operator_group_size[first]; i++)
+    {
+        const OperatorEntry *op = &operator_entries[operator_order[operator_start[first] + i]];
+        int k = 1;
+        while (k < op->length && text[k] == op->text[k])
+            k++;
+        if (k == op->length)
+        {
+            *length = op->length;
+            return op->type;
+        }
+    }
+    *length = 0;
+    return TOKEN_UNKNOWN;
+}
+
+/// @brief Lexes one ordinary token
+static Token lex_token(Lexer *lexer)
 {
 
     //printf("[lexer_next_token] peek: '%c' (0x%02X) at pos: %d\n", peek(lexer), peek(lexer), lexer->pos);
@@ -178,68 +577,56 @@ Token lexer_next_token(Lexer *lexer)
     char c = peek(lexer);
 
     if (c == '\0')
-        return make_token(TOKEN_EOF, "EOF", lexer->line, lexer->column);
+        return slice_token(lexer, TOKEN_EOF, "EOF", -1, lexer_offset(lexer), lexer->line, lexer->column);
 
     // Identifiers, keywords, G-code words
 if (isalpha(c) || c == '_') {
-    int start = lexer->pos; // mark start before any advance
+    int64_t start = lexer_offset(lexer); // mark start before any advance
     advance(lexer); // consume the first character
 
     while (isalnum(peek(lexer)) || peek(lexer) == '_')
         advance(lexer);
 
 
-int len = lexer->pos - start;
-char *word = strndup_portable(&lexer->source[start], len);
+int len = (int)(lexer_offset(lexer) - start);
+const char *word = lexer_text_at(lexer, start);
+const char *keyword = NULL;
 
-Token_Type type = keyword_lookup(word);
+Token_Type type = keyword_lookup(word, len, &keyword);
+if (keyword)
+    return slice_token(lexer, type, keyword, -1, start, lexer->line, start_col);
 
-if (type == TOKEN_IDENTIFIER && (word[0] == 'G' || word[0] == 'M' || word[0] == 'T'))
+if (word[0] == 'G' || word[0] == 'M' || word[0] == 'T')
     type = TOKEN_GCODE_WORD;
 
-Token token = make_token(type, word, lexer->line, start_col);
-free(word);  // Free the temporary word buffer
-return token;
+return interned_token(lexer, type, word, len, start, lexer->line, start_col);
 
 }
 
     // String literals
     if (c == '"') {
+        int64_t start = lexer_offset(lexer);
         int start_line = lexer->line;
         int start_column = lexer->column;
         advance(lexer); // consume opening quote
         
-        // Calculate buffer size needed (worst case: every char is escaped)
-        int capacity = 64;
-        char *buffer = malloc(capacity);
-        if (!buffer) {
-            report_error("[Lexer] ERROR: Memory allocation failed for string literal");
-            return make_token(TOKEN_UNKNOWN, "", lexer->line, start_col);
-        }
-        
         int len = 0;
         
         while (peek(lexer) != '"' && peek(lexer) != '\0') {
-            // Expand buffer if needed
-            if (len >= capacity - 2) {
-                capacity *= 2;
-                char *new_buffer = realloc(buffer, capacity);
-                if (!new_buffer) {
-                    free(buffer);
-                    report_error("[Lexer] ERROR: Memory allocation failed for string literal");
-                    return make_token(TOKEN_UNKNOWN, "", lexer->line, start_col);
-                }
-                buffer = new_buffer;
+            // Expand the reusable decode buffer if needed
+            if (!reserve_scratch(lexer, len + 2)) {
+                lexer_error(lexer, "[Lexer] ERROR: Memory allocation failed for string literal");
+                return slice_token(lexer, TOKEN_UNKNOWN, "", -1, start, lexer->line, start_col);
             }
+            char *buffer = lexer->scratch;
             
             char ch = peek(lexer);
             if (ch == '\\') {
                 advance(lexer); // consume backslash
                 char escaped = peek(lexer);
                 if (escaped == '\0') {
-                    free(buffer);
-                    report_error("[Lexer] ERROR: Unterminated string literal at line %d, column %d", start_line, start_column);
-                    return make_token(TOKEN_UNKNOWN, "", lexer->line, start_col);
+                    lexer_error(lexer, "[Lexer] ERROR: Unterminated string literal at line %d, column %d", start_line, start_column);
+                    return slice_token(lexer, TOKEN_UNKNOWN, "", -1, start, lexer->line, start_col);
                 }
                 
                 switch (escaped) {
@@ -256,8 +643,7 @@ return token;
                         buffer[len++] = '\\';
                         break;
                     default:
-                        free(buffer);
-                        report_error("[Lexer] ERROR: Invalid escape sequence '\\%c' at line %d, column %d", escaped, lexer->line, lexer->column);
+                        lexer_error(lexer, "[Lexer] ERROR: Invalid escape sequence '\\%c' at line %d, column %d", escaped, lexer->line, lexer->column);
                         // Consume the rest of the string to avoid further parsing errors
                         while (peek(lexer) != '"' && peek(lexer) != '\0') {
                             advance(lexer);
@@ -265,7 +651,7 @@ return token;
                         if (peek(lexer) == '"') {
                             advance(lexer); // consume closing quote
                         }
-                        return make_token(TOKEN_UNKNOWN, "", lexer->line, start_col);
+                        return slice_token(lexer, TOKEN_UNKNOWN, "", -1, start, lexer->line, start_col);
                 }
                 advance(lexer); // consume escaped character
             } else {
@@ -275,17 +661,13 @@ return token;
         }
         
         if (peek(lexer) != '"') {
-            free(buffer);
-            report_error("[Lexer] ERROR: Unterminated string literal at line %d, column %d", start_line, start_column);
-            return make_token(TOKEN_UNKNOWN, "", lexer->line, start_col);
+            lexer_error(lexer, "[Lexer] ERROR: Unterminated string literal at line %d, column %d", start_line, start_column);
+            return slice_token(lexer, TOKEN_UNKNOWN, "", -1, start, lexer->line, start_col);
         }
         
         advance(lexer); // consume closing quote
-        buffer[len] = '\0';
         
-        Token token = make_token(TOKEN_STRING, buffer, start_line, start_column);
-        free(buffer);
-        return token;
+        return interned_token(lexer, TOKEN_STRING, len ? lexer->scratch : "", len, start, start_line, start_column);
     }
 
     // Number literals (including negative and dot-prefixed)
@@ -294,18 +676,21 @@ return token;
     {
         int allow_unary = 0;
         if (c == '-') {
-            int prev = lexer->pos - 1;
+            // Look back over whitespace (stream windows keep a short lookbehind)
+            int64_t prev = lexer->pos - 1;
             while (prev > 0 && isspace(lexer->source[prev]))
                 prev--;
-            if (prev == 0 || lexer->source[prev] == '=' || lexer->source[prev] == '(' || lexer->source[prev] == '[')
+            if (prev < 0 || (prev == 0 && lexer->window_offset == 0) ||
+                lexer->source[prev] == '=' || lexer->source[prev] == '(' || lexer->source[prev] == '[')
                 allow_unary = 1;
         } else {
             allow_unary = 1;
         }
 
         if (allow_unary) {
-            int start = lexer->pos;
+            int64_t start = lexer_offset(lexer);
             int seen_dot = 0;
+            int extra_dots = 0;
             advance(lexer);
 
             while (1) {
@@ -320,6 +705,7 @@ return token;
                         seen_dot = 1;
                         advance(lexer);
                     } else {
+                        extra_dots = 1;
                         advance(lexer);
                     }
                 } else {
@@ -327,56 +713,110 @@ return token;
                 }
             }
 
-            int len = lexer->pos - start;
-         char *num = strndup_portable(&lexer->source[start], len);
-            int j = 0, dot_seen = 0;
-            for (int i = 0; i < len; i++) {
-                if (num[i] == '.') {
-                    if (!dot_seen) {
-                        dot_seen = 1;
-                        num[j++] = '.';
+            int len = (int)(lexer_offset(lexer) - start);
+            const char *num = lexer_text_at(lexer, start);
+
+            // Repeated dots collapse to the first one ("1.2.3" -> "1.23"),
+            // which is the only case that needs a scratch copy
+            if (extra_dots) {
+                if (!reserve_scratch(lexer, len + 1)) {
+                    lexer_error(lexer, "[Lexer] ERROR: Memory allocation failed for number literal");
+                    return slice_token(lexer, TOKEN_UNKNOWN, "", -1, start, lexer->line, start_col);
+                }
+                int j = 0, dot_seen = 0;
+                for (int i = 0; i < len; i++) {
+                    if (num[i] == '.') {
+                        if (!dot_seen) {
+                            dot_seen = 1;
+                            lexer->scratch[j++] = '.';
+                        }
+                    } else {
+                        lexer->scratch[j++] = num[i];
                     }
-                } else {
-                    num[j++] = num[i];
                 }
+                return number_token(lexer, lexer->scratch, j, start, lexer->line, start_col);
             }
-            num[j] = '\0';
-            Token token = make_token(TOKEN_NUMBER, num, lexer->line, start_col);
-            free(num);  // Free the temporary num buffer
-            return token;
+            return number_token(lexer, num, len, start, lexer->line, start_col);
         }
     }
 
 // Special check for '...', '..<', and '..'
 if (c == '.' && peek_next(lexer) == '.' && peek_ahead(lexer, 2) == '.') {
     advance(lexer); advance(lexer); advance(lexer);
-    return make_token(TOKEN_DOTDOTDOT, "...", lexer->line, start_col);
+    return slice_token(lexer, TOKEN_DOTDOTDOT, "...", -1, lexer_offset(lexer) - 3, lexer->line, start_col);
 }
 if (c == '.' && peek_next(lexer) == '.' && peek_ahead(lexer, 2) == '<') {
     advance(lexer); advance(lexer); advance(lexer);
-    return make_token(TOKEN_DOTDOT_LT, "..<", lexer->line, start_col);
+    return slice_token(lexer, TOKEN_DOTDOT_LT, "..<", -1, lexer_offset(lexer) - 3, lexer->line, start_col);
 }
 if (c == '.' && peek_next(lexer) == '.') {
     advance(lexer); advance(lexer);
-    return make_token(TOKEN_DOTDOT, "..", lexer->line, start_col);
+    return slice_token(lexer, TOKEN_DOTDOT, "..", -1, lexer_offset(lexer) - 2, lexer->line, start_col);
 }
 
     // General operators, delimiters, dot
-#define X(text, type, str, ch) \
-    if (strncmp(&lexer->source[lexer->pos], text, strlen(text)) == 0) { \
-        lexer->pos += strlen(text); \
-        lexer->column += strlen(text); \
-        return make_token(type, text, lexer->line, start_col); \
+    unsigned char first = (unsigned char)c;
+    for (int i = 0; i < operator_group_size[first]; i++)
+    {
+        const OperatorEntry *op = &operator_entries[operator_order[operator_start[first] + i]];
+        if (op->length == 1 || operator_follows(lexer, op))
+        {
+            int64_t start = lexer_offset(lexer);
+            lexer->pos += op->length;
+            lexer->column += op->length;
+            return slice_token(lexer, op->type, op->text, -1, start, lexer->line, start_col);
+        }
     }
 
-    TOKEN_OPERATOR_LIST
-    TOKEN_DELIMITER_LIST
-    TOKEN_DOT_LIST
-
-#undef X
-
     // Unknown character fallback
+    int64_t start = lexer_offset(lexer);
     advance(lexer);
-    char unknown[2] = {c, '\0'};
-    return make_token(TOKEN_UNKNOWN, unknown, lexer->line, start_col);
+    return interned_token(lexer, TOKEN_UNKNOWN, lexer_text_at(lexer, start), 1, start, lexer->line, start_col);
+}
+
+/// @brief Captures the raw body of `note { ... }` up to its matching '}'
+/// @note The closing brace is left for the next token; an unterminated
+///       note runs to the end of input.
+static Token lex_note_text(Lexer *lexer)
+{
+    int64_t start = lexer_offset(lexer);
+    int line = lexer->line;
+    int column = lexer->column;
+    int depth = 1;
+
+    lexer->keep = start;
+    while (1)
+    {
+        char c = peek(lexer);
+        if (c == '\0')
+            break;
+        if (c == '{')
+            depth++;
+        else if (c == '}' && --depth == 0)
+            break;
+        advance(lexer);
+    }
+
+    return slice_token(lexer, TOKEN_NOTE_TEXT, lexer_text_at(lexer, start), -1, start, line, column);
+}
+
+/// @brief Main lexer function to get the next token
+Token lexer_next_token(Lexer *lexer)
+{
+    Token token = lexer->note_state == 2 ? lex_note_text(lexer) : lex_token(lexer);
+
+    // note { ... } bodies are free text, so the lexer hands them over in one piece
+    if (token.type == TOKEN_NOTE)
+        lexer->note_state = 1;
+    else if (lexer->note_state == 1 && token.type == TOKEN_LBRACE)
+        lexer->note_state = 2;
+    else
+        lexer->note_state = 0;
+    return token;
+}
+
+const char *lexer_error_source(const Lexer *lexer)
+{
+    error_source_first_line = lexer->window_line;
+    return lexer->source;
 }
@@ -1,25 +1,80 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "token_types.h"
 #include "keyword_table.h"
+#include "intern.h"
 
+// Tokens do not own their text: `value` is either static operator/keyword
+// text, a string interned in the compilation's InternTable, or (for numbers
+// read from a stream) a small lexer-owned buffer valid for a few tokens.
+// TOKEN_NOTE_TEXT is the exception: `value` points at the raw source slice
+// and only its first `length` bytes belong to the token.
 typedef struct {
     Token_Type type;
-    char* value;
+    const char* value;
+    int id;         // intern id for identifiers, G-code words and literals, -1 otherwise
+    int64_t offset; // absolute byte offset of the token in the input
+    int length;     // byte length of the token in the input
     int line;
     int column;
 } Token;
 
+/** @brief Reads up to `capacity` bytes of streamed input, returns 0 at end of input. */
+typedef size_t (*LexerReadFn)(void* context, char* buffer, size_t capacity);
+
+#define LEXER_NUMBER_RING 4
+
 typedef struct {
-    const char* source;
-    int pos;
+    const char* source;     // borrowed, NUL-terminated (may be an mmap view), or the stream window
+    int64_t pos;            // index into source
     int line;
     int column;
+    InternTable* strings;   // borrowed from the runtime
+    char* scratch;          // reusable buffer for decoding string literals
+    int scratch_capacity;
+
+    // Streaming input; `read` is NULL when the whole source is in memory
+    LexerReadFn read;
+    void* read_context;
+    char* window;           // owned buffer that `source` points into
+    size_t window_capacity;
+    int64_t window_length;
+    int64_t window_offset;  // absolute input offset of source[0]
+    int window_line;        // line number of source[0]
+    int64_t keep;           // absolute offset the window must still hold
+    int at_end;
+
+    int note_state;         // 1 after `note`, 2 after `note {`: next token is the raw body
+    int defer_errors;       // hold errors in `error` instead of reporting them
+    char error[256];        // pending lexical error, empty when none
+
+    // Stream mode does not intern numbers, so memory stays bounded
+    char* numbers[LEXER_NUMBER_RING];
+    int number_capacity[LEXER_NUMBER_RING];
+    int number_next;
 } Lexer;
 
 Lexer* lexer_new(const char* source);
+Lexer* lexer_new_stream(LexerReadFn read, void* context);
 void lexer_free(Lexer* lexer);     
 Token lexer_next_token(Lexer* lexer);
 
+/** @brief Token type of keyword or built-in name `word`, TOKEN_IDENTIFIER for any other word. */
+Token_Type lexer_keyword_type(const char* word, int length);
+
+/**
+ * @brief Operator, delimiter or dot pattern that NUL-terminated `text` starts with.
+ * @param length Output: its length, 0 with TOKEN_UNKNOWN when none matches.
+ */
+Token_Type lexer_operator_type(const char* text, int* length);
+
+/**
+ * @brief Source text for error context, with the line number of its first byte.
+ * @note For streamed input this is the current window, not the whole file.
+ */
+const char* lexer_error_source(const Lexer* lexer);
+
 #endif // LEXER_H
@@ -0,0 +1,342 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../error/error.h"
+#include "token_array.h"
+#include "token_utils.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#define TOKEN_ARRAY_THREADS 1
+#endif
+
+// Token types are stored in a byte per token
+typedef char token_type_fits_in_a_byte[TOKEN_UNKNOWN < 256 ? 1 : -1];
+
+// The lexer thread wakes the parser at most once per this many tokens
+#define TOKEN_PUBLISH_INTERVAL 1024
+
+struct TokenArrayThread {
+#ifdef TOKEN_ARRAY_THREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_mutex_t intern_lock;    // shared with the parser thread through InternTable.lock
+    int published;              // tokens the lexer has handed over, guarded by lock
+    int done;                   // guarded by lock
+    int cancel;                 // guarded by lock
+#else
+    int unused;
+#endif
+};
+
+/// @brief Appends one lexed token, allocating its block on first use
+/// @return 0 when out of memory
+static int append_token(TokenArray *tokens, const Token *token)
+{
+    int block = tokens->count / TOKEN_BLOCK_SIZE;
+    int slot = tokens->count % TOKEN_BLOCK_SIZE;
+
+    if (block >= tokens->block_capacity)
+        return 0;
+    if (!tokens->blocks[block])
+    {
+        tokens->blocks[block] = malloc(sizeof(TokenBlock));
+        if (!tokens->blocks[block])
+            return 0;
+    }
+
+    TokenBlock *b = tokens->blocks[block];
+    b->types[slot] = (uint8_t)token->type;
+    b->starts[slot] = token->offset;
+    b->lengths[slot] = token->length;
+    b->ids[slot] = token->id;
+    b->values[slot] = token->value;
+    tokens->count++;
+    return 1;
+}
+
+/// @brief Keeps the lexer's pending error for the token that was just appended
+static void record_error(TokenArray *tokens)
+{
+#ifdef TOKEN_ARRAY_THREADS
+    // The parser thread reads the list while reporting
+    if (tokens->thread)
+        pthread_mutex_lock(&tokens->thread->lock);
+#endif
+    if (tokens->error_count >= tokens->error_capacity)
+    {
+        int capacity = tokens->error_capacity ? tokens->error_capacity * 2 : 8;
+        TokenError *errors = realloc(tokens->errors, capacity * sizeof(TokenError));
+        if (errors)
+        {
+            tokens->errors = errors;
+            tokens->error_capacity = capacity;
+        }
+    }
+    if (tokens->error_count < tokens->error_capacity)
+    {
+        tokens->errors[tokens->error_count].index = tokens->count - 1;
+        tokens->errors[tokens->error_count].message = strdup(tokens->lexer->error);
+        tokens->error_count++;
+    }
+#ifdef TOKEN_ARRAY_THREADS
+    if (tokens->thread)
+        pthread_mutex_unlock(&tokens->thread->lock);
+#endif
+}
+
+#ifdef TOKEN_ARRAY_THREADS
+/// @brief Makes `count` tokens visible to the parser thread
+/// @return 1 if the parser has asked the lexer to stop
+static int publish(TokenArray *tokens, int done)
+{
+    struct TokenArrayThread *t = tokens->thread;
+    pthread_mutex_lock(&t->lock);
+    t->published = tokens->count;
+    t->done = done;
+    int cancel = t->cancel;
+    pthread_cond_signal(&t->ready);
+    pthread_mutex_unlock(&t->lock);
+    return cancel;
+}
+#endif
+
+/// @brief Lexes the whole source into the array
+static void fill_tokens(TokenArray *tokens)
+{
+    while (1)
+    {
+        Token token = lexer_next_token(tokens->lexer);
+        if (!append_token(tokens, &token))
+        {
+            // The parser sees EOF here; only the inline path may report directly
+            if (!tokens->thread)
+                report_error("[Lexer] ERROR: Memory allocation failed for token array");
+            break;
+        }
+        if (tokens->lexer->error[0])
+        {
+            record_error(tokens);
+            tokens->lexer->error[0] = '\0';
+        }
+        if (token.type == TOKEN_EOF)
+            break;
+
+#ifdef TOKEN_ARRAY_THREADS
+        if (tokens->thread && tokens->count % TOKEN_PUBLISH_INTERVAL == 0 && publish(tokens, 0))
+            return;
+#endif
+    }
+
+#ifdef TOKEN_ARRAY_THREADS
+    if (tokens->thread)
+    {
+        publish(tokens, 1);
+        return;
+    }
+#endif
+    tokens->visible = tokens->count;
+    tokens->finished = 1;
+}
+
+#ifdef TOKEN_ARRAY_THREADS
+static void *lexer_thread_main(void *context)
+{
+    fill_tokens(context);
+    return NULL;
+}
+
+/// @brief Starts the lexer thread; returns 0 if it could not be started
+static int start_thread(TokenArray *tokens)
+{
+    struct TokenArrayThread *t = calloc(1, sizeof(*t));
+    if (!t)
+        return 0;
+
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->ready, NULL);
+    pthread_mutex_init(&t->intern_lock, NULL);
+    tokens->thread = t;
+    // The parser interns G-code words and note placeholders while the lexer runs
+    tokens->lexer->strings->lock = &t->intern_lock;
+    if (pthread_create(&t->thread, NULL, lexer_thread_main, tokens) != 0)
+    {
+        tokens->lexer->strings->lock = NULL;
+        pthread_mutex_destroy(&t->intern_lock);
+        pthread_cond_destroy(&t->ready);
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+        tokens->thread = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+/// @brief Waits until token `index` exists or the lexer thread is done
+static void wait_for_token(TokenArray *tokens, int index)
+{
+    struct TokenArrayThread *t = tokens->thread;
+    pthread_mutex_lock(&t->lock);
+    while (t->published <= index && !t->done)
+        pthread_cond_wait(&t->ready, &t->lock);
+    tokens->visible = t->published;
+    tokens->finished = t->done;
+    pthread_mutex_unlock(&t->lock);
+}
+#endif
+
+/// @brief Lexes `source` into contiguous token blocks, inline or on a lexer thread
+TokenArray *token_array_new(const char *source, int use_thread)
+{
+    TokenArray *tokens = calloc(1, sizeof(TokenArray));
+    if (!tokens)
+        return NULL;
+
+    tokens->source = source;
+    tokens->source_length = (int64_t)strlen(source);
+    tokens->lexer = lexer_new(source);
+
+    // Every token but the final EOF consumes at least one byte
+    tokens->block_capacity = (int)(tokens->source_length / TOKEN_BLOCK_SIZE) + 2;
+    tokens->blocks = calloc(tokens->block_capacity, sizeof(TokenBlock *));
+    if (!tokens->lexer || !tokens->blocks)
+    {
+        token_array_free(tokens);
+        return NULL;
+    }
+    tokens->lexer->defer_errors = 1;
+
+#ifdef TOKEN_ARRAY_THREADS
+    if (use_thread && start_thread(tokens))
+        return tokens;
+#else
+    (void)use_thread;
+#endif
+
+    fill_tokens(tokens);
+    return tokens;
+}
+
+Token token_array_at(TokenArray *tokens, int index)
+{
+#ifdef TOKEN_ARRAY_THREADS
+    if (index >= tokens->visible && !tokens->finished)
+        wait_for_token(tokens, index);
+#endif
+    // Past the end (or after an allocation failure) the parser keeps seeing EOF
+    if (index >= tokens->visible || index < 0)
+    {
+        Token eof = make_token(TOKEN_EOF, "EOF", 0, 0);
+        eof.offset = tokens->source_length;
+        return eof;
+    }
+
+    const TokenBlock *b = tokens->blocks[index / TOKEN_BLOCK_SIZE];
+    int slot = index % TOKEN_BLOCK_SIZE;
+
+    Token token = make_token((Token_Type)b->types[slot], b->values[slot], 0, 0);
+    token.id = b->ids[slot];
+    token.offset = b->starts[slot];
+    token.length = b->lengths[slot];
+
+    // Lexical errors surface when the parser reaches their token
+    if (token.type == TOKEN_UNKNOWN)
+    {
+#ifdef TOKEN_ARRAY_THREADS
+        if (tokens->thread)
+            pthread_mutex_lock(&tokens->thread->lock);
+#endif
+        while (tokens->next_error < tokens->error_count && tokens->errors[tokens->next_error].index <= index)
+            report_error("%s", tokens->errors[tokens->next_error++].message);
+#ifdef TOKEN_ARRAY_THREADS
+        if (tokens->thread)
+            pthread_mutex_unlock(&tokens->thread->lock);
+#endif
+    }
+    return token;
+}
+
+/// @brief Records where every line starts so positions can be found by binary search
+static int build_line_index(TokenArray *tokens)
+{
+    int capacity = 64;
+    tokens->line_starts = malloc(capacity * sizeof(int64_t));
+    if (!tokens->line_starts)
+        return 0;
+
+    tokens->line_starts[0] = 0;
+    tokens->line_count = 1;
+    const char *p = tokens->source;
+    const char *end = tokens->source + tokens->source_length;
+    while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL)
+    {
+        if (tokens->line_count >= capacity)
+        {
+            capacity *= 2;
+            int64_t *grown = realloc(tokens->line_starts, capacity * sizeof(int64_t));
+            if (!grown)
+                return 0;
+            tokens->line_starts = grown;
+        }
+        tokens->line_starts[tokens->line_count++] = ++p - tokens->source;
+    }
+    return 1;
+}
+
+void token_array_position(TokenArray *tokens, int64_t offset, int *line, int *column)
+{
+    if (!tokens->line_starts && !build_line_index(tokens))
+    {
+        *line = 1;
+        *column = (int)offset + 1;
+        return;
+    }
+
+    // Last line start at or before offset
+    int low = 0, high = tokens->line_count - 1;
+    while (low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if (tokens->line_starts[mid] <= offset)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    *line = low + 1;
+    *column = (int)(offset - tokens->line_starts[low]) + 1;
+}
+
+void token_array_free(TokenArray *tokens)
+{
+    if (!tokens)
+        return;
+
+#ifdef TOKEN_ARRAY_THREADS
+    if (tokens->thread)
+    {
+        struct TokenArrayThread *t = tokens->thread;
+        pthread_mutex_lock(&t->lock);
+        t->cancel = 1;
+        pthread_mutex_unlock(&t->lock);
+        pthread_join(t->thread, NULL);
+        tokens->lexer->strings->lock = NULL;
+        pthread_mutex_destroy(&t->intern_lock);
+        pthread_cond_destroy(&t->ready);
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+    }
+#endif
+
+    if (tokens->blocks)
+    {
+        for (int i = 0; i < tokens->block_capacity; i++)
+            free(tokens->blocks[i]);
+        free(tokens->blocks);
+    }
+    for (int i = 0; i < tokens->error_count; i++)
+        free(tokens->errors[i].message);
+    free(tokens->errors);
+    free(tokens->line_starts);
+    lexer_free(tokens->lexer);
+    free(tokens);
+}
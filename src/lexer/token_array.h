@@ -0,0 +1,90 @@
+#ifndef TOKEN_ARRAY_H
+#define TOKEN_ARRAY_H
+
+#include <stdint.h>
+#include "lexer.h"
+
+/** @brief Tokens per block; blocks never move once the lexer has filled them */
+#define TOKEN_BLOCK_SIZE 4096
+
+/** @brief Sources at least this large are lexed on a separate thread */
+#define TOKEN_ARRAY_THREAD_MIN (1 << 20)
+
+/**
+ * @brief One block of the pre-tokenized source, stored as parallel arrays.
+ *
+ * Line and column are not stored: they are derived from `starts` on demand
+ * with token_array_position(), which only error reporting needs.
+ */
+typedef struct {
+    uint8_t types[TOKEN_BLOCK_SIZE];        // Token_Type
+    int64_t starts[TOKEN_BLOCK_SIZE];       // absolute byte offset in the source
+    int32_t lengths[TOKEN_BLOCK_SIZE];
+    int32_t ids[TOKEN_BLOCK_SIZE];          // intern id, -1 when none
+    const char *values[TOKEN_BLOCK_SIZE];   // static or interned text (see Token)
+} TokenBlock;
+
+typedef struct {
+    int index;          // token the error belongs to (always TOKEN_UNKNOWN)
+    char *message;
+} TokenError;
+
+struct TokenArrayThread;
+
+/**
+ * @brief The whole source lexed up front into contiguous token blocks.
+ *
+ * The parser indexes into this array instead of pulling tokens one at a time,
+ * so lookahead is a load and tokens are never freed individually. Lexical
+ * errors are reported when the parser reaches the offending token, matching
+ * the order of the incremental lexer.
+ */
+typedef struct TokenArray {
+    const char *source;         // borrowed, NUL-terminated
+    int64_t source_length;
+    Lexer *lexer;
+
+    TokenBlock **blocks;        // sized up front: a token covers at least one byte
+    int block_capacity;
+    int count;                  // tokens written by the lexer
+    int visible;                // tokens the parser may read without synchronizing
+    int finished;
+
+    TokenError *errors;
+    int error_count;
+    int error_capacity;
+    int next_error;             // first error not yet reported
+
+    int64_t *line_starts;       // built on the first position lookup
+    int line_count;
+
+    struct TokenArrayThread *thread;    // NULL when lexed inline
+} TokenArray;
+
+/**
+ * @brief Lex `source` into a token array.
+ * @param source NUL-terminated text; borrowed, so it must outlive the array.
+ * @param use_thread Lex on a background thread while the caller parses
+ *        (ignored where threads are unavailable).
+ * @return The array, or NULL on allocation failure.
+ */
+TokenArray *token_array_new(const char *source, int use_thread);
+
+/**
+ * @brief Token at `index`, waiting for the lexer thread if needed.
+ * @note Indices past the end return the final TOKEN_EOF. The token's line and
+ *       column are 0; use token_array_position() when they are needed.
+ */
+Token token_array_at(TokenArray *tokens, int index);
+
+/**
+ * @brief Line and column (1-based) of an absolute source offset.
+ */
+void token_array_position(TokenArray *tokens, int64_t offset, int *line, int *column);
+
+/**
+ * @brief Stop the lexer thread if one is running and release the array.
+ */
+void token_array_free(TokenArray *tokens);
+
+#endif // TOKEN_ARRAY_H
@@ -27,6 +27,7 @@ typedef enum {
     TOKEN_NUMBER,
     TOKEN_STRING,
     TOKEN_GCODE_WORD,      // G0, G1, M3, etc.
+    TOKEN_NOTE_TEXT,       // raw body of note { ... }
 
     // Special
     TOKEN_BLOCK_COMMENT,   // /% %/
@@ -13,7 +13,10 @@
 Token make_token(Token_Type type, const char *value, int line, int column) {
     Token token;
     token.type = type;
-    token.value = strdup(value);  // Duplicate the string for safety
+    token.value = value;  // Borrowed: interned or static text
+    token.id = -1;
+    token.offset = 0;
+    token.length = 0;
     token.line = line;
     token.column = column;
 
@@ -21,9 +24,7 @@ Token make_token(Token_Type type, const char *value, int line, int column) {
 }
 
 void token_free(Token token) {
-    if (token.value) {
-        free(token.value);
-    }
+    (void)token;  // Nothing owned
 }
 
 
@@ -11,15 +11,18 @@ extern "C" {
 /**
  * @brief Create a new Token object.
  * @param type Token_Type enum value.
- * @param value The string value of the token (will be duplicated).
+ * @param value The text of the token (borrowed, must outlive the token).
  * @param line Line number where the token appears.
  * @param column Column number where the token starts.
- * @return A populated Token struct.
+ * @return A populated Token struct with no source slice or intern id.
  */
 Token make_token(Token_Type type, const char *value, int line, int column);
 
 /**
- * @brief Free memory associated with a Token (its value string).
+ * @brief Release a Token.
+ *
+ * Tokens borrow their text from the intern table or from static storage,
+ * so this is a no-op kept for API compatibility.
  * @param token The token to clean up.
  */
 void token_free(Token token);
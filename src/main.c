@@ -29,7 +29,10 @@
 
 #include "config/config.h"
 #include "parser/parser.h"
+#include "parser/resolver.h"
+#include "parser/optimizer.h"
 #include "runtime/evaluator.h"
+#include "runtime/bytecode.h"
 #include "utils/output_buffer.h"
 #include "generator/emitter.h"
 #include "utils/file_utils.h"
@@ -44,7 +47,10 @@
 // Declare the runtime variable lookup functions from evaluator.c
 const char* GGCODE_INPUT_FILENAME = NULL;
 void compile_file(const char* input_path, const char* output_path, bool quiet);
+void compile_stream(FILE* input, const char* input_name, const char* output_path, bool quiet);
 void compile_eval(const char* code);
+int compare_engines(const char* input_path);
+int dump_optimized_ast(const char* input_path);
 void compile_all_files_cli(const CLIArgs* args);
 
 
@@ -64,20 +70,8 @@ int ends_with_ggcode(const char *filename) {
 }
 
 
-void compile_file(const char* input_path, const char* output_path, bool quiet) {
-    // Initialize runtime state
-    init_runtime();
-    Runtime* runtime = get_runtime();
-
-    // Reset configuration state for clean compilation
-    reset_config_state();
-
-    GGCODE_INPUT_FILENAME = input_path;
-    long input_size_bytes = 0;
-    runtime->statement_count = 0;
-    reset_runtime_state();
-
-    // Store filename only (no path)
+// Store filename only (no path) and the compile time in the runtime state
+static const char* set_runtime_source_info(Runtime* runtime, const char* input_path) {
 #if defined(_WIN32)
     const char* last_slash = strrchr(input_path, '\\');
     const char* filename = last_slash ? last_slash + 1 : input_path;
@@ -100,23 +94,99 @@ void compile_file(const char* input_path, const char* output_path, bool quiet) {
 
     // Also update legacy globals for backward compatibility
     strftime(RUNTIME_TIME, sizeof(RUNTIME_TIME), "%Y-%m-%d %H:%M:%S", tm_info);
+    return filename;
+}
+
+// Measure peak memory usage (Linux/macOS/Windows)
+static long peak_memory_kb(void) {
+    long memory_kb = 0;
+
+#if defined(__linux__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    memory_kb = usage.ru_maxrss;
+
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        memory_kb = pmc.PeakWorkingSetSize / 1024;
+    }
+#endif
+    return memory_kb;
+}
+
+
+// Run programs with the tree walker instead of the bytecode VM (--tree-walker)
+static bool use_tree_walker = false;
+
+// A parsed program in the form the chosen engine runs
+typedef struct {
+    Bytecode code;
+    bool compiled;          // `code` holds the program
+    FlatAst flat;
+    FlatIndex flat_root;    // tree walker: root of the flat copy, FLAT_NONE to walk the pointer tree
+} Program;
+
+static void prepare_program(Program* program, ASTNode* root) {
+    program->compiled = !use_tree_walker && bytecode_compile(&program->code, root);
+    program->flat_root = FLAT_NONE;
+    if (!program->compiled) {
+        flat_ast_reset(&program->flat);
+        program->flat_root = flat_ast_append(&program->flat, root);
+    }
+}
+
+// Run the bytecode, else the flat AST, else the pointer tree if neither could be built
+static void emit_program(Program* program, ASTNode* root) {
+    if (program->compiled) {
+        emit_gcode_bytecode(&program->code);
+    } else if (program->flat_root != FLAT_NONE) {
+        emit_gcode_flat(&program->flat, program->flat_root);
+    } else {
+        emit_gcode(root);
+    }
+}
+
+static void free_program(Program* program) {
+    bytecode_free(&program->code);
+    flat_ast_free(&program->flat);
+}
+
+void compile_file(const char* input_path, const char* output_path, bool quiet) {
+    // Initialize runtime state
+    init_runtime();
+    Runtime* runtime = get_runtime();
+
+    // Reset configuration state for clean compilation
+    reset_config_state();
+
+    GGCODE_INPUT_FILENAME = input_path;
+    long input_size_bytes = 0;
+    runtime->statement_count = 0;
+    reset_runtime_state();
+
+    const char* filename = set_runtime_source_info(runtime, input_path);
 
-    // Load source
-    char* source = read_file_to_buffer(input_path, &input_size_bytes);
-    if (!source) {
+    // Map the source read-only; the lexer borrows these bytes directly
+    SourceView view;
+    if (!open_source_view(input_path, &view)) {
         if (!quiet) {
             fprintf(stderr, "Error: Failed to read input file '%s': %s\n", input_path, strerror(errno));
         }
         return;
     }
 
+    input_size_bytes = view.size;
     init_output_buffer();
 
     // Parse timing
     Timer parse_timer;
     start_timer(&parse_timer);
 
-    ASTNode* root = parse_script_from_string(source);
+    ASTNode* root = parse_script_from_string(view.data);
+    optimize_ast(root, 1);
+    Program program = {0};
+    prepare_program(&program, root);
     double parse_time = end_timer(&parse_timer);
 
     // Emit timing
@@ -124,26 +194,13 @@ void compile_file(const char* input_path, const char* output_path, bool quiet) {
     start_timer(&emit_timer);
 
  //   reset_line_number();
-    emit_gcode(root);
+    emit_program(&program, root);
     double emit_time = end_timer(&emit_timer);
 
     // ➤ Insert G-code header at the beginning AFTER emit
     emit_gcode_preamble(filename);
 
-// Measure memory usage (Linux/macOS/Windows)
-long memory_kb = 0;
-
-#if defined(__linux__) || defined(__APPLE__)
-    struct rusage usage;
-    getrusage(RUSAGE_SELF, &usage);
-    memory_kb = usage.ru_maxrss;
-
-#elif defined(_WIN32)
-    PROCESS_MEMORY_COUNTERS pmc;
-    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
-        memory_kb = pmc.PeakWorkingSetSize / 1024;
-    }
-#endif
+    long memory_kb = peak_memory_kb();
 
     // Output
     if (get_output_to_file()) {
@@ -163,11 +220,14 @@ long memory_kb = 0;
     long gcode_size_bytes = get_output_length();
 
     if (!quiet) {
-        print_compilation_report(input_size_bytes, gcode_size_bytes, parse_time, emit_time, memory_kb, runtime->statement_count);
+        print_compilation_report(input_size_bytes, gcode_size_bytes, parse_time, emit_time, memory_kb, runtime->statement_count,
+                                 runtime->ast_arena.peak, runtime->scratch.peak);
     }
 
-    free_ast(root);
-    free(source);
+    free_program(&program);
+    arena_free(&runtime->ast_arena);  // the whole AST at once
+    arena_free(&runtime->scratch);
+    close_source_view(&view);
     free_output_buffer();
 
 
@@ -180,6 +240,274 @@ if (has_errors()) {
 }
 }
 
+// Compile a file with the chosen engine and return a copy of its G-code (NULL if unreadable)
+static char* run_engine(const char* input_path, bool tree_walker, const char* compile_time) {
+    init_runtime();
+    Runtime* runtime = get_runtime();
+    reset_config_state();
+
+    GGCODE_INPUT_FILENAME = input_path;
+    runtime->statement_count = 0;
+    reset_runtime_state();
+    const char* filename = set_runtime_source_info(runtime, input_path);
+
+    // Both runs must stamp the same time into the preamble
+    strncpy(runtime->RUNTIME_TIME, compile_time, sizeof(runtime->RUNTIME_TIME) - 1);
+    strncpy(RUNTIME_TIME, compile_time, sizeof(RUNTIME_TIME) - 1);
+
+    SourceView view;
+    if (!open_source_view(input_path, &view)) {
+        return NULL;
+    }
+    init_output_buffer();
+
+    bool saved_engine = use_tree_walker;
+    use_tree_walker = tree_walker;
+    ASTNode* root = parse_script_from_string(view.data);
+    // The walker runs the program as written, so a comparison also checks the optimizer
+    if (!tree_walker) {
+        optimize_ast(root, 1);
+    }
+    Program program = {0};
+    prepare_program(&program, root);
+    emit_program(&program, root);
+    emit_gcode_preamble(filename);
+    use_tree_walker = saved_engine;
+
+    // Errors are part of the result: append them so a difference shows up
+    char* errors = has_errors() ? (char*)get_error_messages() : NULL;
+    const char* output = get_output_buffer() ? get_output_buffer() : "";
+    size_t length = get_output_buffer() ? get_output_length() : 0;
+    size_t error_length = errors ? strlen(errors) : 0;
+    char* result = malloc(length + error_length + 1);
+    if (result) {
+        memcpy(result, output, length);
+        memcpy(result + length, errors ? errors : "", error_length + 1);
+    }
+    free(errors);
+    clear_errors();
+
+    free_program(&program);
+    arena_free(&runtime->ast_arena);
+    arena_free(&runtime->scratch);
+    close_source_view(&view);
+    free_output_buffer();
+    return result;
+}
+
+// Report the first line where two outputs differ
+static void print_first_difference(const char* walker, const char* vm) {
+    int line = 1;
+    const char* walker_line = walker;
+    const char* vm_line = vm;
+    while (*walker && *walker == *vm) {
+        if (*walker == '\n') {
+            line++;
+            walker_line = walker + 1;
+            vm_line = vm + 1;
+        }
+        walker++;
+        vm++;
+    }
+    fprintf(stderr, "    line %d\n    tree walker: %.*s\n    bytecode:    %.*s\n", line,
+            (int)strcspn(walker_line, "\n"), walker_line, (int)strcspn(vm_line, "\n"), vm_line);
+}
+
+/// @brief Run a file on the tree walker and on the bytecode VM and compare the results
+/// @return 0 if both produced the same G-code and errors, 1 otherwise
+int compare_engines(const char* input_path) {
+    char compile_time[64];
+    time_t now = time(NULL);
+    strftime(compile_time, sizeof(compile_time), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    char* walker = run_engine(input_path, true, compile_time);
+    char* vm = run_engine(input_path, false, compile_time);
+    int status = 0;
+
+    if (!walker || !vm) {
+        fprintf(stderr, "Error: Failed to read input file '%s': %s\n", input_path, strerror(errno));
+        status = 1;
+    } else if (strcmp(walker, vm) != 0) {
+        printf("MISMATCH %s\n", input_path);
+        print_first_difference(walker, vm);
+        status = 1;
+    } else {
+        printf("ok       %s\n", input_path);
+    }
+
+    free(walker);
+    free(vm);
+    return status;
+}
+
+/// @brief Print the tree of a file as it is run, after optimize_ast()
+/// @return 0 on success, 1 if the file could not be read
+int dump_optimized_ast(const char* input_path) {
+    init_runtime();
+    Runtime* runtime = get_runtime();
+    reset_config_state();
+
+    GGCODE_INPUT_FILENAME = input_path;
+    reset_runtime_state();
+    set_runtime_source_info(runtime, input_path);
+
+    SourceView view;
+    if (!open_source_view(input_path, &view)) {
+        fprintf(stderr, "Error: Failed to read input file '%s': %s\n", input_path, strerror(errno));
+        return 1;
+    }
+
+    ASTNode* root = parse_script_from_string(view.data);
+    optimize_ast(root, 1);
+    dump_ast(stdout, root);
+
+    if (has_errors()) {
+        print_errors();
+        clear_errors();
+    }
+    arena_free(&runtime->ast_arena);
+    close_source_view(&view);
+    return 0;
+}
+
+// Flush the output buffer once it grows past this many bytes in --stream mode
+#define STREAM_FLUSH_THRESHOLD (64 * 1024)
+
+// State for compile_stream kept outside the setjmp frame
+typedef struct {
+    FILE* input;
+    FILE* out;
+    const char* filename;
+    long input_bytes;
+    long output_bytes;
+    bool preamble_written;
+    double parse_time;
+    double emit_time;
+    Program program;        // reused for every statement
+} StreamState;
+
+static size_t read_stream_chunk(void* context, char* buffer, size_t capacity) {
+    StreamState* state = context;
+    size_t n = fread(buffer, 1, capacity, state->input);
+    state->input_bytes += (long)n;
+    return n;
+}
+
+static void flush_stream_output(StreamState* state) {
+    // The preamble reads `id`, so it goes out with the first flushed chunk
+    if (!state->preamble_written) {
+        emit_gcode_preamble(state->filename);
+        state->preamble_written = true;
+    }
+    state->output_bytes += (long)flush_output_buffer(state->out);
+}
+
+// Parse and emit one statement at a time; returns false after a fatal error
+static bool stream_statements(StreamState* state) {
+    Runtime* runtime = get_runtime();
+
+    if (setjmp(fatal_error_jump_buffer)) {
+        fatal_error_triggered = 0;
+        return false;
+    }
+
+    parser_advance();
+    for (;;) {
+        Timer parse_timer;
+        start_timer(&parse_timer);
+        ArenaMark mark = arena_mark(&runtime->ast_arena);
+        ASTNode* stmt = parse_next_statement();
+        if (!stmt) {
+            state->parse_time += end_timer(&parse_timer);
+            break;
+        }
+        set_parents_recursive(stmt, NULL);
+        resolve_variables(stmt);
+        optimize_ast(stmt, 0);  // one statement is not the whole program: fold only
+        prepare_program(&state->program, stmt);
+        state->parse_time += end_timer(&parse_timer);
+
+        Timer emit_timer;
+        start_timer(&emit_timer);
+        unsigned generation = runtime->function_generation;
+        emit_program(&state->program, stmt);
+        state->emit_time += end_timer(&emit_timer);
+
+        // The function table points into the AST, so keep any statement that defined one
+        if (runtime->function_generation == generation) {
+            arena_release(&runtime->ast_arena, mark);
+        }
+
+        if (get_output_length() >= STREAM_FLUSH_THRESHOLD) {
+            flush_stream_output(state);
+        }
+    }
+    return true;
+}
+
+void compile_stream(FILE* input, const char* input_name, const char* output_path, bool quiet) {
+    // Initialize runtime state
+    init_runtime();
+    Runtime* runtime = get_runtime();
+    reset_config_state();
+
+    GGCODE_INPUT_FILENAME = input_name;
+    runtime->statement_count = 0;
+    reset_runtime_state();
+
+    StreamState state = { .input = input, .out = stdout };
+    state.filename = set_runtime_source_info(runtime, input_name);
+
+    // Output is written as it is produced, so the file is opened up front
+    if (get_output_to_file() && output_path) {
+        state.out = fopen(output_path, "w");
+        if (!state.out) {
+            if (!quiet) {
+                fprintf(stderr, "Error: Failed to write output file '%s': %s\n", output_path, strerror(errno));
+            }
+            return;
+        }
+    }
+
+    init_output_buffer();
+    enter_scope();
+    runtime_has_returned = 0;
+    runtime->current_scope_level = 0;
+    runtime->parser.lexer = lexer_new_stream(read_stream_chunk, &state);
+    reset_line_number();
+
+    stream_statements(&state);
+
+    // A fatal error frees the pending buffer; whatever was flushed before it stays written
+    flush_stream_output(&state);
+    if (state.out != stdout) {
+        fclose(state.out);
+    } else {
+        fflush(stdout);
+    }
+
+    // The report would interleave with G-code written to stdout
+    if (!quiet && state.out != stdout) {
+        print_compilation_report(state.input_bytes, state.output_bytes, state.parse_time, state.emit_time,
+                                 peak_memory_kb(), runtime->statement_count, runtime->ast_arena.peak,
+                                 runtime->scratch.peak);
+    }
+
+    reset_parser_state();
+    free_program(&state.program);
+    arena_free(&runtime->ast_arena);
+    arena_free(&runtime->scratch);
+    free_output_buffer();
+
+    if (has_errors()) {
+        if (!quiet) {
+            report_error("⚠️ Compilation finished with errors");
+            print_errors();
+        }
+        clear_errors();
+    }
+}
+
 void compile_eval(const char* code) {
     // Initialize runtime state
     init_runtime();
@@ -207,7 +535,11 @@ void compile_eval(const char* code) {
     // Parse and emit
     ASTNode* root = parse_script_from_string(code);
     if (root) {
-        emit_gcode(root);
+        optimize_ast(root, 1);
+        Program program = {0};
+        prepare_program(&program, root);
+        emit_program(&program, root);
+        free_program(&program);
         
         // Output directly to terminal (no file)
         printf("%s", get_output_buffer());
@@ -417,6 +749,28 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    use_tree_walker = args->tree_walker;
+
+    // Run every input on both engines; fail if any output differs
+    if (args->compare_engines) {
+        int mismatches = 0;
+        for (int i = 0; i < args->input_count; i++) {
+            mismatches += compare_engines(args->input_files[i]);
+        }
+        free_cli_args(args);
+        return mismatches ? 1 : 0;
+    }
+
+    // Print the optimized tree of every input instead of compiling it
+    if (args->dump_optimized_ast) {
+        int failures = 0;
+        for (int i = 0; i < args->input_count; i++) {
+            failures += dump_optimized_ast(args->input_files[i]);
+        }
+        free_cli_args(args);
+        return failures ? 1 : 0;
+    }
+
     // Handle eval mode
     if (args->eval_mode) {
         if (!args->eval_code) {
@@ -439,6 +793,12 @@ int main(int argc, char* argv[]) {
     // Handle specific input files
     if (args->input_count > 0) {
         for (int i = 0; i < args->input_count; i++) {
+            // "-" reads standard input and writes to stdout unless -o is given
+            if (strcmp(args->input_files[i], "-") == 0) {
+                compile_stream(stdin, "stdin", args->output_file, args->quiet);
+                continue;
+            }
+
             char* output_path = get_smart_output_path(args->input_files[i], args);
             
             if (!args->quiet && args->input_count > 1) {
@@ -446,7 +806,17 @@ int main(int argc, char* argv[]) {
                        args->input_files[i], output_path);
             }
             
-            compile_file(args->input_files[i], output_path, args->quiet);
+            if (args->stream_mode) {
+                FILE* input = fopen(args->input_files[i], "rb");
+                if (!input) {
+                    fprintf(stderr, "Error: Failed to read input file '%s': %s\n", args->input_files[i], strerror(errno));
+                } else {
+                    compile_stream(input, args->input_files[i], output_path, args->quiet);
+                    fclose(input);
+                }
+            } else {
+                compile_file(args->input_files[i], output_path, args->quiet);
+            }
             free(output_path);
         }
         free_cli_args(args);
@@ -8,10 +8,33 @@ typedef struct ASTNode ASTNode;
 // G-code argument (like X[i] or Y[10])
 typedef struct
 {
-    char *key;          // e.g., "X", "Y"
+    const char *key;    // e.g., "X", "Y" (interned)
+    int letter;         // key[0] - 'A', so the emitter never touches the string
     ASTNode *indexExpr; // expression inside []
 } GArg;
 
+// Longest word list the emitter remembers for modal suppression
+#define GCODE_MODAL_KEY_LENGTH 15
+
+// Piece of a compiled note template
+typedef enum
+{
+    NOTE_TEXT,      // literal text
+    NOTE_EXPR,      // [expr] or {expr}, parsed once with the note
+    NOTE_VAR,       // placeholder that did not parse; looked up as a variable name
+    NOTE_TIME,      // [time]
+    NOTE_FILE_NAME, // [ggcode_file_name]
+    NOTE_LINE_END   // closes one "(...)" comment line
+} NoteSegmentKind;
+
+typedef struct
+{
+    NoteSegmentKind kind;
+    const char *text; // NOTE_TEXT / NOTE_VAR, not NUL-terminated for NOTE_TEXT
+    int length;
+    ASTNode *expr;    // NOTE_EXPR
+} NoteSegment;
+
 
 
 
@@ -42,6 +65,8 @@ typedef enum
     AST_IF,
     AST_UNARY,
      AST_EMPTY ,
+    AST_MAP_LITERAL,    // array_literal with a key per element
+    AST_MATCH,
     
     
     AST_NODE_TYPE_COUNT // <- this must always be the last
@@ -64,12 +89,14 @@ struct {
 
 
 struct {
-    char *name;
+    const char *name;
+    int slot;       // variable slot from resolve_variables(), 0 = unresolved
     ASTNode *expr;
 } assign_stmt;
 
 struct {
-    char *name;
+    const char *name;
+    int slot;
     Token_Type op;  // TOKEN_PLUS_EQUAL, TOKEN_MINUS_EQUAL, etc.
     ASTNode *expr;
 } compound_assign;
@@ -87,12 +114,15 @@ struct {
 struct {
     ASTNode **elements;  // array of ASTNode*
     int count;           // number of elements
+    int *keys;           // AST_MAP_LITERAL: interned id of each element's key
 } array_literal;
 
 
 struct {
-    char *var;
-    char *index_var;  // For (char, index) syntax - optional
+    const char *var;
+    const char *index_var;  // For (char, index) syntax - optional
+    int var_slot;
+    int index_slot;
     ASTNode *from;
     ASTNode *to;
     ASTNode *step;
@@ -108,15 +138,17 @@ struct {
 
         struct
         {
-            char *name;
+            const char *name;
             ASTNode **args;
             int arg_count;
+            int builtin;        // bound built-in (BUILTIN_*), BUILTIN_NONE for a user function
+            int slot;           // slot of the name, the user function's registry key
         } call_expr;
 
         struct
         { // function definition: function name(args...) { body }
-            char *name;
-            char **params; // list of parameter names
+            const char *name;
+            const char **params; // list of parameter names
             int param_count;
             ASTNode *body;
         } function_def;
@@ -128,10 +160,11 @@ struct {
 
         struct
         {
-            char *name;
-            char **params;
+            const char *name;
+            const char **params;
             int param_count;
             ASTNode *body;
+            int *param_slots; // after the fields it shares with function_def
         } function_stmt;
 
         struct
@@ -143,13 +176,15 @@ struct {
 
         struct
         { // let x = expr
-            char *name;
+            const char *name;
+            int slot;
             ASTNode *expr; // ✅ store the expression instead of value
         } let_stmt;
 
         struct
         { // variable reference: e.g., x
-            char *name;
+            const char *name;
+            int slot;
         } var;
 
         struct
@@ -159,7 +194,7 @@ struct {
 
         struct
         { // string literal constant
-            char *value;
+            const char *value;
         } string_literal;
 
         struct
@@ -170,7 +205,9 @@ struct {
 
         struct
         {               // G-code: e.g., G1 X[i] Y[0]
-            char *code; // "G1", "M3", etc.
+            const char *code; // "G1", "G90 G94 G17", etc. (interned)
+            int code_id;      // intern id of `code`
+            int modal_key_id; // intern id of the first GCODE_MODAL_KEY_LENGTH bytes of `code`
             GArg *args; // array of arguments
             int argCount;
         } gcode_stmt;
@@ -192,6 +229,8 @@ struct {
         struct
         { // note { ... }
             char *content;
+            NoteSegment *segments; // content split into lines and placeholders
+            int segment_count;
         } note;
 
         struct
@@ -207,6 +246,24 @@ struct {
             ASTNode *else_branch; // NULL if no else
         } if_stmt;
 
+        struct
+        { // match subject { 1, 2 { ... } "A" { ... } else { ... } }
+            ASTNode *subject;
+            ASTNode **arms;       // one block per arm
+            int arm_count;
+            ASTNode *else_branch; // NULL if no else
+            // Built by the parser; each entry is an arm index, -1 for none
+            int dense_first;      // integer label at dense[0]
+            int *dense;           // every integer from dense_first up, for close integer labels
+            int dense_count;
+            double *numbers;      // otherwise the number labels, sorted for a binary search
+            int *number_arms;
+            int number_count;
+            int *string_ids;      // string labels' intern ids, open-addressed, -1 = empty
+            int *string_arms;
+            int string_slots;     // power of two, 0 without string labels
+        } match_stmt;
+
         struct
         { // ternary expression: condition ? true_expr : false_expr
             ASTNode *condition;
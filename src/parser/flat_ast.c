@@ -0,0 +1,395 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flat_ast.h"
+
+/// @brief Builder state: a failed allocation poisons the rest of the build
+typedef struct {
+    FlatAst *ast;
+    int failed;
+} FlatBuilder;
+
+/// @brief Makes room for `extra` more elements of a side table
+static int reserve(void **items, uint32_t count, uint32_t *capacity, uint32_t extra, size_t elem)
+{
+    if (count + extra <= *capacity)
+        return 1;
+
+    uint32_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < count + extra)
+        new_capacity *= 2;
+
+    void *grown = realloc(*items, (size_t)new_capacity * elem);
+    if (!grown)
+        return 0;
+    *items = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+/// @brief Appends an empty node of `type` and returns its index
+static FlatIndex push_node(FlatBuilder *b, ASTNode *origin, ASTNodeType type)
+{
+    FlatAst *ast = b->ast;
+    uint32_t capacity = ast->capacity;
+    if (b->failed ||
+        !reserve((void **)&ast->nodes, ast->count, &capacity, 1, sizeof(FlatNode)) ||
+        !reserve((void **)&ast->origin, ast->count, &ast->capacity, 1, sizeof(ASTNode *)))
+    {
+        b->failed = 1;
+        return FLAT_NONE;
+    }
+
+    FlatNode *node = &ast->nodes[ast->count];
+    node->type = (uint8_t)type;
+    node->flags = 0;
+    node->op = 0;
+    node->a = node->b = node->c = FLAT_NONE;
+    ast->origin[ast->count] = origin;
+    return ast->count++;
+}
+
+/// @brief Reserves a run of `count` list slots and returns its start
+static FlatIndex push_list(FlatBuilder *b, uint32_t count)
+{
+    FlatAst *ast = b->ast;
+    if (b->failed ||
+        !reserve((void **)&ast->lists, ast->list_count, &ast->list_capacity, count, sizeof(FlatIndex)))
+    {
+        b->failed = 1;
+        return FLAT_NONE;
+    }
+
+    FlatIndex start = ast->list_count;
+    for (uint32_t i = 0; i < count; i++)
+        ast->lists[start + i] = FLAT_NONE;
+    ast->list_count += count;
+    return start;
+}
+
+static FlatIndex push_name(FlatBuilder *b, const char *name)
+{
+    FlatAst *ast = b->ast;
+    if (!name)
+        return FLAT_NONE;
+    if (b->failed ||
+        !reserve((void **)&ast->names, ast->name_count, &ast->name_capacity, 1, sizeof(const char *)))
+    {
+        b->failed = 1;
+        return FLAT_NONE;
+    }
+    ast->names[ast->name_count] = name;
+    return ast->name_count++;
+}
+
+static FlatIndex push_number(FlatBuilder *b, double value)
+{
+    FlatAst *ast = b->ast;
+    if (b->failed ||
+        !reserve((void **)&ast->numbers, ast->number_count, &ast->number_capacity, 1, sizeof(double)))
+    {
+        b->failed = 1;
+        return FLAT_NONE;
+    }
+    ast->numbers[ast->number_count] = value;
+    return ast->number_count++;
+}
+
+static FlatIndex build(FlatBuilder *b, ASTNode *node);
+
+/// @brief Builds `count` children into a fresh list run and returns its start
+static FlatIndex build_list(FlatBuilder *b, ASTNode **children, int count)
+{
+    FlatIndex start = push_list(b, (uint32_t)count);
+    for (int i = 0; i < count && !b->failed; i++)
+    {
+        // Children may grow `lists`, so index it only after they are built
+        FlatIndex child = build(b, children[i]);
+        if (!b->failed)
+            b->ast->lists[start + i] = child;
+    }
+    return start;
+}
+
+/// @brief Stores the fields of node `index`; the vector may have moved since it was pushed
+static void set_fields(FlatBuilder *b, FlatIndex index, FlatIndex a, FlatIndex bb, FlatIndex c)
+{
+    if (b->failed)
+        return;
+    FlatNode *node = &b->ast->nodes[index];
+    node->a = a;
+    node->b = bb;
+    node->c = c;
+}
+
+/// @brief Appends `node` and its subtree in pre-order
+static FlatIndex build(FlatBuilder *b, ASTNode *node)
+{
+    if (!node || b->failed)
+        return FLAT_NONE;
+
+    FlatIndex self = push_node(b, node, node->type);
+    if (b->failed)
+        return FLAT_NONE;
+
+    switch (node->type)
+    {
+    case AST_NUMBER:
+        set_fields(b, self, push_number(b, node->number.value), FLAT_NONE, FLAT_NONE);
+        break;
+
+    case AST_STRING:
+        set_fields(b, self, push_name(b, node->string_literal.value), FLAT_NONE, FLAT_NONE);
+        break;
+
+    case AST_VAR:
+        set_fields(b, self, push_name(b, node->var.name), (FlatIndex)node->var.slot, FLAT_NONE);
+        break;
+
+    case AST_UNARY:
+    {
+        b->ast->nodes[self].op = (uint16_t)node->unary_expr.op;
+        FlatIndex operand = build(b, node->unary_expr.operand);
+        set_fields(b, self, operand, FLAT_NONE, FLAT_NONE);
+        break;
+    }
+
+    case AST_BINARY:
+    {
+        b->ast->nodes[self].op = (uint16_t)node->binary_expr.op;
+        FlatIndex left = build(b, node->binary_expr.left);
+        FlatIndex right = build(b, node->binary_expr.right);
+        set_fields(b, self, left, right, FLAT_NONE);
+        break;
+    }
+
+    case AST_TERNARY:
+    {
+        FlatIndex cond = build(b, node->ternary_expr.condition);
+        FlatIndex then_expr = build(b, node->ternary_expr.true_expr);
+        FlatIndex else_expr = build(b, node->ternary_expr.false_expr);
+        set_fields(b, self, cond, then_expr, else_expr);
+        break;
+    }
+
+    case AST_IF:
+    {
+        FlatIndex cond = build(b, node->if_stmt.condition);
+        FlatIndex then_branch = build(b, node->if_stmt.then_branch);
+        FlatIndex else_branch = build(b, node->if_stmt.else_branch);
+        set_fields(b, self, cond, then_branch, else_branch);
+        break;
+    }
+
+    case AST_MATCH:
+    {
+        // The arms, then the else block; the label tables stay in the pointer node
+        int arm_count = node->match_stmt.arm_count;
+        FlatIndex subject = build(b, node->match_stmt.subject);
+        FlatIndex list = push_list(b, (uint32_t)arm_count + 1);
+        for (int i = 0; i <= arm_count && !b->failed; i++)
+        {
+            FlatIndex arm = build(b, i < arm_count ? node->match_stmt.arms[i] : node->match_stmt.else_branch);
+            if (!b->failed)
+                b->ast->lists[list + i] = arm;
+        }
+        set_fields(b, self, subject, list, (FlatIndex)arm_count);
+        break;
+    }
+
+    case AST_INDEX:
+    {
+        FlatIndex array = build(b, node->index_expr.array);
+        FlatIndex index = build(b, node->index_expr.index);
+        set_fields(b, self, array, index, FLAT_NONE);
+        break;
+    }
+
+    case AST_ARRAY_LITERAL:
+    case AST_MAP_LITERAL:
+    {
+        FlatIndex list = build_list(b, node->array_literal.elements, node->array_literal.count);
+        set_fields(b, self, list, (FlatIndex)node->array_literal.count, FLAT_NONE);
+        break;
+    }
+
+    case AST_CALL:
+    {
+        FlatIndex name = push_name(b, node->call_expr.name);
+        FlatIndex list = build_list(b, node->call_expr.args, node->call_expr.arg_count);
+        set_fields(b, self, name, list, (FlatIndex)node->call_expr.arg_count);
+        break;
+    }
+
+    case AST_LET:
+    {
+        FlatIndex name = push_name(b, node->let_stmt.name);
+        FlatIndex expr = build(b, node->let_stmt.expr);
+        set_fields(b, self, name, expr, (FlatIndex)node->let_stmt.slot);
+        break;
+    }
+
+    case AST_ASSIGN:
+    {
+        FlatIndex name = push_name(b, node->assign_stmt.name);
+        FlatIndex expr = build(b, node->assign_stmt.expr);
+        set_fields(b, self, name, expr, (FlatIndex)node->assign_stmt.slot);
+        break;
+    }
+
+    case AST_COMPOUND_ASSIGN:
+    {
+        b->ast->nodes[self].op = (uint16_t)node->compound_assign.op;
+        FlatIndex name = push_name(b, node->compound_assign.name);
+        FlatIndex expr = build(b, node->compound_assign.expr);
+        set_fields(b, self, name, expr, (FlatIndex)node->compound_assign.slot);
+        break;
+    }
+
+    case AST_ASSIGN_INDEX:
+    {
+        FlatIndex target = build(b, node->assign_index.target);
+        FlatIndex value = build(b, node->assign_index.value);
+        set_fields(b, self, target, value, FLAT_NONE);
+        break;
+    }
+
+    case AST_EXPR_STMT:
+    {
+        FlatIndex expr = build(b, node->expr_stmt.expr);
+        set_fields(b, self, expr, FLAT_NONE, FLAT_NONE);
+        break;
+    }
+
+    case AST_RETURN:
+    {
+        FlatIndex expr = build(b, node->return_stmt.expr);
+        set_fields(b, self, expr, FLAT_NONE, FLAT_NONE);
+        break;
+    }
+
+    case AST_BLOCK:
+    {
+        FlatIndex list = build_list(b, node->block.statements, node->block.count);
+        set_fields(b, self, list, (FlatIndex)node->block.count, FLAT_NONE);
+        break;
+    }
+
+    case AST_WHILE:
+    {
+        FlatIndex cond = build(b, node->while_stmt.condition);
+        FlatIndex body = build(b, node->while_stmt.body);
+        set_fields(b, self, cond, body, FLAT_NONE);
+        break;
+    }
+
+    case AST_FOR:
+    {
+        b->ast->nodes[self].flags = (node->for_stmt.exclusive ? FLAT_FOR_EXCLUSIVE : 0) |
+                                    (node->for_stmt.is_string_iteration ? FLAT_FOR_STRING : 0);
+        FlatIndex var = push_name(b, node->for_stmt.var);
+        FlatIndex list = push_list(b, 7);
+        FlatIndex parts[7] = {
+            push_name(b, node->for_stmt.index_var),
+            build(b, node->for_stmt.from),
+            build(b, node->for_stmt.to),
+            build(b, node->for_stmt.step),
+            build(b, node->for_stmt.iterable),
+            (FlatIndex)node->for_stmt.var_slot,
+            (FlatIndex)node->for_stmt.index_slot,
+        };
+        FlatIndex body = build(b, node->for_stmt.body);
+        if (!b->failed)
+            memcpy(&b->ast->lists[list], parts, sizeof(parts));
+        set_fields(b, self, var, list, body);
+        break;
+    }
+
+    case AST_GCODE:
+    {
+        int argc = node->gcode_stmt.argCount;
+        FlatIndex code = push_name(b, node->gcode_stmt.code);
+        FlatIndex list = push_list(b, 2 + (uint32_t)argc * 2);
+        if (!b->failed)
+        {
+            b->ast->lists[list] = (FlatIndex)node->gcode_stmt.code_id;
+            b->ast->lists[list + 1] = (FlatIndex)node->gcode_stmt.modal_key_id;
+        }
+        for (int i = 0; i < argc && !b->failed; i++)
+        {
+            FlatIndex value = build(b, node->gcode_stmt.args[i].indexExpr);
+            if (!b->failed)
+            {
+                b->ast->lists[list + 2 + 2 * i] = (FlatIndex)node->gcode_stmt.args[i].letter;
+                b->ast->lists[list + 2 + 2 * i + 1] = value;
+            }
+        }
+        set_fields(b, self, code, list, (FlatIndex)argc);
+        break;
+    }
+
+    case AST_NOTE:
+        set_fields(b, self, push_name(b, node->note.content), FLAT_NONE, FLAT_NONE);
+        break;
+
+    case AST_FUNCTION:
+    {
+        int param_count = node->function_stmt.param_count;
+        FlatIndex name = push_name(b, node->function_stmt.name);
+        FlatIndex list = push_list(b, (uint32_t)param_count + 1);
+        FlatIndex body = build(b, node->function_stmt.body);
+        for (int i = 0; i < param_count && !b->failed; i++)
+        {
+            FlatIndex param = push_name(b, node->function_stmt.params[i]);
+            if (!b->failed)
+                b->ast->lists[list + 1 + i] = param;
+        }
+        if (!b->failed)
+            b->ast->lists[list] = body;
+        set_fields(b, self, name, list, (FlatIndex)param_count);
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    return b->failed ? FLAT_NONE : self;
+}
+
+FlatIndex flat_ast_append(FlatAst *ast, ASTNode *root)
+{
+    if (!ast || !root)
+        return FLAT_NONE;
+
+    FlatAst before = *ast;
+    FlatBuilder builder = {ast, 0};
+    FlatIndex index = build(&builder, root);
+    if (builder.failed)
+    {
+        // Keep the storage, drop the partial subtree
+        ast->count = before.count;
+        ast->list_count = before.list_count;
+        ast->number_count = before.number_count;
+        ast->name_count = before.name_count;
+        return FLAT_NONE;
+    }
+    return index;
+}
+
+void flat_ast_reset(FlatAst *ast)
+{
+    ast->count = 0;
+    ast->list_count = 0;
+    ast->number_count = 0;
+    ast->name_count = 0;
+}
+
+void flat_ast_free(FlatAst *ast)
+{
+    free(ast->nodes);
+    free(ast->origin);
+    free(ast->lists);
+    free(ast->numbers);
+    free(ast->names);
+    memset(ast, 0, sizeof(FlatAst));
+}
@@ -0,0 +1,104 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <stdint.h>
+#include "ast_nodes.h"
+
+/** @brief Index of a node in FlatAst.nodes (or of an entry in a side table) */
+typedef uint32_t FlatIndex;
+
+/** @brief Absent child, e.g. a bare `return` or an `if` without `else` */
+#define FLAT_NONE UINT32_MAX
+
+/** @brief FlatNode.flags for AST_FOR */
+#define FLAT_FOR_EXCLUSIVE 0x01
+#define FLAT_FOR_STRING 0x02
+
+/**
+ * @brief One node of the flat AST: 16 bytes, four to a cache line.
+ *
+ * The meaning of a, b and c depends on the node type. "name" is an index into
+ * FlatAst.names, "list" the start of a run in FlatAst.lists.
+ *
+ *   AST_NUMBER          a = index into numbers
+ *   AST_STRING          a = name
+ *   AST_VAR             a = name, b = slot (see resolve_variables())
+ *   AST_UNARY           op, a = operand
+ *   AST_BINARY          op, a = left, b = right
+ *   AST_TERNARY, AST_IF a = condition, b = then, c = else (FLAT_NONE if absent)
+ *   AST_INDEX           a = array, b = index
+ *   AST_ARRAY_LITERAL   a = list, b = count
+ *   AST_MAP_LITERAL     a = list of values, b = count (keys stay in the pointer node)
+ *   AST_CALL            a = name, b = list of arguments, c = count
+ *   AST_LET, AST_ASSIGN a = name, b = value, c = slot
+ *   AST_COMPOUND_ASSIGN op, a = name, b = value, c = slot
+ *   AST_ASSIGN_INDEX    a = target, b = value
+ *   AST_EXPR_STMT       a = expression
+ *   AST_RETURN          a = expression (FLAT_NONE for a bare return)
+ *   AST_BLOCK           a = list, b = count
+ *   AST_WHILE           a = condition, b = body
+ *   AST_MATCH           a = subject, b = list of arms then else (FLAT_NONE
+ *                       if absent), c = arm count; labels stay in the pointer node
+ *   AST_FOR             flags, a = variable name, b = list of
+ *                       [index name, from, to, step, iterable,
+ *                       variable slot, index slot], c = body
+ *   AST_GCODE           a = name of the code text, b = list of
+ *                       [code id, modal key id, then letter, value pairs],
+ *                       c = argument count
+ *   AST_NOTE            a = name of the note text
+ *   AST_FUNCTION        a = name, b = list of [body, parameter names...],
+ *                       c = parameter count
+ */
+typedef struct {
+    uint8_t type;       // ASTNodeType
+    uint8_t flags;
+    uint16_t op;        // Token_Type
+    FlatIndex a, b, c;
+} FlatNode;
+
+/**
+ * @brief Contiguous, index-addressed copy of a pointer AST.
+ *
+ * Nodes are stored in pre-order, so every statement's subtree is one
+ * contiguous run of `nodes`. Names and string texts are borrowed from the
+ * intern table and AST arena, which must outlive the flat copy. `origin`
+ * maps each flat node back to the pointer node it was built from, for the
+ * parts of the runtime that still work on ASTNode (function bodies, notes).
+ */
+typedef struct {
+    FlatNode *nodes;
+    ASTNode **origin;
+    uint32_t count;
+    uint32_t capacity;
+
+    FlatIndex *lists;       // child runs: block statements, call arguments...
+    uint32_t list_count;
+    uint32_t list_capacity;
+
+    double *numbers;
+    uint32_t number_count;
+    uint32_t number_capacity;
+
+    const char **names;
+    uint32_t name_count;
+    uint32_t name_capacity;
+} FlatAst;
+
+/**
+ * @brief Append the flat form of `root` to `ast`.
+ * @return Index of the new root node, or FLAT_NONE on allocation failure
+ *         (the AST is left as it was before the call).
+ */
+FlatIndex flat_ast_append(FlatAst *ast, ASTNode *root);
+
+/**
+ * @brief Forget all nodes but keep the storage for the next append.
+ */
+void flat_ast_reset(FlatAst *ast);
+
+/**
+ * @brief Release all storage owned by the flat AST.
+ */
+void flat_ast_free(FlatAst *ast);
+
+#endif // FLAT_AST_H
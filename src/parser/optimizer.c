@@ -0,0 +1,785 @@
+#include <stdlib.h>
+#include <string.h>
+#include "optimizer.h"
+#include "resolver.h"
+#include "../lexer/keyword_table.h"
+#include "../config/config.h"
+#include "../error/error.h"
+#include "../runtime/evaluator.h"
+#include "../runtime/runtime_state.h"
+
+/// @brief Bits of Optimizer.known: where a slot's propagated value may replace it
+#define KNOWN_AT_TOP 0x01      // top-level statements after its `let`
+#define KNOWN_IN_FUNCTION 0x02 // function bodies: no user call runs before the `let`
+
+/// @brief What the pass knows about each slot, and the function bodies it still has to visit
+typedef struct {
+    int whole_program;
+    int slots;              // entries in each table: every interned name's slot is below this
+    int unresolved;         // some name has no slot: propagate nothing and keep every function
+    int in_function;        // folding a function body
+    int first_call;         // first top-level statement that calls a user function
+    int *lets;              // `let` statements per slot
+    int *writes;            // any other binding or assignment per slot
+    int *calls;             // user function calls per slot
+    unsigned char *known;   // KNOWN_* bits
+    double *values;         // propagated value, already rounded by number_value()
+    ASTNode **bodies;       // functions found at top level, folded after it
+    int body_count;
+    int body_capacity;
+} Optimizer;
+
+static ASTNode *fold_statement(Optimizer *o, ASTNode *node);
+
+/// @brief Counts a use of `slot` in `table`; a name without a slot disables propagation
+static void count_slot(Optimizer *o, int *table, int slot)
+{
+    if (slot <= 0 || slot >= o->slots)
+        o->unresolved = 1;
+    else
+        table[slot]++;
+}
+
+/// @brief Tallies bindings, assignments and user calls under `node`, part of top-level statement `top`
+static void count_uses(Optimizer *o, const ASTNode *node, int top, int in_function)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case AST_LET:
+        count_slot(o, o->lets, node->let_stmt.slot);
+        count_uses(o, node->let_stmt.expr, top, in_function);
+        break;
+
+    case AST_ASSIGN:
+        count_slot(o, o->writes, node->assign_stmt.slot);
+        count_uses(o, node->assign_stmt.expr, top, in_function);
+        break;
+
+    case AST_COMPOUND_ASSIGN:
+        count_slot(o, o->writes, node->compound_assign.slot);
+        count_uses(o, node->compound_assign.expr, top, in_function);
+        break;
+
+    case AST_ASSIGN_INDEX:
+    {
+        // `a[i][j] = v` writes `a`
+        const ASTNode *base = node->assign_index.target;
+        while (base && base->type == AST_INDEX)
+            base = base->index_expr.array;
+        if (base && base->type == AST_VAR)
+            count_slot(o, o->writes, base->var.slot);
+        else
+            o->unresolved = 1;
+        count_uses(o, node->assign_index.target, top, in_function);
+        count_uses(o, node->assign_index.value, top, in_function);
+        break;
+    }
+
+    case AST_UNARY:
+        count_uses(o, node->unary_expr.operand, top, in_function);
+        break;
+
+    case AST_BINARY:
+        count_uses(o, node->binary_expr.left, top, in_function);
+        count_uses(o, node->binary_expr.right, top, in_function);
+        break;
+
+    case AST_TERNARY:
+        count_uses(o, node->ternary_expr.condition, top, in_function);
+        count_uses(o, node->ternary_expr.true_expr, top, in_function);
+        count_uses(o, node->ternary_expr.false_expr, top, in_function);
+        break;
+
+    case AST_INDEX:
+        count_uses(o, node->index_expr.array, top, in_function);
+        count_uses(o, node->index_expr.index, top, in_function);
+        break;
+
+    case AST_ARRAY_LITERAL:
+    case AST_MAP_LITERAL:
+        for (int i = 0; i < node->array_literal.count; i++)
+            count_uses(o, node->array_literal.elements[i], top, in_function);
+        break;
+
+    case AST_CALL:
+        if (node->call_expr.builtin == BUILTIN_NONE)
+        {
+            count_slot(o, o->calls, node->call_expr.slot);
+            if (!in_function && top < o->first_call)
+                o->first_call = top;
+        }
+        for (int i = 0; i < node->call_expr.arg_count; i++)
+            count_uses(o, node->call_expr.args[i], top, in_function);
+        break;
+
+    case AST_EXPR_STMT:
+        count_uses(o, node->expr_stmt.expr, top, in_function);
+        break;
+
+    case AST_RETURN:
+        count_uses(o, node->return_stmt.expr, top, in_function);
+        break;
+
+    case AST_BLOCK:
+        for (int i = 0; i < node->block.count; i++)
+            count_uses(o, node->block.statements[i], top, in_function);
+        break;
+
+    case AST_IF:
+        count_uses(o, node->if_stmt.condition, top, in_function);
+        count_uses(o, node->if_stmt.then_branch, top, in_function);
+        count_uses(o, node->if_stmt.else_branch, top, in_function);
+        break;
+
+    case AST_MATCH:
+        count_uses(o, node->match_stmt.subject, top, in_function);
+        for (int i = 0; i < node->match_stmt.arm_count; i++)
+            count_uses(o, node->match_stmt.arms[i], top, in_function);
+        count_uses(o, node->match_stmt.else_branch, top, in_function);
+        break;
+
+    case AST_WHILE:
+        count_uses(o, node->while_stmt.condition, top, in_function);
+        count_uses(o, node->while_stmt.body, top, in_function);
+        break;
+
+    case AST_FOR:
+        count_slot(o, o->writes, node->for_stmt.var_slot);
+        if (node->for_stmt.index_var)
+            count_slot(o, o->writes, node->for_stmt.index_slot);
+        count_uses(o, node->for_stmt.from, top, in_function);
+        count_uses(o, node->for_stmt.to, top, in_function);
+        count_uses(o, node->for_stmt.step, top, in_function);
+        count_uses(o, node->for_stmt.iterable, top, in_function);
+        count_uses(o, node->for_stmt.body, top, in_function);
+        break;
+
+    case AST_FUNCTION:
+        for (int i = 0; i < node->function_stmt.param_count; i++)
+            count_slot(o, o->writes, node->function_stmt.param_slots ? node->function_stmt.param_slots[i] : 0);
+        count_uses(o, node->function_stmt.body, top, 1);
+        break;
+
+    case AST_GCODE:
+        for (int i = 0; i < node->gcode_stmt.argCount; i++)
+            count_uses(o, node->gcode_stmt.args[i].indexExpr, top, in_function);
+        break;
+
+    case AST_NOTE:
+        for (int i = 0; i < node->note.segment_count; i++)
+            count_uses(o, node->note.segments[i].expr, top, in_function);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/// @brief Reads a literal as the evaluator would: numbers rounded by number_value()
+static int literal_value(const ASTNode *node, Value *out)
+{
+    if (!node)
+        return 0;
+    if (node->type == AST_NUMBER)
+    {
+        *out = number_value(node->number.value);
+        return 1;
+    }
+    if (node->type == AST_STRING)
+    {
+        *out = interned_value(node->string_literal.value);
+        return 1;
+    }
+    return 0;
+}
+
+/// @brief Turns `node` into the number literal `value` in place, so its parent needs no update
+static void make_number(ASTNode *node, double value)
+{
+    node->type = AST_NUMBER;
+    node->number.value = value;
+}
+
+/// @brief Whether apply_binary() computes `op` on these operands without reporting an error
+static int binary_folds(Token_Type op, const Value *left, const Value *right)
+{
+    if (op == TOKEN_EQUAL_EQUAL || op == TOKEN_BANG_EQUAL)
+        return 1;
+    if (left->type != VAL_NUMBER || right->type != VAL_NUMBER)
+        return 0;
+
+    switch (op)
+    {
+    case TOKEN_SLASH:
+        return right->number != 0.0;
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+    case TOKEN_STAR:
+    case TOKEN_CARET:
+    case TOKEN_LESS:
+    case TOKEN_LESS_EQUAL:
+    case TOKEN_GREATER:
+    case TOKEN_GREATER_EQUAL:
+    case TOKEN_AND:
+    case TOKEN_OR:
+    case TOKEN_AMPERSAND:
+    case TOKEN_PIPE:
+    case TOKEN_LSHIFT:
+    case TOKEN_RSHIFT:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/// @brief Folds the expression `node` and returns what replaces it
+static ASTNode *fold_expr(Optimizer *o, ASTNode *node)
+{
+    if (!node)
+        return NULL;
+
+    switch (node->type)
+    {
+    case AST_VAR:
+    {
+        int slot = node->var.slot;
+        int need = o->in_function ? KNOWN_IN_FUNCTION : KNOWN_AT_TOP;
+        if (slot > 0 && slot < o->slots && (o->known[slot] & need))
+            make_number(node, o->values[slot]);
+        break;
+    }
+
+    case AST_UNARY:
+    {
+        node->unary_expr.operand = fold_expr(o, node->unary_expr.operand);
+        Token_Type op = node->unary_expr.op;
+        Value operand;
+        if ((op == TOKEN_BANG || op == TOKEN_MINUS) && literal_value(node->unary_expr.operand, &operand) &&
+            operand.type == VAL_NUMBER)
+            make_number(node, apply_unary(op, operand.number).number);
+        break;
+    }
+
+    case AST_BINARY:
+    {
+        node->binary_expr.left = fold_expr(o, node->binary_expr.left);
+        node->binary_expr.right = fold_expr(o, node->binary_expr.right);
+        Value left, right;
+        if (literal_value(node->binary_expr.left, &left) && literal_value(node->binary_expr.right, &right) &&
+            binary_folds(node->binary_expr.op, &left, &right))
+            make_number(node, apply_binary(node->binary_expr.op, &left, &right).number);
+        break;
+    }
+
+    case AST_TERNARY:
+    {
+        node->ternary_expr.condition = fold_expr(o, node->ternary_expr.condition);
+        node->ternary_expr.true_expr = fold_expr(o, node->ternary_expr.true_expr);
+        node->ternary_expr.false_expr = fold_expr(o, node->ternary_expr.false_expr);
+        Value condition;
+        if (literal_value(node->ternary_expr.condition, &condition) && condition.type == VAL_NUMBER)
+        {
+            ASTNode *chosen = condition.number != 0 ? node->ternary_expr.true_expr : node->ternary_expr.false_expr;
+            if (chosen)
+            {
+                chosen->parent = node->parent;
+                return chosen;
+            }
+        }
+        break;
+    }
+
+    case AST_INDEX:
+        node->index_expr.array = fold_expr(o, node->index_expr.array);
+        node->index_expr.index = fold_expr(o, node->index_expr.index);
+        break;
+
+    case AST_ARRAY_LITERAL:
+    case AST_MAP_LITERAL:
+        for (int i = 0; i < node->array_literal.count; i++)
+            node->array_literal.elements[i] = fold_expr(o, node->array_literal.elements[i]);
+        break;
+
+    case AST_CALL:
+    {
+        for (int i = 0; i < node->call_expr.arg_count; i++)
+            node->call_expr.args[i] = fold_expr(o, node->call_expr.args[i]);
+
+        // User functions may emit G-code
+        int builtin = node->call_expr.builtin;
+        if (!builtin_is_pure(builtin))
+            break;
+        Value args[BUILTIN_MAX_ARGS];
+        int count = builtin_arg_count(builtin);
+        for (int i = 0; i < count; i++)
+            if (!literal_value(node->call_expr.args[i], &args[i]) || args[i].type != VAL_NUMBER)
+                return node;
+        make_number(node, call_builtin(builtin, args).number);
+        break;
+    }
+
+    default:
+        break;
+    }
+    return node;
+}
+
+/// @brief Folds an assignment target, leaving the variable it writes in place
+static void fold_target(Optimizer *o, ASTNode *target)
+{
+    while (target && target->type == AST_INDEX)
+    {
+        target->index_expr.index = fold_expr(o, target->index_expr.index);
+        target = target->index_expr.array;
+    }
+}
+
+/// @brief The value of a folded condition, as if_condition() and while_continues() read it
+static int constant_condition(const ASTNode *condition, int *holds)
+{
+    Value value;
+    if (!literal_value(condition, &value) || value.type != VAL_NUMBER)
+        return 0;
+    *holds = value.number != 0;
+    return 1;
+}
+
+/// @brief Queues the body of a function met at top level, folded once all constants are known
+static void defer_body(Optimizer *o, ASTNode *function)
+{
+    if (o->body_count == o->body_capacity)
+    {
+        int capacity = o->body_capacity ? o->body_capacity * 2 : 16;
+        ASTNode **grown = realloc(o->bodies, sizeof(ASTNode *) * capacity);
+        if (!grown)
+            return; // left unfolded
+        o->bodies = grown;
+        o->body_capacity = capacity;
+    }
+    o->bodies[o->body_count++] = function;
+}
+
+/// @brief Folds every statement of a block, dropping the ones that turned out dead
+static void fold_block(Optimizer *o, ASTNode *block)
+{
+    int kept = 0;
+    for (int i = 0; i < block->block.count; i++)
+    {
+        ASTNode *stmt = fold_statement(o, block->block.statements[i]);
+        if (stmt)
+            block->block.statements[kept++] = stmt;
+    }
+    block->block.count = kept;
+}
+
+/// @brief Folds the statement `node`; returns what replaces it, NULL if it can never do anything
+static ASTNode *fold_statement(Optimizer *o, ASTNode *node)
+{
+    if (!node)
+        return NULL;
+
+    switch (node->type)
+    {
+    case AST_LET:
+        node->let_stmt.expr = fold_expr(o, node->let_stmt.expr);
+        break;
+
+    case AST_ASSIGN:
+        node->assign_stmt.expr = fold_expr(o, node->assign_stmt.expr);
+        break;
+
+    case AST_COMPOUND_ASSIGN:
+        node->compound_assign.expr = fold_expr(o, node->compound_assign.expr);
+        break;
+
+    case AST_ASSIGN_INDEX:
+        fold_target(o, node->assign_index.target);
+        node->assign_index.value = fold_expr(o, node->assign_index.value);
+        break;
+
+    case AST_EXPR_STMT:
+        node->expr_stmt.expr = fold_expr(o, node->expr_stmt.expr);
+        break;
+
+    case AST_RETURN:
+        node->return_stmt.expr = fold_expr(o, node->return_stmt.expr);
+        break;
+
+    case AST_BLOCK:
+        fold_block(o, node);
+        break;
+
+    case AST_IF:
+    {
+        node->if_stmt.condition = fold_expr(o, node->if_stmt.condition);
+        int holds;
+        if (!constant_condition(node->if_stmt.condition, &holds))
+        {
+            node->if_stmt.then_branch = fold_statement(o, node->if_stmt.then_branch);
+            node->if_stmt.else_branch = fold_statement(o, node->if_stmt.else_branch);
+            break;
+        }
+
+        // The branch that runs takes the place of the `if`; it keeps its own scope
+        ASTNode *live = fold_statement(o, holds ? node->if_stmt.then_branch : node->if_stmt.else_branch);
+        if (live)
+            live->parent = node->parent;
+        return live;
+    }
+
+    case AST_MATCH:
+    {
+        node->match_stmt.subject = fold_expr(o, node->match_stmt.subject);
+        Value subject;
+        if (!literal_value(node->match_stmt.subject, &subject))
+        {
+            for (int i = 0; i < node->match_stmt.arm_count; i++)
+                node->match_stmt.arms[i] = fold_statement(o, node->match_stmt.arms[i]);
+            node->match_stmt.else_branch = fold_statement(o, node->match_stmt.else_branch);
+            break;
+        }
+
+        // As for `if`: the arm that runs takes the place of the `match`
+        int arm = match_arm(node, &subject);
+        ASTNode *live = fold_statement(o, arm >= 0 ? node->match_stmt.arms[arm] : node->match_stmt.else_branch);
+        if (live)
+            live->parent = node->parent;
+        return live;
+    }
+
+    case AST_WHILE:
+    {
+        node->while_stmt.condition = fold_expr(o, node->while_stmt.condition);
+        int holds;
+        if (constant_condition(node->while_stmt.condition, &holds) && !holds)
+            return NULL;
+        node->while_stmt.body = fold_statement(o, node->while_stmt.body);
+        break;
+    }
+
+    case AST_FOR:
+        // The iterable stays a variable: string iteration reads it by reference
+        node->for_stmt.from = fold_expr(o, node->for_stmt.from);
+        node->for_stmt.to = fold_expr(o, node->for_stmt.to);
+        node->for_stmt.step = fold_expr(o, node->for_stmt.step);
+        node->for_stmt.body = fold_statement(o, node->for_stmt.body);
+        break;
+
+    case AST_FUNCTION:
+    {
+        int slot = variable_slot(node->function_stmt.name);
+        if (o->whole_program && !o->unresolved && slot > 0 && slot < o->slots && o->calls[slot] == 0)
+            return NULL;
+        if (o->in_function || !o->whole_program)
+            node->function_stmt.body = fold_statement(o, node->function_stmt.body);
+        else
+            defer_body(o, node);
+        break;
+    }
+
+    case AST_GCODE:
+        for (int i = 0; i < node->gcode_stmt.argCount; i++)
+            node->gcode_stmt.args[i].indexExpr = fold_expr(o, node->gcode_stmt.args[i].indexExpr);
+        break;
+
+    case AST_NOTE:
+        for (int i = 0; i < node->note.segment_count; i++)
+            node->note.segments[i].expr = fold_expr(o, node->note.segments[i].expr);
+        break;
+
+    default:
+        break;
+    }
+    return node;
+}
+
+/// @brief Folds the statements of the whole program in order, propagating its `let` constants
+static void fold_program(Optimizer *o, ASTNode *root)
+{
+    for (int i = 0; i < root->block.count; i++)
+        count_uses(o, root->block.statements[i], i, 0);
+
+    int kept = 0;
+    for (int i = 0; i < root->block.count; i++)
+    {
+        ASTNode *stmt = fold_statement(o, root->block.statements[i]);
+        if (!stmt)
+            continue;
+        root->block.statements[kept++] = stmt;
+
+        // A number bound once and never changed is that number from here on
+        int slot = stmt->type == AST_LET ? stmt->let_stmt.slot : 0;
+        if (!o->unresolved && slot > 0 && slot < o->slots && o->lets[slot] == 1 && o->writes[slot] == 0 &&
+            stmt->let_stmt.expr && stmt->let_stmt.expr->type == AST_NUMBER)
+        {
+            o->values[slot] = number_value(stmt->let_stmt.expr->number.value).number;
+            o->known[slot] = KNOWN_AT_TOP | (i < o->first_call ? KNOWN_IN_FUNCTION : 0);
+        }
+    }
+    root->block.count = kept;
+
+    // Bodies run whenever they are called, so only constants bound before any call reach them
+    o->in_function = 1;
+    for (int i = 0; i < o->body_count; i++)
+        o->bodies[i]->function_stmt.body = fold_statement(o, o->bodies[i]->function_stmt.body);
+}
+
+void optimize_ast(ASTNode *root, int whole_program)
+{
+    if (!root)
+        return;
+
+    Optimizer o = {0};
+    o.whole_program = whole_program && root->type == AST_BLOCK;
+    o.first_call = root->type == AST_BLOCK ? root->block.count : 0;
+    if (o.whole_program)
+    {
+        o.slots = get_runtime()->strings.count + 1;
+        o.lets = calloc(o.slots, sizeof(int));
+        o.writes = calloc(o.slots, sizeof(int));
+        o.calls = calloc(o.slots, sizeof(int));
+        o.known = calloc(o.slots, 1);
+        o.values = calloc(o.slots, sizeof(double));
+        if (!o.lets || !o.writes || !o.calls || !o.known || !o.values)
+            o.whole_program = 0; // fold only
+    }
+
+    if (o.whole_program)
+    {
+        fold_program(&o, root);
+    }
+    else
+    {
+        // The root is what the caller holds on to, so a replacement is copied into it
+        ASTNode *result = fold_statement(&o, root);
+        if (!result)
+        {
+            root->type = AST_BLOCK;
+            root->block.statements = NULL;
+            root->block.count = 0;
+        }
+        else if (result != root)
+        {
+            ASTNode *parent = root->parent;
+            *root = *result;
+            root->parent = parent;
+        }
+    }
+
+    free(o.lets);
+    free(o.writes);
+    free(o.calls);
+    free(o.known);
+    free(o.values);
+    free(o.bodies);
+}
+
+/// @brief Source text of an operator token
+static const char *operator_text(Token_Type op)
+{
+    switch (op)
+    {
+#define X(str, type, text, ch) \
+    case type:                 \
+        return text;
+        TOKEN_OPERATOR_LIST
+#undef X
+    default:
+        return "?";
+    }
+}
+
+/// @brief Prints `depth` levels of indentation
+static void indent(FILE *out, int depth)
+{
+    fprintf(out, "%*s", depth * 2, "");
+}
+
+static void dump_node(FILE *out, const ASTNode *node, int depth);
+
+/// @brief Prints a labelled child one level deeper, skipping absent ones
+static void dump_child(FILE *out, const char *label, const ASTNode *node, int depth)
+{
+    if (!node)
+        return;
+    indent(out, depth);
+    fprintf(out, "%s:\n", label);
+    dump_node(out, node, depth + 1);
+}
+
+static void dump_node(FILE *out, const ASTNode *node, int depth)
+{
+    indent(out, depth);
+    if (!node)
+    {
+        fprintf(out, "(null)\n");
+        return;
+    }
+
+    switch (node->type)
+    {
+    case AST_NUMBER:
+        fprintf(out, "NUMBER %.17g\n", node->number.value);
+        break;
+
+    case AST_STRING:
+        fprintf(out, "STRING \"%s\"\n", node->string_literal.value ? node->string_literal.value : "");
+        break;
+
+    case AST_VAR:
+        fprintf(out, "VAR %s\n", node->var.name);
+        break;
+
+    case AST_UNARY:
+        fprintf(out, "UNARY %s\n", operator_text(node->unary_expr.op));
+        dump_node(out, node->unary_expr.operand, depth + 1);
+        break;
+
+    case AST_BINARY:
+        fprintf(out, "BINARY %s\n", operator_text(node->binary_expr.op));
+        dump_node(out, node->binary_expr.left, depth + 1);
+        dump_node(out, node->binary_expr.right, depth + 1);
+        break;
+
+    case AST_TERNARY:
+        fprintf(out, "TERNARY\n");
+        dump_node(out, node->ternary_expr.condition, depth + 1);
+        dump_node(out, node->ternary_expr.true_expr, depth + 1);
+        dump_node(out, node->ternary_expr.false_expr, depth + 1);
+        break;
+
+    case AST_INDEX:
+        fprintf(out, "INDEX\n");
+        dump_node(out, node->index_expr.array, depth + 1);
+        dump_node(out, node->index_expr.index, depth + 1);
+        break;
+
+    case AST_ARRAY_LITERAL:
+    case AST_MAP_LITERAL:
+        fprintf(out, "%s %d\n", node->type == AST_MAP_LITERAL ? "MAP" : "ARRAY", node->array_literal.count);
+        for (int i = 0; i < node->array_literal.count; i++)
+            dump_node(out, node->array_literal.elements[i], depth + 1);
+        break;
+
+    case AST_CALL:
+        fprintf(out, "CALL %s%s\n", node->call_expr.name,
+                node->call_expr.builtin == BUILTIN_NONE ? "" : " (built-in)");
+        for (int i = 0; i < node->call_expr.arg_count; i++)
+            dump_node(out, node->call_expr.args[i], depth + 1);
+        break;
+
+    case AST_LET:
+        fprintf(out, "LET %s\n", node->let_stmt.name);
+        dump_node(out, node->let_stmt.expr, depth + 1);
+        break;
+
+    case AST_ASSIGN:
+        fprintf(out, "ASSIGN %s\n", node->assign_stmt.name);
+        dump_node(out, node->assign_stmt.expr, depth + 1);
+        break;
+
+    case AST_COMPOUND_ASSIGN:
+        fprintf(out, "COMPOUND_ASSIGN %s %s\n", node->compound_assign.name, operator_text(node->compound_assign.op));
+        dump_node(out, node->compound_assign.expr, depth + 1);
+        break;
+
+    case AST_ASSIGN_INDEX:
+        fprintf(out, "ASSIGN_INDEX\n");
+        dump_node(out, node->assign_index.target, depth + 1);
+        dump_node(out, node->assign_index.value, depth + 1);
+        break;
+
+    case AST_EXPR_STMT:
+        fprintf(out, "EXPR_STMT\n");
+        dump_node(out, node->expr_stmt.expr, depth + 1);
+        break;
+
+    case AST_RETURN:
+        fprintf(out, "RETURN\n");
+        if (node->return_stmt.expr)
+            dump_node(out, node->return_stmt.expr, depth + 1);
+        break;
+
+    case AST_BLOCK:
+        fprintf(out, "BLOCK %d\n", node->block.count);
+        for (int i = 0; i < node->block.count; i++)
+            dump_node(out, node->block.statements[i], depth + 1);
+        break;
+
+    case AST_IF:
+        fprintf(out, "IF\n");
+        dump_child(out, "condition", node->if_stmt.condition, depth + 1);
+        dump_child(out, "then", node->if_stmt.then_branch, depth + 1);
+        dump_child(out, "else", node->if_stmt.else_branch, depth + 1);
+        break;
+
+    case AST_MATCH:
+        fprintf(out, "MATCH %d\n", node->match_stmt.arm_count);
+        dump_child(out, "subject", node->match_stmt.subject, depth + 1);
+        for (int i = 0; i < node->match_stmt.arm_count; i++)
+            dump_child(out, "arm", node->match_stmt.arms[i], depth + 1);
+        dump_child(out, "else", node->match_stmt.else_branch, depth + 1);
+        break;
+
+    case AST_WHILE:
+        fprintf(out, "WHILE\n");
+        dump_child(out, "condition", node->while_stmt.condition, depth + 1);
+        dump_child(out, "body", node->while_stmt.body, depth + 1);
+        break;
+
+    case AST_FOR:
+        if (node->for_stmt.is_string_iteration)
+            fprintf(out, "FOR %s%s%s in\n", node->for_stmt.var, node->for_stmt.index_var ? ", " : "",
+                    node->for_stmt.index_var ? node->for_stmt.index_var : "");
+        else
+            fprintf(out, "FOR %s %s\n", node->for_stmt.var, node->for_stmt.exclusive ? "..<" : "..");
+        dump_child(out, "iterable", node->for_stmt.iterable, depth + 1);
+        dump_child(out, "from", node->for_stmt.from, depth + 1);
+        dump_child(out, "to", node->for_stmt.to, depth + 1);
+        dump_child(out, "step", node->for_stmt.step, depth + 1);
+        dump_child(out, "body", node->for_stmt.body, depth + 1);
+        break;
+
+    case AST_FUNCTION:
+        fprintf(out, "FUNCTION %s(", node->function_stmt.name);
+        for (int i = 0; i < node->function_stmt.param_count; i++)
+            fprintf(out, "%s%s", i ? ", " : "", node->function_stmt.params[i]);
+        fprintf(out, ")\n");
+        dump_node(out, node->function_stmt.body, depth + 1);
+        break;
+
+    case AST_GCODE:
+        fprintf(out, "GCODE %s\n", node->gcode_stmt.code);
+        for (int i = 0; i < node->gcode_stmt.argCount; i++)
+            dump_child(out, node->gcode_stmt.args[i].key, node->gcode_stmt.args[i].indexExpr, depth + 1);
+        break;
+
+    case AST_NOTE:
+        fprintf(out, "NOTE\n");
+        for (int i = 0; i < node->note.segment_count; i++)
+        {
+            const NoteSegment *segment = &node->note.segments[i];
+            if (segment->kind == NOTE_EXPR)
+                dump_child(out, "expr", segment->expr, depth + 1);
+            else if (segment->kind == NOTE_TEXT || segment->kind == NOTE_VAR)
+            {
+                indent(out, depth + 1);
+                fprintf(out, "%s \"%.*s\"\n", segment->kind == NOTE_TEXT ? "text" : "var", segment->length,
+                        segment->text);
+            }
+        }
+        break;
+
+    default:
+        fprintf(out, "%s\n", get_ast_type_name(node->type));
+        break;
+    }
+}
+
+void dump_ast(FILE *out, const ASTNode *root)
+{
+    dump_node(out, root, 0);
+}
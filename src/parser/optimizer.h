@@ -0,0 +1,27 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stdio.h>
+#include "ast_nodes.h"
+
+/**
+ * @brief Simplify the resolved program `root` in place before it is run.
+ *
+ * Folds operators and pure built-ins whose operands are number literals,
+ * using the evaluator's own arithmetic so every result is rounded exactly as
+ * at run time; anything that would report an error is left alone. An `if`
+ * whose condition folds keeps only the branch that runs.
+ *
+ * With `whole_program` set, `root` must be the complete program: a top-level
+ * `let` of a number that nothing else binds or assigns is substituted into
+ * the statements after it, and functions that are never called are dropped.
+ * A single statement of a stream is only folded.
+ */
+void optimize_ast(ASTNode *root, int whole_program);
+
+/**
+ * @brief Print the tree under `root` to `out`, one node per line, indented by depth.
+ */
+void dump_ast(FILE *out, const ASTNode *root);
+
+#endif // OPTIMIZER_H
@@ -10,16 +10,31 @@
 #include <ctype.h>
 #include <setjmp.h>
 #define M_PI 3.14159265358979323846
+// Set while a note placeholder is tried: errors abandon it instead of being reported
+static jmp_buf *placeholder_escape;
+
 #define PARSE_ERROR(msg, ...) \
-    fatal_error(get_runtime()->parser.lexer->source, get_runtime()->parser.current.line, get_runtime()->parser.current.column, msg, ##__VA_ARGS__)
+    do { \
+        if (placeholder_escape) \
+            longjmp(*placeholder_escape, 1); \
+        fatal_error(parser_error_source(), parser_token_line(&get_runtime()->parser.current), parser_token_column(&get_runtime()->parser.current), msg, ##__VA_ARGS__); \
+    } while (0)
+
+// An error the parser recovers from, reported unless a note placeholder is being tried
+#define PARSE_REPORT(msg, ...) \
+    do { \
+        if (placeholder_escape) \
+            longjmp(*placeholder_escape, 1); \
+        report_error(msg, ##__VA_ARGS__); \
+    } while (0)
 
 // Enhanced error reporting macro specifically for return statements
 #define RETURN_ERROR(context, msg, ...) \
-    report_return_error(get_runtime()->parser.lexer->source, get_runtime()->parser.current.line, get_runtime()->parser.current.column, context, msg, ##__VA_ARGS__)
+    report_return_error(parser_error_source(), parser_token_line(&get_runtime()->parser.current), parser_token_column(&get_runtime()->parser.current), context, msg, ##__VA_ARGS__)
 
 // Non-fatal error reporting that allows parsing to continue
 #define PARSE_WARNING(msg, ...) \
-    report_error("Warning at %d:%d: " msg, get_runtime()->parser.current.line, get_runtime()->parser.current.column, ##__VA_ARGS__)
+    report_error("Warning at %d:%d: " msg, parser_token_line(&get_runtime()->parser.current), parser_token_column(&get_runtime()->parser.current), ##__VA_ARGS__)
 
 // Parser moved to runtime state - no more global parser
 
@@ -28,6 +43,7 @@ static ASTNode *parse_block();
 static ASTNode *parse_while();
 static ASTNode *parse_for();
 static ASTNode *parse_if();
+static ASTNode *parse_match();
 static ASTNode *parse_let();
 static ASTNode *parse_note();
 static ASTNode *parse_gcode();
@@ -38,21 +54,59 @@ static ASTNode *parse_function();
 static ASTNode *parse_return();
 // static ASTNode *parse_assignment();
 static ASTNode *parse_postfix_expression(); // <-- add this
+static const char *parser_error_source(void);
 
 // Forward declaration
 
 // Restore static variable needed by parse_gcode
 static int gcode_mode_active = 0;
 
+/// @brief Allocates a zeroed node in the compilation's AST arena
+static ASTNode *new_node(ASTNodeType type)
+{
+    ASTNode *node = arena_calloc(&get_runtime()->ast_arena, sizeof(ASTNode));
+    if (!node)
+    {
+        PARSE_ERROR("Memory allocation failed for AST node");
+    }
+    node->type = type;
+    return node;
+}
+
+/// @brief Makes room for one more element in an arena-backed array under construction
+/// @return The array, moved if it could not grow in place
+static void *grow_ast_array(void *array, int count, int *capacity, size_t element_size)
+{
+    if (count < *capacity)
+        return array;
+
+    int new_capacity = *capacity == 0 ? 4 : *capacity * 2;
+    array = arena_grow(&get_runtime()->ast_arena, array, *capacity * element_size, new_capacity * element_size);
+    if (!array)
+    {
+        PARSE_ERROR("Memory allocation failed while growing an AST array");
+    }
+    *capacity = new_capacity;
+    return array;
+}
+
+static ASTNode **grow_node_array(ASTNode **array, int count, int *capacity)
+{
+    return grow_ast_array(array, count, capacity, sizeof(ASTNode *));
+}
+
 /// @brief step 2
 /// @return
 ASTNode *parse_script() {
 
+    Runtime *rt = get_runtime();
+    ArenaMark mark = arena_mark(&rt->ast_arena);
 
     if (setjmp(fatal_error_jump_buffer)) {
-        // ⛔ Fatal error triggered, return NULL cleanly
+        // ⛔ Fatal error triggered, return NULL cleanly; nothing can reach the partial tree
 
         fatal_error_triggered = 0;
+        arena_release(&rt->ast_arena, mark);
         return NULL;
     }
 
@@ -62,7 +116,6 @@ ASTNode *parse_script() {
 
     
 
-    Runtime *rt = get_runtime();
     while (rt->parser.current.type != TOKEN_EOF) {
         if (rt->parser.current.type == TOKEN_NEWLINE) {
             parser_advance();
@@ -86,34 +139,44 @@ if (stmt->type == AST_EMPTY || stmt->type == AST_NOP)
     continue;
 
 
-                if (count >= capacity) {
-            int new_capacity = (capacity == 0) ? 4 : capacity * 2;
-            ASTNode **new_array = malloc(new_capacity * sizeof(ASTNode *));
-if (!new_array) {
-    PARSE_ERROR("[parse_script] Memory allocation failed for statement array");
+        statements = grow_node_array(statements, count, &capacity);
+        statements[count++] = stmt;
+        }
+
+    ASTNode *block = new_node(AST_BLOCK);
+    block->block.statements = statements;
+    block->block.count = count;
+
+    // free_ast() on this root hands its space back to the arena
+    rt->ast_root = block;
+    rt->ast_root_mark = mark;
+    return block;
 }
 
-            if (statements) {
-                memcpy(new_array, statements, count * sizeof(ASTNode *));
-                free(statements);
-            }
-            statements = new_array;
-            capacity = new_capacity;
+/// @brief Parse one top-level statement for statement-at-a-time compilation
+/// @return The next statement, or NULL at end of input. Fatal errors longjmp
+///         to the caller's fatal_error_jump_buffer.
+ASTNode *parse_next_statement()
+{
+    Runtime *rt = get_runtime();
+    while (rt->parser.current.type != TOKEN_EOF) {
+        if (rt->parser.current.type == TOKEN_NEWLINE) {
+            parser_advance();
+            continue;
         }
 
-        statements[count++] = stmt;
+        ASTNode *stmt = parse_statement();
+        if (!stmt) {
+            report_error("[parse_next_statement] Skipping NULL stmt");
+            continue;
         }
 
-    ASTNode *block = malloc(sizeof(ASTNode));
-if (!block) {
-    PARSE_ERROR("[parse_script] Memory allocation failed for block");
-}
-
+        if (stmt->type == AST_EMPTY || stmt->type == AST_NOP)
+            continue;
 
-    block->type = AST_BLOCK;
-    block->block.statements = statements;
-    block->block.count = count;
-    return block;
+        return stmt;
+    }
+    return NULL;
 }
 
 int get_precedence(Token_Type op)
@@ -157,10 +220,46 @@ void parser_advance()
     Runtime *rt = get_runtime();
     // printf("[Parser parser_advance()] calling lexer_next_token...\n");
     rt->parser.previous = rt->parser.current;
-    rt->parser.current = lexer_next_token(rt->parser.lexer);
+    if (rt->parser.tokens)
+        rt->parser.current = token_array_at(rt->parser.tokens, ++rt->parser.token_index);
+    else
+        rt->parser.current = lexer_next_token(rt->parser.lexer);
     // printf("[Parser parser_advance()] got token: type=%d, value=%s\n", rt->parser.current.type, rt->parser.current.value);
 }
 
+/// @brief Line of a token; pre-tokenized sources compute it only when asked
+int parser_token_line(const Token *token)
+{
+    TokenArray *tokens = get_runtime()->parser.tokens;
+    if (!tokens || token->line > 0)
+        return token->line;
+
+    int line, column;
+    token_array_position(tokens, token->offset, &line, &column);
+    return line;
+}
+
+/// @brief Column of a token; pre-tokenized sources compute it only when asked
+int parser_token_column(const Token *token)
+{
+    TokenArray *tokens = get_runtime()->parser.tokens;
+    if (!tokens || token->line > 0)
+        return token->column;
+
+    int line, column;
+    token_array_position(tokens, token->offset, &line, &column);
+    return column;
+}
+
+/// @brief Source text passed to the error reporters for context lines
+static const char *parser_error_source(void)
+{
+    Runtime *rt = get_runtime();
+    if (rt->parser.tokens)
+        return rt->parser.tokens->source;
+    return lexer_error_source(rt->parser.lexer);
+}
+
 // Function definition context tracking for parser
 void parser_enter_function_definition(void)
 {
@@ -203,8 +302,7 @@ static ASTNode *parse_unary()
 
         ASTNode *operand = parse_unary(); // recursive for !! or -- etc.
 
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = AST_UNARY;
+        ASTNode *node = new_node(AST_UNARY);
         node->unary_expr.op = op.type;
         node->unary_expr.operand = operand;
         return node;
@@ -230,14 +328,14 @@ if (rt->parser.current.type == TOKEN_LPAREN)
     // Handle empty parentheses like: ()
     if (rt->parser.current.type == TOKEN_RPAREN) {
         //printf("[parse_primary] ⚠️ Empty parentheses detected — unexpected in primary expression.\n");
-        report_error("[parse_primary] Unexpected empty '()' expression.");
+        PARSE_REPORT("[parse_primary] Unexpected empty '()' expression.");
         return NULL;
     }
 
     ASTNode *expr = parse_binary_expression();
 
     if (!expr) {
-        report_error("[parse_primary] Failed to parse inner expression inside parentheses");
+        PARSE_REPORT("[parse_primary] Failed to parse inner expression inside parentheses");
         return NULL;
     }
 
@@ -245,7 +343,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
 
     if (!match(TOKEN_RPAREN))
     {
-        report_error("[parse_primary] Expected ')' after expression, but got '%s'", rt->parser.current.value);
+        PARSE_REPORT("[parse_primary] Expected ')' after expression, but got '%s'", rt->parser.current.value);
         return NULL;
     }
 
@@ -266,12 +364,10 @@ if (rt->parser.current.type == TOKEN_LPAREN)
         parser_advance(); // consume '-'
         ASTNode *right = parse_primary();
 
-        ASTNode *zero = malloc(sizeof(ASTNode));
-        zero->type = AST_NUMBER;
+        ASTNode *zero = new_node(AST_NUMBER);
         zero->number.value = 0;
 
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = AST_BINARY;
+        ASTNode *node = new_node(AST_BINARY);
         node->binary_expr.op = TOKEN_MINUS;
         node->binary_expr.left = zero;
         node->binary_expr.right = right;
@@ -309,8 +405,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
         }
 
         parser_advance(); // consume the constant
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = AST_NUMBER;
+        ASTNode *node = new_node(AST_NUMBER);
         node->number.value = val;
         return node;
     }
@@ -320,7 +415,8 @@ if (rt->parser.current.type == TOKEN_LPAREN)
         (rt->parser.current.type >= TOKEN_FUNC_ABS && rt->parser.current.type <= TOKEN_FUNC_EXP))
     {
 
-        char *name = strdup(rt->parser.current.value);
+        const char *name = rt->parser.current.value; // interned, not copied
+        Token_Type name_type = rt->parser.current.type;
         //fprintf(stderr, "[Parser] Detected identifier or function name: '%s'\n", name);
 
         parser_advance(); // consume function or variable name
@@ -336,11 +432,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
 
             while (rt->parser.current.type != TOKEN_RPAREN)
             {
-                if (arg_count >= arg_capacity)
-                {
-                    arg_capacity = (arg_capacity == 0) ? 4 : arg_capacity * 2;
-                    args = realloc(args, arg_capacity * sizeof(ASTNode *));
-                }
+                args = grow_node_array(args, arg_count, &arg_capacity);
 
                 //fprintf(stderr, "[Parser] Parsing argument %d for '%s'\n", arg_count + 1, name);
                 args[arg_count++] = parse_binary_expression();
@@ -361,11 +453,11 @@ if (rt->parser.current.type == TOKEN_LPAREN)
                // fprintf(stderr, "[Parser] ERROR: Expected ')' after function arguments for '%s'\n", name);
             }
 
-            ASTNode *node = malloc(sizeof(ASTNode));
-            node->type = AST_CALL;
+            ASTNode *node = new_node(AST_CALL);
             node->call_expr.name = name;
             node->call_expr.args = args;
             node->call_expr.arg_count = arg_count;
+            node->call_expr.builtin = bind_builtin(name_type, name, arg_count);
 
             //fprintf(stderr, "[Parser] Created AST_CALL node for function '%s' with %d arguments\n", name, arg_count);
             return node;
@@ -374,8 +466,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
         else
         {
             // Variable reference
-            ASTNode *node = malloc(sizeof(ASTNode));
-            node->type = AST_VAR;
+            ASTNode *node = new_node(AST_VAR);
             node->var.name = name;
             return node;
         }
@@ -384,8 +475,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
     // Handle numeric constants
     if (rt->parser.current.type == TOKEN_NUMBER)
     {
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = AST_NUMBER;
+        ASTNode *node = new_node(AST_NUMBER);
         node->number.value = atof(rt->parser.current.value);
         parser_advance(); // consume number
         return node;
@@ -394,17 +484,8 @@ if (rt->parser.current.type == TOKEN_LPAREN)
     // Handle string literals
     if (rt->parser.current.type == TOKEN_STRING)
     {
-        ASTNode *node = malloc(sizeof(ASTNode));
-        if (!node) {
-            PARSE_ERROR("Memory allocation failed for string literal");
-        }
-        
-        node->type = AST_STRING;
-        node->string_literal.value = strdup(rt->parser.current.value);
-        if (!node->string_literal.value) {
-            free(node);
-            PARSE_ERROR("Memory allocation failed for string literal value");
-        }
+        ASTNode *node = new_node(AST_STRING);
+        node->string_literal.value = rt->parser.current.value; // interned literal
         
         parser_advance(); // consume string
         return node;
@@ -423,11 +504,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
         {
             while (1)
             {
-                if (count >= capacity)
-                {
-                    capacity = capacity == 0 ? 4 : capacity * 2;
-                    elements = realloc(elements, capacity * sizeof(ASTNode *));
-                }
+                elements = grow_node_array(elements, count, &capacity);
 
                 elements[count++] = parse_binary_expression();
 
@@ -441,7 +518,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
                 }
                 else
                 {
-                    report_error("[Parser] Expected ',' or ']' in array literal, found '%s'", rt->parser.current.value);
+                    PARSE_REPORT("[Parser] Expected ',' or ']' in array literal, found '%s'", rt->parser.current.value);
                     return NULL;
                 }
             }
@@ -449,8 +526,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
 
         match(TOKEN_RBRACKET); // consume final ']'
 
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = AST_ARRAY_LITERAL;
+        ASTNode *node = new_node(AST_ARRAY_LITERAL);
         node->array_literal.elements = elements;
         node->array_literal.count = count;
 
@@ -465,8 +541,7 @@ if (rt->parser.current.type == TOKEN_LPAREN)
                 PARSE_ERROR("Expected ']' after index");
             }
 
-            ASTNode *index_node = malloc(sizeof(ASTNode));
-            index_node->type = AST_INDEX;
+            ASTNode *index_node = new_node(AST_INDEX);
             index_node->index_expr.array = node;
             index_node->index_expr.index = index;
             node = index_node; // chain it
@@ -475,14 +550,62 @@ if (rt->parser.current.type == TOKEN_LPAREN)
         return node;
     }
 
+    // Handle map literal: {"A": 1, "B": [2, 3]}
+    if (rt->parser.current.type == TOKEN_LBRACE)
+    {
+        parser_advance(); // consume '{'
+
+        ASTNode **elements = NULL;
+        int *keys = NULL;
+        int count = 0, capacity = 0, key_capacity = 0;
+
+        while (rt->parser.current.type != TOKEN_RBRACE)
+        {
+            if (rt->parser.current.type != TOKEN_STRING)
+            {
+                PARSE_ERROR("Expected a string key in map literal, found '%s'", rt->parser.current.value);
+            }
+
+            // Keys are interned once here, so a lookup compares ids
+            const char *key = rt->parser.current.value;
+            keys = grow_ast_array(keys, count, &key_capacity, sizeof(int));
+            keys[count] = intern_id(&rt->strings, key, (int)strlen(key));
+            parser_advance(); // consume key
+
+            if (!match(TOKEN_COLON))
+            {
+                PARSE_ERROR("Expected ':' after map key \"%s\"", key);
+            }
+
+            elements = grow_node_array(elements, count, &capacity);
+            elements[count++] = parse_binary_expression();
+
+            if (rt->parser.current.type == TOKEN_COMMA)
+            {
+                parser_advance(); // consume comma and continue
+            }
+            else if (rt->parser.current.type != TOKEN_RBRACE)
+            {
+                PARSE_ERROR("Expected ',' or '}' in map literal, found '%s'", rt->parser.current.value);
+            }
+        }
+
+        match(TOKEN_RBRACE); // consume final '}'
+
+        ASTNode *node = new_node(AST_MAP_LITERAL);
+        node->array_literal.elements = elements;
+        node->array_literal.count = count;
+        node->array_literal.keys = keys;
+        return node;
+    }
+
             PARSE_ERROR("[parse_primary end] Unexpected token in expression: '%s'", rt->parser.current.value);
 
 
 
 
     // Return dummy NOP node to avoid crashing
-    ASTNode *dummy = malloc(sizeof(ASTNode));
-    dummy->type = AST_NOP;
+    ASTNode *dummy = new_node(AST_NOP);
     return dummy;
 }
 
@@ -500,8 +623,7 @@ static ASTNode *parse_postfix_expression()
             PARSE_ERROR("Expected ']' after index");
         }
 
-        ASTNode *index_node = malloc(sizeof(ASTNode));
-        index_node->type = AST_INDEX;
+        ASTNode *index_node = new_node(AST_INDEX);
         index_node->index_expr.array = expr;
         index_node->index_expr.index = index;
         expr = index_node;
@@ -539,8 +661,7 @@ static ASTNode *parse_binary_expression_prec(int min_prec)
             
             ASTNode *false_expr = parse_binary_expression_prec(prec); // Right-associative
             
-            ASTNode *node = malloc(sizeof(ASTNode));
-            node->type = AST_TERNARY;
+            ASTNode *node = new_node(AST_TERNARY);
             node->ternary_expr.condition = left;
             node->ternary_expr.true_expr = true_expr;
             node->ternary_expr.false_expr = false_expr;
@@ -555,8 +676,7 @@ static ASTNode *parse_binary_expression_prec(int min_prec)
             int next_prec = (op == TOKEN_CARET) ? prec : prec + 1;
             ASTNode *right = parse_binary_expression_prec(next_prec);
 
-            ASTNode *node = malloc(sizeof(ASTNode));
-            node->type = AST_BINARY;
+            ASTNode *node = new_node(AST_BINARY);
             node->binary_expr.op = op;
             node->binary_expr.left = left;
             node->binary_expr.right = right;
@@ -583,7 +703,7 @@ static ASTNode *parse_function()
         PARSE_ERROR("Expected function name after 'function'");
     }
 
-    char *name = strdup(rt->parser.current.value); // Save function name
+    const char *name = rt->parser.current.value; // Save function name (interned)
     parser_advance();                          // Consume name
 
     if (!match(TOKEN_LPAREN))
@@ -592,7 +712,7 @@ static ASTNode *parse_function()
     }
 
     // Handle parameter list
-    char **params = NULL;
+    const char **params = NULL;
     int param_count = 0, param_capacity = 0;
 
     while (rt->parser.current.type != TOKEN_RPAREN)
@@ -603,17 +723,9 @@ static ASTNode *parse_function()
         }
 
         // Grow parameter list if needed
-        if (param_count >= param_capacity)
-        {
-            param_capacity = param_capacity == 0 ? 4 : param_capacity * 2;
-            params = realloc(params, param_capacity * sizeof(char *));
-            if (!params)
-            {
-                PARSE_ERROR("Out of memory while parsing parameters");
-            }
-        }
+        params = grow_ast_array(params, param_count, &param_capacity, sizeof(char *));
 
-        params[param_count++] = strdup(rt->parser.current.value);
+        params[param_count++] = rt->parser.current.value;
         parser_advance(); // Consume parameter name
 
         if (rt->parser.current.type == TOKEN_COMMA)
@@ -638,8 +750,7 @@ static ASTNode *parse_function()
     parser_exit_function_definition();
 
     // Build function node
-    ASTNode *node = calloc(1, sizeof(ASTNode));
-    node->type = AST_FUNCTION;
+    ASTNode *node = new_node(AST_FUNCTION);
     node->function_stmt.name = name;
     node->function_stmt.params = params;
     node->function_stmt.param_count = param_count;
@@ -664,27 +775,23 @@ static ASTNode *parse_return()
     // Enhanced function context validation with detailed error messages
     if (!parser_is_inside_function_definition()) {
         // Provide context-specific error messages based on current parsing context
-        if (rt->parser.lexer->line == 1) {
+        if (parser_token_line(&rt->parser.current) == 1) {
             PARSE_ERROR("Return statement at global scope (line %d:%d) - return statements are only valid inside functions.\n"
                        "  → Suggestion: Wrap your code in a function definition:\n"
                        "    function main() {\n"
                        "        return %s\n"
                        "    }", 
-                       return_token.line, return_token.column,
+                       parser_token_line(&return_token), parser_token_column(&return_token),
                        rt->parser.current.type != TOKEN_NEWLINE && rt->parser.current.type != TOKEN_EOF ? "your_expression" : "");
         } else {
             PARSE_ERROR("Return statement outside function context (line %d:%d) - return statements must be inside function definitions.\n"
                        "  → Current context: Global scope\n"
                        "  → Suggestion: Move this return statement inside a function", 
-                       return_token.line, return_token.column);
+                       parser_token_line(&return_token), parser_token_column(&return_token));
         }
         
         // Error recovery: create a dummy return node to continue parsing
-        ASTNode *error_node = malloc(sizeof(ASTNode));
-        if (error_node) {
-            error_node->type = AST_NOP;  // Use NOP to indicate error recovery
-        }
-        return error_node;
+        return new_node(AST_NOP);  // Use NOP to indicate error recovery
     }
     
     ASTNode *expr = NULL;
@@ -714,37 +821,37 @@ static ASTNode *parse_return()
                     PARSE_ERROR("Invalid operator '%s' at start of return expression (line %d:%d).\n"
                                "  → Error: Operators cannot appear at the beginning of expressions\n"
                                "  → Suggestion: Add a value before the operator, e.g., 'return 0 %s expression'", 
-                               saved_current.value, saved_current.line, saved_current.column, saved_current.value);
+                               saved_current.value, parser_token_line(&saved_current), parser_token_column(&saved_current), saved_current.value);
                     break;
                 case TOKEN_RPAREN:
                     PARSE_ERROR("Unexpected ')' in return expression (line %d:%d) - missing opening parenthesis.\n"
                                "  → Error: Unmatched closing parenthesis\n"
                                "  → Suggestion: Add opening '(' or remove the closing ')'", 
-                               saved_current.line, saved_current.column);
+                               parser_token_line(&saved_current), parser_token_column(&saved_current));
                     break;
                 case TOKEN_COMMA:
                     PARSE_ERROR("Unexpected ',' in return expression (line %d:%d) - return statements accept only single expressions.\n"
                                "  → Error: Multiple values in return statement\n"
                                "  → Suggestion: Return a single value or use an array: 'return [value1, value2]'", 
-                               saved_current.line, saved_current.column);
+                               parser_token_line(&saved_current), parser_token_column(&saved_current));
                     break;
                 case TOKEN_RBRACKET:
                     PARSE_ERROR("Unexpected ']' in return expression (line %d:%d) - missing opening bracket.\n"
                                "  → Error: Unmatched closing bracket\n"
                                "  → Suggestion: Add opening '[' or remove the closing ']'", 
-                               saved_current.line, saved_current.column);
+                               parser_token_line(&saved_current), parser_token_column(&saved_current));
                     break;
                 case TOKEN_EQUAL:
                     PARSE_ERROR("Unexpected '=' in return expression (line %d:%d) - assignment not allowed in return statements.\n"
                                "  → Error: Cannot assign values in return expressions\n"
                                "  → Suggestion: Use comparison '==' or move assignment before return", 
-                               saved_current.line, saved_current.column);
+                               parser_token_line(&saved_current), parser_token_column(&saved_current));
                     break;
                 default:
                     PARSE_ERROR("Invalid or malformed expression in return statement (line %d:%d) starting with '%s'.\n"
                                "  → Error: Unexpected token '%s' of type %d\n"
                                "  → Suggestion: Check expression syntax and ensure proper operators/operands", 
-                               saved_current.line, saved_current.column, saved_current.value, 
+                               parser_token_line(&saved_current), parser_token_column(&saved_current), saved_current.value, 
                                saved_current.value, saved_current.type);
                     break;
             }
@@ -765,7 +872,7 @@ static ASTNode *parse_return()
                 PARSE_ERROR("Empty or invalid expression in return statement (line %d:%d).\n"
                            "  → Error: Expression evaluated to no-operation\n"
                            "  → Suggestion: Provide a valid expression after 'return'", 
-                           return_token.line, return_token.column);
+                           parser_token_line(&return_token), parser_token_column(&return_token));
             }
             
             // Enhanced validation for trailing invalid tokens with specific error messages
@@ -781,7 +888,7 @@ static ASTNode *parse_return()
                     PARSE_ERROR("Multiple expressions in return statement (line %d:%d) - found '%s' after '%s'.\n"
                                "  → Error: Return statements can only contain one expression\n"
                                "  → Suggestion: Use an operator between values: 'return %s + %s' or 'return %s * %s'", 
-                               rt->parser.current.line, rt->parser.current.column,
+                               parser_token_line(&rt->parser.current), parser_token_column(&rt->parser.current),
                                rt->parser.current.value, rt->parser.previous.value,
                                rt->parser.previous.value, rt->parser.current.value,
                                rt->parser.previous.value, rt->parser.current.value);
@@ -789,12 +896,12 @@ static ASTNode *parse_return()
                     PARSE_ERROR("Unexpected '(' after return expression (line %d:%d).\n"
                                "  → Error: Function call syntax after return expression\n"
                                "  → Suggestion: Move function call inside return: 'return function_name(args)'", 
-                               rt->parser.current.line, rt->parser.current.column);
+                               parser_token_line(&rt->parser.current), parser_token_column(&rt->parser.current));
                 } else {
                     PARSE_ERROR("Unexpected token '%s' after return expression (line %d:%d).\n"
                                "  → Error: Invalid syntax following return expression\n"
                                "  → Suggestion: End return statement with newline or '}'", 
-                               rt->parser.current.value, rt->parser.current.line, rt->parser.current.column);
+                               rt->parser.current.value, parser_token_line(&rt->parser.current), parser_token_column(&rt->parser.current));
                 }
                 
                 // Error recovery: skip the problematic token and continue
@@ -806,21 +913,12 @@ static ASTNode *parse_return()
         // This is valid, but we can provide helpful context in debug mode
         #ifdef DEBUG_PARSER
         printf("INFO: Bare return statement at line %d:%d (no expression)\n", 
-               return_token.line, return_token.column);
+               parser_token_line(&return_token), parser_token_column(&return_token));
         #endif
     }
     
     // Create return AST node with enhanced error checking
-    ASTNode *node = malloc(sizeof(ASTNode));
-    if (!node) {
-        PARSE_ERROR("Memory allocation failed for return statement (line %d:%d).\n"
-                   "  → Error: Out of memory while creating AST node\n"
-                   "  → Suggestion: Check available memory or simplify code structure", 
-                   return_token.line, return_token.column);
-        return NULL;  // Return NULL to indicate failure
-    }
-    
-    node->type = AST_RETURN;
+    ASTNode *node = new_node(AST_RETURN);
     node->return_stmt.expr = expr;  // Can be NULL for bare returns
     
     // Store line information in the AST node for runtime error reporting
@@ -846,6 +944,8 @@ static ASTNode *parse_statement()
         return parse_for();
     if (rt->parser.current.type == TOKEN_IF)
         return parse_if();
+    if (rt->parser.current.type == TOKEN_MATCH)
+        return parse_match();
     if (rt->parser.current.type == TOKEN_LET)
         return parse_let();
     if (rt->parser.current.type == TOKEN_NOTE)
@@ -867,8 +967,7 @@ static ASTNode *parse_statement()
     ASTNode *expr = parse_binary_expression();
     if (expr && expr->type != AST_NOP)
     {
-        ASTNode *stmt = malloc(sizeof(ASTNode));
-        stmt->type = AST_EXPR_STMT;
+        ASTNode *stmt = new_node(AST_EXPR_STMT);
         stmt->expr_stmt.expr = expr;
         return stmt;
     }
@@ -886,8 +985,7 @@ static ASTNode *parse_identifier_statement()
     // Case 1: Function call like foo(1,2)
     if (node->type == AST_CALL)
     {
-        ASTNode *stmt = malloc(sizeof(ASTNode));
-        stmt->type = AST_EXPR_STMT;
+        ASTNode *stmt = new_node(AST_EXPR_STMT);
         stmt->expr_stmt.expr = node;
         return stmt;
     }
@@ -895,7 +993,7 @@ static ASTNode *parse_identifier_statement()
     // Case 2: Assignment like foo = 123 or maze[i][j] = 7
     if (rt->parser.current.type == TOKEN_EQUAL)
     {
-        ASTNode *assign = malloc(sizeof(ASTNode));
+        ASTNode *assign = new_node(AST_NOP);
         ASTNode *rhs = NULL;
         parser_advance(); // consume '='
 
@@ -933,8 +1031,7 @@ static ASTNode *parse_identifier_statement()
             PARSE_ERROR("[parse_identifier_statement] Compound assignment only supported for variables, not array indices");
         }
 
-        ASTNode *compound = malloc(sizeof(ASTNode));
-        compound->type = AST_COMPOUND_ASSIGN;
+        ASTNode *compound = new_node(AST_COMPOUND_ASSIGN);
         compound->compound_assign.name = node->var.name;
         compound->compound_assign.op = rt->parser.current.type;
         
@@ -947,12 +1044,10 @@ static ASTNode *parse_identifier_statement()
     // Case 3: Implicit assignment like `foo` → `foo = 0`
     if (node->type == AST_VAR)
     {
-        ASTNode *assign = malloc(sizeof(ASTNode));
-        assign->type = AST_ASSIGN;
+        ASTNode *assign = new_node(AST_ASSIGN);
         assign->assign_stmt.name = node->var.name;
 
-        ASTNode *rhs = malloc(sizeof(ASTNode));
-        rhs->type = AST_NUMBER;
+        ASTNode *rhs = new_node(AST_NUMBER);
         rhs->number.value = 0.0;
 
         assign->assign_stmt.expr = rhs;
@@ -960,8 +1055,7 @@ static ASTNode *parse_identifier_statement()
     }
 
     // Case 4: Fallback to raw expression
-    ASTNode *stmt = malloc(sizeof(ASTNode));
-    stmt->type = AST_EXPR_STMT;
+    ASTNode *stmt = new_node(AST_EXPR_STMT);
     stmt->expr_stmt.expr = node;
     return stmt;
 }
@@ -988,11 +1082,7 @@ static ASTNode *parse_block()
         ASTNode *stmt = parse_statement();
         if (stmt != NULL)
         {
-            if (count >= capacity)
-            {
-                capacity = capacity == 0 ? 4 : capacity * 2;
-                statements = realloc(statements, capacity * sizeof(ASTNode *));
-            }
+            statements = grow_node_array(statements, count, &capacity);
 
             statements[count++] = stmt;
         }
@@ -1006,8 +1096,7 @@ static ASTNode *parse_block()
             parser_advance();
     }
 
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = AST_BLOCK;
+    ASTNode *node = new_node(AST_BLOCK);
     node->block.statements = statements;
     node->block.count = count;
     return node;
@@ -1023,7 +1112,7 @@ static ASTNode *parse_let()
         PARSE_ERROR("[parse_let] Expected identifier after 'let'");
     }
 
-    char *name = strdup(rt->parser.current.value);
+    const char *name = rt->parser.current.value;
     parser_advance();
 
     if (!match(TOKEN_EQUAL))
@@ -1033,8 +1122,7 @@ static ASTNode *parse_let()
 
     ASTNode *expr = parse_binary_expression(); // Save the raw expression
 
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = AST_LET;
+    ASTNode *node = new_node(AST_LET);
     node->let_stmt.name = name;
     node->let_stmt.expr = expr;
     return node;
@@ -1055,7 +1143,7 @@ static ASTNode *parse_for()
             PARSE_ERROR("[parse_for] Expected identifier for character variable, but got '%s'", rt->parser.current.value);
         }
         
-        char *var = strdup(rt->parser.current.value);
+        const char *var = rt->parser.current.value;
         parser_advance();
         
         if (rt->parser.current.type != TOKEN_COMMA)
@@ -1069,7 +1157,7 @@ static ASTNode *parse_for()
             PARSE_ERROR("[parse_for] Expected identifier for index variable, but got '%s'", rt->parser.current.value);
         }
         
-        char *index_var = strdup(rt->parser.current.value);
+        const char *index_var = rt->parser.current.value;
         parser_advance();
         
         if (rt->parser.current.type != TOKEN_RPAREN)
@@ -1088,8 +1176,7 @@ static ASTNode *parse_for()
         ASTNode *iterable = parse_binary_expression();
         ASTNode *body = parse_block();
 
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = AST_FOR;
+        ASTNode *node = new_node(AST_FOR);
         node->for_stmt.var = var;
         node->for_stmt.index_var = index_var;
         node->for_stmt.from = NULL;
@@ -1108,7 +1195,7 @@ static ASTNode *parse_for()
         PARSE_ERROR("[parse_for] Expected identifier after 'for', but got '%s'", rt->parser.current.value);
     }
 
-    char *var = strdup(rt->parser.current.value);
+    const char *var = rt->parser.current.value;
     parser_advance();
 
     // Check for string iteration syntax: for char in string_var
@@ -1120,8 +1207,7 @@ static ASTNode *parse_for()
         ASTNode *iterable = parse_binary_expression();
         ASTNode *body = parse_block();
 
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = AST_FOR;
+        ASTNode *node = new_node(AST_FOR);
         node->for_stmt.var = var;
         node->for_stmt.index_var = NULL;
         node->for_stmt.from = NULL;
@@ -1170,16 +1256,14 @@ static ASTNode *parse_for()
     }
     if (!step)
     {
-        step = malloc(sizeof(ASTNode));
-        step->type = AST_NUMBER;
+        step = new_node(AST_NUMBER);
         step->number.value = 1.0;
     }
 
     ///step5
     ASTNode *body = parse_block();
 
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = AST_FOR;
+    ASTNode *node = new_node(AST_FOR);
     node->for_stmt.var = var;
     node->for_stmt.index_var = NULL;
     node->for_stmt.from = from;
@@ -1200,70 +1284,174 @@ static ASTNode *parse_while()
 
     ASTNode *body = parse_block(); // parse block after condition
 
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = AST_WHILE;
+    ASTNode *node = new_node(AST_WHILE);
     node->while_stmt.condition = condition;
     node->while_stmt.body = body;
 
     return node;
 }
 
-static ASTNode *parse_note()
+/// @brief Appends one segment to a note template under construction
+static void push_note_segment(ASTNode *note, int *capacity, NoteSegmentKind kind,
+                              const char *text, int length, ASTNode *expr)
+{
+    note->note.segments = grow_ast_array(note->note.segments, note->note.segment_count, capacity, sizeof(NoteSegment));
+    NoteSegment *segment = &note->note.segments[note->note.segment_count++];
+    segment->kind = kind;
+    segment->text = text;
+    segment->length = length;
+    segment->expr = expr;
+}
+
+/// @brief Parses a note placeholder, or returns NULL without reporting if it does not parse.
+///
+/// The note may never run, so a bad placeholder must not fail the program;
+/// it is kept as a variable lookup and reported only if the note is emitted.
+static ASTNode *try_parse_placeholder(const char *expr_text)
 {
     Runtime *rt = get_runtime();
-    parser_advance(); // skip 'note'
+    Lexer *saved_lexer = rt->parser.lexer;
+    TokenArray *saved_tokens = rt->parser.tokens;
+    int saved_index = rt->parser.token_index;
+    Token saved_current = rt->parser.current;
 
-    // printf("[Parser] Saw 'note'\n");
+    Lexer *lexer = lexer_new(expr_text);
+    if (!lexer)
+        return NULL;
+    lexer->defer_errors = 1;
 
-    if (rt->parser.current.type != TOKEN_LBRACE)
+    ASTNode *expr = NULL;
+    jmp_buf escape;
+    if (!setjmp(escape))
     {
-        PARSE_ERROR("[parse_note] Expected '{' after 'note'");
+        placeholder_escape = &escape;
+        rt->parser.lexer = lexer;
+        rt->parser.tokens = NULL;
+        parser_advance();
+        expr = parse_binary_expression();
+        if (lexer->error[0])
+            expr = NULL;
     }
+    placeholder_escape = NULL;
 
-    // Manually store brace start before advancing
+    lexer_free(lexer);
+    rt->parser.lexer = saved_lexer;
+    rt->parser.tokens = saved_tokens;
+    rt->parser.token_index = saved_index;
+    rt->parser.current = saved_current;
+    return expr;
+}
 
-    const char *start = rt->parser.lexer->source + rt->parser.lexer->pos;
+/// @brief Splits a note body into comment lines of text and placeholder segments.
+///
+/// Empty lines are dropped and a trailing '\r' becomes a space. A placeholder
+/// runs from '[' or '{' to the closer that balances it (at most 255 characters)
+/// and is parsed here, once, instead of every time the note is emitted.
+static void compile_note_template(ASTNode *note)
+{
+    Runtime *rt = get_runtime();
+    int capacity = 0;
+    const char *p = note->note.content;
 
-    int start_pos = rt->parser.lexer->pos;
+    while (*p)
+    {
+        const char *line_end = strchr(p, '\n');
+        if (!line_end)
+            line_end = p + strlen(p);
+        if (line_end == p)
+        {
+            p++;
+            continue;
+        }
 
-    // printf("[Parser] Found '{' at position %d\n", rt->parser.lexer->pos);
+        const char *text = p;
+        while (p < line_end)
+        {
+            if (*p != '[' && *p != '{')
+            {
+                // A line's closing '\r' is shown as a space
+                if (*p == '\r' && p + 1 == line_end)
+                {
+                    if (p > text)
+                        push_note_segment(note, &capacity, NOTE_TEXT, text, (int)(p - text), NULL);
+                    push_note_segment(note, &capacity, NOTE_TEXT, " ", 1, NULL);
+                    text = line_end;
+                }
+                p++;
+                continue;
+            }
 
-    parser_advance(); // consume '{'
-    int brace_depth = 1;
+            if (p > text)
+                push_note_segment(note, &capacity, NOTE_TEXT, text, (int)(p - text), NULL);
 
-    while (rt->parser.current.type != TOKEN_EOF && brace_depth > 0)
-    {
-        char c = rt->parser.lexer->source[rt->parser.lexer->pos];
-        if (c == '{')
-            brace_depth++;
-        else if (c == '}')
-            brace_depth--;
-        
-        // Properly track line numbers when encountering newlines
-        if (c == '\n') {
-            rt->parser.lexer->line++;
-            rt->parser.lexer->column = 1;
-        } else {
-            rt->parser.lexer->column++;
+            char opening_char = *p;
+            char closing_char = (opening_char == '[') ? ']' : '}';
+            p++;
+            const char *expr_start = p;
+            int depth = 0;   // `[a[i]]` closes at its second ']'
+            while (p < line_end && p - expr_start < 255)
+            {
+                if (*p == opening_char)
+                    depth++;
+                else if (*p == closing_char && depth-- == 0)
+                    break;
+                p++;
+            }
+            char *expr_text = arena_strndup(&rt->ast_arena, expr_start, (size_t)(p - expr_start));
+            if (!expr_text)
+            {
+                PARSE_ERROR("[parse_note] Memory allocation failed for note placeholder");
+            }
+            if (p < line_end && *p == closing_char)
+                p++;
+            text = p;
+
+            size_t expr_length = strlen(expr_text);
+            if (expr_length > 0 && expr_text[expr_length - 1] == '\r' && p == line_end)
+                expr_text[expr_length - 1] = ' ';   // the line's '\r' fell inside an unclosed placeholder
+
+            if (strcmp(expr_text, "time") == 0)
+                push_note_segment(note, &capacity, NOTE_TIME, NULL, 0, NULL);
+            else if (strcmp(expr_text, "ggcode_file_name") == 0)
+                push_note_segment(note, &capacity, NOTE_FILE_NAME, NULL, 0, NULL);
+            else
+            {
+                ASTNode *expr = try_parse_placeholder(expr_text);
+                push_note_segment(note, &capacity, expr ? NOTE_EXPR : NOTE_VAR, expr_text, (int)strlen(expr_text), expr);
+            }
         }
-        
-        rt->parser.lexer->pos++;
+
+        if (p > text)
+            push_note_segment(note, &capacity, NOTE_TEXT, text, (int)(p - text), NULL);
+        push_note_segment(note, &capacity, NOTE_LINE_END, NULL, 0, NULL);
     }
+}
 
-    int len = rt->parser.lexer->pos - start_pos - 1; // exclude final '}'
-    char *content = strndup_portable(start, len);
+static ASTNode *parse_note()
+{
+    Runtime *rt = get_runtime();
+    parser_advance(); // skip 'note'
 
-    // //printf("[Parser] Raw captured string (%d bytes): \"", len);
-    // fwrite(content, 1, len, stdout);
-    // //printf("\"\n");
+    // printf("[Parser] Saw 'note'\n");
 
-    parser_advance(); // consume final '}'
+    if (rt->parser.current.type != TOKEN_LBRACE)
+    {
+        PARSE_ERROR("[parse_note] Expected '{' after 'note'");
+    }
 
-    //  //printf("[Parser] Consumed '}'\n");
+    // The lexer hands the raw body over as one TOKEN_NOTE_TEXT slice
+    parser_advance(); // consume '{'
+    char *content = arena_strndup(&rt->ast_arena, rt->parser.current.value, rt->parser.current.length);
+    if (!content)
+    {
+        PARSE_ERROR("[parse_note] Memory allocation failed for note text");
+    }
+    parser_advance(); // consume the body
+    match(TOKEN_RBRACE); // an unterminated note runs to the end of input
 
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = AST_NOTE;
+    ASTNode *node = new_node(AST_NOTE);
     node->note.content = content;
+    compile_note_template(node);
     return node;
 }
 
@@ -1283,7 +1471,15 @@ static ASTNode *parse_gcode()
         parser_advance();
     }
 
-    char *code = strdup(line);
+    // Interned ids let the emitter compare word lists as integers
+    int length = (int)strlen(line);
+    int code_id = intern_id(&rt->strings, line, length);
+    int modal_key_id = intern_id(&rt->strings, line,
+                                 length < GCODE_MODAL_KEY_LENGTH ? length : GCODE_MODAL_KEY_LENGTH);
+    if (code_id < 0 || modal_key_id < 0)
+    {
+        PARSE_ERROR("[parse_gcode] Memory allocation failed for G-code word");
+    }
     GArg *args = NULL;
     int count = 0, capacity = 0;
 
@@ -1299,7 +1495,6 @@ static ASTNode *parse_gcode()
             break;
         }
 
-        char *key_copy = strdup(key);
         parser_advance();
 
         ASTNode *index = NULL;
@@ -1314,20 +1509,17 @@ static ASTNode *parse_gcode()
         }
 
         // Expand storage
-        if (count >= capacity)
-        {
-            capacity = capacity == 0 ? 4 : capacity * 2;
-            args = realloc(args, capacity * sizeof(GArg));
-        }
+        args = grow_ast_array(args, count, &capacity, sizeof(GArg));
 
-        args[count++] = (GArg){key_copy, index};
+        args[count++] = (GArg){key, key[0] - 'A', index};
 
         // We stop adding args once we hit anything that’s not a valid G-code arg
     }
 
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = AST_GCODE;
-    node->gcode_stmt.code = code;
+    ASTNode *node = new_node(AST_GCODE);
+    node->gcode_stmt.code = intern_text(&rt->strings, code_id);
+    node->gcode_stmt.code_id = code_id;
+    node->gcode_stmt.modal_key_id = modal_key_id;
     node->gcode_stmt.args = args;
     node->gcode_stmt.argCount = count;
     gcode_mode_active = 1;
@@ -1338,8 +1530,7 @@ static ASTNode *parse_gcode()
 static ASTNode *parse_if()
 {
     Runtime *rt = get_runtime();
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = AST_IF;
+    ASTNode *node = new_node(AST_IF);
 
     parser_advance(); // skip 'if'
 
@@ -1382,169 +1573,213 @@ static ASTNode *parse_if()
     return node;
 }
 
-void free_ast(ASTNode *node)
+// Number label of a `match` arm, before the dispatch table is built
+typedef struct
 {
-    if (!node)
+    double value;
+    int arm;
+} MatchNumber;
+
+/// @brief Orders number labels by value, then by arm, so the first arm of a repeated label comes first
+static int compare_match_numbers(const void *a, const void *b)
+{
+    const MatchNumber *x = a, *y = b;
+    if (x->value != y->value)
+        return x->value < y->value ? -1 : 1;
+    return x->arm - y->arm;
+}
+
+/// @brief Fills an arena table of `count` ints with -1 (no arm)
+static int *new_arm_table(int count)
+{
+    int *table = arena_alloc(&get_runtime()->ast_arena, (size_t)count * sizeof(int));
+    if (!table)
+    {
+        PARSE_ERROR("Memory allocation failed for a match table");
+    }
+    for (int i = 0; i < count; i++)
+        table[i] = -1;
+    return table;
+}
+
+/// @brief Builds the number dispatch of `node`: a dense table for close integer labels, else a sorted list
+static void build_match_numbers(ASTNode *node, MatchNumber *labels, int count)
+{
+    if (count == 0)
         return;
 
-    switch (node->type)
+    double low = labels[0].value, high = labels[0].value;
+    int integral = 1;
+    for (int i = 0; i < count; i++)
     {
+        double value = labels[i].value;
+        integral = integral && value > -1e9 && value < 1e9 && value == (double)(int)value;
+        if (value < low)
+            low = value;
+        if (value > high)
+            high = value;
+    }
 
-    case AST_NOP:
-        // Nothing to free
-        break;
+    double span = high - low + 1;
+    if (integral && span <= (count * 2 > 16 ? count * 2 : 16))
+    {
+        node->match_stmt.dense_first = (int)low;
+        node->match_stmt.dense_count = (int)span;
+        node->match_stmt.dense = new_arm_table((int)span);
+        for (int i = 0; i < count; i++)
+        {
+            int *entry = &node->match_stmt.dense[(int)labels[i].value - (int)low];
+            if (*entry < 0)
+                *entry = labels[i].arm;
+        }
+        return;
+    }
 
-    case AST_EMPTY:
-        // Nothing to free
-        break;
+    qsort(labels, (size_t)count, sizeof(MatchNumber), compare_match_numbers);
+    Runtime *rt = get_runtime();
+    double *numbers = arena_alloc(&rt->ast_arena, (size_t)count * sizeof(double));
+    int *arms = arena_alloc(&rt->ast_arena, (size_t)count * sizeof(int));
+    if (!numbers || !arms)
+    {
+        PARSE_ERROR("Memory allocation failed for a match table");
+    }
+    int unique = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (unique > 0 && numbers[unique - 1] == labels[i].value)
+            continue;
+        numbers[unique] = labels[i].value;
+        arms[unique++] = labels[i].arm;
+    }
+    node->match_stmt.numbers = numbers;
+    node->match_stmt.number_arms = arms;
+    node->match_stmt.number_count = unique;
+}
 
+/// @brief Builds the string dispatch of `node`: intern ids hashed like map keys
+static void build_match_strings(ASTNode *node, const int *ids, const int *arms, int count)
+{
+    if (count == 0)
+        return;
 
-case AST_EXPR_STMT:
-    free_ast(node->expr_stmt.expr);
-    break;
+    int slots = 4;
+    while (slots < count * 2)
+        slots *= 2;
+    node->match_stmt.string_slots = slots;
+    node->match_stmt.string_ids = new_arm_table(slots);
+    node->match_stmt.string_arms = new_arm_table(slots);
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int slot = ((unsigned int)ids[i] * 2654435761u) & (unsigned int)(slots - 1);
+        while (node->match_stmt.string_ids[slot] >= 0 && node->match_stmt.string_ids[slot] != ids[i])
+            slot = (slot + 1) & (unsigned int)(slots - 1);
+        if (node->match_stmt.string_ids[slot] < 0)
+        {
+            node->match_stmt.string_ids[slot] = ids[i];
+            node->match_stmt.string_arms[slot] = arms[i];
+        }
+    }
+}
 
+/// @brief Parses `match subject { labels { ... } ... else { ... } }`; each arm is a block,
+///        chosen through tables built here rather than by testing the labels one by one
+static ASTNode *parse_match()
+{
+    Runtime *rt = get_runtime();
+    ASTNode *node = new_node(AST_MATCH);
 
+    parser_advance(); // skip 'match'
+    node->match_stmt.subject = parse_binary_expression();
 
-    case AST_BINARY:
-        free_ast(node->binary_expr.left);
-        free_ast(node->binary_expr.right);
-        break;
+    if (!match(TOKEN_LBRACE))
+    {
+        PARSE_ERROR("[parse_match] Expected '{' after match subject");
+    }
 
-    case AST_ASSIGN_INDEX:
-        free_ast(node->assign_index.target);
-        free_ast(node->assign_index.value);
-        break;
+    MatchNumber *numbers = NULL;
+    int *string_ids = NULL, *string_arms = NULL;
+    int number_count = 0, number_capacity = 0;
+    int string_count = 0, string_capacity = 0, string_arm_capacity = 0;
+    int arm_capacity = 0;
 
-    case AST_FUNCTION:
-        // Free function name
-        if (node->function_stmt.name) {
-            free(node->function_stmt.name);
-        }
-        // Free parameter names
-        if (node->function_stmt.params) {
-            for (int i = 0; i < node->function_stmt.param_count; i++) {
-                if (node->function_stmt.params[i]) {
-                    free(node->function_stmt.params[i]);
-                }
-            }
-            free(node->function_stmt.params);
-        }
-        // Free function body
-        if (node->function_stmt.body) {
-            free_ast(node->function_stmt.body);
-        }
-        break;
-
-    case AST_RETURN:
-        free_ast(node->return_stmt.expr);
-        break;
-    case AST_LET:
-        free(node->let_stmt.name);
-        break;
-    case AST_VAR:
-        free(node->var.name);
-        break;
-    case AST_GCODE:
-        free(node->gcode_stmt.code);
-        for (int i = 0; i < node->gcode_stmt.argCount; i++)
+    for (;;)
+    {
+        while (rt->parser.current.type == TOKEN_NEWLINE)
+            parser_advance();
+        if (match(TOKEN_RBRACE))
+            break;
+        if (rt->parser.current.type == TOKEN_EOF)
         {
-            free(node->gcode_stmt.args[i].key);
-            free_ast(node->gcode_stmt.args[i].indexExpr);
+            PARSE_ERROR("[parse_match] Unexpected EOF in match");
         }
-        free(node->gcode_stmt.args);
-        break;
-    case AST_CALL:
-        free(node->call_expr.name);
-        for (int i = 0; i < node->call_expr.arg_count; i++)
+
+        if (match(TOKEN_ELSE))
         {
-            free_ast(node->call_expr.args[i]);
-        }
-        free(node->call_expr.args);
-        break;
-
-    case AST_NUMBER:
-        // nothing to free
-        break;
-    case AST_STRING:
-        free(node->string_literal.value);
-        break;
-    case AST_UNARY:
-        free_ast(node->unary_expr.operand);
-        break;
-
-    case AST_WHILE:
-        free_ast(node->while_stmt.condition);
-        free_ast(node->while_stmt.body);
-        break;
-
-    case AST_NOTE:
-        free(node->note.content);
-        break;
-
-    case AST_FOR:
-        free(node->for_stmt.var);
-        if (node->for_stmt.index_var) {
-            free(node->for_stmt.index_var);
-        }
-        if (node->for_stmt.from) {
-            free_ast(node->for_stmt.from);
-        }
-        if (node->for_stmt.to) {
-            free_ast(node->for_stmt.to);
-        }
-        if (node->for_stmt.step) {
-            free_ast(node->for_stmt.step);
-        }
-        if (node->for_stmt.iterable) {
-            free_ast(node->for_stmt.iterable);
+            if (node->match_stmt.else_branch)
+            {
+                PARSE_ERROR("[parse_match] A match has only one else");
+            }
+            node->match_stmt.else_branch = parse_block();
+            continue;
         }
-        free_ast(node->for_stmt.body);
-        break;
 
-    case AST_BLOCK:
-        for (int i = 0; i < node->block.count; i++)
+        // One or more labels, separated by commas
+        int arm = node->match_stmt.arm_count;
+        for (;;)
         {
-            ASTNode *stmt = node->block.statements[i];
-            free_ast(stmt); // Free all statements including functions
+            int negative = match(TOKEN_MINUS);
+            if (rt->parser.current.type == TOKEN_NUMBER)
+            {
+                // Rounded like a number literal, so a label equals the value `==` would
+                double value = atof(rt->parser.current.value);
+                numbers = grow_ast_array(numbers, number_count, &number_capacity, sizeof(MatchNumber));
+                numbers[number_count].value = number_value(negative ? -value : value).number;
+                numbers[number_count++].arm = arm;
+            }
+            else if (rt->parser.current.type == TOKEN_STRING && !negative)
+            {
+                const char *text = rt->parser.current.value;
+                string_ids = grow_ast_array(string_ids, string_count, &string_capacity, sizeof(int));
+                string_arms = grow_ast_array(string_arms, string_count, &string_arm_capacity, sizeof(int));
+                string_ids[string_count] = intern_id(&rt->strings, text, (int)strlen(text));
+                string_arms[string_count++] = arm;
+            }
+            else
+            {
+                PARSE_ERROR("[parse_match] Expected a number or string label, found '%s'", rt->parser.current.value);
+            }
+            parser_advance(); // consume label
+
+            if (!match(TOKEN_COMMA))
+                break;
+            while (rt->parser.current.type == TOKEN_NEWLINE)
+                parser_advance();
         }
-        free(node->block.statements);
-        break;
 
-    case AST_ARRAY_LITERAL:
-        for (int i = 0; i < node->array_literal.count; i++)
+        if (rt->parser.current.type != TOKEN_LBRACE)
         {
-            free_ast(node->array_literal.elements[i]);
+            PARSE_ERROR("[parse_match] Expected '{' after match label");
         }
-        free(node->array_literal.elements);
-        break;
-
-    case AST_INDEX:
-        free_ast(node->index_expr.array);
-        free_ast(node->index_expr.index);
-        break;
-
-    case AST_IF:
-        free_ast(node->if_stmt.condition);
-        free_ast(node->if_stmt.then_branch);
-        if (node->if_stmt.else_branch)
-            free_ast(node->if_stmt.else_branch);
-        break;
-    case AST_ASSIGN:
-        free(node->assign_stmt.name);
-        free_ast(node->assign_stmt.expr);
-        break;
-
-    case AST_COMPOUND_ASSIGN:
-        free(node->compound_assign.name);
-        free_ast(node->compound_assign.expr);
-        break;
-
-    default:
-        report_error("[free_ast] WARNING: Unhandled node type %d", node->type);
-        break;
+        node->match_stmt.arms = grow_node_array(node->match_stmt.arms, arm, &arm_capacity);
+        node->match_stmt.arms[node->match_stmt.arm_count++] = parse_block();
     }
 
-    free(node);
+    build_match_numbers(node, numbers, number_count);
+    build_match_strings(node, string_ids, string_arms, string_count);
+    return node;
+}
+
+/// @brief Releases an AST. Nodes live in the compilation's arena, so this is O(1):
+///        the root of the last parse_script() gives its space back, any other
+///        node is released together with the arena when the compilation ends.
+void free_ast(ASTNode *node)
+{
+    Runtime *rt = get_runtime();
+    if (!node || node != rt->ast_root)
+        return;
+
+    arena_release(&rt->ast_arena, rt->ast_root_mark);
+    rt->ast_root = NULL;
 }
 // Parse an expression from a string while preserving current runtime context
 ASTNode *parse_expression_from_string(const char *expr_text) {
@@ -1556,13 +1791,18 @@ ASTNode *parse_expression_from_string(const char *expr_text) {
     
     // Save current parser state
     Lexer *saved_lexer = rt->parser.lexer;
+    TokenArray *saved_tokens = rt->parser.tokens;
+    int saved_index = rt->parser.token_index;
     Token saved_current = rt->parser.current;
     
     // Create temporary lexer for the expression
     rt->parser.lexer = lexer_new(expr_text);
+    rt->parser.tokens = NULL;
     if (!rt->parser.lexer) {
         // Restore parser state
         rt->parser.lexer = saved_lexer;
+        rt->parser.tokens = saved_tokens;
+        rt->parser.token_index = saved_index;
         rt->parser.current = saved_current;
         return NULL;
     }
@@ -1578,6 +1818,8 @@ ASTNode *parse_expression_from_string(const char *expr_text) {
     
     // Restore parser state
     rt->parser.lexer = saved_lexer;
+    rt->parser.tokens = saved_tokens;
+    rt->parser.token_index = saved_index;
     rt->parser.current = saved_current;
     
     return expr;
@@ -2,18 +2,24 @@
 #define PARSER_H
 
 #include "../lexer/lexer.h"
+#include "../lexer/token_array.h"
 #include "ast_nodes.h"
 
 typedef struct {
-    Lexer* lexer;
+    Lexer* lexer;           // incremental source (streamed input), NULL when `tokens` is set
+    TokenArray* tokens;     // pre-tokenized source
+    int token_index;        // index of `current` in `tokens`
     Token current;
     Token previous;
     int function_definition_depth;  // Track nested function definitions during parsing
 } Parser;
 
 void parser_advance(void); 
+int parser_token_line(const Token* token);
+int parser_token_column(const Token* token);
 ASTNode* parse_inline_expression(const char* expr);
 ASTNode* parse_script(void);
+ASTNode* parse_next_statement(void);
 void free_ast(ASTNode* node);
 void reset_parser_static_vars(void);
 
@@ -0,0 +1,145 @@
+#include <string.h>
+#include "resolver.h"
+#include "../config/config.h"
+#include "../runtime/runtime_state.h"
+
+int variable_slot(const char *name)
+{
+    if (!name)
+        return 0;
+    // Names in the AST are interned already, so this finds the existing id
+    return intern_id(&get_runtime()->strings, name, (int)strlen(name)) + 1;
+}
+
+/// @brief Resolves a list of child nodes
+static void resolve_list(ASTNode **nodes, int count)
+{
+    for (int i = 0; i < count; i++)
+        resolve_variables(nodes[i]);
+}
+
+void resolve_variables(ASTNode *root)
+{
+    if (!root)
+        return;
+
+    switch (root->type)
+    {
+    case AST_VAR:
+        root->var.slot = variable_slot(root->var.name);
+        break;
+
+    case AST_LET:
+        root->let_stmt.slot = variable_slot(root->let_stmt.name);
+        resolve_variables(root->let_stmt.expr);
+        break;
+
+    case AST_ASSIGN:
+        root->assign_stmt.slot = variable_slot(root->assign_stmt.name);
+        resolve_variables(root->assign_stmt.expr);
+        break;
+
+    case AST_COMPOUND_ASSIGN:
+        root->compound_assign.slot = variable_slot(root->compound_assign.name);
+        resolve_variables(root->compound_assign.expr);
+        break;
+
+    case AST_ASSIGN_INDEX:
+        resolve_variables(root->assign_index.target);
+        resolve_variables(root->assign_index.value);
+        break;
+
+    case AST_UNARY:
+        resolve_variables(root->unary_expr.operand);
+        break;
+
+    case AST_BINARY:
+        resolve_variables(root->binary_expr.left);
+        resolve_variables(root->binary_expr.right);
+        break;
+
+    case AST_TERNARY:
+        resolve_variables(root->ternary_expr.condition);
+        resolve_variables(root->ternary_expr.true_expr);
+        resolve_variables(root->ternary_expr.false_expr);
+        break;
+
+    case AST_INDEX:
+        resolve_variables(root->index_expr.array);
+        resolve_variables(root->index_expr.index);
+        break;
+
+    case AST_ARRAY_LITERAL:
+    case AST_MAP_LITERAL:
+        resolve_list(root->array_literal.elements, root->array_literal.count);
+        break;
+
+    case AST_CALL:
+        root->call_expr.slot = variable_slot(root->call_expr.name);
+        resolve_list(root->call_expr.args, root->call_expr.arg_count);
+        break;
+
+    case AST_EXPR_STMT:
+        resolve_variables(root->expr_stmt.expr);
+        break;
+
+    case AST_RETURN:
+        resolve_variables(root->return_stmt.expr);
+        break;
+
+    case AST_BLOCK:
+        resolve_list(root->block.statements, root->block.count);
+        break;
+
+    case AST_IF:
+        resolve_variables(root->if_stmt.condition);
+        resolve_variables(root->if_stmt.then_branch);
+        resolve_variables(root->if_stmt.else_branch);
+        break;
+
+    case AST_MATCH:
+        resolve_variables(root->match_stmt.subject);
+        resolve_list(root->match_stmt.arms, root->match_stmt.arm_count);
+        resolve_variables(root->match_stmt.else_branch);
+        break;
+
+    case AST_WHILE:
+        resolve_variables(root->while_stmt.condition);
+        resolve_variables(root->while_stmt.body);
+        break;
+
+    case AST_FOR:
+        root->for_stmt.var_slot = variable_slot(root->for_stmt.var);
+        root->for_stmt.index_slot = variable_slot(root->for_stmt.index_var);
+        resolve_variables(root->for_stmt.from);
+        resolve_variables(root->for_stmt.to);
+        resolve_variables(root->for_stmt.step);
+        resolve_variables(root->for_stmt.iterable);
+        resolve_variables(root->for_stmt.body);
+        break;
+
+    case AST_FUNCTION:
+    {
+        int count = root->function_stmt.param_count;
+        if (count > 0 && !root->function_stmt.param_slots)
+            root->function_stmt.param_slots = arena_alloc(&get_runtime()->ast_arena, sizeof(int) * count);
+        for (int i = 0; i < count && root->function_stmt.param_slots; i++)
+            root->function_stmt.param_slots[i] = variable_slot(root->function_stmt.params[i]);
+        resolve_variables(root->function_stmt.body);
+        break;
+    }
+
+    case AST_GCODE:
+        for (int i = 0; i < root->gcode_stmt.argCount; i++)
+            resolve_variables(root->gcode_stmt.args[i].indexExpr);
+        break;
+
+    case AST_NOTE:
+        for (int i = 0; i < root->note.segment_count; i++)
+            resolve_variables(root->note.segments[i].expr);
+        break;
+
+    default:
+        break;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast_nodes.h"
+
+/**
+ * @brief Slot of a variable name: its intern id + 1, or 0 if it cannot be interned.
+ *
+ * Slots index the runtime's binding table directly, so a resolved reference
+ * finds its innermost live binding without comparing names.
+ */
+int variable_slot(const char *name);
+
+/**
+ * @brief Give every variable reference, assignment, declaration, loop variable,
+ *        parameter and call under `root` its slot.
+ *
+ * Scoping stays dynamic (a function sees its caller's locals, and assigning an
+ * unknown name declares it), so the slot names the variable, not a frame
+ * position; the runtime keeps the innermost binding of each slot.
+ */
+void resolve_variables(ASTNode *root);
+
+#endif // RESOLVER_H
@@ -0,0 +1,1185 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+
+/// @brief Structurally equal pure expressions, which share one cache if that pays off
+typedef struct {
+    const ASTNode *expr;    // first occurrence
+    uint32_t hash;
+    const ASTNode *list;    // statement list of the latest occurrence
+    int worth;              // repeats within a statement list, or is invariant in its loop
+    uint32_t cache;         // index into Bytecode.caches, BC_NONE if not cached
+} ExprClass;
+
+/// @brief What a loop writes while it runs
+typedef struct {
+    int *writes;            // slots
+    uint32_t count;
+    uint32_t capacity;
+    int escapes;            // runs code on the tree walker, which may write any variable
+} Loop;
+
+/// @brief Compiler state: a failed allocation poisons the rest of the compile
+typedef struct {
+    Bytecode *code;
+    uint32_t registers;     // high-water mark
+    int temporaries;        // the current statement evaluated something into the scratch arena
+    int failed;
+
+    ExprClass *classes;
+    uint32_t class_count;
+    uint32_t class_capacity;
+    uint32_t *buckets;      // open addressing over classes: index + 1, 0 = empty
+    uint32_t bucket_count;  // a power of two
+    uint32_t *slot_lists;   // per slot up to slot_limit: start and count in Bytecode.cache_lists
+    int slot_limit;
+} Compiler;
+
+/// @brief Makes room for `extra` more elements of a table
+static int reserve(void **items, uint32_t count, uint32_t *capacity, uint32_t extra, size_t elem)
+{
+    if (count + extra <= *capacity)
+        return 1;
+
+    uint32_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < count + extra)
+        new_capacity *= 2;
+
+    void *grown = realloc(*items, (size_t)new_capacity * elem);
+    if (!grown)
+        return 0;
+    *items = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+/// @brief Appends an instruction and returns its index
+static uint32_t emit(Compiler *c, Opcode op, uint16_t aux, uint32_t a, uint32_t b, uint32_t cc)
+{
+    Bytecode *code = c->code;
+    if (c->failed || !reserve((void **)&code->code, code->count, &code->capacity, 1, sizeof(Instr)))
+    {
+        c->failed = 1;
+        return 0;
+    }
+
+    Instr *instr = &code->code[code->count];
+    instr->op = (uint16_t)op;
+    instr->aux = aux;
+    instr->a = a;
+    instr->b = b;
+    instr->c = cc;
+    return code->count++;
+}
+
+/// @brief Index of the next instruction, the target of a jump to "here"
+static uint32_t here(const Compiler *c)
+{
+    return c->code->count;
+}
+
+/// @brief Points field b or c of the jump at `at` to the next instruction
+static void patch_b(Compiler *c, uint32_t at)
+{
+    if (!c->failed)
+        c->code->code[at].b = here(c);
+}
+
+static void patch_c(Compiler *c, uint32_t at)
+{
+    if (!c->failed)
+        c->code->code[at].c = here(c);
+}
+
+static uint32_t push_number(Compiler *c, double value)
+{
+    Bytecode *code = c->code;
+    if (c->failed || !reserve((void **)&code->numbers, code->number_count, &code->number_capacity, 1, sizeof(double)))
+    {
+        c->failed = 1;
+        return 0;
+    }
+    code->numbers[code->number_count] = value;
+    return code->number_count++;
+}
+
+static uint32_t push_name(Compiler *c, const char *name)
+{
+    Bytecode *code = c->code;
+    if (c->failed || !reserve((void **)&code->names, code->name_count, &code->name_capacity, 1, sizeof(const char *)))
+    {
+        c->failed = 1;
+        return 0;
+    }
+    code->names[code->name_count] = name;
+    return code->name_count++;
+}
+
+static uint32_t push_node(Compiler *c, ASTNode *node)
+{
+    Bytecode *code = c->code;
+    if (c->failed || !reserve((void **)&code->nodes, code->node_count, &code->node_capacity, 1, sizeof(ASTNode *)))
+    {
+        c->failed = 1;
+        return 0;
+    }
+    code->nodes[code->node_count] = node;
+    return code->node_count++;
+}
+
+/// @brief Notes that register `r` is used
+static uint32_t use_register(Compiler *c, uint32_t r)
+{
+    if (r + 1 > c->registers)
+        c->registers = r + 1;
+    return r;
+}
+
+/// @brief Leaves `node` to the tree walker, which evaluates it as eval_value() does
+static void compile_eval(Compiler *c, ASTNode *node, uint32_t dst)
+{
+    emit(c, OP_EVAL, 0, use_register(c, dst), push_node(c, node), 0);
+    c->temporaries = 1;
+}
+
+/// @brief Whether call `node` runs on the tree walker: user functions, and push() and pop(),
+///        which change the variable their first argument names
+static int runs_on_walker(const ASTNode *node)
+{
+    return node->call_expr.builtin == BUILTIN_NONE || builtin_changes_array(node->call_expr.builtin);
+}
+
+/// @brief Opcode with a fast path for two numbers, OP_BINARY for the rest
+static Opcode binary_opcode(Token_Type op)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return OP_ADD;
+    case TOKEN_MINUS:
+        return OP_SUB;
+    case TOKEN_STAR:
+        return OP_MUL;
+    case TOKEN_SLASH:
+        return OP_DIV;
+    case TOKEN_LESS:
+        return OP_LESS;
+    case TOKEN_LESS_EQUAL:
+        return OP_LESS_EQUAL;
+    case TOKEN_GREATER:
+        return OP_GREATER;
+    case TOKEN_GREATER_EQUAL:
+        return OP_GREATER_EQUAL;
+    case TOKEN_EQUAL_EQUAL:
+        return OP_EQUAL;
+    case TOKEN_BANG_EQUAL:
+        return OP_NOT_EQUAL;
+    default:
+        return OP_BINARY;
+    }
+}
+
+static void compile_expr(Compiler *c, ASTNode *node, uint32_t dst);
+
+/// @brief Compiles expression `node` into register `dst` without looking at its cache
+static void compile_value(Compiler *c, ASTNode *node, uint32_t dst)
+{
+    if (!node)
+    {
+        compile_eval(c, node, dst);
+        return;
+    }
+
+    use_register(c, dst);
+    switch (node->type)
+    {
+    case AST_NUMBER:
+        // Rounded once here instead of on every run
+        emit(c, OP_NUMBER, 0, dst, push_number(c, number_value(node->number.value).number), 0);
+        break;
+
+    case AST_STRING:
+        emit(c, OP_STRING, 0, dst, push_name(c, node->string_literal.value ? node->string_literal.value : ""), 0);
+        break;
+
+    case AST_VAR:
+        emit(c, OP_GET, 0, dst, (uint32_t)node->var.slot, push_name(c, node->var.name));
+        break;
+
+    case AST_UNARY:
+        compile_expr(c, node->unary_expr.operand, dst);
+        emit(c, OP_UNARY, (uint16_t)node->unary_expr.op, dst, dst, 0);
+        break;
+
+    case AST_BINARY:
+        compile_expr(c, node->binary_expr.left, dst);
+        compile_expr(c, node->binary_expr.right, dst + 1);
+        emit(c, binary_opcode(node->binary_expr.op), (uint16_t)node->binary_expr.op, dst, dst, dst + 1);
+        break;
+
+    case AST_TERNARY:
+    {
+        compile_expr(c, node->ternary_expr.condition, dst);
+        uint32_t to_false = emit(c, OP_JUMP_UNLESS, 0, dst, 0, 0);
+        compile_expr(c, node->ternary_expr.true_expr, dst);
+        uint32_t to_end = emit(c, OP_JUMP, 0, 0, 0, 0);
+        patch_b(c, to_false);
+        compile_expr(c, node->ternary_expr.false_expr, dst);
+        patch_b(c, to_end);
+        break;
+    }
+
+    case AST_INDEX:
+        compile_expr(c, node->index_expr.array, dst);
+        compile_expr(c, node->index_expr.index, dst + 1);
+        emit(c, OP_INDEX, 0, dst, dst, dst + 1);
+        break;
+
+    case AST_EXPR_STMT:
+        if (node->expr_stmt.expr)
+            compile_expr(c, node->expr_stmt.expr, dst);
+        else
+            emit(c, OP_NUMBER, 0, dst, push_number(c, 0.0), 0);
+        break;
+
+    case AST_CALL:
+        if (runs_on_walker(node))
+        {
+            // User functions bind their parameters one by one in their own scope
+            compile_eval(c, node, dst);
+            break;
+        }
+        {
+            // Bound at parse time with the right arity, so the arguments go straight into registers
+            int count = builtin_arg_count(node->call_expr.builtin);
+            for (int i = 0; i < count; i++)
+                compile_expr(c, node->call_expr.args[i], dst + (uint32_t)i);
+            emit(c, OP_CALL_BUILTIN, 0, dst, (uint32_t)node->call_expr.builtin, (uint32_t)count);
+        }
+        break;
+
+    default:
+        // User calls and array literals
+        compile_eval(c, node, dst);
+        break;
+    }
+}
+
+// --- Caching repeated and loop-invariant expressions ---
+
+/// @brief Whether `node` computes the same value from the same variables with no other effect
+static int pure_expr(const ASTNode *node)
+{
+    if (!node)
+        return 0;
+
+    switch (node->type)
+    {
+    case AST_NUMBER:
+    case AST_STRING:
+        return 1;
+    case AST_VAR:
+        // An unresolved name could alias any slot
+        return node->var.slot > 0;
+    case AST_UNARY:
+        return pure_expr(node->unary_expr.operand);
+    case AST_BINARY:
+        return pure_expr(node->binary_expr.left) && pure_expr(node->binary_expr.right);
+    case AST_INDEX:
+        return pure_expr(node->index_expr.array) && pure_expr(node->index_expr.index);
+    case AST_CALL:
+        if (!builtin_is_pure(node->call_expr.builtin))
+            return 0;
+        for (int i = 0; i < builtin_arg_count(node->call_expr.builtin); i++)
+        {
+            if (!pure_expr(node->call_expr.args[i]))
+                return 0;
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/// @brief Rough number of instructions `node` compiles to, built-in calls counting extra
+static int expr_cost(const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_UNARY:
+        return 1 + expr_cost(node->unary_expr.operand);
+    case AST_BINARY:
+        return 1 + expr_cost(node->binary_expr.left) + expr_cost(node->binary_expr.right);
+    case AST_INDEX:
+        return 1 + expr_cost(node->index_expr.array) + expr_cost(node->index_expr.index);
+    case AST_CALL:
+    {
+        int cost = 3;
+        for (int i = 0; i < builtin_arg_count(node->call_expr.builtin); i++)
+            cost += expr_cost(node->call_expr.args[i]);
+        return cost;
+    }
+    default:
+        return 1;
+    }
+}
+
+/// @brief A cache costs a check and a store, so only expressions of a few instructions get one
+static int cacheable(const ASTNode *node)
+{
+    return pure_expr(node) && expr_cost(node) >= 3;
+}
+
+static uint32_t mix(uint32_t hash, uint32_t value)
+{
+    return (hash ^ value) * 16777619u;
+}
+
+/// @brief Hash of a pure expression, equal for structurally equal ones
+static uint32_t expr_hash(const ASTNode *node)
+{
+    uint32_t hash = mix(2166136261u, (uint32_t)node->type);
+    switch (node->type)
+    {
+    case AST_NUMBER:
+    {
+        uint64_t bits;
+        double value = number_value(node->number.value).number;
+        memcpy(&bits, &value, sizeof(bits));
+        return mix(mix(hash, (uint32_t)bits), (uint32_t)(bits >> 32));
+    }
+    case AST_STRING:
+        // Interned, so equal strings share a pointer
+        return mix(hash, (uint32_t)(uintptr_t)node->string_literal.value);
+    case AST_VAR:
+        return mix(hash, (uint32_t)node->var.slot);
+    case AST_UNARY:
+        return mix(mix(hash, (uint32_t)node->unary_expr.op), expr_hash(node->unary_expr.operand));
+    case AST_BINARY:
+        hash = mix(hash, (uint32_t)node->binary_expr.op);
+        return mix(mix(hash, expr_hash(node->binary_expr.left)), expr_hash(node->binary_expr.right));
+    case AST_INDEX:
+        return mix(mix(hash, expr_hash(node->index_expr.array)), expr_hash(node->index_expr.index));
+    case AST_CALL:
+        hash = mix(hash, (uint32_t)node->call_expr.builtin);
+        for (int i = 0; i < builtin_arg_count(node->call_expr.builtin); i++)
+            hash = mix(hash, expr_hash(node->call_expr.args[i]));
+        return hash;
+    default:
+        return hash;
+    }
+}
+
+/// @brief Whether two pure expressions always compute the same value
+static int expr_equal(const ASTNode *a, const ASTNode *b)
+{
+    if (a->type != b->type)
+        return 0;
+
+    switch (a->type)
+    {
+    case AST_NUMBER:
+        return number_value(a->number.value).number == number_value(b->number.value).number;
+    case AST_STRING:
+        return a->string_literal.value == b->string_literal.value;
+    case AST_VAR:
+        return a->var.slot == b->var.slot;
+    case AST_UNARY:
+        return a->unary_expr.op == b->unary_expr.op && expr_equal(a->unary_expr.operand, b->unary_expr.operand);
+    case AST_BINARY:
+        return a->binary_expr.op == b->binary_expr.op && expr_equal(a->binary_expr.left, b->binary_expr.left) &&
+               expr_equal(a->binary_expr.right, b->binary_expr.right);
+    case AST_INDEX:
+        return expr_equal(a->index_expr.array, b->index_expr.array) &&
+               expr_equal(a->index_expr.index, b->index_expr.index);
+    case AST_CALL:
+        if (a->call_expr.builtin != b->call_expr.builtin)
+            return 0;
+        for (int i = 0; i < builtin_arg_count(a->call_expr.builtin); i++)
+        {
+            if (!expr_equal(a->call_expr.args[i], b->call_expr.args[i]))
+                return 0;
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/// @brief Doubles the class hash table and reinserts every class
+static int grow_buckets(Compiler *c)
+{
+    uint32_t count = c->bucket_count ? c->bucket_count * 2 : 256;
+    uint32_t *buckets = calloc(count, sizeof(uint32_t));
+    if (!buckets)
+        return 0;
+    for (uint32_t i = 0; i < c->class_count; i++)
+    {
+        uint32_t at = c->classes[i].hash & (count - 1);
+        while (buckets[at])
+            at = (at + 1) & (count - 1);
+        buckets[at] = i + 1;
+    }
+    free(c->buckets);
+    c->buckets = buckets;
+    c->bucket_count = count;
+    return 1;
+}
+
+/// @brief The class of cacheable expression `node`; with `create`, a new one if it has none
+static ExprClass *find_class(Compiler *c, const ASTNode *node, int create)
+{
+    uint32_t hash = expr_hash(node);
+    if (c->bucket_count)
+    {
+        for (uint32_t at = hash & (c->bucket_count - 1); c->buckets[at]; at = (at + 1) & (c->bucket_count - 1))
+        {
+            ExprClass *entry = &c->classes[c->buckets[at] - 1];
+            if (entry->hash == hash && expr_equal(entry->expr, node))
+                return entry;
+        }
+    }
+    if (!create || c->failed)
+        return NULL;
+
+    if (((c->class_count + 1) * 2 > c->bucket_count && !grow_buckets(c)) ||
+        !reserve((void **)&c->classes, c->class_count, &c->class_capacity, 1, sizeof(ExprClass)))
+    {
+        c->failed = 1;
+        return NULL;
+    }
+
+    uint32_t at = hash & (c->bucket_count - 1);
+    while (c->buckets[at])
+        at = (at + 1) & (c->bucket_count - 1);
+    c->buckets[at] = c->class_count + 1;
+
+    ExprClass *entry = &c->classes[c->class_count++];
+    entry->expr = node;
+    entry->hash = hash;
+    entry->list = NULL;
+    entry->worth = 0;
+    entry->cache = BC_NONE;
+    return entry;
+}
+
+/// @brief Records that `loop` writes variable `slot`
+static void loop_write(Compiler *c, Loop *loop, int slot)
+{
+    if (slot <= 0)
+    {
+        loop->escapes = 1; // written by name: may be any variable
+        return;
+    }
+    if (!reserve((void **)&loop->writes, loop->count, &loop->capacity, 1, sizeof(int)))
+    {
+        c->failed = 1;
+        return;
+    }
+    loop->writes[loop->count++] = slot;
+}
+
+/// @brief Collects what running `node` writes into `loop`
+static void collect_writes(Compiler *c, Loop *loop, const ASTNode *node)
+{
+    if (!node || loop->escapes)
+        return;
+
+    switch (node->type)
+    {
+    case AST_LET:
+        loop_write(c, loop, node->let_stmt.slot);
+        collect_writes(c, loop, node->let_stmt.expr);
+        break;
+    case AST_ASSIGN:
+        loop_write(c, loop, node->assign_stmt.slot);
+        collect_writes(c, loop, node->assign_stmt.expr);
+        break;
+    case AST_COMPOUND_ASSIGN:
+        loop_write(c, loop, node->compound_assign.slot);
+        collect_writes(c, loop, node->compound_assign.expr);
+        break;
+    case AST_FOR:
+        loop_write(c, loop, node->for_stmt.var_slot);
+        if (node->for_stmt.is_string_iteration)
+            loop->escapes = 1;
+        collect_writes(c, loop, node->for_stmt.from);
+        collect_writes(c, loop, node->for_stmt.to);
+        collect_writes(c, loop, node->for_stmt.step);
+        collect_writes(c, loop, node->for_stmt.body);
+        break;
+    case AST_BLOCK:
+        for (int i = 0; i < node->block.count; i++)
+            collect_writes(c, loop, node->block.statements[i]);
+        break;
+    case AST_IF:
+        collect_writes(c, loop, node->if_stmt.condition);
+        collect_writes(c, loop, node->if_stmt.then_branch);
+        collect_writes(c, loop, node->if_stmt.else_branch);
+        break;
+    case AST_MATCH:
+        collect_writes(c, loop, node->match_stmt.subject);
+        for (int i = 0; i < node->match_stmt.arm_count; i++)
+            collect_writes(c, loop, node->match_stmt.arms[i]);
+        collect_writes(c, loop, node->match_stmt.else_branch);
+        break;
+    case AST_WHILE:
+        collect_writes(c, loop, node->while_stmt.condition);
+        collect_writes(c, loop, node->while_stmt.body);
+        break;
+    case AST_GCODE:
+        for (int i = 0; i < node->gcode_stmt.argCount; i++)
+            collect_writes(c, loop, node->gcode_stmt.args[i].indexExpr);
+        break;
+    case AST_NOTE:
+        for (int i = 0; i < node->note.segment_count; i++)
+            collect_writes(c, loop, node->note.segments[i].expr);
+        break;
+    case AST_FUNCTION:
+    case AST_RETURN:
+    case AST_NUMBER:
+    case AST_STRING:
+    case AST_VAR:
+        break;
+    case AST_UNARY:
+        collect_writes(c, loop, node->unary_expr.operand);
+        break;
+    case AST_BINARY:
+        collect_writes(c, loop, node->binary_expr.left);
+        collect_writes(c, loop, node->binary_expr.right);
+        break;
+    case AST_TERNARY:
+        collect_writes(c, loop, node->ternary_expr.condition);
+        collect_writes(c, loop, node->ternary_expr.true_expr);
+        collect_writes(c, loop, node->ternary_expr.false_expr);
+        break;
+    case AST_INDEX:
+        collect_writes(c, loop, node->index_expr.array);
+        collect_writes(c, loop, node->index_expr.index);
+        break;
+    case AST_CALL:
+        if (runs_on_walker(node))
+            loop->escapes = 1;
+        for (int i = 0; i < node->call_expr.arg_count; i++)
+            collect_writes(c, loop, node->call_expr.args[i]);
+        break;
+    default:
+        // Indexed stores, expression statements and the rest run on the tree walker
+        loop->escapes = 1;
+        break;
+    }
+}
+
+/// @brief Whether pure expression `node` reads none of the variables `loop` writes
+static int loop_invariant(const ASTNode *node, const Loop *loop)
+{
+    switch (node->type)
+    {
+    case AST_VAR:
+        for (uint32_t i = 0; i < loop->count; i++)
+        {
+            if (loop->writes[i] == node->var.slot)
+                return 0;
+        }
+        return 1;
+    case AST_UNARY:
+        return loop_invariant(node->unary_expr.operand, loop);
+    case AST_BINARY:
+        return loop_invariant(node->binary_expr.left, loop) && loop_invariant(node->binary_expr.right, loop);
+    case AST_INDEX:
+        return loop_invariant(node->index_expr.array, loop) && loop_invariant(node->index_expr.index, loop);
+    case AST_CALL:
+        for (int i = 0; i < builtin_arg_count(node->call_expr.builtin); i++)
+        {
+            if (!loop_invariant(node->call_expr.args[i], loop))
+                return 0;
+        }
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+/// @brief Finds the cacheable expressions under `node`, which runs in `loop` (NULL for none) as part of `list`
+static void analyze_expr(Compiler *c, const ASTNode *node, const Loop *loop, const ASTNode *list)
+{
+    if (!node)
+        return;
+
+    if (cacheable(node))
+    {
+        ExprClass *entry = find_class(c, node, 1);
+        if (!entry)
+            return;
+        if (entry->list == list || (loop && !loop->escapes && loop_invariant(node, loop)))
+            entry->worth = 1;
+        entry->list = list;
+
+        // Its parts only run when it misses, so they need no caches of their own for this
+        if (entry->worth)
+            return;
+    }
+
+    switch (node->type)
+    {
+    case AST_UNARY:
+        analyze_expr(c, node->unary_expr.operand, loop, list);
+        break;
+    case AST_BINARY:
+        analyze_expr(c, node->binary_expr.left, loop, list);
+        analyze_expr(c, node->binary_expr.right, loop, list);
+        break;
+    case AST_TERNARY:
+        analyze_expr(c, node->ternary_expr.condition, loop, list);
+        analyze_expr(c, node->ternary_expr.true_expr, loop, list);
+        analyze_expr(c, node->ternary_expr.false_expr, loop, list);
+        break;
+    case AST_INDEX:
+        analyze_expr(c, node->index_expr.array, loop, list);
+        analyze_expr(c, node->index_expr.index, loop, list);
+        break;
+    case AST_CALL:
+        // A user call's arguments are evaluated by the tree walker
+        if (runs_on_walker(node))
+            break;
+        for (int i = 0; i < builtin_arg_count(node->call_expr.builtin); i++)
+            analyze_expr(c, node->call_expr.args[i], loop, list);
+        break;
+    default:
+        break;
+    }
+}
+
+static void analyze_statement(Compiler *c, const ASTNode *node, const Loop *loop, const ASTNode *list);
+
+/// @brief Analyzes a loop whose condition or range `head` and `body` run on every iteration
+static void analyze_loop(Compiler *c, const ASTNode *node, const ASTNode *head, const ASTNode *body)
+{
+    Loop loop = {0};
+    if (node->type == AST_FOR)
+        loop_write(c, &loop, node->for_stmt.var_slot);
+    collect_writes(c, &loop, head);
+    collect_writes(c, &loop, body);
+
+    analyze_expr(c, head, &loop, node);
+    analyze_statement(c, body, &loop, body);
+    free(loop.writes);
+}
+
+/// @brief Finds the cacheable expressions of the statements compile_statement() compiles
+static void analyze_statement(Compiler *c, const ASTNode *node, const Loop *loop, const ASTNode *list)
+{
+    if (!node || c->failed)
+        return;
+
+    switch (node->type)
+    {
+    case AST_LET:
+        analyze_expr(c, node->let_stmt.expr, loop, list);
+        break;
+    case AST_ASSIGN:
+        analyze_expr(c, node->assign_stmt.expr, loop, list);
+        break;
+    case AST_COMPOUND_ASSIGN:
+        analyze_expr(c, node->compound_assign.expr, loop, list);
+        break;
+    case AST_GCODE:
+        for (int i = 0; i < node->gcode_stmt.argCount; i++)
+            analyze_expr(c, node->gcode_stmt.args[i].indexExpr, loop, list);
+        break;
+    case AST_NOTE:
+        for (int i = 0; i < node->note.segment_count; i++)
+            analyze_expr(c, node->note.segments[i].expr, loop, list);
+        break;
+    case AST_IF:
+        analyze_expr(c, node->if_stmt.condition, loop, list);
+        analyze_statement(c, node->if_stmt.then_branch, loop, node->if_stmt.then_branch);
+        analyze_statement(c, node->if_stmt.else_branch, loop, node->if_stmt.else_branch);
+        break;
+    case AST_MATCH:
+        analyze_expr(c, node->match_stmt.subject, loop, list);
+        for (int i = 0; i < node->match_stmt.arm_count; i++)
+            analyze_statement(c, node->match_stmt.arms[i], loop, node->match_stmt.arms[i]);
+        analyze_statement(c, node->match_stmt.else_branch, loop, node->match_stmt.else_branch);
+        break;
+    case AST_BLOCK:
+        for (int i = 0; i < node->block.count; i++)
+            analyze_statement(c, node->block.statements[i], loop, node);
+        break;
+    case AST_WHILE:
+        analyze_loop(c, node, node->while_stmt.condition, node->while_stmt.body);
+        break;
+    case AST_FOR:
+        if (node->for_stmt.is_string_iteration || !node->for_stmt.body)
+            break;
+        analyze_expr(c, node->for_stmt.from, loop, list);
+        analyze_expr(c, node->for_stmt.to, loop, list);
+        analyze_expr(c, node->for_stmt.step, loop, list);
+        analyze_loop(c, node, NULL, node->for_stmt.body);
+        break;
+    default:
+        // Run by the tree walker
+        break;
+    }
+}
+
+/// @brief Adds each variable slot `node` reads to `slots`, once
+static void expr_slots(const ASTNode *node, int *slots, int *count, int capacity)
+{
+    switch (node->type)
+    {
+    case AST_VAR:
+        for (int i = 0; i < *count; i++)
+        {
+            if (slots[i] == node->var.slot)
+                return;
+        }
+        if (*count < capacity)
+            slots[(*count)++] = node->var.slot;
+        break;
+    case AST_UNARY:
+        expr_slots(node->unary_expr.operand, slots, count, capacity);
+        break;
+    case AST_BINARY:
+        expr_slots(node->binary_expr.left, slots, count, capacity);
+        expr_slots(node->binary_expr.right, slots, count, capacity);
+        break;
+    case AST_INDEX:
+        expr_slots(node->index_expr.array, slots, count, capacity);
+        expr_slots(node->index_expr.index, slots, count, capacity);
+        break;
+    case AST_CALL:
+        for (int i = 0; i < builtin_arg_count(node->call_expr.builtin); i++)
+            expr_slots(node->call_expr.args[i], slots, count, capacity);
+        break;
+    default:
+        break;
+    }
+}
+
+/// @brief Number of variables `node` reads, counting repeats
+static int expr_var_count(const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_VAR:
+        return 1;
+    case AST_UNARY:
+        return expr_var_count(node->unary_expr.operand);
+    case AST_BINARY:
+        return expr_var_count(node->binary_expr.left) + expr_var_count(node->binary_expr.right);
+    case AST_INDEX:
+        return expr_var_count(node->index_expr.array) + expr_var_count(node->index_expr.index);
+    case AST_CALL:
+    {
+        int count = 0;
+        for (int i = 0; i < builtin_arg_count(node->call_expr.builtin); i++)
+            count += expr_var_count(node->call_expr.args[i]);
+        return count;
+    }
+    default:
+        return 0;
+    }
+}
+
+/// @brief Gives each worthwhile class a cache and lists, per variable, the caches a write to it empties
+static void plan_caches(Compiler *c)
+{
+    Bytecode *code = c->code;
+    int slots[64];
+
+    // Slots read by cached expressions, counted per slot first
+    for (uint32_t i = 0; i < c->class_count; i++)
+    {
+        ExprClass *entry = &c->classes[i];
+        if (!entry->worth)
+            continue;
+        int count = 0;
+        // Expressions reading more variables than fit are not worth tracking
+        if (expr_var_count(entry->expr) > (int)(sizeof(slots) / sizeof(slots[0])))
+            continue;
+        expr_slots(entry->expr, slots, &count, (int)(sizeof(slots) / sizeof(slots[0])));
+        entry->cache = code->cache_count++;
+        for (int j = 0; j < count; j++)
+        {
+            if (slots[j] > c->slot_limit)
+                c->slot_limit = slots[j];
+        }
+    }
+    if (!code->cache_count)
+        return;
+
+    c->slot_lists = calloc((size_t)(c->slot_limit + 1) * 2, sizeof(uint32_t));
+    if (!c->slot_lists ||
+        !reserve((void **)&code->caches, 0, &code->cache_capacity, code->cache_count, sizeof(double)))
+    {
+        c->failed = 1;
+        return;
+    }
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (uint32_t i = 0; i < c->class_count; i++)
+        {
+            ExprClass *entry = &c->classes[i];
+            if (entry->cache == BC_NONE)
+                continue;
+            int count = 0;
+            expr_slots(entry->expr, slots, &count, (int)(sizeof(slots) / sizeof(slots[0])));
+            for (int j = 0; j < count; j++)
+            {
+                uint32_t *list = &c->slot_lists[slots[j] * 2];
+                if (pass == 0)
+                    list[1]++;
+                else
+                    code->cache_lists[list[0] + list[1]++] = entry->cache;
+            }
+        }
+
+        if (pass == 0)
+        {
+            // Lay the lists out one after another, then fill them in the second pass
+            uint32_t total = 0;
+            for (int slot = 0; slot <= c->slot_limit; slot++)
+            {
+                c->slot_lists[slot * 2] = total;
+                total += c->slot_lists[slot * 2 + 1];
+                c->slot_lists[slot * 2 + 1] = 0;
+            }
+            if (!reserve((void **)&code->cache_lists, 0, &code->cache_list_capacity, total, sizeof(uint32_t)))
+            {
+                c->failed = 1;
+                return;
+            }
+            code->cache_list_count = total;
+        }
+    }
+}
+
+/// @brief After a write to variable `slot`: empties the caches of the expressions that read it
+static void invalidate(Compiler *c, int slot)
+{
+    if (!c->code->cache_count)
+        return;
+    if (slot <= 0)
+    {
+        // Written by name: could be any variable
+        emit(c, OP_INVALIDATE, 0, 0, BC_NONE, 0);
+        return;
+    }
+    if (slot > c->slot_limit || !c->slot_lists || !c->slot_lists[slot * 2 + 1])
+        return;
+    emit(c, OP_INVALIDATE, 0, c->slot_lists[slot * 2], c->slot_lists[slot * 2 + 1], 0);
+}
+
+/// @brief Compiles expression `node` into register `dst`; registers above it are free
+static void compile_expr(Compiler *c, ASTNode *node, uint32_t dst)
+{
+    ExprClass *entry = c->code->cache_count && cacheable(node) ? find_class(c, node, 0) : NULL;
+    if (!entry || entry->cache == BC_NONE)
+    {
+        compile_value(c, node, dst);
+        return;
+    }
+
+    // Read the cache, or compute the value and fill it
+    uint32_t check = emit(c, OP_CACHED, 0, use_register(c, dst), entry->cache, 0);
+    compile_value(c, node, dst);
+    emit(c, OP_CACHE_FILL, 0, dst, entry->cache, 0);
+    patch_c(c, check);
+}
+
+/// @brief Closes a statement: drops what it left in the scratch arena
+static void end_statement(Compiler *c)
+{
+    if (c->temporaries)
+    {
+        emit(c, OP_RELEASE, 0, 0, 0, 0);
+        c->temporaries = 0;
+    }
+}
+
+/// @brief Leaves statement `node` to the tree walker
+static void compile_walk(Compiler *c, ASTNode *node)
+{
+    emit(c, OP_WALK, 0, 0, push_node(c, node), 0);
+}
+
+static void compile_statement(Compiler *c, ASTNode *node, uint32_t base);
+
+static void compile_gcode(Compiler *c, ASTNode *node, uint32_t base)
+{
+    emit(c, OP_GCODE, 0, 0, push_node(c, node), 0);
+    for (int i = 0; i < node->gcode_stmt.argCount; i++)
+    {
+        const GArg *arg = &node->gcode_stmt.args[i];
+        uint32_t value = BC_NONE;
+        if (arg->indexExpr)
+        {
+            compile_expr(c, arg->indexExpr, base);
+            value = base;
+        }
+        emit(c, OP_GCODE_WORD, (uint16_t)arg->letter, value, 0, (uint32_t)i);
+    }
+    emit(c, OP_GCODE_END, 0, 0, 0, 0);
+    end_statement(c);
+}
+
+static void compile_note(Compiler *c, ASTNode *node, uint32_t base)
+{
+    uint32_t note = push_node(c, node);
+    emit(c, OP_NOTE, 0, 0, note, 0);
+    for (int i = 0; i < node->note.segment_count; i++)
+    {
+        uint32_t value = BC_NONE;
+        if (node->note.segments[i].kind == NOTE_EXPR)
+        {
+            compile_expr(c, node->note.segments[i].expr, base);
+            value = base;
+        }
+        emit(c, OP_NOTE_SEGMENT, 0, value, note, (uint32_t)i);
+    }
+    end_statement(c);
+}
+
+/// @brief Numeric FOR: registers base..base+2 hold the counter, end and step while it runs
+static void compile_for(Compiler *c, ASTNode *node, uint32_t base)
+{
+    compile_expr(c, node->for_stmt.from, base);
+    compile_expr(c, node->for_stmt.to, base + 1);
+    if (node->for_stmt.step)
+        compile_expr(c, node->for_stmt.step, base + 2);
+    else
+        emit(c, OP_NUMBER, 0, use_register(c, base + 2), push_number(c, 1.0), 0);
+
+    uint32_t init = emit(c, OP_FOR_INIT, node->for_stmt.exclusive ? 1 : 0, base, 0, 0);
+    end_statement(c);
+    uint32_t top = here(c);
+    emit(c, OP_FOR_SET, 0, base, (uint32_t)node->for_stmt.var_slot, push_name(c, node->for_stmt.var));
+    invalidate(c, node->for_stmt.var_slot);
+    compile_statement(c, node->for_stmt.body, base + 3);
+    emit(c, OP_FOR_NEXT, 0, base, top, 0);
+    patch_b(c, init);
+}
+
+static void compile_while(Compiler *c, ASTNode *node, uint32_t base)
+{
+    uint32_t counter = use_register(c, base);
+    emit(c, OP_WHILE_INIT, 0, counter, 0, 0);
+    uint32_t top = here(c);
+    compile_expr(c, node->while_stmt.condition, base + 1);
+    end_statement(c);
+    uint32_t test = emit(c, OP_WHILE, 0, base + 1, 0, counter);
+    compile_statement(c, node->while_stmt.body, base + 1);
+    emit(c, OP_LOOP, 0, counter, top, 0);
+    patch_b(c, test);
+}
+
+static void compile_if(Compiler *c, ASTNode *node, uint32_t base)
+{
+    compile_expr(c, node->if_stmt.condition, base);
+    end_statement(c);
+    uint32_t test = emit(c, OP_IF, 0, base, 0, 0);
+    compile_statement(c, node->if_stmt.then_branch, base);
+    if (node->if_stmt.else_branch)
+    {
+        uint32_t skip_else = emit(c, OP_JUMP, 0, 0, 0, 0);
+        patch_b(c, test);
+        compile_statement(c, node->if_stmt.else_branch, base);
+        patch_b(c, skip_else);
+    }
+    else
+    {
+        patch_b(c, test);
+    }
+    patch_c(c, test);
+}
+
+/// @brief OP_MATCH jumps to the arm_count + 1 OP_JUMPs after it: one per arm, then the else
+static void compile_match(Compiler *c, ASTNode *node, uint32_t base)
+{
+    size_t arm_count = node->match_stmt.arm_count > 0 ? (size_t)node->match_stmt.arm_count : 0;
+    compile_expr(c, node->match_stmt.subject, base);
+    // The subject may be a temporary string, so OP_MATCH drops the temporaries after its lookup
+    emit(c, OP_MATCH, c->temporaries ? 1 : 0, base, push_node(c, node), 0);
+    c->temporaries = 0;
+
+    uint32_t table = here(c);
+    for (size_t i = 0; i <= arm_count; i++)
+        emit(c, OP_JUMP, 0, 0, 0, 0);
+
+    uint32_t *ends = calloc(arm_count + 1, sizeof(uint32_t));
+    if (!ends)
+    {
+        c->failed = 1;
+        return;
+    }
+    for (size_t i = 0; i <= arm_count; i++)
+    {
+        patch_b(c, table + (uint32_t)i);
+        compile_statement(c, i < arm_count ? node->match_stmt.arms[i] : node->match_stmt.else_branch, base);
+        if (i < arm_count)
+            ends[i] = emit(c, OP_JUMP, 0, 0, 0, 0);
+    }
+    for (size_t i = 0; i < arm_count; i++)
+        patch_b(c, ends[i]);
+    free(ends);
+}
+
+/// @brief Whether every statement of a block is there to compile
+static int block_complete(const ASTNode *node)
+{
+    for (int i = 0; i < node->block.count; i++)
+    {
+        if (!node->block.statements[i])
+            return 0;
+    }
+    return 1;
+}
+
+/// @brief Compiles statement `node` with the emitter's semantics; registers from `base` up are free
+static void compile_statement(Compiler *c, ASTNode *node, uint32_t base)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case AST_NOP:
+    case AST_RETURN:
+        // The emitter ignores a top-level return
+        break;
+
+    case AST_LET:
+        if (!node->let_stmt.name)
+        {
+            compile_walk(c, node);
+            break;
+        }
+        compile_expr(c, node->let_stmt.expr, base);
+        emit(c, OP_LET, 0, base, (uint32_t)node->let_stmt.slot, push_name(c, node->let_stmt.name));
+        invalidate(c, node->let_stmt.slot);
+        end_statement(c);
+        break;
+
+    case AST_ASSIGN:
+        compile_expr(c, node->assign_stmt.expr, base);
+        emit(c, OP_ASSIGN, 0, base, (uint32_t)node->assign_stmt.slot, push_name(c, node->assign_stmt.name));
+        invalidate(c, node->assign_stmt.slot);
+        end_statement(c);
+        break;
+
+    case AST_COMPOUND_ASSIGN:
+    {
+        uint32_t name = push_name(c, node->compound_assign.name);
+        uint32_t slot = (uint32_t)node->compound_assign.slot;
+        uint32_t find = emit(c, OP_FIND, 0, 0, slot, name);
+        compile_expr(c, node->compound_assign.expr, base);
+        emit(c, OP_COMPOUND, (uint16_t)node->compound_assign.op, base, slot, name);
+        invalidate(c, node->compound_assign.slot);
+        if (!c->failed)
+            c->code->code[find].a = here(c);
+        end_statement(c);
+        break;
+    }
+
+    case AST_GCODE:
+        if (!node->gcode_stmt.code)
+            compile_walk(c, node);
+        else
+            compile_gcode(c, node, base);
+        break;
+
+    case AST_NOTE:
+        if (!node->note.content)
+            compile_walk(c, node);
+        else
+            compile_note(c, node, base);
+        break;
+
+    case AST_FOR:
+        if (!node->for_stmt.var || !node->for_stmt.body || node->for_stmt.is_string_iteration)
+            compile_walk(c, node);
+        else
+            compile_for(c, node, base);
+        break;
+
+    case AST_WHILE:
+        compile_while(c, node, base);
+        break;
+
+    case AST_IF:
+        compile_if(c, node, base);
+        break;
+
+    case AST_MATCH:
+        compile_match(c, node, base);
+        break;
+
+    case AST_BLOCK:
+        if (!block_complete(node))
+        {
+            compile_walk(c, node);
+            break;
+        }
+        for (int i = 0; i < node->block.count; i++)
+            compile_statement(c, node->block.statements[i], base);
+        break;
+
+    case AST_FUNCTION:
+        emit(c, OP_DEFINE, 0, 0, push_node(c, node), 0);
+        break;
+
+    default:
+        // Calls, indexed stores and anything the emitter reports as unknown
+        compile_walk(c, node);
+        break;
+    }
+}
+
+int bytecode_compile(Bytecode *code, ASTNode *root)
+{
+    if (!code || !root)
+        return 0;
+
+    code->count = 0;
+    code->number_count = 0;
+    code->name_count = 0;
+    code->node_count = 0;
+    code->cache_count = 0;
+    code->cache_list_count = 0;
+
+    Compiler compiler = {.code = code};
+    analyze_statement(&compiler, root, NULL, root);
+    plan_caches(&compiler);
+    compile_statement(&compiler, root, 0);
+    emit(&compiler, OP_HALT, 0, 0, 0, 0);
+    free(compiler.classes);
+    free(compiler.buckets);
+    free(compiler.slot_lists);
+
+    // Registers start out as numbers, so a loop counter is never read uninitialised
+    uint32_t registers = compiler.registers ? compiler.registers : 1;
+    if (!compiler.failed &&
+        !reserve((void **)&code->registers, 0, &code->register_capacity, registers, sizeof(Value)))
+        compiler.failed = 1;
+    if (compiler.failed)
+        return 0;
+
+    code->register_count = registers;
+    for (uint32_t i = 0; i < registers; i++)
+        code->registers[i] = number_value(0.0);
+    return 1;
+}
+
+void bytecode_free(Bytecode *code)
+{
+    free(code->code);
+    free(code->numbers);
+    free(code->names);
+    free(code->nodes);
+    free(code->registers);
+    free(code->caches);
+    free(code->cache_lists);
+    memset(code, 0, sizeof(Bytecode));
+}
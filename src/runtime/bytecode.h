@@ -0,0 +1,137 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include "../parser/ast_nodes.h"
+#include "evaluator.h"
+
+/** @brief Operand that is not used, e.g. the value of a G-code word without one */
+#define BC_NONE UINT32_MAX
+
+/**
+ * @brief Instructions of the register VM.
+ *
+ * Expressions write register `a`; statements read their value from it.
+ * "name" is an index into Bytecode.names, "node" one into Bytecode.nodes,
+ * "target" an instruction index.
+ *
+ * A pure expression that repeats within a statement list, or does not change
+ * while its loop runs, is computed once into a cache and then read from it.
+ * Writing one of its variables empties the cache, and so does anything the
+ * tree walker runs, since it may write any variable.
+ */
+typedef enum
+{
+    OP_NUMBER,          // a = numbers[b]
+    OP_STRING,          // a = the string literal names[b]
+    OP_GET,             // a = variable b = slot, c = name
+    OP_UNARY,           // a = aux(b), aux = operator
+    OP_ADD,             // a = b + c; these and OP_BINARY keep the operator in aux
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_BINARY,          // any other operator
+    OP_INDEX,           // a = b[c]
+    OP_CALL_BUILTIN,    // a = built-in b applied to the c registers from a up
+    OP_EVAL,            // a = node b, evaluated by the tree walker (user calls, array literals)
+    OP_CACHED,          // a = cache b and skip to target c, unless the cache is empty
+    OP_CACHE_FILL,      // cache b = a, if a is a number computed without errors
+    OP_JUMP_UNLESS,     // to target b unless a is a non-zero number
+    OP_JUMP,            // to target b
+
+    OP_LET,             // set variable b = slot, c = name to a
+    OP_ASSIGN,          // the same, falling back to 0 for an invalid value
+    OP_FIND,            // compound assignment: skip to target a unless variable b, c exists
+    OP_COMPOUND,        // variable b, c op= a, aux = operator
+    OP_IF,              // a = condition, b = else target, c = end target
+    OP_MATCH,           // to the OP_JUMP that follows for the arm of node b subject a selects, the
+                        // last for none; aux = drop the statement's temporaries first
+    OP_WHILE_INIT,      // a = iteration counter
+    OP_WHILE,           // to target b unless condition a holds; c = iteration counter
+    OP_LOOP,            // next iteration of counter a, back to target b
+    OP_FOR_INIT,        // a = first of [counter, end, step], b = exit target, aux = exclusive
+    OP_FOR_SET,         // variable b, c = counter a
+    OP_FOR_NEXT,        // step counter a, back to target b
+    OP_GCODE,           // start the line of G-code node b
+    OP_GCODE_WORD,      // append word c with value a (BC_NONE for none), aux = letter
+    OP_GCODE_END,       // write the line
+    OP_NOTE,            // start note node b
+    OP_NOTE_SEGMENT,    // append segment c of note node b, with value a for an expression
+    OP_DEFINE,          // register function node b
+    OP_INVALIDATE,      // empty the b caches listed from cache_lists[a] (all of them for b = BC_NONE)
+    OP_WALK,            // run statement node b with the tree walker
+    OP_RELEASE,         // drop the temporaries of the statement that just ended
+    OP_HALT,
+    OP_COUNT_
+} Opcode;
+
+/** @brief One instruction: 16 bytes, four to a cache line */
+typedef struct
+{
+    uint16_t op;        // Opcode
+    uint16_t aux;       // operator, letter or flag
+    uint32_t a, b, c;
+} Instr;
+
+/**
+ * @brief A program compiled for the register VM.
+ *
+ * Names, strings and nodes are borrowed from the AST, which must outlive the
+ * bytecode. Variables stay in the runtime's binding table, so scoping is the
+ * same as the tree walker's; registers only hold the values of expressions
+ * and loop state.
+ */
+typedef struct
+{
+    Instr *code;
+    uint32_t count;
+    uint32_t capacity;
+
+    double *numbers;
+    uint32_t number_count;
+    uint32_t number_capacity;
+
+    const char **names;
+    uint32_t name_count;
+    uint32_t name_capacity;
+
+    ASTNode **nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+
+    Value *registers;
+    uint32_t register_count;
+    uint32_t register_capacity;
+
+    double *caches;             // cached expression values, NaN while empty
+    uint32_t cache_count;
+    uint32_t cache_capacity;
+
+    uint32_t *cache_lists;      // per variable, the caches a write to it empties
+    uint32_t cache_list_count;
+    uint32_t cache_list_capacity;
+} Bytecode;
+
+/**
+ * @brief Compile the program `root` into `code`, replacing what it held.
+ * @return 1 on success, 0 on allocation failure (run the tree walker instead)
+ */
+int bytecode_compile(Bytecode *code, ASTNode *root);
+
+/**
+ * @brief Release all storage owned by the bytecode.
+ */
+void bytecode_free(Bytecode *code);
+
+/**
+ * @brief Run compiled code: the VM counterpart of emit_gcode().
+ */
+void emit_gcode_bytecode(Bytecode *code);
+
+#endif // BYTECODE_H
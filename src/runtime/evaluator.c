@@ -97,9 +97,11 @@ static double compat_fmod_impl(double x, double y) {
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "../parser/ast_nodes.h"
 #include <math.h>
 #include "../parser/parser.h"
+#include "../parser/resolver.h"
 #include "error/error.h"
 #define FATAL_ERROR(msg, ...) fatal_error(NULL, 0, 0, msg, ##__VA_ARGS__)
 #include "config/config.h"
@@ -121,8 +123,8 @@ void check_config_variable(const char* name, Value* val) {
     }
 }
 
-#define MAX_VARIABLES 1024
 #define MAX_FUNCTIONS 64
+#define MAX_TAIL_CALLS 1000000  // Self calls one frame may run in place before it counts as infinite
 
 Value *eval_let(ASTNode *node);
 Value *eval_function_call(ASTNode *node);
@@ -131,10 +133,13 @@ Value *runtime_return_value;
 void free_value(Value *val); // Forward declaration
 void register_function(ASTNode *node);
 void eval_if(ASTNode *stmt);
+static void eval_match(ASTNode *stmt);
 void eval_for(ASTNode *stmt);
 void eval_while(ASTNode *stmt);
 
-static ASTNode *find_function(const char *name);
+static ASTNode *find_function(int slot);
+static Value *scratch_number(double x);
+static int tail_call(ASTNode *call);
 int runtime_has_returned = 0;
 
 double get_number(const Value *val)
@@ -149,21 +154,21 @@ double get_number(const Value *val)
 
 double get_scalar(ASTNode *node)
 {
-    const Value *v = eval_expr(node);
-    if (!v || v->type != VAL_NUMBER)
+    Value v = eval_value(node);
+    if (v.type != VAL_NUMBER)
     {
         report_error("[Runtime evaluator] get_scalar() expected number");
         return 0.0;
     }
-    return v->number;
+    return v.number;
 }
 
 Value *eval_let(ASTNode *node)
 {
     const char *name = node->let_stmt.name;
-    Value *value = eval_expr(node->let_stmt.expr);
-    declare_var(name, value);
-    return make_number_value(0.0); // Return a default value, since LET is not an expression
+    Value value = eval_value(node->let_stmt.expr);
+    declare_var_slot(node->let_stmt.slot, name, &value);
+    return scratch_number(0.0); // Return a default value, since LET is not an expression
 }
 
 Value *eval(ASTNode *node)
@@ -171,20 +176,35 @@ Value *eval(ASTNode *node)
     return eval_expr(node); // delegate to eval_expr
 }
 
-Value *get_var(const char *name)
+/// @brief Index of the innermost live variable bound to `slot`, or -1
+static int binding_index(const Runtime *rt, int slot)
+{
+    if (slot <= 0 || slot >= rt->binding_capacity)
+        return -1;
+    return rt->bindings[slot] - 1;
+}
+
+/// @brief Slot of a reference: the resolved one, or looked up from the name for unresolved nodes
+static int reference_slot(int slot, const char *name)
+{
+    return slot ? slot : variable_slot(name);
+}
+
+Value *get_var_slot(int slot, const char *name)
 {
     const Runtime *rt = get_runtime();
-    for (int i = rt->var_count - 1; i >= 0; --i)
-    {
-        if (strcmp(rt->variables[i].name, name) == 0)
-        {
-            return rt->variables[i].val;
-        }
-    }
+    int i = binding_index(rt, reference_slot(slot, name));
+    if (i >= 0)
+        return rt->variables[i].val;
     report_error("[Runtime evaluator] Variable not found: %s", name);
     return NULL;
 }
 
+Value *get_var(const char *name)
+{
+    return get_var_slot(0, name);
+}
+
 void set_parents_recursive(ASTNode *node, ASTNode *parent) {
     if (!node) return;
 
@@ -218,6 +238,13 @@ void set_parents_recursive(ASTNode *node, ASTNode *parent) {
             if (node->if_stmt.else_branch)
                 set_parents_recursive(node->if_stmt.else_branch, node);
             break;
+        case AST_MATCH:
+            set_parents_recursive(node->match_stmt.subject, node);
+            for (int i = 0; i < node->match_stmt.arm_count; i++)
+                set_parents_recursive(node->match_stmt.arms[i], node);
+            if (node->match_stmt.else_branch)
+                set_parents_recursive(node->match_stmt.else_branch, node);
+            break;
         case AST_WHILE:
             set_parents_recursive(node->while_stmt.condition, node);
             set_parents_recursive(node->while_stmt.body, node);
@@ -241,6 +268,7 @@ void set_parents_recursive(ASTNode *node, ASTNode *parent) {
                 set_parents_recursive(node->call_expr.args[i], node);
             break;
         case AST_ARRAY_LITERAL:
+        case AST_MAP_LITERAL:
             for (int i = 0; i < node->array_literal.count; i++)
                 set_parents_recursive(node->array_literal.elements[i], node);
             break;
@@ -308,12 +336,31 @@ void reset_runtime_state(void)
         runtime_return_value = NULL;
     }
 
-    // Reset runtime state
+    free(rt->variables);
+    free(rt->bindings);
+    free(rt->function_slots);
+    free(rt->scope_bases);
+    function_stack_free();
+
+    // Reset runtime state (interned strings and the AST arena may still back a live AST,
+    // and the caller may still hold temporaries from the scratch arena)
+    InternTable strings = rt->strings;
+    Arena ast_arena = rt->ast_arena;
+    ASTNode *ast_root = rt->ast_root;
+    ArenaMark ast_root_mark = rt->ast_root_mark;
+    Arena scratch = rt->scratch;
+    struct ScratchRef *scratch_refs = rt->scratch_refs;
     memset(rt, 0, sizeof(Runtime));
+    rt->strings = strings;
+    rt->ast_arena = ast_arena;
+    rt->ast_root = ast_root;
+    rt->ast_root_mark = ast_root_mark;
+    rt->scratch = scratch;
+    rt->scratch_refs = scratch_refs;
 
     // Initialize recursion protection
     rt->recursion_depth = 0;
-    rt->max_recursion_depth = 100;  // Default limit for recursion protection
+    rt->max_recursion_depth = DEFAULT_MAX_RECURSION_DEPTH;  // Default limit for recursion protection
 
     // Initialize function stack
     function_stack_init();
@@ -333,6 +380,23 @@ void enter_scope()
     Runtime *rt = get_runtime();
     rt->current_scope_level++;
 
+    // Remember where this scope's variables start so exit_scope() can cut the stack there
+    int level = rt->current_scope_level;
+    if (level >= rt->scope_capacity)
+    {
+        int capacity = rt->scope_capacity ? rt->scope_capacity * 2 : 64;
+        while (capacity <= level)
+            capacity *= 2;
+        int *bases = realloc(rt->scope_bases, sizeof(int) * capacity);
+        if (!bases)
+        {
+            report_error("[enter_scope] ERROR: failed to grow the scope stack");
+            FATAL_ERROR("[enter_scope] ERROR: failed to grow the scope stack");
+        }
+        rt->scope_bases = bases;
+        rt->scope_capacity = capacity;
+    }
+    rt->scope_bases[level] = rt->var_count;
 }
 
 void reset_parser_state() {
@@ -342,6 +406,7 @@ void reset_parser_state() {
         lexer_free(rt->parser.lexer);
         rt->parser.lexer = NULL;
     }
+    token_array_free(rt->parser.tokens);
     // Reset the rest of the parser state
     memset(&rt->parser, 0, sizeof(Parser));  // full reset
 }
@@ -355,80 +420,276 @@ ASTNode *parse_script_from_string(const char *source)
     runtime_has_returned = 0;
     rt->current_scope_level = 0;
 
-    rt->parser.lexer = lexer_new(source);
+    // Lex everything up front; large sources are lexed on a second thread while parsing
+    rt->parser.tokens = token_array_new(source, strlen(source) >= TOKEN_ARRAY_THREAD_MIN);
+    rt->parser.token_index = -1;
+    rt->parser.lexer = rt->parser.tokens ? NULL : lexer_new(source);
 
     parser_advance();
     ASTNode *root = parse_script();
     set_parents_recursive(root, NULL);
+    resolve_variables(root);
     reset_parser_state();
     reset_line_number();
 
     return root;
 }
 
-Value *copy_value(Value *val)
+// A payload block starts with its owner count and the bytes of room after the header
+#define PAYLOAD_HEADER 2
+
+// The `refs` of a string whose text the intern table holds: nothing to count, copy or free
+static size_t interned_text[PAYLOAD_HEADER];
+
+/// @brief Allocates a payload block headed by its owner count, which starts at 1
+static size_t *new_payload(size_t bytes)
 {
-    if (!val) {
+    size_t *refs = malloc(sizeof(size_t) * PAYLOAD_HEADER + bytes);
+    if (!refs)
+        FATAL_ERROR("[Runtime evaluator] malloc failed for a string or array payload");
+    refs[0] = 1;
+    refs[1] = bytes;
+    return refs;
+}
 
-        return NULL;
-    }
+/// @brief Makes room for `bytes` in the payload of owned, unshared `array`, at least doubling
+///        it when it has to move so that appending one element at a time is amortized O(1)
+static int reserve_payload(Value *array, size_t bytes)
+{
+    size_t room = array->refs[1];
+    if (bytes <= room)
+        return 1;
+    if (bytes < room * 2)
+        bytes = room * 2;
+    size_t *refs = realloc(array->refs, sizeof(size_t) * PAYLOAD_HEADER + bytes);
+    if (!refs)
+        return 0;
+    refs[1] = bytes;
+    array->refs = refs;
+    if (array->width)
+        array->array.numbers = (double *)(refs + PAYLOAD_HEADER);
+    else
+        array->array.items = (Value **)(refs + PAYLOAD_HEADER);
+    return 1;
+}
 
-    Value *copy = malloc(sizeof(Value));
-    if (!copy) {
+/// @brief Gives `val` an owned copy of `str`
+static void own_string(Value *val, const char *str)
+{
+    if (!str)
+        str = "";
+    size_t length = strlen(str);
+    val->refs = new_payload(length + 1);
+    val->string = (char *)(val->refs + PAYLOAD_HEADER);
+    memcpy(val->string, str, length + 1);
+}
 
-        FATAL_ERROR("[copy_value] malloc failed for Value");
-    }
+/// @brief Gives `val` an owned, uninitialised item array of `count` elements
+static void own_items(Value *val, size_t count)
+{
+    val->refs = new_payload(sizeof(Value *) * (count ? count : 1));
+    val->width = 0;
+    val->array.items = (Value **)(val->refs + PAYLOAD_HEADER);
+    val->array.count = count;
+}
+
+/// @brief Gives `val` an owned, uninitialised block of `count` elements of `width` numbers each
+static void own_numbers(Value *val, size_t count, unsigned width)
+{
+    size_t numbers = count * width;
+    val->refs = new_payload(sizeof(double) * (numbers ? numbers : 1));
+    val->width = width;
+    val->array.numbers = (double *)(val->refs + PAYLOAD_HEADER);
+    val->array.count = count;
+}
 
-    copy->type = val->type;
+/// @brief Gives `val` an owned copy of the packed numbers of `array`
+static void own_copy_of_numbers(Value *val, const Value *array)
+{
+    own_numbers(val, array->array.count, array->width);
+    memcpy(val->array.numbers, array->array.numbers, sizeof(double) * array->array.count * array->width);
+}
 
-    if (val->type == VAL_NUMBER)
-    {
+/// @brief A map's entries in the order their keys were first stored, and a hash index over them
+struct Map
+{
+    int *keys;          // interned ids in the runtime's string table
+    Value **values;
+    size_t count;
+    size_t capacity;
+    size_t *slots;      // open addressing: entry + 1, 0 when empty; a power of two of them
+    size_t slot_count;
+};
+
+/// @brief Gives `val` an owned, empty map
+static void own_map(Value *val)
+{
+    val->type = VAL_MAP;
+    val->refs = new_payload(sizeof(struct Map));
+    val->map = (struct Map *)(val->refs + PAYLOAD_HEADER);
+    memset(val->map, 0, sizeof(struct Map));
+}
 
-        copy->number = val->number;
-    }
-else if (val->type == VAL_ARRAY)
+/// @brief Where key `id` of `map` is indexed, or the empty slot it would take
+static size_t *map_slot(const struct Map *map, int id)
 {
+    size_t mask = map->slot_count - 1;
+    size_t slot = ((size_t)id * 2654435761u) & mask;
+    while (map->slots[slot] && map->keys[map->slots[slot] - 1] != id)
+        slot = (slot + 1) & mask;
+    return &map->slots[slot];
+}
+
+/// @brief The value stored under key `id`, or NULL if there is none
+static Value *map_find(const struct Map *map, int id)
+{
+    if (!map->slot_count)
+        return NULL;
+    size_t entry = *map_slot(map, id);
+    return entry ? map->values[entry - 1] : NULL;
+}
 
-    copy->array.count = val->array.count;
-    copy->array.items = malloc(sizeof(Value *) * val->array.count);
-    if (!copy->array.items) {
-        free(copy);
-        FATAL_ERROR("[copy_value] malloc failed for array Value");
+/// @brief Stores owned `val` under key `id`, freeing the value it replaces
+static void map_insert(struct Map *map, int id, Value *val)
+{
+    // Keep the index at most half full so probe chains stay short
+    if ((map->count + 1) * 2 > map->slot_count)
+    {
+        size_t slot_count = map->slot_count ? map->slot_count * 2 : 8;
+        size_t *slots = calloc(slot_count, sizeof(size_t));
+        if (!slots)
+            FATAL_ERROR("[Runtime evaluator] malloc failed for a map index");
+        free(map->slots);
+        map->slots = slots;
+        map->slot_count = slot_count;
+        for (size_t i = 0; i < map->count; i++)
+            *map_slot(map, map->keys[i]) = i + 1;
+    }
+
+    size_t *slot = map_slot(map, id);
+    if (*slot)
+    {
+        free_value(map->values[*slot - 1]);
+        map->values[*slot - 1] = val;
+        return;
     }
 
-    for (size_t i = 0; i < val->array.count; ++i)
+    if (map->count == map->capacity)
     {
+        size_t capacity = map->capacity ? map->capacity * 2 : 8;
+        int *keys = realloc(map->keys, sizeof(int) * capacity);
+        if (keys)
+            map->keys = keys;
+        Value **values = realloc(map->values, sizeof(Value *) * capacity);
+        if (values)
+            map->values = values;
+        if (!keys || !values)
+            FATAL_ERROR("[Runtime evaluator] malloc failed for map entries");
+        map->capacity = capacity;
+    }
+    map->keys[map->count] = id;
+    map->values[map->count] = val;
+    *slot = ++map->count;
+}
 
-        copy->array.items[i] = copy_value(val->array.items[i]);
-        if (!copy->array.items[i]) {
-            report_error("[copy_value] Failed to copy element %zu — cleaning up", i);
-            // Free previously allocated items
-            for (size_t j = 0; j < i; ++j) {
-                if (copy->array.items[j]) free(copy->array.items[j]);
-            }
-            free(copy->array.items);
-            free(copy);
-            FATAL_ERROR("[copy_value] Failed to copy element %zu — cleaning up", i);
-        }
+/// @brief Gives `val` an owned map of the entries of `from`, each copied, or shared with `share`
+static void own_copy_of_map(Value *val, const struct Map *from, int share)
+{
+    own_map(val);
+    for (size_t i = 0; i < from->count; i++)
+        map_insert(val->map, from->keys[i], share ? share_value(from->values[i]) : copy_value(from->values[i]));
+}
+
+/// @brief Drops `val`'s claim on its payload, freeing it with the last owner
+static void release_payload(Value *val)
+{
+    if (!val->refs || val->refs == interned_text || --*val->refs > 0)
+        return;
+    if (val->type == VAL_ARRAY && !val->width)
+    {
+        for (size_t i = 0; i < val->array.count; i++)
+            free_value(val->array.items[i]);
+    }
+    if (val->type == VAL_MAP)
+    {
+        for (size_t i = 0; i < val->map->count; i++)
+            free_value(val->map->values[i]);
+        free(val->map->keys);
+        free(val->map->values);
+        free(val->map->slots);
+    }
+    free(val->refs);
+    val->refs = NULL;
+}
+
+Value *make_string_value(const char *str)
+{
+    Value *val = malloc(sizeof(Value));
+    if (!val)
+    {
+        report_error("[make_string_value] malloc failed for Value");
+        return NULL;
     }
+    val->type = VAL_STRING;
+    own_string(val, str);
+    return val;
+}
+
+Value interned_value(const char *text)
+{
+    Value val = {.type = VAL_STRING, .string = (char *)(text ? text : ""), .refs = text ? interned_text : NULL};
+    return val;
+}
+
+Value char_value(char c)
+{
+    return interned_value(intern_byte((unsigned char)c));
 }
+
+Value *make_map_value(void)
+{
+    Value *val = malloc(sizeof(Value));
+    if (!val)
+        FATAL_ERROR("[make_map_value] malloc failed for Value");
+    memset(val, 0, sizeof(Value));
+    own_map(val);
+    return val;
+}
+
+Value *copy_value(Value *val)
+{
+    if (!val)
+        return NULL;
+
+    Value *copy = malloc(sizeof(Value));
+    if (!copy)
+        FATAL_ERROR("[copy_value] malloc failed for Value");
+
+    *copy = *val;
+    copy->refs = NULL;
+    if (val->type == VAL_ARRAY && val->width)
+    {
+        own_copy_of_numbers(copy, val);
+    }
+    else if (val->type == VAL_ARRAY)
+    {
+        own_items(copy, val->array.count);
+        for (size_t i = 0; i < val->array.count; i++)
+            copy->array.items[i] = copy_value(val->array.items[i]);
+    }
     else if (val->type == VAL_STRING)
     {
-        if (val->string) {
-            copy->string = strdup(val->string);
-            if (!copy->string) {
-                free(copy);
-                FATAL_ERROR("[copy_value] strdup failed for string Value");
-            }
-        } else {
-            copy->string = strdup("");
-            if (!copy->string) {
-                free(copy);
-                FATAL_ERROR("[copy_value] strdup failed for empty string Value");
-            }
-        }
+        // Interned text is already shared for good
+        if (val->refs == interned_text)
+            copy->refs = interned_text;
+        else
+            own_string(copy, val->string);
     }
-    else
+    else if (val->type == VAL_MAP)
+    {
+        own_copy_of_map(copy, val->map, 0);
+    }
+    else if (val->type != VAL_NUMBER)
     {
         printf("[copy_value] Unknown Value type: %d\n", val->type);
     }
@@ -436,217 +697,699 @@ else if (val->type == VAL_ARRAY)
     return copy;
 }
 
-// Evaluate expressions
-Value *eval_expr(ASTNode *node)
+Value *share_value(const Value *val)
 {
-    if (!node)
+    // Numbers have no payload, and temporaries none that outlives the statement
+    if (!val || val->type == VAL_NUMBER || !val->refs)
+        return copy_value((Value *)val);
+
+    Value *share = malloc(sizeof(Value));
+    if (!share)
+        FATAL_ERROR("[share_value] malloc failed for Value");
+    *share = *val;
+    if (share->refs != interned_text)
+        ++*share->refs;
+    return share;
+}
+
+int unshare_value(Value *val)
+{
+    if (!val || (val->type != VAL_ARRAY && val->type != VAL_MAP) || !val->refs || *val->refs == 1)
+        return 1;
+
+    // Other owners keep the old items; this one gets its own array of the same elements
+    Value old = *val;
+    if (old.type == VAL_MAP)
     {
-        report_error("[eval_expr] NULL node passed to eval_expr");
-        return NULL;
+        own_copy_of_map(val, old.map, 1);
     }
-
-    switch (node->type)
+    else if (old.width)
     {
-    case AST_NUMBER:
-        return make_number_value(node->number.value);
+        own_copy_of_numbers(val, &old);
+    }
+    else
+    {
+        own_items(val, old.array.count);
+        for (size_t i = 0; i < old.array.count; i++)
+            val->array.items[i] = share_value(old.array.items[i]);
+    }
+    release_payload(&old);
+    return 1;
+}
 
-    case AST_STRING:
-        return make_string_value(node->string_literal.value);
+/// @brief Resizes owned, unshared packed `array` to `count` elements, new numbers being 0
+static int resize_numbers(Value *array, size_t count)
+{
+    size_t old_count = array->array.count;
+    if (count > old_count)
+    {
+        if (!reserve_payload(array, sizeof(double) * count * array->width))
+            return 0;
+        memset(array->array.numbers + old_count * array->width, 0,
+               sizeof(double) * (count - old_count) * array->width);
+    }
+    // Shrinking keeps the block's room for a later grow
+    array->array.count = count;
+    return 1;
+}
 
-case AST_VAR:
+/// @brief Turns packed `array` into one of Values, each row becoming an array of its own
+static void unpack_array(Value *array)
 {
-    Value *val = get_var(node->var.name);
-    if (!val)
+    Value old = *array;
+    own_items(array, old.array.count);
+    for (size_t i = 0; i < old.array.count; i++)
     {
-        report_error("[Runtime evaluator] Variable '%s' is undefined", node->var.name);
-        return make_number_value(0.0);
+        Value item = array_item(&old, i);
+        array->array.items[i] = copy_value(&item);
     }
-    return val;  // ✅ Return original value, whether number or array
+    release_payload(&old);
 }
 
+int resize_array(Value *array, size_t count)
+{
+    if (!array || array->type != VAL_ARRAY || !array->refs)
+        return 0;
+
+    // A new element is the number 0, which fits a row of numbers only as a Value
+    if (array->width > 1 && count > array->array.count)
+        unpack_array(array);
+    unshare_value(array);
+    if (array->width)
+        return resize_numbers(array, count);
+
+    size_t old_count = array->array.count;
+    if (count <= old_count)
+    {
+        // Shrinking keeps the block's room for a later grow
+        for (size_t i = count; i < old_count; i++)
+            free_value(array->array.items[i]);
+        array->array.count = count;
+        return 1;
+    }
+
+    if (!reserve_payload(array, sizeof(Value *) * count))
+        return 0;
+    array->array.count = count;
+    for (size_t i = old_count; i < count; i++)
+        array->array.items[i] = make_number_value(0);
+    return 1;
+}
 
-    case AST_LET:
-        eval_let(node);                // <-- Actually execute the let
-        return make_number_value(0.0); // Return dummy value to satisfy eval_expr()
+/// @brief A number by value, kept exactly as given (NaN and Infinity included)
+static Value raw_number_value(double x)
+{
+    Value val = {.type = VAL_NUMBER, .number = x};
+    return val;
+}
 
-    case AST_UNARY:
+/// @brief Copies a by-value result into the scratch arena for the Value * API
+static Value *scratch_value(Value val)
+{
+    Value *temp = arena_alloc(&get_runtime()->scratch, sizeof(Value));
+    if (!temp)
     {
-        double operand = get_number(eval_expr(node->unary_expr.operand));
-        switch (node->unary_expr.op)
-        {
-        case TOKEN_BANG:
-            return make_number_value(!operand);
-        case TOKEN_MINUS:
-            return make_number_value(-operand);
-        default:
-
-            report_error("[Runtime evaluator] Unknown unary operator: %d", node->unary_expr.op);
-            return make_number_value(0.0);
-        }
+        report_error("[Runtime evaluator] scratch allocation failed for Value");
+        return NULL;
     }
+    *temp = val;
+    return temp;
+}
 
-    case AST_BINARY:
+/// @brief A temporary number, rounded like scratch_number()
+static Value *scratch_number(double x)
+{
+    return scratch_value(number_value(x));
+}
+
+Value array_item(const Value *array, size_t index)
+{
+    if (!array->width)
+        return *array->array.items[index];
+    if (array->width == 1)
+        return raw_number_value(array->array.numbers[index]);
+
+    // A row stays where it is packed; storing it anywhere copies it out
+    Value row = {.type = VAL_ARRAY, .width = 1};
+    row.array.numbers = array->array.numbers + index * array->width;
+    row.array.count = array->width;
+    return row;
+}
+
+/// @brief Whether `item` is an array of exactly `width` numbers
+static int is_number_row(const Value *item, size_t width)
+{
+    if (item->type != VAL_ARRAY || item->array.count != width || item->width > 1)
+        return 0;
+    for (size_t i = 0; !item->width && i < width; i++)
     {
-        Value *left_val = eval_expr(node->binary_expr.left);
-        Value *right_val = eval_expr(node->binary_expr.right);
-        Token_Type op = node->binary_expr.op;
+        if (item->array.items[i]->type != VAL_NUMBER)
+            return 0;
+    }
+    return 1;
+}
 
-        if (!left_val || !right_val) {
-            report_error("[Runtime evaluator] Failed to evaluate binary expression operands");
-            return make_number_value(0.0);
-        }
+/// @brief Whether `item` can be stored at `index` of packed `array` without unpacking it
+static int fits_packed(const Value *array, size_t index, const Value *item)
+{
+    if (array->width == 1)
+        return item->type == VAL_NUMBER;
+    // Growing past the end would need rows of 0s, which are numbers rather than rows
+    return index <= array->array.count && is_number_row(item, array->width);
+}
 
-        // Handle comparison operators that can work with different types
-        if (op == TOKEN_EQUAL_EQUAL || op == TOKEN_BANG_EQUAL) {
-            int result = 0;
-            
-            // Both are strings - compare string values
-            if (left_val->type == VAL_STRING && right_val->type == VAL_STRING) {
-                result = strcmp(left_val->string, right_val->string) == 0;
-            }
-            // Both are numbers - compare numeric values
-            else if (left_val->type == VAL_NUMBER && right_val->type == VAL_NUMBER) {
-                result = left_val->number == right_val->number;
-            }
-            // Different types - not equal
-            else {
-                result = 0;
-            }
-            
-            // Apply negation for != operator
-            if (op == TOKEN_BANG_EQUAL) {
-                result = !result;
-            }
-            
-            return make_number_value(result ? 1.0 : 0.0);
-        }
+int store_item(Value *array, size_t index, const Value *item)
+{
+    if (!array || array->type != VAL_ARRAY || !item)
+        return 0;
 
-        // For all other operations, we need numbers
-        if (left_val->type != VAL_NUMBER || right_val->type != VAL_NUMBER) {
-            report_error("[Runtime evaluator] Arithmetic operations require numeric operands");
-            return make_number_value(0.0);
-        }
+    // An empty packed array takes the width of the first row stored into it, so pushed points stay packed
+    if (array->width && array->refs && array->array.count == 0 && index == 0 && item->type == VAL_ARRAY &&
+        item->array.count >= 2 && item->array.count <= UINT_MAX && is_number_row(item, item->array.count) &&
+        unshare_value(array))
+        array->width = (unsigned)item->array.count;
 
-        double left = left_val->number;
-        double right = right_val->number;
+    if (array->width && fits_packed(array, index, item))
+    {
+        // Read the numbers first: the item may be a row of this very array
+        double number;
+        double *numbers = array->width == 1 ? &number : arena_alloc(&get_runtime()->scratch, sizeof(double) * array->width);
+        if (!numbers)
+            return 0;
+        for (unsigned i = 0; i < array->width; i++)
+            numbers[i] = array->width == 1 ? item->number : array_item(item, i).number;
+
+        int grows = index >= array->array.count;
+        if (grows ? !array->refs || !unshare_value(array) || !resize_numbers(array, index + 1)
+                  : !unshare_value(array))
+            return 0;
+        memcpy(array->array.numbers + index * array->width, numbers, sizeof(double) * array->width);
+        return 1;
+    }
+
+    // Nothing but an owned array can take Values of its own
+    if (!array->refs)
+        return 0;
+
+    // Claim the item before the array changes: it may be the array itself or one of its elements
+    Value *stored = share_value(item);
+    if (array->width)
+        unpack_array(array);
+    if (index >= array->array.count ? !resize_array(array, index + 1) : !unshare_value(array))
+    {
+        free_value(stored);
+        return 0;
+    }
+    free_value(array->array.items[index]);
+    array->array.items[index] = stored;
+    return 1;
+}
 
-        switch (op)
-        {
-        case TOKEN_PLUS:
-            return make_number_value(left + right);
-        case TOKEN_MINUS:
-            return make_number_value(left - right);
-        case TOKEN_STAR:
-            return make_number_value(left * right);
-        case TOKEN_SLASH:
-            if (right == 0.0)
-            {
-                // Modern IEEE 754 compliant division by zero handling
-                if (left > 0.0) {
-                    report_error("[Runtime evaluator] Division by zero: %.5f / 0.0 = +∞", left);
-                    return make_raw_number_value(INFINITY);
-                } else if (left < 0.0) {
-                    report_error("[Runtime evaluator] Division by zero: %.5f / 0.0 = -∞", left);
-                    return make_raw_number_value(-INFINITY);
-                } else {
-                    report_error("[Runtime evaluator] Indeterminate form: 0.0 / 0.0 = NaN");
-                    return make_raw_number_value(NAN);
-                }
-            }
-            return make_number_value(left / right);
-        case TOKEN_CARET:
-            return make_number_value(compat_pow_impl(left, right));
-        case TOKEN_LESS:
-            return make_number_value(left < right ? 1.0 : 0.0);
-        case TOKEN_LESS_EQUAL:
-            return make_number_value(left <= right ? 1.0 : 0.0);
-        case TOKEN_GREATER:
-            return make_number_value(left > right ? 1.0 : 0.0);
-        case TOKEN_GREATER_EQUAL:
-            return make_number_value(left >= right ? 1.0 : 0.0);
-
-        case TOKEN_BANG_EQUAL:
-            // This case is handled above with TOKEN_EQUAL_EQUAL
-            return make_number_value(left != right ? 1.0 : 0.0);
-        case TOKEN_AND:
-            return make_number_value((left != 0.0 && right != 0.0) ? 1.0 : 0.0);
-
-        case TOKEN_OR:
-        {
-            double result = (left != 0.0 || right != 0.0) ? 1.0 : 0.0;
-            //printf("[Eval] OR: %.2f || %.2f => %.2f\n", left, right, result);
-            return make_number_value(result);
-        }
+/// @brief Interned id of map key `key`; unless `add` is set, -1 when no map can hold it
+static int map_key(const Value *key, int add)
+{
+    InternTable *strings = &get_runtime()->strings;
+    int length = (int)strlen(key->string);
+    return add ? intern_id(strings, key->string, length) : intern_find(strings, key->string, length);
+}
 
-        case TOKEN_AMPERSAND:
-            return make_number_value((double)((int)left & (int)right));
-        
-        case TOKEN_PIPE:
-            return make_number_value((double)((int)left | (int)right));
-        
-        case TOKEN_LSHIFT:
-            return make_number_value((double)((int)left << (int)right));
-        
-        case TOKEN_RSHIFT:
-            return make_number_value((double)((int)left >> (int)right));
-        
-        default:
+int store_entry(Value *map, const Value *key, const Value *item)
+{
+    if (!map || map->type != VAL_MAP || !map->refs || !key || key->type != VAL_STRING || !item)
+        return 0;
+    int id = map_key(key, 1);
+    if (id < 0)
+        return 0;
+
+    // Claim the item before the map changes: it may be the map itself or one of its values
+    Value *stored = share_value(item);
+    unshare_value(map);
+    map_insert(map->map, id, stored);
+    return 1;
+}
 
-            report_error("[Runtime evaluator] Unknown binary operator: %d", op);
-            return make_number_value(0.0);
-        }
+/// @brief The value stored under `key` in map `map`, or NULL after reporting why there is none
+static Value *map_get(const Value *map, const Value *key)
+{
+    if (!key || key->type != VAL_STRING)
+    {
+        report_error("[Runtime] AST_INDEX: Map key is not a string");
+        return NULL;
     }
+    Value *found = map_find(map->map, map_key(key, 0));
+    if (!found)
+        report_error("[Runtime] AST_INDEX: Key \"%s\" not found", key->string);
+    return found;
+}
 
-    case AST_ARRAY_LITERAL:
+/// @brief Packs temporary array literal `array` when its elements are all numbers, or all rows
+/// of the same count of numbers
+static void pack_literal(Value *array)
+{
+    size_t count = array->array.count;
+    Value **items = array->array.items;
+    for (size_t i = 0; i < count; i++)
     {
-        int count = node->array_literal.count;
+        if (!items[i])
+            return;
+    }
 
-        Value **items = malloc(sizeof(Value *) * count);
-        if (!items)
-        {
+    // A row of one number would read back as a number, so rows have at least two
+    size_t width = 1;
+    if (count > 0 && items[0]->type == VAL_ARRAY)
+    {
+        width = items[0]->array.count;
+        if (width < 2 || width > UINT_MAX)
+            return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (width == 1 ? items[i]->type != VAL_NUMBER : !is_number_row(items[i], width))
+            return;
+    }
 
-            report_error("[Runtime evaluator] malloc failed for array literal");
-            FATAL_ERROR("[Runtime evaluator] malloc failed for array literal");
-        }
+    size_t total = count * width;
+    double *numbers = arena_alloc(&get_runtime()->scratch, sizeof(double) * (total ? total : 1));
+    if (!numbers)
+    {
+        report_error("[Runtime evaluator] scratch allocation failed for array literal");
+        FATAL_ERROR("[Runtime evaluator] scratch allocation failed for array literal");
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = 0; j < width; j++)
+            numbers[i * width + j] = width == 1 ? items[i]->number : array_item(items[i], j).number;
+    }
+    array->width = (unsigned)width;
+    array->array.numbers = numbers;
+}
 
-        for (int i = 0; i < count; i++)
-        {
-            ASTNode *element = node->array_literal.elements[i];
+/// @brief A heap value owned by the scratch arena, freed when its mark is released
+struct ScratchRef {
+    Value *val;
+    struct ScratchRef *next;
+};
 
-            // Recursively evaluate (handles nested arrays naturally)
-            Value *v = eval_expr(element);
-            items[i] = v;
-        }
+/// @brief Hands heap value `val` to the enclosing statement, which frees it when it ends
+static Value *scratch_own(Value *val)
+{
+    Runtime *rt = get_runtime();
+    struct ScratchRef *ref = arena_alloc(&rt->scratch, sizeof(struct ScratchRef));
+    if (!ref)
+    {
+        report_error("[Runtime evaluator] scratch allocation failed for Value");
+        free_value(val);
+        return NULL;
+    }
+    ref->val = val;
+    ref->next = rt->scratch_refs;
+    rt->scratch_refs = ref;
+    return val;
+}
 
-        Value *arr_val = malloc(sizeof(Value));
+ScratchMark scratch_mark(void)
+{
+    Runtime *rt = get_runtime();
+    ScratchMark mark = {arena_mark(&rt->scratch), rt->scratch_refs};
+    return mark;
+}
 
-        if (!arr_val)
-        {
-            report_error("[Runtime evaluator] malloc failed for array Value");
-            FATAL_ERROR("[Runtime evaluator] malloc failed for array Value");
-        }
+void scratch_release(ScratchMark mark)
+{
+    Runtime *rt = get_runtime();
+    while (rt->scratch_refs && rt->scratch_refs != mark.refs)
+    {
+        struct ScratchRef *ref = rt->scratch_refs;
+        rt->scratch_refs = ref->next;
+        free_value(ref->val);
+    }
+    arena_release(&rt->scratch, mark.arena);
+}
 
-        arr_val->type = VAL_ARRAY;
-        arr_val->array.items = items;
-        arr_val->array.count = count;
+/// @brief Applies a unary operator to an already evaluated operand
+Value apply_unary(Token_Type op, double operand)
+{
+    switch (op)
+    {
+    case TOKEN_BANG:
+        return number_value(!operand);
+    case TOKEN_MINUS:
+        return number_value(-operand);
+    default:
 
-        // Return the array value (no parent access to prevent crashes)
-        return arr_val;
+        report_error("[Runtime evaluator] Unknown unary operator: %d", op);
+        return number_value(0.0);
+    }
+}
 
+/// @brief Applies a binary operator to already evaluated operands
+Value apply_binary(Token_Type op, const Value *left_val, const Value *right_val)
+{
+    if (!left_val || !right_val) {
+        report_error("[Runtime evaluator] Failed to evaluate binary expression operands");
+        return number_value(0.0);
     }
 
-    case AST_FOR:
-        return eval_function_call(node);
+    // Handle comparison operators that can work with different types
+    if (op == TOKEN_EQUAL_EQUAL || op == TOKEN_BANG_EQUAL) {
+        int result = 0;
+        
+        // Both are strings - compare string values; interned texts are unique, so two of them
+        // are equal only if they are the same text
+        if (left_val->type == VAL_STRING && right_val->type == VAL_STRING) {
+            if (left_val->refs == interned_text && right_val->refs == interned_text)
+                result = left_val->string == right_val->string;
+            else
+                result = left_val->string == right_val->string || strcmp(left_val->string, right_val->string) == 0;
+        }
+        // Both are numbers - compare numeric values
+        else if (left_val->type == VAL_NUMBER && right_val->type == VAL_NUMBER) {
+            result = left_val->number == right_val->number;
+        }
+        // Different types - not equal
+        else {
+            result = 0;
+        }
+        
+        // Apply negation for != operator
+        if (op == TOKEN_BANG_EQUAL) {
+            result = !result;
+        }
+        
+        return number_value(result ? 1.0 : 0.0);
+    }
 
-    case AST_CALL:
-        return eval_function_call(node);
+    // For all other operations, we need numbers
+    if (left_val->type != VAL_NUMBER || right_val->type != VAL_NUMBER) {
+        report_error("[Runtime evaluator] Arithmetic operations require numeric operands");
+        return number_value(0.0);
+    }
 
-    case AST_IF:
+    double left = left_val->number;
+    double right = right_val->number;
+
+    switch (op)
     {
-        const Value *cond = eval_expr(node->if_stmt.condition);
-        if (cond && cond->type == VAL_NUMBER)
+    case TOKEN_PLUS:
+        return number_value(left + right);
+    case TOKEN_MINUS:
+        return number_value(left - right);
+    case TOKEN_STAR:
+        return number_value(left * right);
+    case TOKEN_SLASH:
+        if (right == 0.0)
         {
-            if (cond->number != 0)
+            // Modern IEEE 754 compliant division by zero handling
+            if (left > 0.0) {
+                report_error("[Runtime evaluator] Division by zero: %.5f / 0.0 = +∞", left);
+                return raw_number_value(INFINITY);
+            } else if (left < 0.0) {
+                report_error("[Runtime evaluator] Division by zero: %.5f / 0.0 = -∞", left);
+                return raw_number_value(-INFINITY);
+            } else {
+                report_error("[Runtime evaluator] Indeterminate form: 0.0 / 0.0 = NaN");
+                return raw_number_value(NAN);
+            }
+        }
+        return number_value(left / right);
+    case TOKEN_CARET:
+        return number_value(compat_pow_impl(left, right));
+    case TOKEN_LESS:
+        return number_value(left < right ? 1.0 : 0.0);
+    case TOKEN_LESS_EQUAL:
+        return number_value(left <= right ? 1.0 : 0.0);
+    case TOKEN_GREATER:
+        return number_value(left > right ? 1.0 : 0.0);
+    case TOKEN_GREATER_EQUAL:
+        return number_value(left >= right ? 1.0 : 0.0);
+
+    case TOKEN_BANG_EQUAL:
+        // This case is handled above with TOKEN_EQUAL_EQUAL
+        return number_value(left != right ? 1.0 : 0.0);
+    case TOKEN_AND:
+        return number_value((left != 0.0 && right != 0.0) ? 1.0 : 0.0);
+
+    case TOKEN_OR:
+    {
+        double result = (left != 0.0 || right != 0.0) ? 1.0 : 0.0;
+        //printf("[Eval] OR: %.2f || %.2f => %.2f\n", left, right, result);
+        return number_value(result);
+    }
+
+    case TOKEN_AMPERSAND:
+        return number_value((double)((int)left & (int)right));
+    
+    case TOKEN_PIPE:
+        return number_value((double)((int)left | (int)right));
+    
+    case TOKEN_LSHIFT:
+        return number_value((double)((int)left << (int)right));
+    
+    case TOKEN_RSHIFT:
+        return number_value((double)((int)left >> (int)right));
+    
+    default:
+
+        report_error("[Runtime evaluator] Unknown binary operator: %d", op);
+        return number_value(0.0);
+    }
+}
+
+int element_value(const Value *target, const Value *index_val, Value *element)
+{
+    if (target && target->type == VAL_MAP) {
+        const Value *found = map_get(target, index_val);
+        if (found)
+            *element = *found;
+        return found != NULL;
+    }
+
+    if (!target || target->type != VAL_ARRAY) {
+        report_error("[Runtime] AST_INDEX: Not an array");
+        return 0;
+    }
+
+    if (!index_val || index_val->type != VAL_NUMBER) {
+        report_error("[Runtime] AST_INDEX: Index is not a number");
+        return 0;
+    }
+
+    int index = (int)index_val->number;
+    if (index < 0 || index >= (int)target->array.count) {
+        report_error("[Runtime] AST_INDEX: Index %d out of bounds (size = %zu)", index, target->array.count);
+        return 0;
+    }
+
+    if (!target->width && !target->array.items[index]) {
+        report_error("[Runtime] AST_INDEX: NULL element at index %d", index);
+        return 0;
+    }
+
+    *element = array_item(target, (size_t)index);
+    return 1;
+}
+
+/// @brief Looks up `target[index_val]`, returning the element itself, or NULL after reporting why not
+Value *index_value(const Value *target, const Value *index_val)
+{
+    if (target && target->type == VAL_MAP)
+        return map_get(target, index_val);
+
+    Value element;
+    if (!element_value(target, index_val, &element))
+        return NULL;
+
+    // ✅ Return the value directly (even if it’s another array); packed ones are read out
+    if (!target->width)
+        return target->array.items[(int)index_val->number];
+    return scratch_value(element);
+}
+
+/// @brief Stores `current op= rhs` into `name`
+Value *apply_compound_assign(int slot, const char *name, Token_Type op, const Value *current, const Value *rhs)
+{
+    if (!rhs) {
+        report_error("[eval_expr] Failed to evaluate RHS of compound assignment");
+        return scratch_number(0.0);
+    }
+
+    // Perform the compound operation
+    double result = 0.0;
+    switch (op) {
+        case TOKEN_PLUS_EQUAL:
+            result = current->number + rhs->number;
+            break;
+        case TOKEN_MINUS_EQUAL:
+            result = current->number - rhs->number;
+            break;
+        case TOKEN_STAR_EQUAL:
+            result = current->number * rhs->number;
+            break;
+        case TOKEN_SLASH_EQUAL:
+            if (rhs->number == 0.0) {
+                // Modern IEEE 754 compliant division by zero handling for compound assignment
+                if (current->number > 0.0) {
+                    report_error("[eval_expr] Division by zero in /= operation: %.5f /= 0.0 = +∞", current->number);
+                    result = INFINITY;
+                } else if (current->number < 0.0) {
+                    report_error("[eval_expr] Division by zero in /= operation: %.5f /= 0.0 = -∞", current->number);
+                    result = -INFINITY;
+                } else {
+                    report_error("[eval_expr] Indeterminate form in /= operation: 0.0 /= 0.0 = NaN");
+                    result = NAN;
+                }
+            } else {
+                result = current->number / rhs->number;
+            }
+            break;
+        case TOKEN_CARET_EQUAL:
+            result = compat_pow_impl(current->number, rhs->number);
+            break;
+        case TOKEN_AMPERSAND_EQUAL:
+            result = (double)((int)current->number & (int)rhs->number);
+            break;
+        case TOKEN_PIPE_EQUAL:
+            result = (double)((int)current->number | (int)rhs->number);
+            break;
+        case TOKEN_LSHIFT_EQUAL:
+            result = (double)((int)current->number << (int)rhs->number);
+            break;
+        case TOKEN_RSHIFT_EQUAL:
+            result = (double)((int)current->number >> (int)rhs->number);
+            break;
+        default:
+            report_error("[eval_expr] Unknown compound assignment operator");
+            return scratch_number(0.0);
+    }
+
+    // Set the new value (use raw if it contains special values)
+    Value result_val = (isnan(result) || isinf(result)) ? raw_number_value(result) : number_value(result);
+    set_var_slot(slot, name, &result_val);
+    return scratch_number(0.0);
+}
+
+Value *eval_writable(ASTNode *node)
+{
+    if (!node)
+        return NULL;
+
+    if (node->type == AST_VAR)
+    {
+        Value *val = get_var_slot(node->var.slot, node->var.name);
+        if (!val)
+            report_error("[Runtime evaluator] Variable '%s' is undefined", node->var.name);
+        unshare_value(val);
+        return val;
+    }
+
+    if (node->type == AST_INDEX)
+    {
+        Value *array = eval_writable(node->index_expr.array);
+        Value index_val = eval_value(node->index_expr.index);
+        // Rows stored into one by one become arrays of their own
+        if (array && array->type == VAL_ARRAY && array->width > 1 && array->refs)
+            unpack_array(array);
+        Value *element = index_value(array, &index_val);
+        unshare_value(element);
+        return element;
+    }
+
+    return eval_expr(node);
+}
+
+// Evaluate expressions
+Value *eval_expr(ASTNode *node)
+{
+    if (!node)
+    {
+        report_error("[eval_expr] NULL node passed to eval_expr");
+        return NULL;
+    }
+
+    switch (node->type)
+    {
+    case AST_NUMBER:
+        return scratch_number(node->number.value);
+
+    case AST_STRING:
+        return scratch_value(interned_value(node->string_literal.value));
+
+case AST_VAR:
+{
+    Value *val = get_var_slot(node->var.slot, node->var.name);
+    if (!val)
+    {
+        report_error("[Runtime evaluator] Variable '%s' is undefined", node->var.name);
+        return scratch_number(0.0);
+    }
+    return val;  // ✅ Return original value, whether number or array
+}
+
+
+    case AST_LET:
+        eval_let(node);                // <-- Actually execute the let
+        return scratch_number(0.0); // Return dummy value to satisfy eval_expr()
+
+    case AST_UNARY:
+    case AST_BINARY:
+        return scratch_value(eval_value(node));
+
+    case AST_ARRAY_LITERAL:
+    {
+        int count = node->array_literal.count;
+
+        // The literal is a temporary; storing it in a variable copies it to the heap
+        Value **items = arena_alloc(&get_runtime()->scratch, sizeof(Value *) * count);
+        if (!items)
+        {
+
+            report_error("[Runtime evaluator] scratch allocation failed for array literal");
+            FATAL_ERROR("[Runtime evaluator] scratch allocation failed for array literal");
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            ASTNode *element = node->array_literal.elements[i];
+
+            // Recursively evaluate (handles nested arrays naturally)
+            Value *v = eval_expr(element);
+            items[i] = v;
+        }
+
+        Value array = {.type = VAL_ARRAY};
+        array.array.items = items;
+        array.array.count = count;
+        pack_literal(&array);
+
+        // Return the array value (no parent access to prevent crashes)
+        return scratch_value(array);
+
+    }
+
+    case AST_MAP_LITERAL:
+    {
+        // Built on the heap from the start; the statement owns it until a variable shares it
+        Value *map = make_map_value();
+        for (int i = 0; i < node->array_literal.count; i++)
+        {
+            Value *v = eval_expr(node->array_literal.elements[i]);
+            map_insert(map->map, node->array_literal.keys[i], v ? share_value(v) : make_number_value(0.0));
+        }
+        return scratch_own(map);
+    }
+
+    case AST_FOR:
+        return eval_function_call(node);
+
+    case AST_CALL:
+        return eval_function_call(node);
+
+    case AST_IF:
+    {
+        Value cond = eval_value(node->if_stmt.condition);
+        if (cond.type == VAL_NUMBER)
+        {
+            if (cond.number != 0)
             {
                 Value *result = eval_expr(node->if_stmt.then_branch);
                 // Return statements in if expressions are handled by the branch evaluation
@@ -659,15 +1402,19 @@ case AST_VAR:
                 return result;
             }
         }
-        return make_number_value(0.0);
+        return scratch_number(0.0);
     }
 
+    case AST_MATCH:
+        eval_match(node);
+        return scratch_number(0.0);
+
     case AST_TERNARY:
     {
-        const Value *cond = eval_expr(node->ternary_expr.condition);
-        if (cond && cond->type == VAL_NUMBER)
+        Value cond = eval_value(node->ternary_expr.condition);
+        if (cond.type == VAL_NUMBER)
         {
-            if (cond->number != 0)
+            if (cond.number != 0)
             {
                 return eval_expr(node->ternary_expr.true_expr);
             }
@@ -682,10 +1429,9 @@ case AST_VAR:
 
 case AST_RETURN:
 {
-    runtime_has_returned = 1;
-    
     // Handle null expressions (bare return statements)
     if (node->return_stmt.expr == NULL) {
+        runtime_has_returned = 1;
         // Clean up any existing return value
         if (runtime_return_value) {
             free_value(runtime_return_value);
@@ -694,321 +1440,915 @@ case AST_RETURN:
         return runtime_return_value;
     }
     
-    // Evaluate the return expression
-    Value *ret = eval_expr(node->return_stmt.expr);
-    if (!ret) {
-        // If expression evaluation failed, return 0
-        if (runtime_return_value) {
-            free_value(runtime_return_value);
-        }
-        runtime_return_value = make_number_value(0.0);
-        return runtime_return_value;
-    }
+    // A call of the running function needs no frame of its own
+    if (node->return_stmt.expr->type == AST_CALL && tail_call(node->return_stmt.expr))
+        return runtime_return_value ? runtime_return_value : scratch_number(0.0);
+
+    // Evaluate the return expression; a call in it clears the flag when it returns, so it is set after
+    Value ret = eval_value(node->return_stmt.expr);
+    runtime_has_returned = 1;
     
     // Clean up any existing return value before setting new one
     if (runtime_return_value) {
         free_value(runtime_return_value);
     }
     
-    // Copy the return value for later use
-    runtime_return_value = copy_value(ret);
-    return ret;
+    // Keep the return value for the caller; a local's payload is shared, not copied
+    runtime_return_value = share_value(&ret);
+    return runtime_return_value;
 }
 
 
     case AST_FUNCTION:
         register_function(node);
-        return make_number_value(0.0);
+        return scratch_number(0.0);
 
     case AST_ASSIGN:
-        set_var(node->assign_stmt.name, eval_expr(node->assign_stmt.expr));
-        return make_number_value(0.0);
+    {
+        Value val = eval_value(node->assign_stmt.expr);
+        set_var_slot(node->assign_stmt.slot, node->assign_stmt.name, &val);
+        return scratch_number(0.0);
+    }
 
     case AST_COMPOUND_ASSIGN:
     {
         // Get current value of the variable
-        Value *current = get_var(node->compound_assign.name);
+        Value *current = get_var_slot(node->compound_assign.slot, node->compound_assign.name);
         if (!current) {
             report_error("[eval_expr] Variable '%s' not found for compound assignment", node->compound_assign.name);
-            return make_number_value(0.0);
+            return scratch_number(0.0);
         }
-        
+
         // Evaluate the right-hand side expression
-        Value *rhs = eval_expr(node->compound_assign.expr);
-        if (!rhs) {
-            report_error("[eval_expr] Failed to evaluate RHS of compound assignment");
-            return make_number_value(0.0);
-        }
+        Value rhs = eval_value(node->compound_assign.expr);
+        return apply_compound_assign(node->compound_assign.slot, node->compound_assign.name,
+                                     node->compound_assign.op, current, &rhs);
+    }
 
-        // Perform the compound operation
-        double result = 0.0;
-        switch (node->compound_assign.op) {
-            case TOKEN_PLUS_EQUAL:
-                result = current->number + rhs->number;
-                break;
-            case TOKEN_MINUS_EQUAL:
-                result = current->number - rhs->number;
-                break;
-            case TOKEN_STAR_EQUAL:
-                result = current->number * rhs->number;
-                break;
-            case TOKEN_SLASH_EQUAL:
-                if (rhs->number == 0.0) {
-                    // Modern IEEE 754 compliant division by zero handling for compound assignment
-                    if (current->number > 0.0) {
-                        report_error("[eval_expr] Division by zero in /= operation: %.5f /= 0.0 = +∞", current->number);
-                        result = INFINITY;
-                    } else if (current->number < 0.0) {
-                        report_error("[eval_expr] Division by zero in /= operation: %.5f /= 0.0 = -∞", current->number);
-                        result = -INFINITY;
-                    } else {
-                        report_error("[eval_expr] Indeterminate form in /= operation: 0.0 /= 0.0 = NaN");
-                        result = NAN;
-                    }
-                } else {
-                    result = current->number / rhs->number;
-                }
-                break;
-            case TOKEN_CARET_EQUAL:
-                result = compat_pow_impl(current->number, rhs->number);
-                break;
-            case TOKEN_AMPERSAND_EQUAL:
-                result = (double)((int)current->number & (int)rhs->number);
-                break;
-            case TOKEN_PIPE_EQUAL:
-                result = (double)((int)current->number | (int)rhs->number);
-                break;
-            case TOKEN_LSHIFT_EQUAL:
-                result = (double)((int)current->number << (int)rhs->number);
-                break;
-            case TOKEN_RSHIFT_EQUAL:
-                result = (double)((int)current->number >> (int)rhs->number);
-                break;
-            default:
-                report_error("[eval_expr] Unknown compound assignment operator");
-                return make_number_value(0.0);
+
+
+case AST_INDEX:
+{
+    const Value *target = eval_expr(node->index_expr.array);
+    const Value *index_val = eval_expr(node->index_expr.index);
+    Value *element = index_value(target, index_val);
+    return element ? element : scratch_number(0.0);
+}
+
+
+
+case AST_BLOCK:
+    eval_block(node);
+    return scratch_number(0.0);
+
+
+
+
+
+case AST_WHILE: {
+    while (1) {
+        // The condition's temporaries are dropped before the body runs
+        ScratchMark mark = scratch_mark();
+        Value cond = eval_value(node->while_stmt.condition);
+        scratch_release(mark);
+        if (!get_number(&cond)) {
+            break;
         }
 
-        // Set the new value (use raw if it contains special values)
-        if (isnan(result) || isinf(result)) {
-            set_var(node->compound_assign.name, make_raw_number_value(result));
+        // While loop body should be evaluated as a block, not an expression
+        if (node->while_stmt.body->type == AST_BLOCK) {
+            eval_block(node->while_stmt.body);
         } else {
-            set_var(node->compound_assign.name, make_number_value(result));
+            eval_expr(node->while_stmt.body);
+        }
+
+        if (runtime_has_returned) {
+            break;
         }
-        return make_number_value(0.0);
     }
+    return scratch_number(0.0);
+}
 
 
 
-case AST_INDEX:
+
+
+    case AST_EXPR_STMT:
+        // Expression statements should evaluate their inner expression
+        if (node->expr_stmt.expr) {
+            return eval_expr(node->expr_stmt.expr);
+        }
+        return scratch_number(0.0);
+
+    default:
+
+        report_error("[Runtime evaluator] Unsupported expression type: %d (%s)", node->type, get_ast_type_name(node->type));
+
+        return scratch_number(0.0);
+    }
+}
+
+/// @brief Evaluates a flat AST node; mirrors eval_expr() case for case
+Value *eval_flat_expr(const FlatAst *ast, FlatIndex index)
 {
-    Value *target = eval_expr(node->index_expr.array);
-    const Value *index_val = eval_expr(node->index_expr.index);
+    if (index == FLAT_NONE)
+    {
+        report_error("[eval_expr] NULL node passed to eval_expr");
+        return NULL;
+    }
 
-    if (!target || target->type != VAL_ARRAY) {
-        report_error("[Runtime] AST_INDEX: Not an array");
-        return make_number_value(0.0);
+    const FlatNode *node = &ast->nodes[index];
+    switch (node->type)
+    {
+    case AST_NUMBER:
+        return scratch_number(ast->numbers[node->a]);
+
+    case AST_STRING:
+        return scratch_value(interned_value(ast->names[node->a]));
+
+    case AST_VAR:
+    {
+        const char *name = ast->names[node->a];
+        Value *val = get_var_slot((int)node->b, name);
+        if (!val)
+        {
+            report_error("[Runtime evaluator] Variable '%s' is undefined", name);
+            return scratch_number(0.0);
+        }
+        return val;
     }
 
-    if (!index_val || index_val->type != VAL_NUMBER) {
-        report_error("[Runtime] AST_INDEX: Index is not a number");
-        return make_number_value(0.0);
+    case AST_UNARY:
+    case AST_BINARY:
+        return scratch_value(eval_flat_value(ast, index));
+
+    case AST_TERNARY:
+    {
+        const Value *cond = eval_flat_expr(ast, node->a);
+        if (cond && cond->type == VAL_NUMBER && cond->number != 0)
+            return eval_flat_expr(ast, node->b);
+        return eval_flat_expr(ast, node->c);
     }
 
-    int index = (int)index_val->number;
-    if (index < 0 || index >= (int)target->array.count) {
-        report_error("[Runtime] AST_INDEX: Index %d out of bounds (size = %zu)", index, target->array.count);
-        return make_number_value(0.0);
+    case AST_INDEX:
+    {
+        const Value *target = eval_flat_expr(ast, node->a);
+        const Value *index_val = eval_flat_expr(ast, node->b);
+        Value *element = index_value(target, index_val);
+        return element ? element : scratch_number(0.0);
     }
 
-    Value *result = target->array.items[index];
-    if (!result) {
-        report_error("[Runtime] AST_INDEX: NULL element at index %d", index);
-        return make_number_value(0.0);
+    case AST_CALL:
+    {
+        CallArgs args = {NULL, ast, node->c ? &ast->lists[node->b] : NULL, (int)node->c};
+        return call_function(ast->origin[index], &args);
     }
 
-    // ✅ Return the value directly (even if it’s another array)
-    return result;
+    case AST_ASSIGN:
+    {
+        Value val = eval_flat_value(ast, node->b);
+        set_var_slot((int)node->c, ast->names[node->a], &val);
+        return scratch_number(0.0);
+    }
+
+    case AST_COMPOUND_ASSIGN:
+    {
+        const char *name = ast->names[node->a];
+        Value *current = get_var_slot((int)node->c, name);
+        if (!current) {
+            report_error("[eval_expr] Variable '%s' not found for compound assignment", name);
+            return scratch_number(0.0);
+        }
+        Value rhs = eval_flat_value(ast, node->b);
+        return apply_compound_assign((int)node->c, name, (Token_Type)node->op, current, &rhs);
+    }
+
+    case AST_EXPR_STMT:
+        if (node->a != FLAT_NONE)
+            return eval_flat_expr(ast, node->a);
+        return scratch_number(0.0);
+
+    default:
+        // Statements with their own scoping rules run from the pointer tree
+        return eval_expr(ast->origin[index]);
+    }
 }
 
+static Value call_value(ASTNode *call, const CallArgs *args);
 
+/// @brief Evaluates an expression by value; mirrors eval_expr() for the cases
+///        that produce numbers, so scalar arithmetic never touches the heap
+Value eval_value(ASTNode *node)
+{
+    if (!node)
+    {
+        report_error("[eval_expr] NULL node passed to eval_expr");
+        return number_value(0.0);
+    }
 
-case AST_BLOCK:
-    eval_block(node);
-    return make_number_value(0.0);
+    switch (node->type)
+    {
+    case AST_NUMBER:
+        return number_value(node->number.value);
 
+    case AST_VAR:
+    {
+        const Value *val = get_var_slot(node->var.slot, node->var.name);
+        if (!val)
+        {
+            report_error("[Runtime evaluator] Variable '%s' is undefined", node->var.name);
+            return number_value(0.0);
+        }
+        return *val;
+    }
 
+    case AST_UNARY:
+    {
+        Value operand = eval_value(node->unary_expr.operand);
+        return apply_unary(node->unary_expr.op, get_number(&operand));
+    }
 
+    case AST_BINARY:
+    {
+        Value left = eval_value(node->binary_expr.left);
+        Value right = eval_value(node->binary_expr.right);
+        return apply_binary(node->binary_expr.op, &left, &right);
+    }
 
+    case AST_TERNARY:
+    {
+        Value cond = eval_value(node->ternary_expr.condition);
+        if (cond.type == VAL_NUMBER && cond.number != 0)
+            return eval_value(node->ternary_expr.true_expr);
+        return eval_value(node->ternary_expr.false_expr);
+    }
 
-case AST_WHILE: {
-    while (get_number(eval_expr(node->while_stmt.condition))) {
-        // While loop body should be evaluated as a block, not an expression
-        if (node->while_stmt.body->type == AST_BLOCK) {
-            eval_block(node->while_stmt.body);
-        } else {
-            eval_expr(node->while_stmt.body);
-        }
+    case AST_INDEX:
+    {
+        Value target = eval_value(node->index_expr.array);
+        Value index_val = eval_value(node->index_expr.index);
+        Value element;
+        return element_value(&target, &index_val, &element) ? element : number_value(0.0);
+    }
 
-        if (runtime_has_returned) {
-            break;
+    case AST_CALL:
+    {
+        CallArgs args = {node->call_expr.args, NULL, NULL, node->call_expr.arg_count};
+        return call_value(node, &args);
+    }
+
+    case AST_EXPR_STMT:
+        if (node->expr_stmt.expr)
+            return eval_value(node->expr_stmt.expr);
+        return number_value(0.0);
+
+    default:
+    {
+        // Strings, arrays and statements keep their heap form
+        const Value *val = eval_expr(node);
+        return val ? *val : number_value(0.0);
+    }
+    }
+}
+
+/// @brief eval_value() for a flat AST node
+Value eval_flat_value(const FlatAst *ast, FlatIndex index)
+{
+    if (index == FLAT_NONE)
+    {
+        report_error("[eval_expr] NULL node passed to eval_expr");
+        return number_value(0.0);
+    }
+
+    const FlatNode *node = &ast->nodes[index];
+    switch (node->type)
+    {
+    case AST_NUMBER:
+        return number_value(ast->numbers[node->a]);
+
+    case AST_VAR:
+    {
+        const char *name = ast->names[node->a];
+        const Value *val = get_var_slot((int)node->b, name);
+        if (!val)
+        {
+            report_error("[Runtime evaluator] Variable '%s' is undefined", name);
+            return number_value(0.0);
         }
+        return *val;
+    }
+
+    case AST_UNARY:
+    {
+        Value operand = eval_flat_value(ast, node->a);
+        return apply_unary((Token_Type)node->op, get_number(&operand));
+    }
+
+    case AST_BINARY:
+    {
+        Value left = eval_flat_value(ast, node->a);
+        Value right = eval_flat_value(ast, node->b);
+        return apply_binary((Token_Type)node->op, &left, &right);
+    }
+
+    case AST_TERNARY:
+    {
+        Value cond = eval_flat_value(ast, node->a);
+        if (cond.type == VAL_NUMBER && cond.number != 0)
+            return eval_flat_value(ast, node->b);
+        return eval_flat_value(ast, node->c);
+    }
+
+    case AST_INDEX:
+    {
+        Value target = eval_flat_value(ast, node->a);
+        Value index_val = eval_flat_value(ast, node->b);
+        Value element;
+        return element_value(&target, &index_val, &element) ? element : number_value(0.0);
+    }
+
+    case AST_CALL:
+    {
+        CallArgs args = {NULL, ast, node->c ? &ast->lists[node->b] : NULL, (int)node->c};
+        return call_value(ast->origin[index], &args);
+    }
+
+    case AST_EXPR_STMT:
+        if (node->a != FLAT_NONE)
+            return eval_flat_value(ast, node->a);
+        return number_value(0.0);
+
+    default:
+    {
+        const Value *val = eval_flat_expr(ast, index);
+        return val ? *val : number_value(0.0);
+    }
+    }
+}
+
+/// @brief Evaluates call argument `i` by value, from whichever AST form the call came from
+static Value call_arg_value(const CallArgs *args, int i)
+{
+    if (args->nodes)
+        return eval_value(args->nodes[i]);
+    return eval_flat_value(args->flat, args->indices[i]);
+}
+
+Value *eval_function_call(ASTNode *node)
+{
+    CallArgs args = {node->call_expr.args, NULL, NULL, node->call_expr.arg_count};
+    return call_function(node, &args);
+}
+
+/// @brief A built-in: how many arguments it takes (-1 for a constant, which ignores them) and its
+///        body, either on numbers or on an array or map and the arguments after it
+typedef struct
+{
+    int arity;
+    Value (*fn)(const double *x);
+    Value (*on_value)(Value *array, const Value *args);
+    int changes_array;
+} BuiltinEntry;
+
+// --- Constants ---
+static Value builtin_pi(const double *x) { (void)x; return number_value(M_PI); }
+static Value builtin_tau(const double *x) { (void)x; return number_value(2.0 * M_PI); }
+static Value builtin_eu(const double *x) { (void)x; return number_value(M_E); }
+static Value builtin_deg_to_rad(const double *x) { (void)x; return number_value(M_PI / 180.0); }
+static Value builtin_rad_to_deg(const double *x) { (void)x; return number_value(180.0 / M_PI); }
+
+// --- Basic Math ---
+static Value builtin_abs(const double *x) { return number_value(fabs(x[0])); }
+static Value builtin_mod(const double *x) { return number_value(compat_fmod_impl(x[0], x[1])); }
+static Value builtin_floor(const double *x) { return number_value(floor(x[0])); }
+static Value builtin_ceil(const double *x) { return number_value(ceil(x[0])); }
+static Value builtin_round(const double *x) { return number_value(round(x[0])); }
+static Value builtin_min(const double *x) { return number_value(fmin(x[0], x[1])); }
+static Value builtin_max(const double *x) { return number_value(fmax(x[0], x[1])); }
+static Value builtin_clamp(const double *x) { return number_value(fmin(fmax(x[0], x[1]), x[2])); }
+
+// --- Safe Math Functions ---
+static Value builtin_safe_divide(const double *x)
+{
+    double result = safe_divide(x[0], x[1]);
+    return (isnan(result) || isinf(result)) ? raw_number_value(result) : number_value(result);
+}
+static Value builtin_is_finite(const double *x) { return number_value(is_safe_number(x[0]) ? 1.0 : 0.0); }
+static Value builtin_is_nan(const double *x) { return number_value(isnan(x[0]) ? 1.0 : 0.0); }
+static Value builtin_is_inf(const double *x) { return number_value(isinf(x[0]) ? 1.0 : 0.0); }
+
+// --- Trig ---
+static Value builtin_sin(const double *x) { return number_value(sin(x[0])); }
+static Value builtin_cos(const double *x) { return number_value(cos(x[0])); }
+static Value builtin_tan(const double *x) { return number_value(tan(x[0])); }
+static Value builtin_asin(const double *x) { return number_value(asin(x[0])); }
+static Value builtin_acos(const double *x) { return number_value(acos(x[0])); }
+static Value builtin_atan(const double *x) { return number_value(atan(x[0])); }
+static Value builtin_atan2(const double *x) { return number_value(atan2(x[0], x[1])); }
+static Value builtin_deg(const double *x) { return number_value(x[0] * (180.0 / M_PI)); }
+static Value builtin_rad(const double *x) { return number_value(x[0] * (M_PI / 180.0)); }
+
+// --- Geometry / Vector ---
+static Value builtin_sqrt(const double *x) { return number_value(sqrt(x[0])); }
+static Value builtin_pow(const double *x) { return number_value(compat_pow_impl(x[0], x[1])); }
+static Value builtin_hypot(const double *x) { return number_value(compat_hypot_impl(x[0], x[1])); }
+static Value builtin_lerp(const double *x) { return number_value(x[0] + x[2] * (x[1] - x[0])); }
+static Value builtin_map(const double *x)
+{
+    double v = x[0], in_min = x[1], in_max = x[2], out_min = x[3], out_max = x[4];
+    return number_value(out_min + ((v - in_min) * (out_max - out_min)) / (in_max - in_min));
+}
+static Value builtin_distance(const double *x) { return number_value(compat_hypot_impl(x[2] - x[0], x[3] - x[1])); }
+
+// --- Optional / parser_advanced ---
+static Value builtin_noise(const double *x) { return number_value(sin(x[0])); } // Placeholder
+static Value builtin_sign(const double *x) { return number_value((x[0] > 0) - (x[0] < 0)); }
+static Value builtin_log(const double *x) { return number_value(compat_log_impl(x[0])); }
+static Value builtin_exp(const double *x) { return number_value(compat_exp_impl(x[0])); }
+
+// --- Arrays ---
+
+/// @brief Whether `val`, the first argument of `name`(), is an array; reports it if not
+static int expect_array(const char *name, const Value *val)
+{
+    if (val->type == VAL_ARRAY)
+        return 1;
+    report_error("[Runtime evaluator] %s() expects an array", name);
+    return 0;
+}
+
+/// @brief A temporary array of `count` uninitialised elements: Values for width 0, else packed numbers
+static Value scratch_array(size_t count, unsigned width)
+{
+    Value array = {.type = VAL_ARRAY, .width = width};
+    size_t bytes = width ? sizeof(double) * count * width : sizeof(Value *) * count;
+    void *elements = arena_alloc(&get_runtime()->scratch, bytes ? bytes : 1);
+    if (!elements)
+    {
+        report_error("[Runtime evaluator] scratch allocation failed for array");
+        FATAL_ERROR("[Runtime evaluator] scratch allocation failed for array");
+    }
+    if (width)
+        array.array.numbers = elements;
+    else
+        array.array.items = elements;
+    array.array.count = count;
+    return array;
+}
+
+/// @brief The elements of `array` as `count` numbers, copied into the scratch arena unless already
+///        packed that way; NULL after reporting which built-in got something else
+static const double *array_numbers(const char *name, const Value *array)
+{
+    if (!expect_array(name, array))
+        return NULL;
+    if (array->width == 1)
+        return array->array.numbers;
+
+    double *numbers = array->width ? NULL : scratch_array(array->array.count, 1).array.numbers;
+    for (size_t i = 0; numbers && i < array->array.count; i++)
+    {
+        if (array->array.items[i]->type != VAL_NUMBER)
+            numbers = NULL;
+        else
+            numbers[i] = array->array.items[i]->number;
+    }
+    if (!numbers)
+        report_error("[Runtime evaluator] %s() expects an array of numbers", name);
+    return numbers;
+}
+
+/// @brief Bound `val` of slice(), clamped to 0..count
+static size_t slice_bound(const Value *val, size_t count)
+{
+    if (val->type != VAL_NUMBER)
+    {
+        report_error("[Runtime evaluator] slice() expects number bounds");
+        return 0;
+    }
+    if (!(val->number > 0))
+        return 0;
+    return val->number < (double)count ? (size_t)val->number : count;
+}
+
+static int compare_numbers(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static Value builtin_len(Value *array, const Value *args)
+{
+    (void)args;
+    if (array->type == VAL_STRING)
+        return number_value((double)strlen(array->string));
+    if (array->type == VAL_MAP)
+        return number_value((double)array->map->count);
+    return expect_array("len", array) ? number_value((double)array->array.count) : number_value(0.0);
+}
+
+static Value builtin_push(Value *array, const Value *args)
+{
+    if (!expect_array("push", array))
+        return number_value(0.0);
+    if (!store_item(array, array->array.count, &args[0]))
+    {
+        report_error("[Runtime evaluator] push() needs an array variable to grow");
+        return number_value(0.0);
+    }
+    return number_value((double)array->array.count);
+}
+
+static Value builtin_pop(Value *array, const Value *args)
+{
+    (void)args;
+    if (!expect_array("pop", array))
+        return number_value(0.0);
+    if (!array->refs || array->array.count == 0)
+    {
+        report_error("[Runtime evaluator] pop() needs an array variable with elements");
+        return number_value(0.0);
     }
-    return make_number_value(0.0);
+
+    size_t last = array->array.count - 1;
+    Value item = array_item(array, last);
+    if (item.type != VAL_NUMBER)
+    {
+        // The element outlives its place in the array until the statement ends
+        Value *kept = scratch_own(share_value(&item));
+        if (!kept)
+            return number_value(0.0);
+        item = *kept;
+    }
+    resize_array(array, last);
+    return item;
 }
 
+static Value builtin_slice(Value *array, const Value *args)
+{
+    if (!expect_array("slice", array))
+        return number_value(0.0);
+    size_t start = slice_bound(&args[0], array->array.count);
+    size_t end = slice_bound(&args[1], array->array.count);
+    if (end < start)
+        end = start;
+
+    Value part = scratch_array(end - start, array->width);
+    if (array->width)
+        memcpy(part.array.numbers, array->array.numbers + start * array->width,
+               sizeof(double) * (end - start) * array->width);
+    else
+        memcpy(part.array.items, array->array.items + start, sizeof(Value *) * (end - start));
+    return part;
+}
 
+static Value builtin_sort(Value *array, const Value *args)
+{
+    (void)args;
+    const double *numbers = array_numbers("sort", array);
+    if (!numbers)
+        return number_value(0.0);
+    Value sorted = scratch_array(array->array.count, 1);
+    memcpy(sorted.array.numbers, numbers, sizeof(double) * array->array.count);
+    qsort(sorted.array.numbers, sorted.array.count, sizeof(double), compare_numbers);
+    return sorted;
+}
 
+static Value builtin_reverse(Value *array, const Value *args)
+{
+    (void)args;
+    if (!expect_array("reverse", array))
+        return number_value(0.0);
+    size_t count = array->array.count;
+    unsigned width = array->width;
+    Value reversed = scratch_array(count, width);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (width)
+            memcpy(reversed.array.numbers + i * width, array->array.numbers + (count - 1 - i) * width,
+                   sizeof(double) * width);
+        else
+            reversed.array.items[i] = array->array.items[count - 1 - i];
+    }
+    return reversed;
+}
 
+static Value builtin_sum(Value *array, const Value *args)
+{
+    (void)args;
+    const double *numbers = array_numbers("sum", array);
+    double total = 0.0;
+    for (size_t i = 0; numbers && i < array->array.count; i++)
+        total += numbers[i];
+    return number_value(total);
+}
 
-    case AST_EXPR_STMT:
-        // Expression statements should evaluate their inner expression
-        if (node->expr_stmt.expr) {
-            return eval_expr(node->expr_stmt.expr);
-        }
-        return make_number_value(0.0);
+/// @brief The smallest (`sign` 1) or largest (`sign` -1) number in `array`, for min() and max()
+static Value array_extreme(const char *name, const Value *array, int sign)
+{
+    const double *numbers = array_numbers(name, array);
+    if (!numbers)
+        return number_value(0.0);
+    if (array->array.count == 0)
+    {
+        report_error("[Runtime evaluator] %s() of an empty array", name);
+        return number_value(0.0);
+    }
+    double extreme = numbers[0];
+    for (size_t i = 1; i < array->array.count; i++)
+        extreme = sign > 0 ? fmin(extreme, numbers[i]) : fmax(extreme, numbers[i]);
+    return number_value(extreme);
+}
 
-    default:
+// --- Maps ---
 
-        report_error("[Runtime evaluator] Unsupported expression type: %d (%s)", node->type, get_ast_type_name(node->type));
+static Value builtin_has(Value *map, const Value *args)
+{
+    if (map->type != VAL_MAP || args[0].type != VAL_STRING)
+    {
+        report_error("[Runtime evaluator] has() expects a map and a string key");
+        return number_value(0.0);
+    }
+    return number_value(map_find(map->map, map_key(&args[0], 0)) ? 1.0 : 0.0);
+}
+
+static Value builtin_keys(Value *map, const Value *args)
+{
+    (void)args;
+    if (map->type != VAL_MAP)
+    {
+        report_error("[Runtime evaluator] keys() expects a map");
+        return number_value(0.0);
+    }
 
-        return make_number_value(0.0);
+    // Interned texts outlive the statement, so the strings need no copies
+    InternTable *strings = &get_runtime()->strings;
+    Value keys = scratch_array(map->map->count, 0);
+    for (size_t i = 0; i < map->map->count; i++)
+    {
+        Value key = interned_value(intern_text(strings, map->map->keys[i]));
+        keys.array.items[i] = scratch_value(key);
     }
+    return keys;
 }
 
-Value *eval_function_call(ASTNode *node)
+static Value builtin_array_min(Value *array, const Value *args) { (void)args; return array_extreme("min", array, 1); }
+static Value builtin_array_max(Value *array, const Value *args) { (void)args; return array_extreme("max", array, -1); }
+
+#define KEYWORD(token) [token - TOKEN_FUNC_ABS + 1]
+
+// Indexed by the Builtin number call sites are bound to
+static const BuiltinEntry builtins[BUILTIN_COUNT] = {
+    KEYWORD(TOKEN_FUNC_ABS) = {1, builtin_abs},
+    KEYWORD(TOKEN_FUNC_MOD) = {2, builtin_mod},
+    KEYWORD(TOKEN_FUNC_FLOOR) = {1, builtin_floor},
+    KEYWORD(TOKEN_FUNC_CEIL) = {1, builtin_ceil},
+    KEYWORD(TOKEN_FUNC_ROUND) = {1, builtin_round},
+    KEYWORD(TOKEN_FUNC_MIN) = {2, builtin_min},
+    KEYWORD(TOKEN_FUNC_MAX) = {2, builtin_max},
+    KEYWORD(TOKEN_FUNC_CLAMP) = {3, builtin_clamp},
+    KEYWORD(TOKEN_FUNC_SIN) = {1, builtin_sin},
+    KEYWORD(TOKEN_FUNC_COS) = {1, builtin_cos},
+    KEYWORD(TOKEN_FUNC_TAN) = {1, builtin_tan},
+    KEYWORD(TOKEN_FUNC_ASIN) = {1, builtin_asin},
+    KEYWORD(TOKEN_FUNC_ACOS) = {1, builtin_acos},
+    KEYWORD(TOKEN_FUNC_ATAN) = {1, builtin_atan},
+    KEYWORD(TOKEN_FUNC_ATAN2) = {2, builtin_atan2},
+    KEYWORD(TOKEN_FUNC_DEG) = {1, builtin_deg},
+    KEYWORD(TOKEN_FUNC_RAD) = {1, builtin_rad},
+    KEYWORD(TOKEN_FUNC_SQRT) = {1, builtin_sqrt},
+    KEYWORD(TOKEN_FUNC_POW) = {2, builtin_pow},
+    KEYWORD(TOKEN_FUNC_HYPOT) = {2, builtin_hypot},
+    KEYWORD(TOKEN_FUNC_LERP) = {3, builtin_lerp},
+    KEYWORD(TOKEN_FUNC_MAP) = {5, builtin_map},
+    KEYWORD(TOKEN_FUNC_DISTANCE) = {4, builtin_distance},
+    KEYWORD(TOKEN_FUNC_PI) = {-1, builtin_pi},
+    KEYWORD(TOKEN_FUNC_TAU) = {-1, builtin_tau},
+    KEYWORD(TOKEN_FUNC_EU) = {-1, builtin_eu},
+    KEYWORD(TOKEN_FUNC_DEG_TO_RAD) = {-1, builtin_deg_to_rad},
+    KEYWORD(TOKEN_FUNC_RAD_TO_DEG) = {-1, builtin_rad_to_deg},
+    KEYWORD(TOKEN_FUNC_NOISE) = {1, builtin_noise},
+    KEYWORD(TOKEN_FUNC_SIGN) = {1, builtin_sign},
+    KEYWORD(TOKEN_FUNC_LOG) = {1, builtin_log},
+    KEYWORD(TOKEN_FUNC_EXP) = {1, builtin_exp},
+    [BUILTIN_SAFE_DIVIDE] = {2, builtin_safe_divide},
+    [BUILTIN_IS_FINITE] = {1, builtin_is_finite},
+    [BUILTIN_IS_NAN] = {1, builtin_is_nan},
+    [BUILTIN_IS_INF] = {1, builtin_is_inf},
+    [BUILTIN_LEN] = {1, NULL, builtin_len, 0},
+    [BUILTIN_PUSH] = {2, NULL, builtin_push, 1},
+    [BUILTIN_POP] = {1, NULL, builtin_pop, 1},
+    [BUILTIN_SLICE] = {3, NULL, builtin_slice, 0},
+    [BUILTIN_SORT] = {1, NULL, builtin_sort, 0},
+    [BUILTIN_REVERSE] = {1, NULL, builtin_reverse, 0},
+    [BUILTIN_SUM] = {1, NULL, builtin_sum, 0},
+    [BUILTIN_ARRAY_MIN] = {1, NULL, builtin_array_min, 0},
+    [BUILTIN_ARRAY_MAX] = {1, NULL, builtin_array_max, 0},
+    [BUILTIN_HAS] = {2, NULL, builtin_has, 0},
+    [BUILTIN_KEYS] = {1, NULL, builtin_keys, 0},
+};
+
+#undef KEYWORD
+
+int bind_builtin(int token, const char *name, int argc)
 {
-    const char *name = node->call_expr.name;
-    int argc = node->call_expr.arg_count;
-    ASTNode **args = node->call_expr.args;
-
-// Helper to extract double
-#define SCALAR(i) get_scalar(args[i])
-
-    // --- Constants ---
-    if (strcmp(name, "PI") == 0)
-        return make_number_value(M_PI);
-    if (strcmp(name, "TAU") == 0)
-        return make_number_value(2.0 * M_PI);
-    if (strcmp(name, "EU") == 0)
-        return make_number_value(M_E);
-    if (strcmp(name, "DEG_TO_RAD") == 0)
-        return make_number_value(M_PI / 180.0);
-    if (strcmp(name, "RAD_TO_DEG") == 0)
-        return make_number_value(180.0 / M_PI);
-
-    // --- Basic Math ---
-    if (strcmp(name, "abs") == 0 && argc == 1)
-        return make_number_value(fabs(SCALAR(0)));
-    if (strcmp(name, "mod") == 0 && argc == 2)
-        return make_number_value(compat_fmod_impl(SCALAR(0), SCALAR(1)));
-    if (strcmp(name, "floor") == 0 && argc == 1)
-        return make_number_value(floor(SCALAR(0)));
-    if (strcmp(name, "ceil") == 0 && argc == 1)
-        return make_number_value(ceil(SCALAR(0)));
-    if (strcmp(name, "round") == 0 && argc == 1)
-        return make_number_value(round(SCALAR(0)));
-    if (strcmp(name, "min") == 0 && argc == 2)
-        return make_number_value(fmin(SCALAR(0), SCALAR(1)));
-    if (strcmp(name, "max") == 0 && argc == 2)
-        return make_number_value(fmax(SCALAR(0), SCALAR(1)));
-    
-    // --- Safe Math Functions ---
-    if (strcmp(name, "safe_divide") == 0 && argc == 2) {
-        double result = safe_divide(SCALAR(0), SCALAR(1));
-        return (isnan(result) || isinf(result)) ? make_raw_number_value(result) : make_number_value(result);
+    // The safe-math, array and map helpers are plain identifiers, so they can still name variables
+    static const char *const named[] = {"safe_divide", "is_finite", "is_nan", "is_inf",
+                                        "len", "push", "pop", "slice", "sort", "reverse", "sum",
+                                        "has", "keys"};
+
+    int builtin = BUILTIN_NONE;
+    if ((token == TOKEN_FUNC_MIN || token == TOKEN_FUNC_MAX) && argc == 1)
+    {
+        builtin = token == TOKEN_FUNC_MIN ? BUILTIN_ARRAY_MIN : BUILTIN_ARRAY_MAX;
+    }
+    else if (token >= TOKEN_FUNC_ABS && token <= TOKEN_FUNC_EXP)
+    {
+        builtin = token - TOKEN_FUNC_ABS + 1;
     }
-    if (strcmp(name, "is_finite") == 0 && argc == 1)
-        return make_number_value(is_safe_number(SCALAR(0)) ? 1.0 : 0.0);
-    if (strcmp(name, "is_nan") == 0 && argc == 1)
-        return make_number_value(isnan(SCALAR(0)) ? 1.0 : 0.0);
-    if (strcmp(name, "is_inf") == 0 && argc == 1)
-        return make_number_value(isinf(SCALAR(0)) ? 1.0 : 0.0);
-    if (strcmp(name, "clamp") == 0 && argc == 3)
+    else if (name)
     {
-        double v = SCALAR(0);
-        double lo = SCALAR(1);
-        double hi = SCALAR(2);
-        return make_number_value(fmin(fmax(v, lo), hi));
+        for (int i = 0; i < (int)(sizeof(named) / sizeof(named[0])); i++)
+        {
+            if (strcmp(name, named[i]) == 0)
+                builtin = BUILTIN_SAFE_DIVIDE + i;
+        }
     }
 
-    // --- Trig ---
-    if (strcmp(name, "tan") == 0 && argc == 1)
-        return make_number_value(tan(SCALAR(0)));
-    if (strcmp(name, "asin") == 0 && argc == 1)
-        return make_number_value(asin(SCALAR(0)));
-    if (strcmp(name, "acos") == 0 && argc == 1)
-        return make_number_value(acos(SCALAR(0)));
-    if (strcmp(name, "atan") == 0 && argc == 1)
-        return make_number_value(atan(SCALAR(0)));
-    if (strcmp(name, "atan2") == 0 && argc == 2)
-        return make_number_value(atan2(SCALAR(0), SCALAR(1)));
+    // A call with the wrong number of arguments is left to the user functions, which report it
+    if (builtin == BUILTIN_NONE || (!builtins[builtin].fn && !builtins[builtin].on_value))
+        return BUILTIN_NONE;
+    int arity = builtins[builtin].arity;
+    return arity < 0 || arity == argc ? builtin : BUILTIN_NONE;
+}
+
+int builtin_is_pure(int builtin)
+{
+    // The number entries map numbers to a number and touch nothing else; the array ones
+    // may report errors for what they are given, so they are neither folded nor cached
+    return builtin > BUILTIN_NONE && builtin < BUILTIN_COUNT && builtins[builtin].fn != NULL;
+}
+
+int builtin_changes_array(int builtin)
+{
+    return builtin > BUILTIN_NONE && builtin < BUILTIN_COUNT && builtins[builtin].changes_array;
+}
 
-    if (strcmp(name, "sin") == 0 && argc == 1)
-        return make_number_value(sin(SCALAR(0)));
-    if (strcmp(name, "cos") == 0 && argc == 1)
-        return make_number_value(cos(SCALAR(0)));
-    // Add tan, atan, etc. as needed...
+int builtin_arg_count(int builtin)
+{
+    int arity = builtins[builtin].arity;
+    return arity < 0 ? 0 : arity;
+}
 
-    // --- Geometry / Vector ---
-    if (strcmp(name, "sqrt") == 0 && argc == 1)
-        return make_number_value(sqrt(SCALAR(0)));
-    if (strcmp(name, "pow") == 0 && argc == 2)
-        return make_number_value(compat_pow_impl(SCALAR(0), SCALAR(1)));
-    if (strcmp(name, "hypot") == 0 && argc == 2)
-        return make_number_value(compat_hypot_impl(SCALAR(0), SCALAR(1)));
-    if (strcmp(name, "lerp") == 0 && argc == 3)
+Value call_builtin(int builtin, const Value *args)
+{
+    if (builtins[builtin].on_value)
     {
-        double a = SCALAR(0), b = SCALAR(1), t = SCALAR(2);
-        return make_number_value(a + t * (b - a));
+        // A copy owning nothing, so push() and pop() report it rather than change the caller's array
+        Value array = args[0];
+        array.refs = NULL;
+        return builtins[builtin].on_value(&array, args + 1);
     }
-    if (strcmp(name, "map") == 0 && argc == 5)
+
+    double x[BUILTIN_MAX_ARGS];
+    int count = builtin_arg_count(builtin);
+    for (int i = 0; i < count; i++)
     {
-        double v = SCALAR(0), in_min = SCALAR(1), in_max = SCALAR(2);
-        double out_min = SCALAR(3), out_max = SCALAR(4);
-        return make_number_value(out_min + ((v - in_min) * (out_max - out_min)) / (in_max - in_min));
+        // Numbers only, like get_scalar()
+        x[i] = args[i].type == VAL_NUMBER ? args[i].number : 0.0;
+        if (args[i].type != VAL_NUMBER)
+            report_error("[Runtime evaluator] get_scalar() expected number");
     }
-    if (strcmp(name, "distance") == 0 && argc == 4)
+    return builtins[builtin].fn(x);
+}
+
+/// @brief Runs bound built-in `builtin`, evaluating all of its arguments left to right first
+static Value call_builtin_args(int builtin, const CallArgs *args)
+{
+    Value values[BUILTIN_MAX_ARGS];
+    int count = builtin_arg_count(builtin);
+    if (builtins[builtin].changes_array)
     {
-        double x1 = SCALAR(0), y1 = SCALAR(1), x2 = SCALAR(2), y2 = SCALAR(3);
-        return make_number_value(compat_hypot_impl(x2 - x1, y2 - y1));
+        // The array is looked up last: evaluating the other arguments may move the variables it is in
+        for (int i = 1; i < count; i++)
+            values[i] = call_arg_value(args, i);
+        Value *array = eval_writable(args->nodes ? args->nodes[0] : args->flat->origin[args->indices[0]]);
+        return array ? builtins[builtin].on_value(array, values + 1) : number_value(0.0);
     }
 
-    // --- Optional / parser_advanced ---
-    if (strcmp(name, "sign") == 0 && argc == 1)
+    for (int i = 0; i < count; i++)
+        values[i] = call_arg_value(args, i);
+    return call_builtin(builtin, values);
+}
+
+/// @brief Slot a call site looks its user function up under
+static int call_slot(const ASTNode *call)
+{
+    return call->call_expr.slot ? call->call_expr.slot : variable_slot(call->call_expr.name);
+}
+
+/// @brief Slot parameter `i` of `func` is bound under
+static int param_slot(const ASTNode *func, int i)
+{
+    int slot = func->function_stmt.param_slots ? func->function_stmt.param_slots[i] : 0;
+    return reference_slot(slot, func->function_stmt.params[i]);
+}
+
+/// @brief Whether `expr` calls `func` itself
+static int is_self_call(const ASTNode *expr, const ASTNode *func)
+{
+    return expr->type == AST_CALL && expr->call_expr.builtin == BUILTIN_NONE &&
+           find_function(call_slot(expr)) == func;
+}
+
+/// @brief Whether the variables of frame `ctx` are all parameters, which a new call to the same
+/// function would shadow anyway; any other local would stay visible to it
+static int frame_holds_only_params(const FunctionContext *ctx)
+{
+    const Runtime *rt = get_runtime();
+    const ASTNode *func = ctx->function_node;
+    for (int v = rt->scope_bases[ctx->scope_level]; v < rt->var_count; v++)
     {
-        double x = SCALAR(0);
-        return make_number_value((x > 0) - (x < 0));
+        int i = 0;
+        while (i < func->function_stmt.param_count && rt->variables[v].slot != param_slot(func, i))
+            i++;
+        if (i == func->function_stmt.param_count)
+            return 0;
     }
+    return 1;
+}
+
+/// @brief Runs `return call` without nesting a frame when `call` calls the running function in
+/// tail position: evaluates the arguments as the callee would, leaves them in the stack's
+/// tail_args and unwinds the body for call_user_function() to run it again. Returns 0, having
+/// done nothing, when the call has to nest. The nested call's result would be returned as is,
+/// so the only call that must nest is one that could see a local of this frame.
+static int tail_call(ASTNode *call)
+{
+    Runtime *rt = get_runtime();
+    FunctionContext *ctx = function_stack_peek();
+    if (!ctx || !is_self_call(call, ctx->function_node) || !frame_holds_only_params(ctx))
+        return 0;
 
-    if (strcmp(name, "deg") == 0 && argc == 1)
+    ASTNode *func = ctx->function_node;
+    if (ctx->tail_calls >= MAX_TAIL_CALLS)
     {
-        return make_number_value(SCALAR(0) * (180.0 / M_PI));
+        report_error("Recursion limit exceeded (%d calls). Possible infinite recursion in function '%s'",
+                     MAX_TAIL_CALLS, ctx->function_name);
+        free_value(runtime_return_value);
+        runtime_return_value = make_number_value(0.0);
+        return 1;
     }
+    ctx->tail_calls++;
 
-    if (strcmp(name, "rad") == 0 && argc == 1)
+    FunctionStack *stack = &rt->function_stack;
+    int param_count = func->function_stmt.param_count;
+    if (param_count > stack->tail_arg_capacity)
     {
-        return make_number_value(SCALAR(0) * (M_PI / 180.0));
+        Value **tail_args = realloc(stack->tail_args, sizeof(Value *) * param_count);
+        if (!tail_args)
+        {
+            report_error("[Runtime] Failed to allocate the arguments of a tail call to '%s'", ctx->function_name);
+            FATAL_ERROR("[Runtime] Failed to allocate the arguments of a tail call to '%s'", ctx->function_name);
+        }
+        stack->tail_args = tail_args;
+        stack->tail_arg_capacity = param_count;
     }
 
-    if (strcmp(name, "log") == 0 && argc == 1)
+    // Each argument sees the parameters bound before it, as in a nested call
+    CallArgs args = {call->call_expr.args, NULL, NULL, call->call_expr.arg_count};
+    enter_scope();
+    int base = rt->var_count;
+    for (int i = 0; i < param_count; i++)
     {
-        return make_number_value(compat_log_impl(SCALAR(0)));
+        Value arg_val = i < args.count ? call_arg_value(&args, i) : number_value(0.0);
+        declare_var_slot(param_slot(func, i), func->function_stmt.params[i], &arg_val);
     }
-
-    if (strcmp(name, "exp") == 0 && argc == 1)
-        return make_number_value(compat_exp_impl(SCALAR(0)));
-    if (strcmp(name, "noise") == 0 && argc == 1)
+    for (int i = 0; i < param_count; i++)
     {
-        return make_number_value(sin(SCALAR(0))); // Placeholder
+        stack->tail_args[i] = rt->variables[base + i].val;
+        rt->variables[base + i].val = NULL;
     }
+    exit_scope();
+
+    // Calls made by the arguments may have moved the frames
+    function_stack_peek()->tail_pending = 1;
+    runtime_has_returned = 1;
+    free_value(runtime_return_value);
+    runtime_return_value = NULL;
+    return 1;
+}
+
+/// @brief Runs user-defined function `name`, registered under `slot`, in a new frame and scope
+static Value *call_user_function(int slot, const char *name, const CallArgs *args)
+{
+    int argc = args->count;
 
-    // --- User-defined function ---
-    ASTNode *func = find_function(name);
+    ASTNode *func = find_function(slot);
     if (!func)
     {
         report_error("[Runtime] Function not found: %s", name);
-        return make_number_value(0.0);
+        return scratch_number(0.0);
     }
 
     // Check recursion depth before entering function scope
@@ -1017,9 +2357,8 @@ Value *eval_function_call(ASTNode *node)
         report_error("Recursion limit exceeded (%d calls). Possible infinite recursion in function '%s'", 
                      rt->max_recursion_depth, name);
         
-        // Perform proper cleanup when recursion limit is exceeded
-        // Reset recursion depth to prevent further issues
-        rt->recursion_depth = 0;
+        // Perform proper cleanup when recursion limit is exceeded; the depth
+        // goes back to 0 as the frames already running unwind
         
         // Clear any pending return state to ensure clean state
         runtime_has_returned = 0;
@@ -1029,14 +2368,15 @@ Value *eval_function_call(ASTNode *node)
         }
         
         // Return safe default value instead of crashing
-        return make_number_value(0.0);
+        return scratch_number(0.0);
     }
 
     // Increment recursion depth when entering function execution
     rt->recursion_depth++;
 
-    // ✅ Clear return state before executing function
+    // ✅ Clear return state before executing function; the last call's result was already handed out
     runtime_has_returned = 0;
+    free_value(runtime_return_value);
     runtime_return_value = NULL;
 
     enter_scope();
@@ -1046,82 +2386,58 @@ Value *eval_function_call(ASTNode *node)
         // Function stack push failed, clean up and return
         rt->recursion_depth--;
         exit_scope();
-        return make_number_value(0.0);
+        return scratch_number(0.0);
     }
+    // Calls from the body may grow the stack, so the frame is kept by index
+    int frame = rt->function_stack.count - 1;
 
     int param_count = func->function_stmt.param_count;
     for (int i = 0; i < param_count; i++)
     {
-        Value *arg_val = make_number_value(0.0);
-if (i < argc)
-    arg_val = eval_expr(args[i]);
-
-if (!arg_val) {
-    fprintf(stderr, "🚨 ERROR: Failed to evaluate argument %d for function '%s'\n", i, name);
-    // Proper cleanup before fatal error
-    rt->recursion_depth--;
-    function_stack_pop();
-    exit_scope();
-    
-    // Clear return state to prevent stale values
-    runtime_has_returned = 0;
-    if (runtime_return_value) {
-        free_value(runtime_return_value);
-        runtime_return_value = NULL;
-    }
-    
-    FATAL_ERROR("🚨 ERROR: Failed to evaluate argument %d for function '%s'", i, name);
-}
-
-
-
-        declare_var(func->function_stmt.params[i], arg_val);
+        // Missing arguments default to 0
+        Value arg_val = i < argc ? call_arg_value(args, i) : number_value(0.0);
+        declare_var_slot(param_slot(func, i), func->function_stmt.params[i], &arg_val);
     }
 
 ASTNode *body = func->function_stmt.body;
 
-// ⚠️ Fix: Use emit_gcode instead of eval_expr for statements
-for (int i = 0; i < body->block.count; i++) {
-    ASTNode *stmt = body->block.statements[i];
+for (;;) {
+    // ⚠️ Fix: Use emit_gcode instead of eval_expr for statements
+    for (int i = 0; i < body->block.count; i++) {
+        ASTNode *stmt = body->block.statements[i];
 
-    // ✅ Use emit_gcode for statements that need proper G-code emission
-    // Use eval_expr for everything else to maintain proper execution semantics
-    if (stmt->type == AST_GCODE || stmt->type == AST_NOTE || stmt->type == AST_FOR) {
-        emit_gcode(stmt);
-    } else {
-        // Handle expressions, assignments, conditionals, and returns through eval_expr
-        eval_expr(stmt);
+        // ✅ Use emit_gcode for statements that need proper G-code emission
+        // Use eval_expr for everything else to maintain proper execution semantics
+        if (stmt->type == AST_GCODE || stmt->type == AST_NOTE || stmt->type == AST_FOR) {
+            emit_gcode(stmt);
+        } else {
+            // Handle expressions, assignments, conditionals, and returns through eval_expr
+            ScratchMark mark = scratch_mark();
+            eval_expr(stmt);
+            scratch_release(mark);
+        }
+
+        if (runtime_has_returned)
+            break;
     }
 
-    if (runtime_has_returned)
+    FunctionContext *ctx = &rt->function_stack.contexts[frame];
+    if (!ctx->tail_pending)
         break;
-}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
 
+    // A tail call to this function: bind its arguments in place of the parameters and run again
+    ctx->tail_pending = 0;
+    exit_scope();
+    enter_scope();
+    for (int i = 0; i < param_count; i++)
+    {
+        Value *arg_val = rt->function_stack.tail_args[i];
+        declare_var_slot(param_slot(func, i), func->function_stmt.params[i], arg_val);
+        free_value(arg_val);
+        rt->function_stack.tail_args[i] = NULL;
+    }
+    runtime_has_returned = 0;
+}
     // Pop function context before exiting scope
     function_stack_pop();
     
@@ -1130,26 +2446,42 @@ for (int i = 0; i < body->block.count; i++) {
     // Decrement recursion depth when function returns normally
     rt->recursion_depth--;
 
-    // ✅ Return the result if set, or 0 otherwise
-    if (runtime_return_value)
-        return copy_value(runtime_return_value);
-    else
-        return make_number_value(0.0);
+    // ✅ Return the result if set, or 0 otherwise; the caller's statement now owns it.
+    // The return ended this body only, so the caller goes on with its next statement
+    Value *result = runtime_return_value ? runtime_return_value : make_number_value(0.0);
+    runtime_return_value = NULL;
+    runtime_has_returned = 0;
+    return scratch_own(result);
+}
 
-#undef SCALAR
+Value *call_function(ASTNode *call, const CallArgs *args)
+{
+    if (call->call_expr.builtin != BUILTIN_NONE)
+        return scratch_value(call_builtin_args(call->call_expr.builtin, args));
+    return call_user_function(call_slot(call), call->call_expr.name, args);
 }
 
-int var_exists_in_current_scope(const char *name)
+/// @brief call_function() by value
+static Value call_value(ASTNode *call, const CallArgs *args)
+{
+    if (call->call_expr.builtin != BUILTIN_NONE)
+        return call_builtin_args(call->call_expr.builtin, args);
+
+    const Value *returned = call_user_function(call_slot(call), call->call_expr.name, args);
+    return returned ? *returned : number_value(0.0);
+}
+
+/// @brief Whether the innermost binding of `slot` belongs to the current scope
+static int slot_in_current_scope(int slot)
 {
     const Runtime *rt = get_runtime();
-    for (int i = rt->var_count - 1; i >= 0; --i)
-    {
-        if (rt->variables[i].name && strcmp(rt->variables[i].name, name) == 0)
-        {
-            return rt->variables[i].scope_level == rt->current_scope_level;
-        }
-    }
-    return 0;
+    int i = binding_index(rt, slot);
+    return i >= 0 && rt->variables[i].scope_level == rt->current_scope_level;
+}
+
+int var_exists_in_current_scope(const char *name)
+{
+    return slot_in_current_scope(variable_slot(name));
 }
 
 
@@ -1171,25 +2503,24 @@ void eval_block(ASTNode *block)
     for (int i = 0; i < block->block.count; ++i)
     {
         ASTNode *stmt = block->block.statements[i];
+        ScratchMark mark = scratch_mark();
 
         switch (stmt->type)
         {
         case AST_LET:
         {
-            Value *val = eval_expr(stmt->let_stmt.expr);
-            if (!val) {
-                report_error("[Runtime evaluator] Failed to evaluate expression in LET at block index %d", i);
-                break;
-            }
+            Value value = eval_value(stmt->let_stmt.expr);
+            Value *val = &value;
 
             const Runtime *rt = get_runtime();
-            if (!var_exists_in_current_scope(stmt->let_stmt.name))
+            int slot = reference_slot(stmt->let_stmt.slot, stmt->let_stmt.name);
+            if (!slot_in_current_scope(slot))
             {
                 printf("[Runtime evaluator] DECLARE '%s' = %.4f (scope level %d)\n",
                        stmt->let_stmt.name,
                        val->type == VAL_NUMBER ? val->number : -9999,
                        rt->current_scope_level);
-                declare_var(stmt->let_stmt.name, val);
+                declare_var_slot(slot, stmt->let_stmt.name, val);
             }
             else
             {
@@ -1197,7 +2528,7 @@ void eval_block(ASTNode *block)
                        stmt->let_stmt.name,
                        val->type == VAL_NUMBER ? val->number : -9999,
                        rt->current_scope_level);
-                set_var(stmt->let_stmt.name, val);
+                set_var_slot(slot, stmt->let_stmt.name, val);
             }
             break;
         }
@@ -1214,6 +2545,10 @@ void eval_block(ASTNode *block)
             eval_if(stmt);
             break;
 
+        case AST_MATCH:
+            eval_match(stmt);
+            break;
+
         case AST_FOR:
             eval_for(stmt);
             break;
@@ -1263,6 +2598,7 @@ void eval_block(ASTNode *block)
                          stmt->type, get_ast_type_name(stmt->type), i);
             break;
         }
+        scratch_release(mark);
 
         // ✅ Short-circuit if return was hit
         if (runtime_has_returned) {
@@ -1299,6 +2635,64 @@ void eval_if(ASTNode *stmt)
     }
 }
 
+int match_arm(const ASTNode *match, const Value *subject)
+{
+    if (subject->type == VAL_NUMBER)
+    {
+        double x = subject->number;
+        if (match->match_stmt.dense)
+        {
+            double offset = x - match->match_stmt.dense_first;
+            if (!(offset >= 0 && offset < match->match_stmt.dense_count) || offset != (double)(int)offset)
+                return -1;
+            return match->match_stmt.dense[(int)offset];
+        }
+
+        // Binary search of the sorted labels
+        int low = 0, high = match->match_stmt.number_count - 1;
+        while (low <= high)
+        {
+            int mid = low + (high - low) / 2;
+            double label = match->match_stmt.numbers[mid];
+            if (label == x)
+                return match->match_stmt.number_arms[mid];
+            if (label < x)
+                low = mid + 1;
+            else
+                high = mid - 1;
+        }
+        return -1;
+    }
+
+    if (subject->type == VAL_STRING && subject->string && match->match_stmt.string_slots)
+    {
+        // A string nothing interned cannot equal a label
+        int id = map_key(subject, 0);
+        if (id < 0)
+            return -1;
+        unsigned int mask = (unsigned int)match->match_stmt.string_slots - 1;
+        unsigned int slot = ((unsigned int)id * 2654435761u) & mask;
+        while (match->match_stmt.string_ids[slot] >= 0)
+        {
+            if (match->match_stmt.string_ids[slot] == id)
+                return match->match_stmt.string_arms[slot];
+            slot = (slot + 1) & mask;
+        }
+    }
+    return -1;
+}
+
+/// @brief Runs the arm the subject selects, or the else block when no label equals it
+static void eval_match(ASTNode *stmt)
+{
+    Value subject = eval_value(stmt->match_stmt.subject);
+    int arm = match_arm(stmt, &subject);
+    if (arm >= 0)
+        eval_block(stmt->match_stmt.arms[arm]);
+    else if (stmt->match_stmt.else_branch)
+        eval_block(stmt->match_stmt.else_branch);
+}
+
 void eval_for(ASTNode *stmt)
 {
     // Handle string iteration: for char in string_var or for (char, index) in string_var
@@ -1317,13 +2711,14 @@ void eval_for(ASTNode *stmt)
         
         // Iterate through each character
         for (int i = 0; str[i] != '\0'; i++) {
-            // Create a single-character string for the loop variable
-            char char_str[2] = {str[i], '\0'};
-            set_var(stmt->for_stmt.var, make_string_value(char_str));
+            // One-character strings come from a static table, so this allocates nothing
+            Value char_val = char_value(str[i]);
+            set_var_slot(stmt->for_stmt.var_slot, stmt->for_stmt.var, &char_val);
             
             // If index variable is specified, set it too
             if (stmt->for_stmt.index_var) {
-                set_var(stmt->for_stmt.index_var, make_number_value((double)i));
+                Value index_val = number_value((double)i);
+                set_var_slot(stmt->for_stmt.index_slot, stmt->for_stmt.index_var, &index_val);
             }
             
             eval_block(stmt->for_stmt.body);
@@ -1337,20 +2732,19 @@ void eval_for(ASTNode *stmt)
     }
 
     // Traditional numeric for loop: for i = 1..10
-    const Value *v_from = eval_expr(stmt->for_stmt.from);
-    const Value *v_to = eval_expr(stmt->for_stmt.to);
-    const Value *v_step = stmt->for_stmt.step ? eval_expr(stmt->for_stmt.step) : make_number_value(1.0);
+    Value v_from = eval_value(stmt->for_stmt.from);
+    Value v_to = eval_value(stmt->for_stmt.to);
+    Value v_step = stmt->for_stmt.step ? eval_value(stmt->for_stmt.step) : number_value(1.0);
 
-    if (!v_from || !v_to || !v_step ||
-        v_from->type != VAL_NUMBER || v_to->type != VAL_NUMBER || v_step->type != VAL_NUMBER)
+    if (v_from.type != VAL_NUMBER || v_to.type != VAL_NUMBER || v_step.type != VAL_NUMBER)
     {
         //printf("[Runtime evaluator] ERROR: FOR loop expects numeric values\n");
         return;
     }
 
-    double from = v_from->number;
-    double to = v_to->number;
-    double step = v_step->number;
+    double from = v_from.number;
+    double to = v_to.number;
+    double step = v_step.number;
     int exclusive = stmt->for_stmt.exclusive;
 
     double end = exclusive ? to : (step > 0 ? to + 1e-9 : to - 1e-9);
@@ -1359,7 +2753,8 @@ void eval_for(ASTNode *stmt)
          (step > 0 && i < end) || (step < 0 && i > end);
          i += step)
     {
-        set_var(stmt->for_stmt.var, make_number_value(i));
+        Value counter = number_value(i);
+        set_var_slot(stmt->for_stmt.var_slot, stmt->for_stmt.var, &counter);
         eval_block(stmt->for_stmt.body);
         
         // Check if return was encountered in the loop body
@@ -1458,59 +2853,117 @@ void eval_while(ASTNode *stmt)
 
 
 
-void declare_var(const char *name, Value *val)
+/// @brief Makes room in the binding table for `slot`
+static int reserve_binding(Runtime *rt, int slot)
+{
+    if (slot < rt->binding_capacity)
+        return 1;
+
+    int capacity = rt->binding_capacity ? rt->binding_capacity : 256;
+    while (capacity <= slot)
+        capacity *= 2;
+
+    int *bindings = realloc(rt->bindings, sizeof(int) * capacity);
+    if (!bindings)
+        return 0;
+    memset(bindings + rt->binding_capacity, 0, sizeof(int) * (capacity - rt->binding_capacity));
+    rt->bindings = bindings;
+    rt->binding_capacity = capacity;
+    return 1;
+}
+
+/// @brief Makes room on the variable stack for one more variable
+static int reserve_variable(Runtime *rt)
+{
+    if (rt->var_count < rt->var_capacity)
+        return 1;
+
+    int capacity = rt->var_capacity ? rt->var_capacity * 2 : 64;
+    Variable *variables = realloc(rt->variables, sizeof(Variable) * capacity);
+    if (!variables)
+        return 0;
+    rt->variables = variables;
+    rt->var_capacity = capacity;
+    return 1;
+}
+
+void declare_var_slot(int slot, const char *name, Value *val)
 {
     Runtime *rt = get_runtime();
+    slot = reference_slot(slot, name);
 
     // Prevent duplicate variable names in the same scope
-    for (int i = rt->var_count - 1; i >= 0; --i) {
-        if (rt->variables[i].scope_level != rt->current_scope_level)
-            break;
-        if (rt->variables[i].name && strcmp(rt->variables[i].name, name) == 0) {
-            report_error("[declare_var] ERROR: variable '%s' already declared in current scope.", name);
-            FATAL_ERROR("[declare_var] ERROR: variable '%s' already declared in current scope.", name);
-        }
+    if (slot_in_current_scope(slot)) {
+        report_error("[declare_var] ERROR: variable '%s' already declared in current scope.", name);
+        FATAL_ERROR("[declare_var] ERROR: variable '%s' already declared in current scope.", name);
     }
-    if (rt->var_count >= MAX_VARIABLES)
+    if (slot <= 0 || !reserve_variable(rt) || !reserve_binding(rt, slot))
     {
-        report_error("[declare_var] ERROR: variable limit reached.");
-        FATAL_ERROR("[declare_var] ERROR: variable limit reached.");
+        report_error("[declare_var] ERROR: failed to bind '%s'", name);
+        FATAL_ERROR("[declare_var] ERROR: failed to bind '%s'", name);
     }
-    rt->variables[rt->var_count].name = strdup(name);
-    // Always copy the value for safety
-    Value *copy = copy_value(val);
+    // Strings and arrays the caller owns are shared, not copied
+    Value *copy = share_value(val);
     if (!copy) {
         report_error("[declare_var] ERROR: failed to copy value for '%s'", name);
         FATAL_ERROR("[declare_var] ERROR: failed to copy value for '%s'", name);
     }
-    rt->variables[rt->var_count].val = copy;
-    rt->variables[rt->var_count].scope_level = rt->current_scope_level;
-    rt->var_count++;
+
+    Variable *var = &rt->variables[rt->var_count];
+    var->name = intern_text(&rt->strings, slot - 1);
+    var->slot = slot;
+    var->shadowed = rt->bindings[slot];
+    var->val = copy;
+    var->scope_level = rt->current_scope_level;
+    rt->bindings[slot] = ++rt->var_count;
     
     // Check for configuration variables
     check_config_variable(name, val);
 }
 
+void declare_var(const char *name, Value *val)
+{
+    declare_var_slot(0, name, val);
+}
+
 
 
 
 // Check if variable exists
 int var_exists(const char *name)
 {
-    const Runtime *rt = get_runtime();
-    for (int i = 0; i < rt->var_count; i++)
-    {
-        if (rt->variables[i].name && strcmp(rt->variables[i].name, name) == 0)
-        {
-            return 1;
-        }
-    }
-    return 0;
+    return binding_index(get_runtime(), variable_slot(name)) >= 0;
 }
 
 void register_function(ASTNode *node)
 {
     Runtime *rt = get_runtime();
+    rt->function_generation++;
+
+    // Functions are keyed by the slot of their name, found through the intern table's hash
+    int slot = variable_slot(node->function_stmt.name);
+    if (slot >= rt->function_slot_capacity)
+    {
+        int capacity = rt->function_slot_capacity ? rt->function_slot_capacity : 64;
+        while (capacity <= slot)
+            capacity *= 2;
+        int *slots = realloc(rt->function_slots, sizeof(int) * capacity);
+        if (!slots)
+            FATAL_ERROR("[Runtime] Out of memory registering function '%s'", node->function_stmt.name);
+        memset(slots + rt->function_slot_capacity, 0, sizeof(int) * (capacity - rt->function_slot_capacity));
+        rt->function_slots = slots;
+        rt->function_slot_capacity = capacity;
+    }
+
+    // Redefinitions replace the entry so a stale node from an earlier AST is never called
+    int entry = rt->function_slots[slot] - 1;
+    if (entry >= 0)
+    {
+        rt->function_table[entry].name = node->function_stmt.name;
+        rt->function_table[entry].node = node;
+        return;
+    }
+
     if (rt->function_count >= MAX_FUNCTIONS)
     {
         report_error("[Runtime] Too many functions");
@@ -1518,43 +2971,57 @@ void register_function(ASTNode *node)
     }
     rt->function_table[rt->function_count].name = node->function_stmt.name;
     rt->function_table[rt->function_count].node = node;
-    rt->function_count++;
+    rt->function_slots[slot] = ++rt->function_count;
 }
 
-static ASTNode *find_function(const char *name)
+static ASTNode *find_function(int slot)
 {
     const Runtime *rt = get_runtime();
-    for (int i = 0; i < rt->function_count; i++)
-    {
-        if (strcmp(rt->function_table[i].name, name) == 0)
-            return rt->function_table[i].node;
-    }
-    return NULL;
+    if (slot <= 0 || slot >= rt->function_slot_capacity || !rt->function_slots[slot])
+        return NULL;
+    return rt->function_table[rt->function_slots[slot] - 1].node;
 }
 
 // Function context stack management functions
 void function_stack_init(void)
 {
     Runtime *rt = get_runtime();
+    // The frames themselves stay allocated for the next call
     rt->function_stack.count = 0;
-    memset(rt->function_stack.contexts, 0, sizeof(rt->function_stack.contexts));
+}
+
+void function_stack_free(void)
+{
+    FunctionStack *stack = &get_runtime()->function_stack;
+    free(stack->contexts);
+    free(stack->tail_args);
+    memset(stack, 0, sizeof(*stack));
 }
 
 int function_stack_push(const char *function_name, ASTNode *function_node)
 {
     Runtime *rt = get_runtime();
-    
-    if (rt->function_stack.count >= MAX_FUNCTION_STACK_DEPTH) {
-        report_error("[Function Stack] Maximum function call depth exceeded (%d)", MAX_FUNCTION_STACK_DEPTH);
-        return 0; // Failure
+    FunctionStack *stack = &rt->function_stack;
+
+    if (stack->count >= stack->capacity) {
+        int capacity = stack->capacity ? stack->capacity * 2 : 64;
+        FunctionContext *contexts = realloc(stack->contexts, sizeof(FunctionContext) * capacity);
+        if (!contexts) {
+            report_error("[Function Stack] Failed to grow the call stack past %d frames", stack->count);
+            return 0; // Failure
+        }
+        stack->contexts = contexts;
+        stack->capacity = capacity;
     }
-    
-    FunctionContext *ctx = &rt->function_stack.contexts[rt->function_stack.count];
-    ctx->function_name = strdup(function_name);  // Make a copy of the name
+
+    FunctionContext *ctx = &stack->contexts[stack->count];
+    ctx->function_name = function_name;
     ctx->scope_level = rt->current_scope_level;
+    ctx->tail_calls = 0;
+    ctx->tail_pending = 0;
     ctx->function_node = function_node;
-    
-    rt->function_stack.count++;
+
+    stack->count++;
     return 1; // Success
 }
 
@@ -1568,15 +3035,6 @@ void function_stack_pop(void)
     }
     
     rt->function_stack.count--;
-    FunctionContext *ctx = &rt->function_stack.contexts[rt->function_stack.count];
-    
-    // Free the duplicated function name
-    if (ctx->function_name) {
-        free(ctx->function_name);
-        ctx->function_name = NULL;
-    }
-    ctx->function_node = NULL;
-    ctx->scope_level = 0;
 }
 
 FunctionContext *function_stack_peek(void)
@@ -1609,19 +3067,8 @@ void free_value(Value *val) {
         return;
     }
 
-    if (val->type == VAL_ARRAY) {
-        for (size_t j = 0; j < val->array.count; j++) {
-            free_value(val->array.items[j]);
-            val->array.items[j] = NULL;
-        }
-        free(val->array.items);
-        val->array.items = NULL;
-    } else if (val->type == VAL_STRING) {
-        if (val->string) {
-            free(val->string);
-            val->string = NULL;
-        }
-    }
+    if (val->type == VAL_ARRAY || val->type == VAL_STRING || val->type == VAL_MAP)
+        release_payload(val);
 
     val->type = FREED_MAGIC;  // poison to catch reuse
     free(val);
@@ -1654,29 +3101,18 @@ void exit_scope()
 {
     Runtime *rt = get_runtime();
 
+    // Level 0 (and below) holds the globals, which start at the bottom of the stack
+    int level = rt->current_scope_level;
+    int base = level > 0 && level < rt->scope_capacity ? rt->scope_bases[level] : 0;
 
-    for (int i = rt->var_count - 1; i >= 0; --i)
+    // Pop from the top: each variable hands its slot back to the binding it shadowed
+    while (rt->var_count > base)
     {
-        if (rt->variables[i].scope_level == rt->current_scope_level)
+        Variable *var = &rt->variables[--rt->var_count];
+        rt->bindings[var->slot] = var->shadowed;
+        if (var->val)
         {
-
-
-            free(rt->variables[i].name);
-            rt->variables[i].name = NULL;
-
-            // Use free_value for all value types
-            if (rt->variables[i].val)
-            {
-                free_value(rt->variables[i].val);
-            }
-
-            // Shift remaining variables down
-            for (int j = i; j < rt->var_count - 1; ++j)
-            {
-                rt->variables[j] = rt->variables[j + 1];
-            }
-
-            rt->var_count--;
+            free_value(var->val);
         }
     }
 
@@ -1696,28 +3132,49 @@ void exit_scope()
 
 
 
-void set_var(const char *name, Value *val)
+void set_var_slot(int slot, const char *name, Value *val)
 {
     Runtime *rt = get_runtime();
     if (!val) {
         report_error("[set_var] Warning: null value for '%s'", name);
         return;
     }
-    Value *copy = copy_value(val);
+    slot = reference_slot(slot, name);
+    int i = binding_index(rt, slot);
+    if (i >= 0 && val->type == VAL_NUMBER && rt->variables[i].val && rt->variables[i].val->type == VAL_NUMBER) {
+        // A number has no payload, so the variable's own Value is overwritten
+        rt->variables[i].val->number = val->number;
+        check_config_variable(name, val);
+        return;
+    }
+    if (i >= 0 && val->type == VAL_STRING && val->refs == interned_text && rt->variables[i].val) {
+        // Nor has interned text: the variable's Value takes it in place of what it held.
+        // `val` may be an element of that old value, so it is read first
+        Value text = *val;
+        Value *box = rt->variables[i].val;
+        release_payload(box);
+        *box = text;
+        check_config_variable(name, box);
+        return;
+    }
+    if (i < 0) {
+        // Not found, declare new variable (declare_var_slot() makes the copy)
+        declare_var_slot(slot, name, val);
+        return;
+    }
+    Value *copy = share_value(val);
     if (!copy) {
         report_error("[set_var] Error: failed to copy value for '%s'", name);
         return;
     }
-    for (int i = rt->var_count - 1; i >= 0; i--) {
-        if (rt->variables[i].name && strcmp(rt->variables[i].name, name) == 0) {
-            free_value(rt->variables[i].val);     // Free old value
-            rt->variables[i].val = copy; // Assign new copy
-            
-            // Check for configuration variables
-            check_config_variable(name, val);
-            return;
-        }
-    }
-    // Not found, declare new variable (copy already made)
-    declare_var(name, copy);
+    free_value(rt->variables[i].val);     // Free old value
+    rt->variables[i].val = copy; // Assign new copy
+
+    // Check for configuration variables
+    check_config_variable(name, val);
+}
+
+void set_var(const char *name, Value *val)
+{
+    set_var_slot(0, name, val);
 }
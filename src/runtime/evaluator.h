@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "../parser/ast_nodes.h"
+#include "../parser/flat_ast.h"
 #include "runtime_state.h"
 
 #ifndef M_PI
@@ -21,35 +22,64 @@ void exit_scope(void);
 typedef enum {
     VAL_NUMBER,
     VAL_ARRAY,
-    VAL_STRING
+    VAL_STRING,
+    VAL_MAP
 } ValueType;
 
+struct Map;
+
 // --- Value ---
 typedef struct Value {
     ValueType type;
+    unsigned width;     // VAL_ARRAY: 0 when the elements are Values in `items`; otherwise they are
+                        // numbers packed in `numbers`, `width` per element (1 = a number, more = a row)
     union {
         double number;  // VAL_NUMBER
         struct {
-            struct Value **items;
+            union {
+                struct Value **items;  // width 0
+                double *numbers;       // width > 0: count * width of them, row after row
+            };
             size_t count;
         } array;        // VAL_ARRAY
         char *string;   // VAL_STRING
+        struct Map *map; // VAL_MAP: string keys to Values, in the order they were first stored
     };
+    size_t *refs;       // VAL_STRING, VAL_ARRAY, VAL_MAP: owner count heading the shared payload, then
+                        // its room in bytes; NULL when nothing owns it (temporaries). Interned strings
+                        // share one header that is never counted (see interned_value())
 } Value;
 
 // --- Function declarations ---
 Value *make_number_value(double x);
 Value *make_raw_number_value(double x); // Allows NaN and Infinity
 Value *make_string_value(const char *str);
-Value *copy_value(Value *val);
+Value number_value(double x);         // By value, rounded like make_number_value(); allocates nothing
+Value *copy_value(Value *val);      // Deep copy with payloads of its own
+Value *share_value(const Value *val); // New owner of the same payload, O(1) for owned strings and arrays
 void free_value(Value *val);
 
+// Arrays and maps are copy-on-write: unshare_value() before changing one in place
+int unshare_value(Value *val);
+int resize_array(Value *array, size_t count); // New elements are 0
+Value array_item(const Value *array, size_t index); // In range; a packed row comes back as a view into `array`
+int store_item(Value *array, size_t index, const Value *item); // Grows with 0s; repacks or unpacks as needed
+Value interned_value(const char *text); // `text` from the intern table: stored and compared by pointer, never copied
+Value char_value(char c);               // The one-character string `c`, from intern_byte(); allocates nothing
+Value *make_map_value(void);                                    // An empty map
+int store_entry(Value *map, const Value *key, const Value *item); // Adds or replaces; 0 unless `key` is a string
+
 // Core API
 void set_var(const char *name, Value *val);
 Value *get_var(const char *name);
 int var_exists(const char *name);
 void declare_var(const char *name, Value *val);
 
+// The same, addressed by a slot from resolve_variables(); slot 0 looks `name` up
+Value *get_var_slot(int slot, const char *name);
+void set_var_slot(int slot, const char *name, Value *val);
+void declare_var_slot(int slot, const char *name, Value *val);
+
 // Scalar shortcuts
 void set_scalar(const char *name, double value);
 
@@ -67,8 +97,83 @@ void exit_scope(void);
 // Evaluation
 Value *eval(ASTNode *node);
 
+// Results are either a variable's own Value or a temporary in the runtime's
+// scratch arena that lives until the enclosing statement ends; copy_value()
+// (or storing it with set_var()) is how a value is kept
 Value *eval_expr(ASTNode *node);
+Value *eval_flat_expr(const FlatAst *ast, FlatIndex index);
+
+// The same, by value: numbers come back in the Value itself, strings and arrays
+// still point at their heap payload, which the Value does not own
+Value eval_value(ASTNode *node);
+Value eval_flat_value(const FlatAst *ast, FlatIndex index);
+
+// Operators and indexing on evaluated operands, shared with the bytecode VM
+Value apply_unary(Token_Type op, double operand);
+Value apply_binary(Token_Type op, const Value *left_val, const Value *right_val);
+Value *index_value(const Value *target, const Value *index_val); // NULL after reporting why not
+int element_value(const Value *target, const Value *index_val, Value *element); // By value; 0 after reporting why not
+Value *apply_compound_assign(int slot, const char *name, Token_Type op, const Value *current, const Value *rhs);
+
+// The target of an indexed store, unshared all the way down so the store
+// changes no other owner's array
+Value *eval_writable(ASTNode *node);
+
+// Temporaries live until the statement that made them releases its mark
+typedef struct {
+    ArenaMark arena;
+    struct ScratchRef *refs;
+} ScratchMark;
+
+ScratchMark scratch_mark(void);
+void scratch_release(ScratchMark mark);
+
 void eval_block(ASTNode *block);
+int match_arm(const ASTNode *match, const Value *subject); // Arm of AST_MATCH `match` that `subject` selects, -1 for none
+
+// Arguments of a call, either pointer nodes or indices into a flat AST
+typedef struct {
+    ASTNode **nodes;
+    const FlatAst *flat;
+    const FlatIndex *indices;
+    int count;
+} CallArgs;
+
+// Built-ins call sites are bound to at parse time: 1 + (TOKEN_FUNC_* - TOKEN_FUNC_ABS)
+// for the keyword built-ins, then the safe-math, array and map helpers, which are plain
+// identifiers, then min() and max() of a single array
+#define BUILTIN_KEYWORDS (TOKEN_FUNC_EXP - TOKEN_FUNC_ABS + 1)
+enum {
+    BUILTIN_NONE = 0,   // a user function
+    BUILTIN_SAFE_DIVIDE = BUILTIN_KEYWORDS + 1,
+    BUILTIN_IS_FINITE,
+    BUILTIN_IS_NAN,
+    BUILTIN_IS_INF,
+    BUILTIN_LEN,
+    BUILTIN_PUSH,
+    BUILTIN_POP,
+    BUILTIN_SLICE,
+    BUILTIN_SORT,
+    BUILTIN_REVERSE,
+    BUILTIN_SUM,
+    BUILTIN_HAS,
+    BUILTIN_KEYS,
+    BUILTIN_ARRAY_MIN,
+    BUILTIN_ARRAY_MAX,
+    BUILTIN_COUNT
+};
+#define BUILTIN_MAX_ARGS 5
+
+// The built-in a call of `name` (token type `token`) with `argc` arguments runs, or
+// BUILTIN_NONE if there is none taking that many
+int bind_builtin(int token, const char *name, int argc);
+int builtin_arg_count(int builtin);     // arguments it evaluates; constants take none
+int builtin_is_pure(int builtin);       // same arguments, same result, no other effect: may be folded or cached
+int builtin_changes_array(int builtin); // push() and pop(): changes the variable its first argument names
+Value call_builtin(int builtin, const Value *args);  // args: builtin_arg_count() values; changes no array
+
+// Runs AST_CALL node `call`, through its bound built-in or its user function
+Value *call_function(ASTNode *call, const CallArgs *args);
 
 // Function system
 void register_function(ASTNode *node);
@@ -84,8 +189,10 @@ void function_stack_pop(void);
 FunctionContext *function_stack_peek(void);
 int is_inside_function(void);
 void function_stack_init(void);
+void function_stack_free(void);
 
 ASTNode *parse_script_from_string(const char *source);
+void set_parents_recursive(ASTNode *node, ASTNode *parent);
 
 // Configuration variable detection
 void check_config_variable(const char* name, Value* val);
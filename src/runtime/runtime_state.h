@@ -3,60 +3,82 @@
 
 #include "../parser/ast_nodes.h"
 #include "../parser/parser.h"
+#include "../utils/arena.h"
 #include <stddef.h>
 
-#define MAX_VARIABLES 1024
 #define MAX_FUNCTIONS 64
-#define MAX_FUNCTION_STACK_DEPTH 32
+#define DEFAULT_MAX_RECURSION_DEPTH 1000  // Nested calls; tail calls to the running function reuse its frame
 
 // Forward declarations
 struct Value;
 
 // --- Variable ---
 typedef struct {
-    char *name;
+    const char *name;   // interned
+    int slot;           // see resolve_variables()
+    int shadowed;       // undo record: binding of the same slot restored when this one goes, 0 = none
     int scope_level;
     struct Value *val;
 } Variable;
 
 // --- Function ---
 typedef struct {
-    char *name;
+    const char *name;
     ASTNode *node; // AST_FUNCTION node
 } FunctionEntry;
 
-// --- Function Context for tracking function call stack ---
+// --- Call frame of a running user function ---
 typedef struct {
-    char *function_name;
-    int scope_level;
+    const char *function_name;  // the call site's name, not copied
+    int scope_level;            // scope holding the parameters
+    int tail_calls;             // self calls in tail position this frame has run in place
+    int tail_pending;           // a `return` asked to rerun the body with the stack's tail_args
     ASTNode *function_node;
 } FunctionContext;
 
 // --- Function Stack for managing nested function calls ---
 typedef struct {
-    FunctionContext contexts[MAX_FUNCTION_STACK_DEPTH];
+    FunctionContext *contexts;  // frames, kept and reused from call to call
     int count;
+    int capacity;
+    struct Value **tail_args;   // arguments of the pending tail call, by parameter
+    int tail_arg_capacity;
 } FunctionStack;
 
 // --- Runtime State ---
 typedef struct Runtime {
     int statement_count;
+    int last_modal_key_id;  // Modal key of the last G-code words written, -1 for none
     char RUNTIME_TIME[64];
     char RUNTIME_FILENAME[256];
-    Variable variables[MAX_VARIABLES];
+    Variable *variables;    // stack of live variables, innermost scope on top
     int var_count;
+    int var_capacity;
+    int *bindings;          // slot -> index + 1 of its innermost variable, 0 = unbound
+    int binding_capacity;
     FunctionEntry function_table[MAX_FUNCTIONS];
     int function_count;
+    int *function_slots;    // name slot -> index + 1 of its function_table entry, 0 = none
+    int function_slot_capacity;
+    unsigned function_generation;  // Bumped on every register_function, incl. redefinitions
     int current_scope_level;
+    int *scope_bases;       // level -> var_count when the scope was entered
+    int scope_capacity;
     
     // Function context tracking for return statement validation
     FunctionStack function_stack;
     
     // Recursion protection
     int recursion_depth;        // Current function call depth
-    int max_recursion_depth;    // Maximum allowed depth (default: 100)
+    int max_recursion_depth;    // Maximum allowed depth (default: DEFAULT_MAX_RECURSION_DEPTH)
 
     Parser parser;  // Parser state moved from global to runtime
+    InternTable strings;  // Interned names and literals, owned per compilation
+    Arena ast_arena;      // AST nodes, their arrays and note text, owned per compilation
+    ASTNode *ast_root;    // Last tree parse_script() returned...
+    ArenaMark ast_root_mark;  // ...and where its allocations start
+    Arena scratch;        // Evaluator temporaries, released when the statement that made them ends
+    struct ScratchRef *scratch_refs;  // Heap values owned by those temporaries, newest first
     // Add more fields as needed (error state, output buffer, etc.)
 } Runtime;
 
@@ -0,0 +1,425 @@
+#include <math.h>
+#include <string.h>
+#include "bytecode.h"
+#include "config/config.h"
+#include "error/error.h"
+#include "generator/emitter.h"
+#include "utils/output_buffer.h"
+
+double get_number(Value *val);
+
+// Computed goto where the compiler has it: every handler jumps straight to the next one
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+/// @brief Looks up variable `slot`/`name`, reporting it like the tree walker when it is undefined
+static Value vm_variable(int slot, const char *name)
+{
+    const Value *val = get_var_slot(slot, name);
+    if (!val)
+    {
+        report_error("[Runtime evaluator] Variable '%s' is undefined", name);
+        return number_value(0.0);
+    }
+    return *val;
+}
+
+/// @brief Empties every cache: the tree walker may have written any variable
+static void clear_caches(Bytecode *code)
+{
+    for (uint32_t i = 0; i < code->cache_count; i++)
+        code->caches[i] = NAN;
+}
+
+/// @brief Both operands of a binary instruction are numbers, so the fast path applies
+#define NUMBERS(x, y) ((x).type == VAL_NUMBER && (y).type == VAL_NUMBER)
+
+void emit_gcode_bytecode(Bytecode *code)
+{
+    Runtime *rt = get_runtime();
+    Value *r = code->registers;
+    const Instr *ip = code->code;
+    const Instr *start = code->code;
+    const double *numbers = code->numbers;
+    const char *const *names = code->names;
+    ASTNode *const *nodes = code->nodes;
+    double *caches = code->caches;
+    const uint32_t *cache_lists = code->cache_lists;
+    clear_caches(code);
+
+    // Statements release temporaries back to here; nothing in scratch outlives a statement
+    ScratchMark mark = scratch_mark();
+
+    char line[256];             // G-code line being built
+    size_t len = 0;
+    char note[256];             // note line being built
+    size_t used = 0;
+
+#ifdef VM_COMPUTED_GOTO
+#define LABEL(op) [op] = __extension__ &&L_##op
+    static const void *const dispatch[OP_COUNT_] = {
+        LABEL(OP_NUMBER),
+        LABEL(OP_STRING),
+        LABEL(OP_GET),
+        LABEL(OP_UNARY),
+        LABEL(OP_ADD),
+        LABEL(OP_SUB),
+        LABEL(OP_MUL),
+        LABEL(OP_DIV),
+        LABEL(OP_LESS),
+        LABEL(OP_LESS_EQUAL),
+        LABEL(OP_GREATER),
+        LABEL(OP_GREATER_EQUAL),
+        LABEL(OP_EQUAL),
+        LABEL(OP_NOT_EQUAL),
+        LABEL(OP_BINARY),
+        LABEL(OP_INDEX),
+        LABEL(OP_CALL_BUILTIN),
+        LABEL(OP_EVAL),
+        LABEL(OP_CACHED),
+        LABEL(OP_CACHE_FILL),
+        LABEL(OP_JUMP_UNLESS),
+        LABEL(OP_JUMP),
+        LABEL(OP_LET),
+        LABEL(OP_ASSIGN),
+        LABEL(OP_FIND),
+        LABEL(OP_COMPOUND),
+        LABEL(OP_IF),
+        LABEL(OP_MATCH),
+        LABEL(OP_WHILE_INIT),
+        LABEL(OP_WHILE),
+        LABEL(OP_LOOP),
+        LABEL(OP_FOR_INIT),
+        LABEL(OP_FOR_SET),
+        LABEL(OP_FOR_NEXT),
+        LABEL(OP_GCODE),
+        LABEL(OP_GCODE_WORD),
+        LABEL(OP_GCODE_END),
+        LABEL(OP_NOTE),
+        LABEL(OP_NOTE_SEGMENT),
+        LABEL(OP_DEFINE),
+        LABEL(OP_INVALIDATE),
+        LABEL(OP_WALK),
+        LABEL(OP_RELEASE),
+        LABEL(OP_HALT),
+    };
+#define CASE(op) L_##op:
+#define NEXT() __extension__({ goto *dispatch[(++ip)->op]; })
+#define JUMP(target) __extension__({ ip = start + (target); goto *dispatch[ip->op]; })
+    __extension__({ goto *dispatch[ip->op]; });
+#else
+#define CASE(op) case op:
+#define NEXT() do { ip++; goto next; } while (0)
+#define JUMP(target) do { ip = start + (target); goto next; } while (0)
+next:
+    switch ((Opcode)ip->op)
+    {
+#endif
+
+    // --- Expressions ---
+    CASE(OP_NUMBER)
+    {
+        // Rounded by the compiler already
+        Value val = {.type = VAL_NUMBER, .number = numbers[ip->b]};
+        r[ip->a] = val;
+        NEXT();
+    }
+
+    CASE(OP_STRING)
+    {
+        r[ip->a] = interned_value(names[ip->b]);
+        NEXT();
+    }
+
+    CASE(OP_GET)
+        r[ip->a] = vm_variable((int)ip->b, names[ip->c]);
+        NEXT();
+
+    CASE(OP_UNARY)
+        r[ip->a] = apply_unary((Token_Type)ip->aux, get_number(&r[ip->b]));
+        NEXT();
+
+    CASE(OP_ADD)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number + r[ip->c].number);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_SUB)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number - r[ip->c].number);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_MUL)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number * r[ip->c].number);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_DIV)
+        // Division by zero is reported by apply_binary()
+        if (NUMBERS(r[ip->b], r[ip->c]) && r[ip->c].number != 0.0)
+            r[ip->a] = number_value(r[ip->b].number / r[ip->c].number);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_LESS)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number < r[ip->c].number ? 1.0 : 0.0);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_LESS_EQUAL)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number <= r[ip->c].number ? 1.0 : 0.0);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_GREATER)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number > r[ip->c].number ? 1.0 : 0.0);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_GREATER_EQUAL)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number >= r[ip->c].number ? 1.0 : 0.0);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_EQUAL)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number == r[ip->c].number ? 1.0 : 0.0);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_NOT_EQUAL)
+        if (NUMBERS(r[ip->b], r[ip->c]))
+            r[ip->a] = number_value(r[ip->b].number != r[ip->c].number ? 1.0 : 0.0);
+        else
+            r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_BINARY)
+        r[ip->a] = apply_binary((Token_Type)ip->aux, &r[ip->b], &r[ip->c]);
+        NEXT();
+
+    CASE(OP_INDEX)
+    {
+        Value element;
+        r[ip->a] = element_value(&r[ip->b], &r[ip->c], &element) ? element : number_value(0.0);
+        NEXT();
+    }
+
+    CASE(OP_CALL_BUILTIN)
+        r[ip->a] = call_builtin((int)ip->b, &r[ip->a]);
+        NEXT();
+
+    CASE(OP_EVAL)
+        r[ip->a] = eval_value(nodes[ip->b]);
+        clear_caches(code);
+        NEXT();
+
+    CASE(OP_CACHED)
+        // An empty cache holds NaN, which no cached value can be
+        if (isnan(caches[ip->b]))
+            NEXT();
+        r[ip->a] = number_value(0.0);
+        r[ip->a].number = caches[ip->b];
+        JUMP(ip->c);
+
+    CASE(OP_CACHE_FILL)
+        // A value that came with an error is computed again, so the error is reported again
+        if (r[ip->a].type == VAL_NUMBER && !has_errors())
+            caches[ip->b] = r[ip->a].number;
+        NEXT();
+
+    CASE(OP_JUMP_UNLESS)
+        if (r[ip->a].type == VAL_NUMBER && r[ip->a].number != 0)
+            NEXT();
+        JUMP(ip->b);
+
+    CASE(OP_JUMP)
+        JUMP(ip->b);
+
+    // --- Statements ---
+    CASE(OP_LET)
+        rt->statement_count++;
+        set_var_slot((int)ip->b, names[ip->c], &r[ip->a]);
+        NEXT();
+
+    CASE(OP_ASSIGN)
+        rt->statement_count++;
+        assign_checked((int)ip->b, names[ip->c], &r[ip->a]);
+        NEXT();
+
+    CASE(OP_FIND)
+        rt->statement_count++;
+        if (get_var_slot((int)ip->b, names[ip->c]))
+            NEXT();
+        report_error("[eval_expr] Variable '%s' not found for compound assignment", names[ip->c]);
+        JUMP(ip->a);
+
+    CASE(OP_COMPOUND)
+    {
+        Value *current = get_var_slot((int)ip->b, names[ip->c]);
+        if (current)
+            apply_compound_assign((int)ip->b, names[ip->c], (Token_Type)ip->aux, current, &r[ip->a]);
+        else
+            report_error("[eval_expr] Variable '%s' not found for compound assignment", names[ip->c]);
+        NEXT();
+    }
+
+    CASE(OP_IF)
+    {
+        rt->statement_count++;
+        double cond;
+        if (!if_condition(&r[ip->a], &cond))
+            JUMP(ip->c);
+        if (cond)
+            NEXT();
+        JUMP(ip->b);
+    }
+
+    CASE(OP_MATCH)
+    {
+        rt->statement_count++;
+        const ASTNode *node = nodes[ip->b];
+        int arm = match_arm(node, &r[ip->a]);
+        if (ip->aux)
+            scratch_release(mark);
+        JUMP((uint32_t)(ip - start) + 1 + (uint32_t)(arm >= 0 ? arm : node->match_stmt.arm_count));
+    }
+
+    CASE(OP_WHILE_INIT)
+        rt->statement_count++;
+        r[ip->a] = number_value(0.0);
+        NEXT();
+
+    CASE(OP_WHILE)
+        if (while_continues(&r[ip->a], (int)r[ip->c].number))
+            NEXT();
+        JUMP(ip->b);
+
+    CASE(OP_LOOP)
+        // A return inside a called function ends the loop, as in the tree walker
+        if (runtime_has_returned)
+            NEXT();
+        r[ip->a].number += 1;
+        JUMP(ip->b);
+
+    CASE(OP_FOR_INIT)
+    {
+        rt->statement_count++;
+        Value *loop = &r[ip->a];   // counter, end, step
+        double from, to, step;
+        if (!for_range(&loop[0], &loop[1], &loop[2], &from, &to, &step))
+            JUMP(ip->b);
+
+        double end = ip->aux ? to : (step > 0 ? to + 1e-9 : to - 1e-9);
+        loop[0].number = from;
+        loop[1].number = end;
+        if (step > 0 ? from < end : from > end)
+            NEXT();
+        JUMP(ip->b);
+    }
+
+    CASE(OP_FOR_SET)
+    {
+        Value counter = number_value(r[ip->a].number);
+        set_var_slot((int)ip->b, names[ip->c], &counter);
+        NEXT();
+    }
+
+    CASE(OP_FOR_NEXT)
+    {
+        if (runtime_has_returned)
+            NEXT();
+        Value *loop = &r[ip->a];
+        double step = loop[2].number;
+        loop[0].number += step;
+        if (step > 0 ? loop[0].number < loop[1].number : loop[0].number > loop[1].number)
+            JUMP(ip->b);
+        NEXT();
+    }
+
+    CASE(OP_GCODE)
+    {
+        rt->statement_count++;
+        const ASTNode *node = nodes[ip->b];
+        len = begin_gcode_line(line, sizeof(line), node->gcode_stmt.code,
+                               node->gcode_stmt.code_id, node->gcode_stmt.modal_key_id);
+        NEXT();
+    }
+
+    CASE(OP_GCODE_WORD)
+    {
+        int has_value = ip->a != BC_NONE;
+        Value zero = number_value(0.0);
+        len = append_gcode_arg(line, sizeof(line), len, (int)ip->c, ip->aux, has_value,
+                               has_value ? &r[ip->a] : &zero);
+        NEXT();
+    }
+
+    CASE(OP_GCODE_END)
+        write_line_to_output(line, len);
+        NEXT();
+
+    CASE(OP_NOTE)
+        rt->statement_count++;
+        used = 0;
+        note[0] = '\0';
+        NEXT();
+
+    CASE(OP_NOTE_SEGMENT)
+    {
+        const NoteSegment *segment = &nodes[ip->b]->note.segments[ip->c];
+        Value zero = number_value(0.0);
+        used = append_note_segment(note, sizeof(note), used, segment, ip->a != BC_NONE ? &r[ip->a] : &zero);
+        NEXT();
+    }
+
+    CASE(OP_DEFINE)
+        register_function(nodes[ip->b]);
+        NEXT();
+
+    CASE(OP_INVALIDATE)
+        if (ip->b == BC_NONE)
+            clear_caches(code);
+        else
+            for (uint32_t i = 0; i < ip->b; i++)
+                caches[cache_lists[ip->a + i]] = NAN;
+        NEXT();
+
+    CASE(OP_WALK)
+        emit_gcode(nodes[ip->b]);
+        clear_caches(code);
+        NEXT();
+
+    CASE(OP_RELEASE)
+        scratch_release(mark);
+        NEXT();
+
+    CASE(OP_HALT)
+        scratch_release(mark);
+        return;
+
+#ifndef VM_COMPUTED_GOTO
+    default:
+        report_error("[VM] Unknown opcode %d", ip->op);
+        scratch_release(mark);
+        return;
+    }
+#endif
+}
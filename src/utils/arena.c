@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// Every allocation starts on this boundary
+#define ARENA_ALIGNMENT 16
+
+struct ArenaChunk {
+    ArenaChunk *prev;
+    size_t size;            // usable bytes after the header
+    size_t used;
+};
+
+#define ALIGN_UP(n) (((n) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define CHUNK_HEADER ALIGN_UP(sizeof(ArenaChunk))
+#define CHUNK_DATA(chunk) ((char *)(chunk) + CHUNK_HEADER)
+
+/// @brief Frees a chunk, or keeps it as the spare if it is a standard one
+static void recycle_chunk(Arena *arena, ArenaChunk *chunk)
+{
+    if (!arena->spare && chunk->size == ARENA_CHUNK_SIZE)
+        arena->spare = chunk;
+    else
+        free(chunk);
+}
+
+/// @brief Pushes a chunk with room for at least `size` bytes
+static ArenaChunk *push_chunk(Arena *arena, size_t size)
+{
+    ArenaChunk *chunk;
+    if (arena->spare && size <= arena->spare->size)
+    {
+        chunk = arena->spare;
+        arena->spare = NULL;
+    }
+    else
+    {
+        size_t capacity = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        chunk = malloc(CHUNK_HEADER + capacity);
+        if (!chunk)
+            return NULL;
+        chunk->size = capacity;
+    }
+
+    chunk->used = 0;
+    chunk->prev = arena->head;
+    arena->head = chunk;
+    return chunk;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = ALIGN_UP(size ? size : 1);
+
+    ArenaChunk *chunk = arena->head;
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        chunk = push_chunk(arena, size);
+        if (!chunk)
+            return NULL;
+    }
+
+    void *ptr = CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    return ptr;
+}
+
+void *arena_calloc(Arena *arena, size_t size)
+{
+    void *ptr = arena_alloc(arena, size);
+    if (ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    ArenaChunk *chunk = arena->head;
+    size_t old_aligned = ALIGN_UP(old_size ? old_size : 1);
+    size_t new_aligned = ALIGN_UP(new_size ? new_size : 1);
+
+    // The most recent allocation can simply be extended
+    if (ptr && chunk && (char *)ptr + old_aligned == CHUNK_DATA(chunk) + chunk->used &&
+        new_aligned >= old_aligned && new_aligned - old_aligned <= chunk->size - chunk->used)
+    {
+        chunk->used += new_aligned - old_aligned;
+        arena->used += new_aligned - old_aligned;
+        if (arena->used > arena->peak)
+            arena->peak = arena->used;
+        return ptr;
+    }
+
+    void *grown = arena_alloc(arena, new_size);
+    if (grown && ptr)
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    return grown;
+}
+
+char *arena_strndup(Arena *arena, const char *text, size_t length)
+{
+    char *copy = arena_alloc(arena, length + 1);
+    if (!copy)
+        return NULL;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+ArenaMark arena_mark(const Arena *arena)
+{
+    ArenaMark mark = {arena->head, arena->head ? arena->head->used : 0, arena->used};
+    return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark)
+{
+    while (arena->head && arena->head != mark.chunk)
+    {
+        ArenaChunk *chunk = arena->head;
+        arena->head = chunk->prev;
+        recycle_chunk(arena, chunk);
+    }
+    if (arena->head)
+        arena->head->used = mark.chunk_used;
+    arena->used = mark.used;
+}
+
+void arena_free(Arena *arena)
+{
+    while (arena->head)
+    {
+        ArenaChunk *chunk = arena->head;
+        arena->head = chunk->prev;
+        free(chunk);
+    }
+    free(arena->spare);
+    memset(arena, 0, sizeof(Arena));
+}
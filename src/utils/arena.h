@@ -0,0 +1,79 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Default chunk size; larger requests get a chunk of their own */
+#define ARENA_CHUNK_SIZE 65536
+
+typedef struct ArenaChunk ArenaChunk;
+
+/**
+ * @brief Bump allocator that owns everything allocated from it.
+ *
+ * Allocations are never freed one at a time: the whole arena is released at
+ * once with arena_free(), or rolled back to an earlier arena_mark() with
+ * arena_release(). Memory is suitably aligned for any object.
+ */
+typedef struct {
+    ArenaChunk *head;       // chunk being filled; earlier chunks hang off it
+    ArenaChunk *spare;      // one released chunk kept for reuse
+    size_t used;            // bytes handed out and not released
+    size_t peak;            // high-water mark of `used`
+} Arena;
+
+/** @brief A point to roll an arena back to with arena_release() */
+typedef struct {
+    ArenaChunk *chunk;
+    size_t chunk_used;
+    size_t used;
+} ArenaMark;
+
+/**
+ * @brief Allocate `size` bytes from the arena.
+ * @return Uninitialized memory, or NULL on allocation failure.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Allocate `size` zeroed bytes from the arena.
+ */
+void *arena_calloc(Arena *arena, size_t size);
+
+/**
+ * @brief Resize an allocation, in place when it is the most recent one.
+ * @param ptr Earlier allocation of `old_size` bytes, or NULL.
+ * @return The (possibly moved) allocation, or NULL on failure. The old block
+ *         is not reclaimed when the data moves.
+ */
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Copy `length` bytes of `text` into the arena and NUL-terminate them.
+ */
+char *arena_strndup(Arena *arena, const char *text, size_t length);
+
+/**
+ * @brief Remember the current allocation point.
+ */
+ArenaMark arena_mark(const Arena *arena);
+
+/**
+ * @brief Release everything allocated since `mark` was taken.
+ */
+void arena_release(Arena *arena, ArenaMark mark);
+
+/**
+ * @brief Release all memory owned by the arena and reset it to empty.
+ */
+void arena_free(Arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENA_H
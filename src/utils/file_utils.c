@@ -1,5 +1,14 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include "file_utils.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 char* read_file_to_buffer(const char* filename, long* out_size) {
     FILE* file = fopen(filename, "r");
@@ -22,3 +31,58 @@ char* read_file_to_buffer(const char* filename, long* out_size) {
     if (out_size) *out_size = size;
     return buffer;
 }
+
+/// @brief Opens a file as a borrowed, read-only view
+/// @param view Output: filled on success, zeroed on failure
+/// @return 1 on success, 0 on failure (errno is preserved)
+/// @note On POSIX the file is mapped with mmap. The kernel zero-fills the tail of
+///       the last page, which gives the mapping its NUL terminator for free. Files
+///       that end exactly on a page boundary (and empty files) have no spare byte,
+///       so they fall back to read_file_to_buffer.
+int open_source_view(const char* filename, SourceView* view) {
+    memset(view, 0, sizeof(SourceView));
+
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        long page_size = sysconf(_SC_PAGESIZE);
+        if (page_size > 0 && st.st_size % page_size != 0) {
+            void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+#ifdef POSIX_MADV_SEQUENTIAL
+                posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+                close(fd);
+                view->data = data;
+                view->size = (long)st.st_size;
+                view->mapped_length = (size_t)st.st_size;
+                return 1;
+            }
+        }
+    }
+    close(fd);
+#endif
+
+    char* buffer = read_file_to_buffer(filename, &view->size);
+    if (!buffer) return 0;
+    view->data = buffer;
+    return 1;
+}
+
+/// @brief Releases a view returned by open_source_view
+void close_source_view(SourceView* view) {
+    if (!view || !view->data) return;
+
+#ifndef _WIN32
+    if (view->mapped_length) {
+        munmap((void*)view->data, view->mapped_length);
+    } else
+#endif
+    {
+        free((void*)view->data);
+    }
+    memset(view, 0, sizeof(SourceView));
+}
@@ -1,8 +1,21 @@
 #ifndef FILE_UTILS_H
 #define FILE_UTILS_H
 
+#include <stddef.h>
+
 char* read_file_to_buffer(const char* filename, long* out_size);
 
+// Read-only view of an input file. The bytes are always NUL-terminated so
+// the lexer and error reporting can borrow them directly.
+typedef struct {
+    const char* data;
+    long size;
+    size_t mapped_length;   // non-zero when data is an mmap'd region
+} SourceView;
+
+int open_source_view(const char* filename, SourceView* view);
+void close_source_view(SourceView* view);
+
 const char* get_input_file();
 const char* get_output_file();
 
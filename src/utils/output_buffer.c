@@ -27,7 +27,10 @@ void free_output_buffer() {
 }
 
 void write_to_output(const char* line) {
-    size_t len = strlen(line);
+    write_line_to_output(line, strlen(line));
+}
+
+void write_line_to_output(const char* line, size_t len) {
     if (gcode_output_length + len + 2 > gcode_output_capacity) {
         gcode_output_capacity = (gcode_output_capacity + len + 256) * 2;
         char *tmp = realloc(gcode_output, gcode_output_capacity);
@@ -47,6 +50,17 @@ size_t get_output_length() {
     return gcode_output_length;
 }
 
+// Write out everything buffered so far and start over; returns bytes written
+size_t flush_output_buffer(FILE* out) {
+    if (!gcode_output || gcode_output_length == 0) {
+        return 0;
+    }
+    size_t written = fwrite(gcode_output, 1, gcode_output_length, out);
+    gcode_output_length = 0;
+    gcode_output[0] = '\0';
+    return written;
+}
+
 
 void prepend_to_output_buffer(const char* prefix) {
     size_t prefix_len = strlen(prefix);
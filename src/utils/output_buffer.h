@@ -2,6 +2,7 @@
 #define OUTPUT_BUFFER_H
 
 #include <stddef.h>
+#include <stdio.h>
 
 #define OUTPUT_BUFFER_SIZE 65536
 
@@ -9,9 +10,11 @@ extern char output_buffer[];  // <-- this is the declaration
 
 void init_output_buffer();
 void write_to_output(const char* line);
+void write_line_to_output(const char* line, size_t len);  // same, when the length is known
 void free_output_buffer();
 const char* get_output_buffer();
 size_t get_output_length();
+size_t flush_output_buffer(FILE* out);  // write and empty the buffer (streaming mode)
 void prepend_to_output_buffer(const char* prefix);  // <-- your prepend function
 void emit_gcode_preamble(const char* default_filename); 
 
@@ -1,8 +1,9 @@
 // utils/report.c
+#include <stddef.h>
 #include <stdio.h>
 #include "report.h"
 
-void print_compilation_report(long input_size, long output_size, double parse_time, double emit_time, long mem_kb, int statement_count) {
+void print_compilation_report(long input_size, long output_size, double parse_time, double emit_time, long mem_kb, int statement_count, size_t ast_arena_bytes, size_t scratch_peak_bytes) {
 
 
 #if defined(_WIN32)
@@ -16,6 +17,7 @@ void print_compilation_report(long input_size, long output_size, double parse_ti
     printf("Output     : %ld bytes (%.2f KB)\n", output_size, output_size / 1024.0);
     printf("Parse      : %.4f sec   Emit: %.4f sec\n", parse_time, emit_time);
     printf("Memory     : %ld KB     Statements: %d\n", mem_kb, statement_count);
+    printf("AST arena  : %.2f KB   Scratch peak: %.2f KB\n", ast_arena_bytes / 1024.0, scratch_peak_bytes / 1024.0);
     printf("-----------------------------------------------\n");
 #else
   printf("\n┏┓┏┓┏┓┏┓┳┓┏┓  ┏┓       •┓   •      ┳┓         \n");
@@ -26,6 +28,7 @@ printf("\033[1;37mInput  \033[0m : \033[1;33m%ld bytes\033[1;22m (%.2f KB)\n", i
 printf("\033[1;37mOutput \033[0m : \033[1;33m%ld bytes\033[1;22m  (%.2f KB)\n", output_size, output_size / 1024.0);
 printf("\033[1;37mParse  \033[0m : \033[1;36m%.4f sec\033[0m   \033[1;37mEmit\033[0m: \033[1;36m%.4f sec\033[0m\n", parse_time, emit_time);
 printf("\033[1;37mMemory \033[0m : \033[1;33m%ld KB\033[0m     \033[1;37mStatements\033[0m: \033[1;33m%d\033[0m\n", mem_kb, statement_count);
+printf("\033[1;37mArena  \033[0m : \033[1;33m%.2f KB\033[0m (AST)   \033[1;33m%.2f KB\033[0m (scratch peak)\n", ast_arena_bytes / 1024.0, scratch_peak_bytes / 1024.0);
 
     printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n");
 #endif
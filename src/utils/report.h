@@ -1,2 +1,3 @@
 // utils/report.h
-void print_compilation_report(long input_size, long output_size, double parse_time, double emit_time, long mem_kb, int statement_count);
+#include <stddef.h>
+void print_compilation_report(long input_size, long output_size, double parse_time, double emit_time, long mem_kb, int statement_count, size_t ast_arena_bytes, size_t scratch_peak_bytes);
@@ -0,0 +1,254 @@
+// Lexer microbenchmark: reports tokens/sec for a keyword- and operator-heavy
+// corpus, or for a .ggcode file given on the command line. It then resolves
+// every word and operator of the input with the linear scan the lexer used
+// before its lookup tables, and with the tables, and compares the two.
+//
+//   make bench
+//   ./bin/bench_lexer [file.ggcode] [passes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../../src/lexer/lexer.h"
+#include "../../src/config/config.h"
+#include "../../src/utils/file_utils.h"
+#include "../../src/utils/time_utils.h"
+
+#define BENCH_DEFAULT_PASSES 200
+#define BENCH_CORPUS_REPEAT 500
+
+static const char *bench_snippet =
+    "let radius = 10.5\n"
+    "let steps = 36\n"
+    "function spiral(r, n) {\n"
+    "    for i = 0..<n step 1 {\n"
+    "        let a = i * TAU / n\n"
+    "        let x = r * cos(a) + abs(sin(a) * 0.5)\n"
+    "        let y = r * sin(a) - floor(max(a, 1))\n"
+    "        if (x >= 0 && y <= 0 || x != y) {\n"
+    "            G1 X[x] Y[y] F[1200]\n"
+    "        } else {\n"
+    "            G0 X[round(x)] Y[clamp(y, -5, 5)]\n"
+    "        }\n"
+    "        r -= 0.25\n"
+    "        n <<= 1\n"
+    "    }\n"
+    "    return sqrt(pow(r, 2) + hypot(r, r)) ^ 2\n"
+    "}\n"
+    "while (radius > 1) { radius *= 0.9 ; note {r=[radius]} }\n";
+
+static char *build_corpus(void)
+{
+    size_t snippet_len = strlen(bench_snippet);
+    char *corpus = malloc(snippet_len * BENCH_CORPUS_REPEAT + 1);
+    if (!corpus)
+        return NULL;
+
+    for (int i = 0; i < BENCH_CORPUS_REPEAT; i++)
+        memcpy(corpus + snippet_len * i, bench_snippet, snippet_len);
+    corpus[snippet_len * BENCH_CORPUS_REPEAT] = '\0';
+    return corpus;
+}
+
+// Reference: the linear keyword and operator scan that predates the tables
+typedef struct {
+    const char *text;
+    int length;
+    Token_Type type;
+} ScanEntry;
+
+static const ScanEntry scan_keywords[] = {
+#define X(name, type) { name, (int)sizeof(name) - 1, type },
+    KEYWORD_LIST
+    TOKEN_FUNCTION_LIST
+#undef X
+};
+
+static const ScanEntry scan_operators[] = {
+#define X(text, type, str, ch) { text, (int)sizeof(text) - 1, type },
+    TOKEN_OPERATOR_LIST
+    TOKEN_DELIMITER_LIST
+    TOKEN_DOT_LIST
+#undef X
+};
+
+#define SCAN_KEYWORD_COUNT (int)(sizeof(scan_keywords) / sizeof(scan_keywords[0]))
+#define SCAN_OPERATOR_COUNT (int)(sizeof(scan_operators) / sizeof(scan_operators[0]))
+
+static Token_Type scan_keyword_type(const char *word, int length)
+{
+    for (int i = 0; i < SCAN_KEYWORD_COUNT; i++)
+    {
+        if (scan_keywords[i].length == length && memcmp(word, scan_keywords[i].text, (size_t)length) == 0)
+            return scan_keywords[i].type;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+static Token_Type scan_operator_type(const char *text, int *length)
+{
+    for (int i = 0; i < SCAN_OPERATOR_COUNT; i++)
+    {
+        if (strncmp(text, scan_operators[i].text, (size_t)scan_operators[i].length) == 0)
+        {
+            *length = scan_operators[i].length;
+            return scan_operators[i].type;
+        }
+    }
+    *length = 0;
+    return TOKEN_UNKNOWN;
+}
+
+// The words and operators of the input, as slices of the source
+typedef struct {
+    const char *text;
+    int length;     // 0 for an operator, which is matched against the NUL-terminated rest
+} Lookup;
+
+/// @brief Collects the word and operator tokens of `source`; returns how many
+static int collect_lookups(const char *source, Lookup **out)
+{
+    int count = 0, capacity = 1024;
+    Lookup *items = malloc(sizeof(Lookup) * (size_t)capacity);
+    Lexer *lexer = lexer_new(source);
+    if (!items || !lexer)
+    {
+        free(items);
+        lexer_free(lexer);
+        return -1;
+    }
+
+    Token token;
+    do
+    {
+        token = lexer_next_token(lexer);
+        const char *text = source + token.offset;
+        int word = isalpha((unsigned char)text[0]) || text[0] == '_';
+        int skip = token.type == TOKEN_EOF || token.type == TOKEN_NEWLINE || token.type == TOKEN_NUMBER ||
+                   token.type == TOKEN_STRING || token.type == TOKEN_NOTE_TEXT || token.type == TOKEN_UNKNOWN;
+        if (skip || (!word && text[0] == '\0'))
+            continue;
+
+        if (count == capacity)
+        {
+            capacity *= 2;
+            Lookup *grown = realloc(items, sizeof(Lookup) * (size_t)capacity);
+            if (!grown)
+                break;
+            items = grown;
+        }
+        items[count].text = text;
+        items[count].length = word ? token.length : 0;
+        count++;
+    } while (token.type != TOKEN_EOF);
+
+    lexer_free(lexer);
+    *out = items;
+    return count;
+}
+
+/// @brief Resolves every lookup `passes` times, with the tables or the linear scan.
+///        Returns the seconds taken and sums the token types into `checksum`
+static double resolve_lookups(const Lookup *items, int count, int passes, int use_tables, long *checksum)
+{
+    *checksum = 0;
+    Timer timer;
+    start_timer(&timer);
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int length;
+            Token_Type type;
+            if (items[i].length)
+                type = use_tables ? lexer_keyword_type(items[i].text, items[i].length)
+                                  : scan_keyword_type(items[i].text, items[i].length);
+            else
+                type = use_tables ? lexer_operator_type(items[i].text, &length)
+                                  : scan_operator_type(items[i].text, &length);
+            *checksum += type;
+        }
+    }
+
+    return end_timer(&timer);
+}
+
+/// @brief Lexes `source` `passes` times and returns the seconds taken
+static double lex_passes(const char *source, int passes, long *tokens)
+{
+    *tokens = 0;
+    Timer timer;
+    start_timer(&timer);
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        Lexer *lexer = lexer_new(source);
+        if (!lexer)
+            return -1.0;
+
+        Token token;
+        do
+        {
+            token = lexer_next_token(lexer);
+            (*tokens)++;
+        } while (token.type != TOKEN_EOF);
+
+        lexer_free(lexer);
+    }
+
+    return end_timer(&timer);
+}
+
+/// @brief Prints one throughput line and returns the `unit`s per second
+static double report(const char *label, long count, const char *unit, double seconds)
+{
+    double rate = seconds > 0 ? count / seconds : 0.0;
+    printf("%-14s %ld %s in %.3f s, %.2f M %s/sec\n", label, count, unit, seconds, rate / 1e6, unit);
+    return rate;
+}
+
+int main(int argc, char **argv)
+{
+    char *source = argc > 1 ? read_file_to_buffer(argv[1], NULL) : build_corpus();
+    int passes = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_PASSES;
+    if (!source || passes <= 0)
+    {
+        fprintf(stderr, "usage: %s [file.ggcode] [passes]\n", argv[0]);
+        return 1;
+    }
+
+    init_runtime();
+    printf("%zu bytes x %d passes\n", strlen(source), passes);
+
+    long tokens;
+    double seconds = lex_passes(source, passes, &tokens);
+    if (seconds < 0)
+        return 1;
+    report("lexer:", tokens, "tokens", seconds);
+
+    Lookup *items = NULL;
+    int count = collect_lookups(source, &items);
+    if (count < 0)
+        return 1;
+
+    long scan_sum, table_sum;
+    double scan_seconds = resolve_lookups(items, count, passes, 0, &scan_sum);
+    double table_seconds = resolve_lookups(items, count, passes, 1, &table_sum);
+    if (scan_sum != table_sum)
+    {
+        fprintf(stderr, "lookup tables and linear scan disagree\n");
+        return 1;
+    }
+
+    long lookups = (long)count * passes;
+    double before = report("linear scan:", lookups, "lookups", scan_seconds);
+    double after = report("lookup tables:", lookups, "lookups", table_seconds);
+    if (before > 0)
+        printf("Lookup speedup: %.2fx\n", after / before);
+
+    free(items);
+    free(source);
+    return 0;
+}
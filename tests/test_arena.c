@@ -0,0 +1,110 @@
+#include "Unity/src/unity.h"
+#include "utils/arena.h"
+#include "parser/parser.h"
+#include "runtime/evaluator.h"
+#include "config/config.h"
+#include <stdint.h>
+#include <string.h>
+
+static Arena arena;
+
+void setUp(void)
+{
+    memset(&arena, 0, sizeof(arena));
+}
+
+void tearDown(void)
+{
+    arena_free(&arena);
+}
+
+void test_arena_alloc_is_aligned_and_counted(void)
+{
+    char *a = arena_alloc(&arena, 3);
+    double *b = arena_alloc(&arena, sizeof(double));
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_EQUAL_UINT(0, (uintptr_t)b % sizeof(double));
+    TEST_ASSERT_TRUE(arena.used >= 3 + sizeof(double));
+    TEST_ASSERT_EQUAL_UINT(arena.used, arena.peak);
+}
+
+void test_arena_large_allocation_gets_own_chunk(void)
+{
+    char *big = arena_alloc(&arena, ARENA_CHUNK_SIZE * 3);
+    TEST_ASSERT_NOT_NULL(big);
+    memset(big, 'x', ARENA_CHUNK_SIZE * 3);
+    char *small = arena_strndup(&arena, "G1 X10", 2);
+    TEST_ASSERT_EQUAL_STRING("G1", small);
+}
+
+void test_arena_grow_extends_last_allocation_in_place(void)
+{
+    int *numbers = arena_alloc(&arena, 4 * sizeof(int));
+    for (int i = 0; i < 4; i++)
+        numbers[i] = i;
+
+    int *grown = arena_grow(&arena, numbers, 4 * sizeof(int), 8 * sizeof(int));
+    TEST_ASSERT_TRUE(grown == numbers);
+
+    // Once something else was allocated the data has to move
+    arena_alloc(&arena, 1);
+    int *moved = arena_grow(&arena, grown, 8 * sizeof(int), 16 * sizeof(int));
+    TEST_ASSERT_TRUE(moved != grown);
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL_INT(i, moved[i]);
+}
+
+void test_arena_release_rolls_back_to_mark(void)
+{
+    arena_alloc(&arena, 100);
+    ArenaMark mark = arena_mark(&arena);
+    size_t used = arena.used;
+
+    void *first = arena_alloc(&arena, 64);
+    for (int i = 0; i < 10; i++)
+        arena_alloc(&arena, ARENA_CHUNK_SIZE / 2);
+    size_t peak = arena.peak;
+
+    arena_release(&arena, mark);
+    TEST_ASSERT_EQUAL_UINT(used, arena.used);
+    TEST_ASSERT_EQUAL_UINT(peak, arena.peak);
+
+    // The same space is handed out again
+    TEST_ASSERT_TRUE(arena_alloc(&arena, 64) == first);
+}
+
+void test_free_ast_returns_root_space_to_arena(void)
+{
+    init_runtime();
+    Runtime *rt = get_runtime();
+
+    ASTNode *keep = parse_script_from_string("let a = 1");
+    TEST_ASSERT_NOT_NULL(keep);
+    size_t used = rt->ast_arena.used;
+
+    ASTNode *root = parse_script_from_string("for i = 0..10 { G1 X[i * 2] Y[i] }\nnote { done }");
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(rt->ast_arena.used > used);
+
+    free_ast(root);
+    TEST_ASSERT_EQUAL_UINT(used, rt->ast_arena.used);
+
+    // Earlier trees stay valid until the compilation ends
+    TEST_ASSERT_EQUAL(AST_LET, keep->block.statements[0]->type);
+    free_ast(keep);
+
+    init_runtime();
+    TEST_ASSERT_EQUAL_UINT(0, get_runtime()->ast_arena.used);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_arena_alloc_is_aligned_and_counted);          // 1
+    RUN_TEST(test_arena_large_allocation_gets_own_chunk);       // 2
+    RUN_TEST(test_arena_grow_extends_last_allocation_in_place); // 3
+    RUN_TEST(test_arena_release_rolls_back_to_mark);            // 4
+    RUN_TEST(test_free_ast_returns_root_space_to_arena);        // 5
+    return UNITY_END();
+}
@@ -468,6 +468,53 @@ void test_emit_function_empty_body(void)
     free_ast(root);
 }
 
+void test_emit_match_runs_one_arm(void)
+{
+    const char *code =
+        "let small = 0\n"
+        "let other = 0\n"
+        "let vowels = 0\n"
+        "for i = 0..5 {\n"
+        "  match i { 1, 2 { small += 1 } 2 { small += 100 } else { other += 1 } }\n"
+        "}\n"
+        "for c in \"match\" { match c { \"a\", \"e\" { vowels += 1 } } }\n";
+    ASTNode *root = parse_script_from_string(code);
+
+    g_runtime.statement_count = 0;
+    reset_runtime_state();
+    emit_gcode(root);
+
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, get_var("small")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(4.0, get_var("other")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, get_var("vowels")->number);
+
+    free_ast(root);
+}
+
+void test_emit_operands_evaluate_left_to_right(void)
+{
+    // The left operand is read before a call on the right changes it
+    const char *code =
+        "let a = 1\n"
+        "function f() { a = 0 return 1 }\n"
+        "let sum = a + f()\n"
+        "a = 1\n"
+        "let both = a && f()\n"
+        "a = 1\n"
+        "let after = f() + a\n";
+    ASTNode *root = parse_script_from_string(code);
+
+    g_runtime.statement_count = 0;
+    reset_runtime_state();
+    emit_gcode(root);
+
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, get_var("sum")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, get_var("both")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, get_var("after")->number);
+
+    free_ast(root);
+}
+
 void test_builtin_math_functions_and_constants(void)
 {
     const char *code =
@@ -723,6 +770,52 @@ void test_emit_function_no_return(void)
     free_ast(root);
 }
 
+void test_emit_function_no_return_after_nested_call(void)
+{
+    // The value f0() returns to f1() must not become f1()'s own result
+    const char *code =
+        "let arr = [1, 2, 3, 4]\n"
+        "function f0() { return arr[3] }\n"
+        "function f1() { G1 X[f0()] Y[1] }\n"
+        "let inner = f0()\n"
+        "let outer = f1()\n";
+
+    ASTNode *root = parse_script_from_string(code);
+    g_runtime.statement_count = 0;
+    reset_runtime_state();
+    emit_gcode(root);
+
+    TEST_ASSERT_EQUAL_DOUBLE(4.0, get_var("inner")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, get_var("outer")->number); // No return = 0.0 by convention
+
+    free_ast(root);
+}
+
+void test_emit_function_continues_after_nested_call(void)
+{
+    // A callee's return ends the callee only; the caller runs its next statements
+    const char *code =
+        "function inner(x) { return x * 2 }\n"
+        "function outer(y) {\n"
+        "  let r = inner(y)\n"
+        "  r = r + 1\n"
+        "  return r\n"
+        "}\n"
+        "let result = outer(3)\n"
+        "let calls = 0\n"
+        "for i = 0..<4 { calls = calls + inner(1) }\n";
+
+    ASTNode *root = parse_script_from_string(code);
+    g_runtime.statement_count = 0;
+    reset_runtime_state();
+    emit_gcode(root);
+
+    TEST_ASSERT_EQUAL_DOUBLE(7.0, get_var("result")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(8.0, get_var("calls")->number);
+
+    free_ast(root);
+}
+
 void test_array_assignment_and_access(void)
 {
 
@@ -771,7 +864,7 @@ void test_emit_maze_generator_program(void)
     Value *row0 = maze->array.items[0];
     TEST_ASSERT_NOT_NULL(row0);
     TEST_ASSERT_EQUAL(VAL_ARRAY, row0->type);
-    TEST_ASSERT_EQUAL_DOUBLE(0.0, row0->array.items[1]->number);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, array_item(row0, 1).number);
 
     free_ast(root);
 }
@@ -812,6 +905,10 @@ int main(void)
     RUN_TEST(test_emit_function_expr_args);              // 30
     RUN_TEST(test_builtin_min_max);                      // 31
     RUN_TEST(test_emit_function_empty_body);             // 32
+    RUN_TEST(test_emit_match_runs_one_arm);              // 33
+    RUN_TEST(test_emit_operands_evaluate_left_to_right); // 34
+    RUN_TEST(test_emit_function_no_return_after_nested_call); // 35
+    RUN_TEST(test_emit_function_continues_after_nested_call); // 36
 
     return UNITY_END();
 }
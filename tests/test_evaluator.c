@@ -1021,6 +1021,377 @@ void test_eval_string_mixed_content(void)
     free_ast(root);
 }
 
+void test_eval_resolver_gives_each_name_one_slot(void)
+{
+    ASTNode *root = parse_script_from_string(
+        "let a = 1\n"
+        "let b = a + 2\n"
+        "a += b\n"
+        "function f(a) { return a }\n");
+    TEST_ASSERT_NOT_NULL(root);
+
+    ASTNode *let_a = root->block.statements[0];
+    ASTNode *let_b = root->block.statements[1];
+    ASTNode *compound = root->block.statements[2];
+    ASTNode *func = root->block.statements[3];
+
+    int slot = let_a->let_stmt.slot;
+    TEST_ASSERT_TRUE(slot > 0);
+    TEST_ASSERT_NOT_EQUAL(slot, let_b->let_stmt.slot);
+    TEST_ASSERT_EQUAL_INT(slot, let_b->let_stmt.expr->binary_expr.left->var.slot);
+    TEST_ASSERT_EQUAL_INT(slot, compound->compound_assign.slot);
+    TEST_ASSERT_EQUAL_INT(let_b->let_stmt.slot, compound->compound_assign.expr->var.slot);
+    TEST_ASSERT_NOT_NULL(func->function_stmt.param_slots);
+    TEST_ASSERT_EQUAL_INT(slot, func->function_stmt.param_slots[0]);
+
+    free_ast(root);
+}
+
+void test_eval_slot_bindings_keep_dynamic_scope(void)
+{
+    reset_runtime_state();
+
+    // A callee sees its caller's parameter; the global comes back once the call returns
+    ASTNode *root = parse_script_from_string(
+        "let x = 1\n"
+        "function inner() { return x }\n"
+        "function outer(x) { return inner() }\n"
+        "let during = outer(5)\n"
+        "let after = inner()\n");
+    TEST_ASSERT_NOT_NULL(root);
+    emit_gcode(root);
+
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, get_var("during")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, get_var("after")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, get_var("x")->number);
+
+    free_ast(root);
+}
+
+void test_eval_variables_grow_past_old_limit(void)
+{
+    reset_runtime_state();
+
+    // 3000 distinct globals: more than the old fixed table of 1024 could hold
+    size_t size = 3000 * 24 + 1;
+    char *source = malloc(size);
+    TEST_ASSERT_NOT_NULL(source);
+    size_t used = 0;
+    for (int i = 0; i < 3000; i++)
+        used += (size_t)snprintf(source + used, size - used, "let v%d = %d\n", i, i);
+
+    ASTNode *root = parse_script_from_string(source);
+    TEST_ASSERT_NOT_NULL(root);
+    emit_gcode(root);
+
+    TEST_ASSERT_EQUAL_INT(3000, get_runtime()->var_count);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, get_var("v0")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(2999.0, get_var("v2999")->number);
+
+    free_ast(root);
+    free(source);
+    reset_runtime_state();
+}
+
+void test_eval_exit_scope_drops_the_whole_frame(void)
+{
+    reset_runtime_state();
+    set_var("x", make_number_value(1.0));
+    int globals = get_runtime()->var_count;
+
+    enter_scope();
+    declare_var("x", make_number_value(2.0));
+    enter_scope();
+    declare_var("y", make_number_value(3.0));
+    declare_var("x", make_number_value(4.0));
+    TEST_ASSERT_EQUAL_DOUBLE(4.0, get_var("x")->number);
+
+    exit_scope();
+    TEST_ASSERT_EQUAL_INT(globals + 1, get_runtime()->var_count);
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, get_var("x")->number);
+    TEST_ASSERT_FALSE(var_exists("y"));
+
+    exit_scope();
+    TEST_ASSERT_EQUAL_INT(globals, get_runtime()->var_count);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, get_var("x")->number);
+    reset_runtime_state();
+}
+
+void test_eval_value_keeps_numbers_unboxed(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string("let r = 2\nlet a = -(r * cos(0) + 0.00000123) / 4");
+    eval_expr(root->block.statements[0]);
+    Value *var = get_var("r");
+
+    // Same result and rounding as the heap path
+    Value value = eval_value(root->block.statements[1]->let_stmt.expr);
+    TEST_ASSERT_EQUAL(VAL_NUMBER, value.type);
+    TEST_ASSERT_EQUAL_DOUBLE(get_number(eval_expr(root->block.statements[1]->let_stmt.expr)), value.number);
+    TEST_ASSERT_EQUAL_DOUBLE(make_number_value(0.0012345678)->number, number_value(0.0012345678).number);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, number_value(0.000001).number);
+
+    // Storing a number over a number reuses the variable's Value
+    Value next = number_value(7.5);
+    set_var("r", &next);
+    TEST_ASSERT_TRUE(get_var("r") == var);
+    TEST_ASSERT_EQUAL_DOUBLE(7.5, var->number);
+
+    free_ast(root);
+    reset_runtime_state();
+}
+
+void test_eval_statement_temporaries_are_released(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string(
+        "let s = \"ab\"\n"
+        "for i = 0..200 {\n"
+        "  y = [i, i + 1]\n"
+        "  s = \"cd\"\n"
+        "}\n");
+    Arena *scratch = &get_runtime()->scratch;
+    size_t before = scratch->used;
+    scratch->peak = before;
+
+    emit_gcode(root);
+
+    // Every statement gave its temporaries back; only stored values were kept
+    TEST_ASSERT_EQUAL_UINT(before, scratch->used);
+    TEST_ASSERT_TRUE(scratch->peak - before < 1024);
+    TEST_ASSERT_EQUAL_STRING("cd", get_var("s")->string);
+    TEST_ASSERT_EQUAL_DOUBLE(201.0, array_item(get_var("y"), 1).number);
+
+    free_ast(root);
+    reset_runtime_state();
+}
+
+void test_eval_arrays_share_until_written(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string(
+        "let a = [1, [2, 3], \"s\"]\n"
+        "let b = a\n"
+        "function id(x) { return x }\n"
+        "let c = id(a)\n");
+    emit_gcode(root);
+
+    // Assignment, the argument and the return all took the same payload
+    Value *a = get_var("a");
+    Value *c = get_var("c");
+    TEST_ASSERT_TRUE(a->array.items == get_var("b")->array.items);
+    TEST_ASSERT_TRUE(a->array.items == c->array.items);
+    TEST_ASSERT_EQUAL_UINT(3, *a->refs);
+
+    // Writing through one owner copies only the path it changes
+    ASTNode *store = parse_script_from_string("b[1][0] = 9");
+    emit_gcode(store);
+    Value *b = get_var("b");
+    TEST_ASSERT_TRUE(a->array.items != b->array.items);
+    TEST_ASSERT_EQUAL_UINT(2, *a->refs);
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, array_item(a->array.items[1], 0).number);
+    TEST_ASSERT_EQUAL_DOUBLE(9.0, array_item(b->array.items[1], 0).number);
+    TEST_ASSERT_TRUE(a->array.items[2]->string == b->array.items[2]->string);
+
+    free_ast(store);
+    free_ast(root);
+    reset_runtime_state();
+}
+
+void test_eval_number_arrays_are_packed(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string(
+        "let xs = [1, 2.5, 3]\n"
+        "let pts = [[0, 1], [2, 3], [4, 5]]\n"
+        "xs[4] = 8\n"
+        "pts[3] = [6, 7]\n"
+        "let mixed = [1, 2]\n"
+        "mixed[1] = \"s\"\n"
+        "let grid = [[0, 0], [0, 0]]\n"
+        "grid[1][0] = 9\n");
+    emit_gcode(root);
+
+    // Number lists hold plain doubles, point lists one row after another
+    Value *xs = get_var("xs");
+    TEST_ASSERT_EQUAL_UINT(1, xs->width);
+    TEST_ASSERT_EQUAL_UINT(5, xs->array.count);
+    TEST_ASSERT_EQUAL_DOUBLE(2.5, xs->array.numbers[1]);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, xs->array.numbers[3]);
+    TEST_ASSERT_EQUAL_DOUBLE(8.0, xs->array.numbers[4]);
+
+    Value *pts = get_var("pts");
+    TEST_ASSERT_EQUAL_UINT(2, pts->width);
+    TEST_ASSERT_EQUAL_UINT(4, pts->array.count);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, pts->array.numbers[5]);
+    TEST_ASSERT_EQUAL_DOUBLE(7.0, pts->array.numbers[7]);
+    Value row = array_item(pts, 2);
+    TEST_ASSERT_EQUAL(VAL_ARRAY, row.type);
+    TEST_ASSERT_EQUAL_DOUBLE(4.0, array_item(&row, 0).number);
+
+    // A string makes the array hold Values; storing into a row gives each row its own array
+    Value *mixed = get_var("mixed");
+    TEST_ASSERT_EQUAL_UINT(0, mixed->width);
+    TEST_ASSERT_EQUAL(VAL_NUMBER, mixed->array.items[0]->type);
+    TEST_ASSERT_EQUAL_STRING("s", mixed->array.items[1]->string);
+
+    Value *grid = get_var("grid");
+    TEST_ASSERT_EQUAL_UINT(0, grid->width);
+    TEST_ASSERT_EQUAL_UINT(1, grid->array.items[1]->width);
+    TEST_ASSERT_EQUAL_DOUBLE(9.0, grid->array.items[1]->array.numbers[0]);
+
+    free_ast(root);
+    reset_runtime_state();
+}
+
+void test_eval_array_builtins(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string(
+        "let pts = []\n"
+        "for i = 0..<100 { push(pts, [i, i * 2]) }\n"
+        "let last = pop(pts)\n"
+        "let xs = [5, 3, 9, 1]\n"
+        "let sorted = sort(xs)\n"
+        "let backwards = reverse(xs)\n"
+        "let middle = slice(xs, 1, 3)\n"
+        "let stats = [len(xs), sum(xs), min(xs), max(xs), max(2, 3)]\n"
+        "let len = len(\"abc\")\n");
+    emit_gcode(root);
+
+    // Rows pushed onto an empty array stay packed, in a block that doubled as it grew
+    Value *pts = get_var("pts");
+    TEST_ASSERT_EQUAL_UINT(2, pts->width);
+    TEST_ASSERT_EQUAL_UINT(99, pts->array.count);
+    TEST_ASSERT_EQUAL_DOUBLE(196.0, pts->array.numbers[197]);
+    TEST_ASSERT_EQUAL_DOUBLE(198.0, array_item(get_var("last"), 1).number);
+
+    // sort() and reverse() return new arrays, leaving their argument as it was
+    static const double sorted[] = {1, 3, 5, 9}, backwards[] = {1, 9, 3, 5}, stats[] = {4, 18, 1, 9, 3};
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL_DOUBLE(sorted[i], array_item(get_var("sorted"), i).number);
+        TEST_ASSERT_EQUAL_DOUBLE(backwards[i], array_item(get_var("backwards"), i).number);
+    }
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, array_item(get_var("xs"), 0).number);
+    TEST_ASSERT_EQUAL_UINT(2, get_var("middle")->array.count);
+    TEST_ASSERT_EQUAL_DOUBLE(9.0, array_item(get_var("middle"), 1).number);
+    for (int i = 0; i < 5; i++)
+        TEST_ASSERT_EQUAL_DOUBLE(stats[i], array_item(get_var("stats"), i).number);
+
+    // The array helpers are plain identifiers, so they can still name variables
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, get_var("len")->number);
+    TEST_ASSERT_FALSE(builtin_is_pure(bind_builtin(TOKEN_IDENTIFIER, "push", 2)));
+    TEST_ASSERT_TRUE(builtin_changes_array(bind_builtin(TOKEN_IDENTIFIER, "pop", 1)));
+    TEST_ASSERT_FALSE(builtin_changes_array(bind_builtin(TOKEN_IDENTIFIER, "sum", 1)));
+
+    free_ast(root);
+    reset_runtime_state();
+}
+
+void test_eval_maps(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string(
+        "let glyphs = {\"A\": [1, 0, 1], \"B\": 2}\n"
+        "let shared = glyphs\n"
+        "glyphs[\"C\"] = \"c\"\n"
+        "glyphs[\"A\"][1] = 5\n"
+        "let picked = glyphs[\"A\"][1]\n"
+        "let found = [has(glyphs, \"C\"), has(shared, \"C\"), has(glyphs, \"never\"), len(glyphs)]\n"
+        "let names = keys(glyphs)\n");
+    emit_gcode(root);
+
+    Value *glyphs = get_var("glyphs");
+    TEST_ASSERT_EQUAL(VAL_MAP, glyphs->type);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, get_var("picked")->number);
+
+    // Storing copies the map first while another variable shares it
+    static const double found[] = {1, 0, 0, 3};
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL_DOUBLE(found[i], array_item(get_var("found"), i).number);
+    Value key = {.type = VAL_STRING, .string = "A"};
+    Value element;
+    TEST_ASSERT_TRUE(element_value(get_var("shared"), &key, &element));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, array_item(&element, 1).number);
+
+    // Keys come back in the order they were first stored
+    Value *names = get_var("names");
+    TEST_ASSERT_EQUAL_UINT(3, names->array.count);
+    TEST_ASSERT_EQUAL_STRING("A", names->array.items[0]->string);
+    TEST_ASSERT_EQUAL_STRING("C", names->array.items[2]->string);
+
+    // A deep copy owns everything it holds
+    Value *copy = copy_value(glyphs);
+    TEST_ASSERT_TRUE(store_entry(copy, &key, &element));
+    TEST_ASSERT_TRUE(element_value(glyphs, &key, &element));
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, array_item(&element, 1).number);
+    free_value(copy);
+
+    free_ast(root);
+    reset_runtime_state();
+}
+
+void test_eval_strings_are_interned(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string(
+        "let last = \"\"\n"
+        "let hits = 0\n"
+        "for c in \"BAB\" { last = c \n if c == \"B\" { hits += 1 } }\n"
+        "let literal = \"B\"\n"
+        "let word = \"BA\"\n"
+        "let same = [literal == last, word == \"BA\", word != \"AB\", word == last]\n");
+    emit_gcode(root);
+
+    // Characters and one-character literals are the same static text, so nothing was allocated
+    Value *last = get_var("last");
+    TEST_ASSERT_TRUE(last->string == intern_byte('B'));
+    TEST_ASSERT_TRUE(get_var("literal")->string == last->string);
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, get_var("hits")->number);
+
+    static const double same[] = {1, 1, 1, 0};
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL_DOUBLE(same[i], array_item(get_var("same"), i).number);
+
+    // A copy keeps sharing the text; a string built elsewhere still compares by content
+    Value *copy = copy_value(get_var("word"));
+    TEST_ASSERT_TRUE(copy->string == get_var("word")->string);
+    Value *built = make_string_value("BA");
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, apply_binary(TOKEN_EQUAL_EQUAL, copy, built).number);
+    free_value(copy);
+    free_value(built);
+
+    free_ast(root);
+    reset_runtime_state();
+}
+
+void test_eval_calls_use_bound_functions(void)
+{
+    reset_runtime_state();
+    ASTNode *root = parse_script_from_string(
+        "function is_nan(a, b) { return a + b }\n"
+        "function twice(x) { return x * 2 }\n"
+        "let n = is_nan(1, 2)\n"
+        "let m = is_nan(0)\n"
+        "let t = twice(4)\n"
+        "function twice(x) { return x * 3 }\n"
+        "let u = twice(4)\n"
+        "let h = hypot(3, 4)\n");
+    emit_gcode(root);
+
+    // A built-in of that name with another arity does not hide a user function
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, get_var("n")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, get_var("m")->number);
+    // Redefinition replaces the registry entry in place
+    TEST_ASSERT_EQUAL_DOUBLE(8.0, get_var("t")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(12.0, get_var("u")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, get_var("h")->number);
+    TEST_ASSERT_EQUAL_INT(2, get_runtime()->function_count);
+
+    free_ast(root);
+    reset_runtime_state();
+}
 
 int main(void)
 {
@@ -1085,6 +1456,18 @@ int main(void)
      RUN_TEST(test_eval_string_memory_management);         //56
      RUN_TEST(test_eval_string_copy_independence);         //57
      RUN_TEST(test_eval_string_mixed_content);             //58tion);       //49 - NEW
+     RUN_TEST(test_eval_resolver_gives_each_name_one_slot); //59
+     RUN_TEST(test_eval_slot_bindings_keep_dynamic_scope); //60
+     RUN_TEST(test_eval_variables_grow_past_old_limit);    //61
+     RUN_TEST(test_eval_exit_scope_drops_the_whole_frame); //62
+     RUN_TEST(test_eval_value_keeps_numbers_unboxed);      //63
+     RUN_TEST(test_eval_statement_temporaries_are_released); //64
+     RUN_TEST(test_eval_arrays_share_until_written);       //65
+     RUN_TEST(test_eval_calls_use_bound_functions);        //66
+     RUN_TEST(test_eval_number_arrays_are_packed);         //67
+     RUN_TEST(test_eval_array_builtins);                   //68
+     RUN_TEST(test_eval_maps);                             //69
+     RUN_TEST(test_eval_strings_are_interned);             //70
      RUN_TEST(test_eval_recursion_recovery_and_stability); //50 - NEW
     return UNITY_END();
 }
@@ -0,0 +1,175 @@
+#include "Unity/src/unity.h"
+#include "parser/flat_ast.h"
+#include "parser/parser.h"
+#include "runtime/evaluator.h"
+#include "generator/emitter.h"
+#include "utils/output_buffer.h"
+#include "config/config.h"
+#include <stdlib.h>
+#include <string.h>
+
+static FlatAst flat;
+
+void setUp(void)
+{
+    memset(&flat, 0, sizeof(flat));
+}
+
+void tearDown(void)
+{
+    flat_ast_free(&flat);
+}
+
+/// @brief Compiles `source` from scratch through one of the walkers and returns the G-code
+static char *compile_with(const char *source, int use_flat)
+{
+    init_runtime();
+    reset_config_state();
+    reset_runtime_state();
+    reset_emitter_state();
+    reset_line_number();
+    init_output_buffer();
+
+    ASTNode *root = parse_script_from_string(source);
+    TEST_ASSERT_NOT_NULL(root);
+
+    if (use_flat)
+    {
+        flat_ast_reset(&flat);
+        FlatIndex index = flat_ast_append(&flat, root);
+        TEST_ASSERT_TRUE(index != FLAT_NONE);
+        emit_gcode_flat(&flat, index);
+    }
+    else
+    {
+        emit_gcode(root);
+    }
+
+    char *output = strdup(get_output_buffer());
+    free_output_buffer();
+    free_ast(root);
+    return output;
+}
+
+static void assert_walkers_agree(const char *source)
+{
+    char *expected = compile_with(source, 0);
+    char *actual = compile_with(source, 1);
+    TEST_ASSERT_TRUE(strlen(expected) > 0);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(expected);
+    free(actual);
+}
+
+void test_flat_layout_is_preorder_with_side_tables(void)
+{
+    init_runtime();
+    ASTNode *root = parse_script_from_string("let a = 1 + 2.5\nG1 X[a] Y[3]");
+    TEST_ASSERT_NOT_NULL(root);
+
+    FlatIndex index = flat_ast_append(&flat, root);
+    TEST_ASSERT_EQUAL_UINT(0, index);
+
+    // block, let, binary, 1, 2.5, gcode, var a, 3
+    TEST_ASSERT_EQUAL_UINT(8, flat.count);
+    const FlatNode *block = &flat.nodes[0];
+    TEST_ASSERT_EQUAL(AST_BLOCK, block->type);
+    TEST_ASSERT_EQUAL_UINT(2, block->b);
+    TEST_ASSERT_EQUAL_UINT(1, flat.lists[block->a]);
+    TEST_ASSERT_EQUAL_UINT(5, flat.lists[block->a + 1]);
+
+    const FlatNode *let = &flat.nodes[1];
+    TEST_ASSERT_EQUAL(AST_LET, let->type);
+    TEST_ASSERT_EQUAL_STRING("a", flat.names[let->a]);
+    TEST_ASSERT_EQUAL_UINT(2, let->b);
+    TEST_ASSERT_EQUAL(TOKEN_PLUS, flat.nodes[2].op);
+    TEST_ASSERT_EQUAL_UINT(3, flat.nodes[2].a);
+    TEST_ASSERT_EQUAL_UINT(4, flat.nodes[2].b);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, flat.numbers[flat.nodes[3].a]);
+    TEST_ASSERT_EQUAL_DOUBLE(2.5, flat.numbers[flat.nodes[4].a]);
+
+    const FlatNode *gcode = &flat.nodes[5];
+    TEST_ASSERT_EQUAL(AST_GCODE, gcode->type);
+    TEST_ASSERT_EQUAL_STRING("G1", flat.names[gcode->a]);
+    TEST_ASSERT_EQUAL_UINT(2, gcode->c);
+    TEST_ASSERT_EQUAL_INT(root->block.statements[1]->gcode_stmt.code_id, (int)flat.lists[gcode->b]);
+    TEST_ASSERT_EQUAL_UINT('X' - 'A', flat.lists[gcode->b + 2]);
+    TEST_ASSERT_EQUAL(AST_VAR, flat.nodes[flat.lists[gcode->b + 3]].type);
+    TEST_ASSERT_EQUAL_UINT('Y' - 'A', flat.lists[gcode->b + 4]);
+
+    // Every flat node remembers the pointer node it came from
+    TEST_ASSERT_TRUE(flat.origin[0] == root);
+    TEST_ASSERT_TRUE(flat.origin[1] == root->block.statements[0]);
+    free_ast(root);
+}
+
+void test_flat_reset_keeps_storage(void)
+{
+    init_runtime();
+    ASTNode *root = parse_script_from_string("for i = 0..3 { G1 X[i] }");
+    TEST_ASSERT_TRUE(flat_ast_append(&flat, root) != FLAT_NONE);
+    FlatNode *nodes = flat.nodes;
+    uint32_t capacity = flat.capacity;
+
+    flat_ast_reset(&flat);
+    TEST_ASSERT_EQUAL_UINT(0, flat.count);
+    TEST_ASSERT_EQUAL_UINT(0, flat_ast_append(&flat, root));
+    TEST_ASSERT_TRUE(flat.nodes == nodes);
+    TEST_ASSERT_EQUAL_UINT(capacity, flat.capacity);
+    free_ast(root);
+}
+
+void test_flat_walker_matches_pointer_walker_on_control_flow(void)
+{
+    assert_walkers_agree(
+        "let total = 0\n"
+        "for i = 0..<6 step 2 {\n"
+        "  total += i\n"
+        "  if i == 2 { G1 X[i] Y[total] } else { G0 X[-i] Z[i > 3 ? 1 : 0] }\n"
+        "}\n"
+        "let n = 3\n"
+        "while n > 0 { G1 Z[n * 0.5] \n n -= 1 }\n"
+        "for j = 3..1 { G2 X[j] I[j / 2] }\n");
+}
+
+void test_flat_walker_matches_pointer_walker_on_calls_and_arrays(void)
+{
+    assert_walkers_agree(
+        "function sq(x) { return x * x }\n"
+        "function spiral(r) { for k = 0..2 { G1 X[cos(k) * r] Y[sin(k) * r] } }\n"
+        "let pts = [[1, 2], [3, 4]]\n"
+        "pts[1] = [5, 6]\n"
+        "spiral(2)\n"
+        "G1 X[sq(pts[1][0])] Y[max(pts[0][1], 7)] F[abs(-100)]\n"
+        "note { total [sq(3)] }\n"
+        "let word = \"ab\"\n"
+        "for c in word { note { char [c] } }\n");
+}
+
+void test_flat_walker_runs_example_program(void)
+{
+    FILE *file = fopen("GGCODE/Flower of Life basic grid.ggcode", "rb");
+    TEST_ASSERT_NOT_NULL_MESSAGE(file, "example program not found");
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    char *source = calloc((size_t)size + 1, 1);
+    TEST_ASSERT_NOT_NULL(source);
+    TEST_ASSERT_TRUE(fread(source, 1, (size_t)size, file) == (size_t)size);
+    fclose(file);
+
+    assert_walkers_agree(source);
+    free(source);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_flat_layout_is_preorder_with_side_tables);             // 1
+    RUN_TEST(test_flat_reset_keeps_storage);                             // 2
+    RUN_TEST(test_flat_walker_matches_pointer_walker_on_control_flow);   // 3
+    RUN_TEST(test_flat_walker_matches_pointer_walker_on_calls_and_arrays); // 4
+    RUN_TEST(test_flat_walker_runs_example_program);                     // 5
+    return UNITY_END();
+}
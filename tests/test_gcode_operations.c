@@ -6,6 +6,8 @@
 #include "../src/parser/parser.h"
 #include "../src/runtime/runtime_state.h"
 #include "../src/generator/emitter.h"
+#include "../src/utils/output_buffer.h"
+#include "../src/config/config.h"
 #include "Unity/src/unity.h"
 
 void setUp(void) {
@@ -255,6 +257,41 @@ void test_conditional_gcode_with_nested_operations(void) {
 }
 
 // Unity test runner setup
+// Repeated G-code words are modal: written once, then only the arguments follow
+void test_gcode_modal_words_written_once(void) {
+    const char* source =
+        "let nline = 0\n"
+        "G1 X[1]\n"
+        "G1 X[2] Y[3]\n"
+        "G0 Z[5]\n"
+        "G90 G94 G17 G21 G40 X[0]\n"
+        "G90 G94 G17 G21 G40 X[1]\n";
+
+    reset_config_state();
+    init_output_buffer();
+    ASTNode* ast = parse_script_from_string(source);
+    TEST_ASSERT_NOT_NULL(ast);
+
+    // Same words share one interned id
+    ASTNode* first = ast->block.statements[1];
+    TEST_ASSERT_EQUAL_INT(first->gcode_stmt.code_id, ast->block.statements[2]->gcode_stmt.code_id);
+    TEST_ASSERT_EQUAL_INT('X' - 'A', first->gcode_stmt.args[0].letter);
+
+    emit_gcode(ast);
+
+    // Only the first 15 bytes of a word list are remembered, so long ones repeat
+    TEST_ASSERT_EQUAL_STRING(
+        "G1 X1.000\n"
+        " X2.000 Y3.000\n"
+        "G0 Z5.000\n"
+        "G90 G94 G17 G21 G40 X0.000\n"
+        "G90 G94 G17 G21 G40 X1.000\n",
+        get_output_buffer());
+
+    free_ast(ast);
+    free_output_buffer();
+}
+
 int main(void) {
     UNITY_BEGIN();
     
@@ -266,6 +303,7 @@ int main(void) {
     RUN_TEST(test_coordinate_transformation_with_flags);
     RUN_TEST(test_loop_gcode_generation_with_operations);
     RUN_TEST(test_conditional_gcode_with_nested_operations);
+    RUN_TEST(test_gcode_modal_words_written_once);
     
     return UNITY_END();
 }
\ No newline at end of file
@@ -1,14 +1,15 @@
 #include "Unity/src/unity.h"
 #include "../src/lexer/lexer.h"
 #include "../src/lexer/token_types.h"
+#include "../src/lexer/token_array.h"
+#include "../src/utils/file_utils.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-// Add static test-local implementation of token_free at the top
+// Tokens borrow their text from the intern table, so there is nothing to free
 static void token_free(Token token) {
-    if (token.value) {
-        free(token.value);
-    }
+    (void)token;
 }
 
 int print_tokens_logs = 0;
@@ -599,6 +600,249 @@ void test_string_with_unterminated_escape()
     free_token_list(&tokens);
 }
 
+void test_identifiers_share_interned_text()
+{
+    // Repeated names must resolve to the same interned text and id
+    TokenList tokens = lex_source("let abc = abc + abcd");
+    print_tokens(&tokens);
+
+    TEST_ASSERT_EQUAL(TOKEN_IDENTIFIER, tokens.tokens[1].type);
+    TEST_ASSERT_EQUAL(TOKEN_IDENTIFIER, tokens.tokens[3].type);
+    TEST_ASSERT_TRUE(tokens.tokens[1].value == tokens.tokens[3].value);
+    TEST_ASSERT_EQUAL(tokens.tokens[1].id, tokens.tokens[3].id);
+    TEST_ASSERT_TRUE(tokens.tokens[1].value != tokens.tokens[5].value);
+
+    // Slices point back into the source
+    TEST_ASSERT_EQUAL(4, tokens.tokens[1].offset);
+    TEST_ASSERT_EQUAL(3, tokens.tokens[1].length);
+    TEST_ASSERT_EQUAL(4, tokens.tokens[5].length);
+
+    free_token_list(&tokens);
+}
+
+void test_every_keyword_and_operator_from_tables()
+{
+    // Each X-macro entry must lex back to its own token type
+#define X(name, type) \
+    { TokenList tokens = lex_source(name); \
+      assert_token(tokens.tokens[0], type, name); \
+      free_token_list(&tokens); }
+    KEYWORD_LIST
+    TOKEN_FUNCTION_LIST
+#undef X
+
+    // ';' is skipped like whitespace, so it never reaches the dispatch table
+#define X(text, type, str, ch) \
+    if (type != TOKEN_SEMICOLON) \
+    { TokenList tokens = lex_source(text " "); \
+      assert_token(tokens.tokens[0], type, text); \
+      free_token_list(&tokens); }
+    TOKEN_OPERATOR_LIST
+    TOKEN_DELIMITER_LIST
+#undef X
+
+    // Near-misses stay identifiers
+    TokenList tokens = lex_source("lets sine PIE atan3");
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL(TOKEN_IDENTIFIER, tokens.tokens[i].type);
+    free_token_list(&tokens);
+}
+
+static void write_sized_script(const char *path, long size)
+{
+    // "let a = 1" padded with comment bytes to an exact file size
+    FILE *f = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fputs("let a = 1\n//", f);
+    for (long i = 12; i < size; i++)
+        fputc('x', f);
+    fclose(f);
+}
+
+void test_source_view_borrows_file_bytes()
+{
+    const char *path = "test_lexer_view.tmp.ggcode";
+    long sizes[] = {4000, 4096, 8192 + 7};
+
+    for (int i = 0; i < 3; i++)
+    {
+        write_sized_script(path, sizes[i]);
+
+        SourceView view;
+        TEST_ASSERT_TRUE(open_source_view(path, &view));
+        TEST_ASSERT_EQUAL(sizes[i], view.size);
+        TEST_ASSERT_EQUAL('\0', view.data[view.size]);
+
+        // The lexer reads the view in place: no copy of the source
+        Lexer *lexer = lexer_new(view.data);
+        TEST_ASSERT_TRUE(lexer->source == view.data);
+        Token token = lexer_next_token(lexer);
+        assert_token(token, TOKEN_LET, "let");
+        lexer_next_token(lexer);
+        lexer_next_token(lexer);
+        assert_token(lexer_next_token(lexer), TOKEN_NUMBER, "1");
+        assert_token(lexer_next_token(lexer), TOKEN_EOF, "EOF");
+        lexer_free(lexer);
+
+        close_source_view(&view);
+        TEST_ASSERT_NULL(view.data);
+    }
+    remove(path);
+}
+
+void test_operators_at_end_of_input()
+{
+    // Each source sits in a buffer that ends at its NUL, so a longer operator
+    // candidate must not read past it
+    const char *sources[] = {"a <", "a <<", "a >>", "a <<=", "a !", "a -"};
+    Token_Type types[] = {TOKEN_LESS, TOKEN_LSHIFT, TOKEN_RSHIFT, TOKEN_LSHIFT_EQUAL, TOKEN_BANG, TOKEN_MINUS};
+
+    for (int i = 0; i < 6; i++)
+    {
+        size_t length = strlen(sources[i]);
+        char *source = malloc(length + 1);
+        TEST_ASSERT_NOT_NULL(source);
+        memcpy(source, sources[i], length + 1);
+
+        Lexer *lexer = lexer_new(source);
+        assert_token(lexer_next_token(lexer), TOKEN_IDENTIFIER, "a");
+        TEST_ASSERT_EQUAL(types[i], lexer_next_token(lexer).type);
+        assert_token(lexer_next_token(lexer), TOKEN_EOF, "EOF");
+        lexer_free(lexer);
+        free(source);
+    }
+}
+
+typedef struct
+{
+    const char *text;
+    size_t length;
+    size_t pos;
+} ChunkReader;
+
+// Hands out at most 7 bytes per call so tokens straddle chunk boundaries
+static size_t read_tiny_chunks(void *context, char *buffer, size_t capacity)
+{
+    ChunkReader *reader = context;
+    size_t n = reader->length - reader->pos;
+    if (n > 7)
+        n = 7;
+    if (n > capacity)
+        n = capacity;
+    memcpy(buffer, reader->text + reader->pos, n);
+    reader->pos += n;
+    return n;
+}
+
+void test_stream_lexer_matches_in_memory_lexer()
+{
+    const char *snippet =
+        "let radius = -10.5 // comment\n"
+        "/* block\n comment */ let name = \"a \\\"quoted\\\" str\"\n"
+        "for i = 0..<10 step 2 { G1 X[i * -0.25] Y[radius >= 1 && i != 3] }\n"
+        "x <<= 1 ; y = (-3) + [ -4 ]\n";
+    size_t snippet_len = strlen(snippet);
+    int repeat = 3000; // ~300 KB, several times the stream window
+    char *source = malloc(snippet_len * repeat + 1);
+    TEST_ASSERT_NOT_NULL(source);
+    for (int i = 0; i < repeat; i++)
+        memcpy(source + snippet_len * i, snippet, snippet_len);
+    source[snippet_len * repeat] = '\0';
+
+    ChunkReader reader = {source, snippet_len * repeat, 0};
+    Lexer *memory = lexer_new(source);
+    Lexer *stream = lexer_new_stream(read_tiny_chunks, &reader);
+    TEST_ASSERT_NOT_NULL(stream);
+
+    Token expected, actual;
+    do
+    {
+        expected = lexer_next_token(memory);
+        actual = lexer_next_token(stream);
+        TEST_ASSERT_EQUAL(expected.type, actual.type);
+        TEST_ASSERT_EQUAL_STRING(expected.value, actual.value);
+        TEST_ASSERT_EQUAL(expected.line, actual.line);
+        TEST_ASSERT_EQUAL(expected.column, actual.column);
+        TEST_ASSERT_TRUE(expected.offset == actual.offset);
+    } while (expected.type != TOKEN_EOF);
+
+    // Only a bounded window of the input was ever held
+    TEST_ASSERT_TRUE(stream->window_capacity < reader.length);
+
+    lexer_free(stream);
+    lexer_free(memory);
+    free(source);
+}
+
+void test_note_body_is_one_raw_token()
+{
+    Lexer *lexer = lexer_new("note { a {b} \"c\" // d }\nG1");
+    assert_token(lexer_next_token(lexer), TOKEN_NOTE, "note");
+    assert_token(lexer_next_token(lexer), TOKEN_LBRACE, "{");
+
+    Token body = lexer_next_token(lexer);
+    TEST_ASSERT_EQUAL(TOKEN_NOTE_TEXT, body.type);
+    TEST_ASSERT_EQUAL(16, body.length);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(body.value, " a {b} \"c\" // d ", 16));
+
+    assert_token(lexer_next_token(lexer), TOKEN_RBRACE, "}");
+    assert_token(lexer_next_token(lexer), TOKEN_GCODE_WORD, "G1");
+    lexer_free(lexer);
+}
+
+static void assert_token_array_matches_lexer(const char *source, int use_thread)
+{
+    TokenArray *tokens = token_array_new(source, use_thread);
+    TEST_ASSERT_NOT_NULL(tokens);
+    Lexer *lexer = lexer_new(source);
+
+    int index = 0;
+    Token expected, actual;
+    do
+    {
+        expected = lexer_next_token(lexer);
+        actual = token_array_at(tokens, index++);
+        TEST_ASSERT_EQUAL(expected.type, actual.type);
+        TEST_ASSERT_EQUAL_STRING(expected.value, actual.value);
+        TEST_ASSERT_TRUE(expected.offset == actual.offset);
+        TEST_ASSERT_EQUAL(expected.length, actual.length);
+
+        // Positions are not stored, only derived from the offset on request
+        int line, column;
+        token_array_position(tokens, actual.offset, &line, &column);
+        TEST_ASSERT_EQUAL(expected.line, line);
+        TEST_ASSERT_EQUAL(expected.column, column);
+    } while (expected.type != TOKEN_EOF);
+
+    // Reading past the end keeps returning EOF
+    TEST_ASSERT_EQUAL(TOKEN_EOF, token_array_at(tokens, index + 10).type);
+
+    lexer_free(lexer);
+    token_array_free(tokens);
+}
+
+void test_token_array_matches_incremental_lexer()
+{
+    const char *snippet =
+        "let radius = -10.5 // comment\n"
+        "for i = 0..<10 step 2 { G1 X[i * -0.25] Y[radius >= 1 && i != 3] }\n"
+        "note { r = [radius] }\n"
+        "let name = \"a\\tb\"\n";
+    size_t snippet_len = strlen(snippet);
+    int repeat = 3000; // several token blocks
+    char *source = malloc(snippet_len * repeat + 1);
+    TEST_ASSERT_NOT_NULL(source);
+    for (int i = 0; i < repeat; i++)
+        memcpy(source + snippet_len * i, snippet, snippet_len);
+    source[snippet_len * repeat] = '\0';
+
+    assert_token_array_matches_lexer(source, 0);
+    assert_token_array_matches_lexer(source, 1);
+    assert_token_array_matches_lexer("", 1);
+
+    free(source);
+}
+
 // === UNITY HOOKS ===
 
 void setUp(void) {}
@@ -639,5 +883,12 @@ int main(void)
     RUN_TEST(test_unterminated_string_error);            // 30
     RUN_TEST(test_invalid_escape_sequence_error);        // 31
     RUN_TEST(test_string_with_unterminated_escape);      // 32
+    RUN_TEST(test_identifiers_share_interned_text);      // 33
+    RUN_TEST(test_every_keyword_and_operator_from_tables); // 34
+    RUN_TEST(test_source_view_borrows_file_bytes);       // 35
+    RUN_TEST(test_stream_lexer_matches_in_memory_lexer); // 36
+    RUN_TEST(test_note_body_is_one_raw_token);           // 37
+    RUN_TEST(test_token_array_matches_incremental_lexer); // 38
+    RUN_TEST(test_operators_at_end_of_input);            // 39
     return UNITY_END();
 }
@@ -0,0 +1,161 @@
+#include "Unity/src/unity.h"
+#include "parser/parser.h"
+#include "parser/optimizer.h"
+#include "runtime/evaluator.h"
+#include "generator/emitter.h"
+#include "utils/output_buffer.h"
+#include "config/config.h"
+#include "error/error.h"
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void)
+{
+    init_runtime();
+    reset_config_state();
+    reset_runtime_state();
+    reset_emitter_state();
+    reset_line_number();
+}
+
+void tearDown(void)
+{
+}
+
+/// @brief Parses and optimizes `source` as a whole program
+static ASTNode *optimize(const char *source)
+{
+    ASTNode *root = parse_script_from_string(source);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_EQUAL(AST_BLOCK, root->type);
+    optimize_ast(root, 1);
+    return root;
+}
+
+/// @brief Compiles `source` from scratch with the tree walker, optimized or as written
+static char *compile_with(const char *source, int optimized)
+{
+    setUp();
+    init_output_buffer();
+
+    ASTNode *root = parse_script_from_string(source);
+    TEST_ASSERT_NOT_NULL(root);
+    if (optimized)
+        optimize_ast(root, 1);
+    emit_gcode(root);
+
+    char *output = strdup(get_output_buffer());
+    free_output_buffer();
+    free_ast(root);
+    return output;
+}
+
+void test_optimizer_folds_constants_with_runtime_rounding(void)
+{
+    ASTNode *root = optimize("G1 X[1 + 2 * 3] Y[sqrt(16) - max(1, 2)] Z[0.000004 * 2] F[2 > 1 ? PI : 0]");
+    TEST_ASSERT_EQUAL(1, root->block.count);
+
+    ASTNode *line = root->block.statements[0];
+    TEST_ASSERT_EQUAL(AST_GCODE, line->type);
+    TEST_ASSERT_EQUAL(4, line->gcode_stmt.argCount);
+    for (int i = 0; i < line->gcode_stmt.argCount; i++)
+        TEST_ASSERT_EQUAL(AST_NUMBER, line->gcode_stmt.args[i].indexExpr->type);
+
+    TEST_ASSERT_EQUAL_DOUBLE(7.0, line->gcode_stmt.args[0].indexExpr->number.value);
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, line->gcode_stmt.args[1].indexExpr->number.value);
+    // Rounded away like the walker's make_number_value() would
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, line->gcode_stmt.args[2].indexExpr->number.value);
+    TEST_ASSERT_EQUAL_DOUBLE(number_value(3.14159265358979323846).number, line->gcode_stmt.args[3].indexExpr->number.value);
+    free_ast(root);
+}
+
+void test_optimizer_leaves_expressions_that_report_errors(void)
+{
+    ASTNode *root = optimize("G1 X[1 / 0] Y[\"a\" + 1] Z[\"a\" == \"a\"]");
+    ASTNode *line = root->block.statements[0];
+    TEST_ASSERT_EQUAL(AST_BINARY, line->gcode_stmt.args[0].indexExpr->type);
+    TEST_ASSERT_EQUAL(AST_BINARY, line->gcode_stmt.args[1].indexExpr->type);
+    TEST_ASSERT_EQUAL(AST_NUMBER, line->gcode_stmt.args[2].indexExpr->type);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, line->gcode_stmt.args[2].indexExpr->number.value);
+    TEST_ASSERT_FALSE(has_errors());
+    free_ast(root);
+}
+
+void test_optimizer_propagates_only_unchanged_top_level_lets(void)
+{
+    ASTNode *root = optimize(
+        "function f() { G1 X[a] Y[late] }\n"   // 0
+        "let a = 2\n"                          // 1
+        "let b = 1\n"                          // 2
+        "b = 3\n"                              // 3
+        "G1 X[a * 5] Y[b]\n"                   // 4
+        "f()\n"                                // 5
+        "let late = 4\n"                       // 6
+        "G1 X[late]\n");                       // 7
+    TEST_ASSERT_EQUAL(8, root->block.count);
+
+    ASTNode *line = root->block.statements[4];
+    TEST_ASSERT_EQUAL(AST_NUMBER, line->gcode_stmt.args[0].indexExpr->type);
+    TEST_ASSERT_EQUAL_DOUBLE(10.0, line->gcode_stmt.args[0].indexExpr->number.value);
+    TEST_ASSERT_EQUAL(AST_VAR, line->gcode_stmt.args[1].indexExpr->type);
+
+    // `late` is bound after f() has run, so only the code after it may assume its value
+    ASTNode *body = root->block.statements[0]->function_stmt.body->block.statements[0];
+    TEST_ASSERT_EQUAL(AST_NUMBER, body->gcode_stmt.args[0].indexExpr->type);
+    TEST_ASSERT_EQUAL(AST_VAR, body->gcode_stmt.args[1].indexExpr->type);
+    TEST_ASSERT_EQUAL(AST_NUMBER, root->block.statements[7]->gcode_stmt.args[0].indexExpr->type);
+    free_ast(root);
+}
+
+void test_optimizer_removes_dead_branches_and_functions(void)
+{
+    ASTNode *root = optimize(
+        "function unused(x) { G1 X[x] }\n"
+        "function used(x) { G1 X[x] }\n"
+        "let mode = 2\n"
+        "if mode == 1 { G0 X[1] } else if mode == 2 { G1 X[2] } else { G2 X[3] }\n"
+        "if 0 { used(1) }\n"
+        "while 0 { G4 P[1] }\n"
+        "used(2)\n");
+    TEST_ASSERT_EQUAL(4, root->block.count);
+    TEST_ASSERT_EQUAL(AST_FUNCTION, root->block.statements[0]->type);
+    TEST_ASSERT_EQUAL_STRING("used", root->block.statements[0]->function_stmt.name);
+
+    // The live branch keeps its block, and so its scope
+    ASTNode *live = root->block.statements[2];
+    TEST_ASSERT_EQUAL(AST_BLOCK, live->type);
+    TEST_ASSERT_EQUAL(1, live->block.count);
+    TEST_ASSERT_EQUAL_STRING("G1", live->block.statements[0]->gcode_stmt.code);
+    TEST_ASSERT_EQUAL(AST_EXPR_STMT, root->block.statements[3]->type);
+    free_ast(root);
+}
+
+void test_optimizer_keeps_program_output(void)
+{
+    const char *source =
+        "let r = 10\n"
+        "let steps = 4\n"
+        "function ring(scale) { for k = 0..<steps { G1 X[cos(k * TAU / steps) * r * scale] Y[sin(k * TAU / steps) * r] } }\n"
+        "let mode = 1\n"
+        "if mode == 1 { ring(0.5) } else { ring(2) }\n"
+        "let w = \"abc\"\n"
+        "note { [w == \"abc\" ? r / 3 : 0] done }\n"
+        "G1 Z[r > 5 && steps < 3] F[abs(-r) * 100]\n";
+    char *expected = compile_with(source, 0);
+    char *actual = compile_with(source, 1);
+    TEST_ASSERT_TRUE(strlen(expected) > 0);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(expected);
+    free(actual);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_optimizer_folds_constants_with_runtime_rounding);     // 1
+    RUN_TEST(test_optimizer_leaves_expressions_that_report_errors);     // 2
+    RUN_TEST(test_optimizer_propagates_only_unchanged_top_level_lets); // 3
+    RUN_TEST(test_optimizer_removes_dead_branches_and_functions);       // 4
+    RUN_TEST(test_optimizer_keeps_program_output);                      // 5
+    return UNITY_END();
+}
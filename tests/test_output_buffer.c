@@ -156,6 +156,33 @@ void test_no_trailing_newline_write(void)
     TEST_ASSERT_EQUAL_CHAR('\n', buffer[len - 1]);
 }
 
+void test_flush_output_buffer_writes_and_empties(void)
+{
+    const char *filename = "test_output_flush.txt";
+    FILE *out = fopen(filename, "w");
+    TEST_ASSERT_NOT_NULL(out);
+
+    write_to_output("G1 X1");
+    TEST_ASSERT_EQUAL_UINT(6, flush_output_buffer(out));
+    TEST_ASSERT_EQUAL_UINT(0, get_output_length());
+    TEST_ASSERT_EQUAL_STRING("", get_output_buffer());
+
+    write_to_output("G1 X2");
+    TEST_ASSERT_EQUAL_UINT(6, flush_output_buffer(out));
+    TEST_ASSERT_EQUAL_UINT(0, flush_output_buffer(out));
+    fclose(out);
+
+    FILE *in = fopen(filename, "r");
+    TEST_ASSERT_NOT_NULL(in);
+    char contents[32] = {0};
+    size_t n = fread(contents, 1, sizeof(contents) - 1, in);
+    fclose(in);
+    remove(filename);
+
+    TEST_ASSERT_EQUAL_UINT(12, n);
+    TEST_ASSERT_EQUAL_STRING("G1 X1\nG1 X2\n", contents);
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -169,5 +196,6 @@ int main(void)
     RUN_TEST(test_multiple_prepends_order);              // 7
     RUN_TEST(test_prepend_after_large_write);            // 8
     RUN_TEST(test_no_trailing_newline_write);            // 9
+    RUN_TEST(test_flush_output_buffer_writes_and_empties); // 10
     return UNITY_END();
 }
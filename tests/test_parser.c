@@ -4,6 +4,9 @@
 #include "../src/lexer/lexer.h"
 #include "../src/parser/parser.h"
 #include "../src/lexer/token_utils.h"
+#include "../src/parser/resolver.h"
+#include "../src/runtime/evaluator.h"
+#include "../src/error/error.h"
 #include "../config/config.h"
 #include <string.h>
 
@@ -319,6 +322,56 @@ void test_parse_note_block(void)
     free_ast_result(&result);
 }
 
+void test_parse_note_template_segments(void)
+{
+    const char *source = "note {x = [x * 2] at [time]\n\nfile {ggcode_file_name}}";
+    ASTResult result = parse_source(source);
+
+    ASTNode *note_stmt = result.root->block.statements[0];
+    TEST_ASSERT_EQUAL(AST_NOTE, note_stmt->type);
+
+    // "x = ", [x * 2], " at ", [time], line end, "file ", [ggcode_file_name], line end
+    NoteSegmentKind expected[] = {NOTE_TEXT, NOTE_EXPR, NOTE_TEXT, NOTE_TIME, NOTE_LINE_END,
+                                  NOTE_TEXT, NOTE_FILE_NAME, NOTE_LINE_END};
+    TEST_ASSERT_EQUAL_INT(8, note_stmt->note.segment_count);
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT_EQUAL_INT(expected[i], note_stmt->note.segments[i].kind);
+
+    const NoteSegment *expr = &note_stmt->note.segments[1];
+    TEST_ASSERT_NOT_NULL(expr->expr);
+    TEST_ASSERT_EQUAL(AST_BINARY, expr->expr->type);
+    TEST_ASSERT_EQUAL_INT(4, note_stmt->note.segments[0].length);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(note_stmt->note.segments[0].text, "x = ", 4));
+
+    free_ast_result(&result);
+}
+
+void test_parse_note_placeholders_balance_brackets(void)
+{
+    // A note may never run, so a placeholder that does not parse must not fail the program
+    clear_errors();
+    const char *source = "note {v [floor(arr[0])] bad [1 +]}\nG1 X[1]";
+    ASTResult result = parse_source(source);
+    TEST_ASSERT_NOT_NULL(result.root);
+    TEST_ASSERT_EQUAL_INT(2, result.root->block.count);
+    TEST_ASSERT_FALSE(has_errors());
+
+    // "v ", [floor(arr[0])], " bad ", [1 +], line end
+    ASTNode *note_stmt = result.root->block.statements[0];
+    NoteSegmentKind expected[] = {NOTE_TEXT, NOTE_EXPR, NOTE_TEXT, NOTE_VAR, NOTE_LINE_END};
+    TEST_ASSERT_EQUAL_INT(5, note_stmt->note.segment_count);
+    for (int i = 0; i < 5; i++)
+        TEST_ASSERT_EQUAL_INT(expected[i], note_stmt->note.segments[i].kind);
+
+    const ASTNode *call = note_stmt->note.segments[1].expr;
+    TEST_ASSERT_EQUAL(AST_CALL, call->type);
+    TEST_ASSERT_EQUAL_INT(1, call->call_expr.arg_count);
+    TEST_ASSERT_EQUAL(AST_INDEX, call->call_expr.args[0]->type);
+    TEST_ASSERT_EQUAL_STRING("1 +", note_stmt->note.segments[3].text);
+
+    free_ast_result(&result);
+}
+
 void test_parse_gcode_implicit_G1(void)
 {
     const char *source = "G1 X[10] Y[20]";
@@ -1016,6 +1069,96 @@ void test_row_index_assignment(void)
     free_ast_result(&result);
 }
 
+void test_calls_are_bound_at_parse_time(void)
+{
+    const char *source =
+        "let a = sin(1)\n"
+        "let b = safe_divide(1, 2)\n"
+        "let c = abs(1, 2)\n"
+        "let d = spiral(1)\n";
+    ASTResult result = parse_source(source);
+    TEST_ASSERT_NOT_NULL(result.root);
+    TEST_ASSERT_EQUAL(4, result.root->block.count);
+
+    ASTNode **stmts = result.root->block.statements;
+    TEST_ASSERT_EQUAL(TOKEN_FUNC_SIN - TOKEN_FUNC_ABS + 1, stmts[0]->let_stmt.expr->call_expr.builtin);
+    TEST_ASSERT_EQUAL(BUILTIN_SAFE_DIVIDE, stmts[1]->let_stmt.expr->call_expr.builtin);
+
+    // Wrong arity and unknown names are left to the user functions, keyed by their name's slot
+    TEST_ASSERT_EQUAL(BUILTIN_NONE, stmts[2]->let_stmt.expr->call_expr.builtin);
+    resolve_variables(result.root);
+    ASTNode *user = stmts[3]->let_stmt.expr;
+    TEST_ASSERT_EQUAL(BUILTIN_NONE, user->call_expr.builtin);
+    TEST_ASSERT_TRUE(user->call_expr.slot > 0);
+    TEST_ASSERT_EQUAL(variable_slot("spiral"), user->call_expr.slot);
+
+    free_ast_result(&result);
+}
+
+void test_parse_map_literal_interns_keys(void)
+{
+    ASTResult result = parse_source("let glyphs = {\"A\": [1, 2], \"B\": 3, \"A\": 4}\nlet empty = {}");
+    TEST_ASSERT_NOT_NULL(result.root);
+    TEST_ASSERT_EQUAL(2, result.root->block.count);
+
+    ASTNode *map = result.root->block.statements[0]->let_stmt.expr;
+    TEST_ASSERT_EQUAL(AST_MAP_LITERAL, map->type);
+    TEST_ASSERT_EQUAL(3, map->array_literal.count);
+    TEST_ASSERT_EQUAL(AST_ARRAY_LITERAL, map->array_literal.elements[0]->type);
+    TEST_ASSERT_EQUAL(AST_NUMBER, map->array_literal.elements[1]->type);
+
+    // A repeated key has the same id, so the later value replaces the earlier one
+    TEST_ASSERT_EQUAL(map->array_literal.keys[0], map->array_literal.keys[2]);
+    TEST_ASSERT_NOT_EQUAL(map->array_literal.keys[0], map->array_literal.keys[1]);
+    TEST_ASSERT_EQUAL_STRING("B", intern_text(&get_runtime()->strings, map->array_literal.keys[1]));
+
+    TEST_ASSERT_EQUAL(0, result.root->block.statements[1]->let_stmt.expr->array_literal.count);
+    free_ast_result(&result);
+}
+
+void test_parse_match_builds_dispatch_tables(void)
+{
+    ASTResult result = parse_source(
+        "match i {\n"
+        "  1, 3 { G1 X[1] }\n"
+        "  -2 { G1 X[2] }\n"
+        "  \"A\", \"B\" { G1 X[3] }\n"
+        "  3 { G1 X[4] }\n"
+        "  else { G0 X[0] }\n"
+        "}\n"
+        "match r { 0.5 { G1 X[1] } 1000 { G1 X[2] } }");
+    TEST_ASSERT_NOT_NULL(result.root);
+    TEST_ASSERT_EQUAL(2, result.root->block.count);
+
+    // Close integer labels index a table from the lowest; the first arm of a repeated label wins
+    ASTNode *dense = result.root->block.statements[0];
+    TEST_ASSERT_EQUAL(AST_MATCH, dense->type);
+    TEST_ASSERT_EQUAL(4, dense->match_stmt.arm_count);
+    TEST_ASSERT_NOT_NULL(dense->match_stmt.else_branch);
+    TEST_ASSERT_EQUAL(-2, dense->match_stmt.dense_first);
+    TEST_ASSERT_EQUAL(6, dense->match_stmt.dense_count);
+    static const int expected[] = {1, -1, -1, 0, -1, 0};
+    for (int i = 0; i < 6; i++)
+        TEST_ASSERT_EQUAL(expected[i], dense->match_stmt.dense[i]);
+
+    Value a = {.type = VAL_STRING, .string = "A"};
+    Value c = {.type = VAL_STRING, .string = "C"};
+    Value three = number_value(3.0), half = number_value(0.5);
+    TEST_ASSERT_EQUAL(2, match_arm(dense, &a));
+    TEST_ASSERT_EQUAL(-1, match_arm(dense, &c));
+    TEST_ASSERT_EQUAL(0, match_arm(dense, &three));
+    TEST_ASSERT_EQUAL(-1, match_arm(dense, &half));
+
+    // Labels far apart or with fractions are searched in sorted order instead
+    ASTNode *sorted = result.root->block.statements[1];
+    TEST_ASSERT_NULL(sorted->match_stmt.dense);
+    TEST_ASSERT_EQUAL(2, sorted->match_stmt.number_count);
+    TEST_ASSERT_EQUAL(0, sorted->match_stmt.string_slots);
+    TEST_ASSERT_EQUAL(0, match_arm(sorted, &half));
+    TEST_ASSERT_EQUAL(-1, match_arm(sorted, &three));
+    free_ast_result(&result);
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -1061,6 +1204,11 @@ int main(void)
     RUN_TEST(test_parse_string_with_tab_escape);             // 40
     RUN_TEST(test_parse_string_with_backslash_escape);       // 41
     RUN_TEST(test_parse_multiple_string_literals);           // 42
+    RUN_TEST(test_parse_note_template_segments);             // 43
+    RUN_TEST(test_calls_are_bound_at_parse_time);            // 44
+    RUN_TEST(test_parse_map_literal_interns_keys);           // 45
+    RUN_TEST(test_parse_match_builds_dispatch_tables);       // 46
+    RUN_TEST(test_parse_note_placeholders_balance_brackets); // 47
     return UNITY_END();
 }
 
@@ -281,6 +281,110 @@ void test_recursion_depth_tracking(void)
     free_ast(root);
 }
 
+// Test that self calls in tail position reuse their frame instead of nesting
+void test_tail_recursion_runs_in_constant_frames(void)
+{
+    const char *code = 
+        "function sum_to(acc, n) {\n"
+        "  if (n <= 0) { return acc }\n"
+        "  return sum_to(acc + n, n - 1)\n"
+        "}\n"
+        "let result = sum_to(0, 5000)\n"; // Far deeper than nested calls may go
+    
+    reset_runtime_state();
+    
+    ASTNode *root = parse_script_from_string(code);
+    TEST_ASSERT_NOT_NULL(root);
+    
+    emit_gcode(root);
+    
+    Value *result = get_var("result");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_DOUBLE(12502500.0, result->number);
+    
+    // One frame did all the work
+    Runtime *rt = get_runtime();
+    TEST_ASSERT_EQUAL_INT(0, rt->recursion_depth);
+    TEST_ASSERT_EQUAL_INT(0, rt->function_stack.count);
+    TEST_ASSERT_TRUE(rt->function_stack.capacity <= 64);
+    
+    free_ast(root);
+}
+
+// Test that calls which must see their caller's locals still nest
+void test_tail_calls_keep_dynamic_scope(void)
+{
+    const char *code = 
+        "function nest(n) {\n"
+        "  let seen = n\n"
+        "  if (n <= 0) { return seen }\n"
+        "  return nest(n - 1)\n"
+        "}\n"
+        "function peek(n) {\n"
+        "  if (n <= 0) { return depth_seen }\n"
+        "  let depth_seen = n\n"
+        "  return peek(n - 1)\n"
+        "}\n"
+        "let a = nest(300)\n"
+        "let b = peek(3)\n"
+        "let c = nest(50) + nest(2)\n";
+    
+    reset_runtime_state();
+    
+    ASTNode *root = parse_script_from_string(code);
+    TEST_ASSERT_NOT_NULL(root);
+    
+    emit_gcode(root);
+    
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, get_var("a")->number);
+    // The innermost call reads the local of the call that made it
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, get_var("b")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, get_var("c")->number);
+    
+    Runtime *rt = get_runtime();
+    TEST_ASSERT_EQUAL_INT(0, rt->recursion_depth);
+    
+    free_ast(root);
+}
+
+// Test that a self call that is not the returned value nests and the body goes on after it
+void test_non_tail_self_calls_run_the_rest_of_the_body(void)
+{
+    const char *code = 
+        "let visits = 0\n"
+        "let last = -1\n"
+        "function count(n) {\n"
+        "  if (n <= 0) { return 0 }\n"
+        "  let below = count(n - 1)\n"
+        "  visits = visits + 1\n"
+        "  return below + 1\n"
+        "}\n"
+        "function down(n) {\n"
+        "  if (n > 0) { return down(n - 1) }\n"
+        "  last = n\n"
+        "}\n"
+        "let counted = count(4)\n"
+        "let reached = down(2000)\n"; // A tail call, though the body does not end in return
+    
+    reset_runtime_state();
+    
+    ASTNode *root = parse_script_from_string(code);
+    TEST_ASSERT_NOT_NULL(root);
+    
+    emit_gcode(root);
+    
+    TEST_ASSERT_EQUAL_DOUBLE(4.0, get_var("counted")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(4.0, get_var("visits")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, get_var("reached")->number);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, get_var("last")->number);
+    
+    Runtime *rt = get_runtime();
+    TEST_ASSERT_EQUAL_INT(0, rt->recursion_depth);
+    TEST_ASSERT_EQUAL_INT(0, rt->function_stack.count);
+    
+    free_ast(root);
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -295,6 +399,9 @@ int main(void)
     RUN_TEST(test_complex_recursion_chain);                 // Complex recursion patterns
     RUN_TEST(test_normal_function_calls_unaffected);        // Normal functions unaffected
     RUN_TEST(test_recursion_depth_tracking);                // Depth tracking accuracy
+    RUN_TEST(test_tail_recursion_runs_in_constant_frames);  // Tail calls reuse their frame
+    RUN_TEST(test_tail_calls_keep_dynamic_scope);           // Locals force a nested call
+    RUN_TEST(test_non_tail_self_calls_run_the_rest_of_the_body); // Only returned calls are tail calls
     
     return UNITY_END();
 }
\ No newline at end of file
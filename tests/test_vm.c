@@ -0,0 +1,255 @@
+#include "Unity/src/unity.h"
+#include "runtime/bytecode.h"
+#include "parser/parser.h"
+#include "runtime/evaluator.h"
+#include "generator/emitter.h"
+#include "utils/output_buffer.h"
+#include "config/config.h"
+#include <stdlib.h>
+#include <string.h>
+
+static Bytecode code;
+
+void setUp(void)
+{
+    memset(&code, 0, sizeof(code));
+}
+
+void tearDown(void)
+{
+    bytecode_free(&code);
+}
+
+/// @brief Compiles `source` from scratch on the tree walker or the VM and returns the G-code
+static char *compile_with(const char *source, int use_vm)
+{
+    init_runtime();
+    reset_config_state();
+    reset_runtime_state();
+    reset_emitter_state();
+    reset_line_number();
+    init_output_buffer();
+
+    ASTNode *root = parse_script_from_string(source);
+    TEST_ASSERT_NOT_NULL(root);
+
+    if (use_vm)
+    {
+        TEST_ASSERT_TRUE(bytecode_compile(&code, root));
+        emit_gcode_bytecode(&code);
+    }
+    else
+    {
+        emit_gcode(root);
+    }
+
+    char *output = strdup(get_output_buffer());
+    free_output_buffer();
+    free_ast(root);
+    return output;
+}
+
+static void assert_engines_agree(const char *source)
+{
+    char *expected = compile_with(source, 0);
+    char *actual = compile_with(source, 1);
+    TEST_ASSERT_TRUE(strlen(expected) > 0);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(expected);
+    free(actual);
+}
+
+void test_vm_layout_uses_registers_and_gcode_opcodes(void)
+{
+    init_runtime();
+    ASTNode *root = parse_script_from_string("let a = 1 + 2.5\nG1 X[a] Y[3]");
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(bytecode_compile(&code, root));
+
+    static const Opcode expected[] = {
+        OP_NUMBER, OP_NUMBER, OP_ADD, OP_LET,
+        OP_GCODE, OP_GET, OP_GCODE_WORD, OP_NUMBER, OP_GCODE_WORD, OP_GCODE_END,
+        OP_HALT};
+    TEST_ASSERT_EQUAL_UINT(sizeof(expected) / sizeof(expected[0]), code.count);
+    for (uint32_t i = 0; i < code.count; i++)
+        TEST_ASSERT_EQUAL_MESSAGE(expected[i], code.code[i].op, "opcode");
+
+    // The sum is built in r0 from r0 and r1; each word is computed into r0
+    TEST_ASSERT_EQUAL_UINT(2, code.register_count);
+    TEST_ASSERT_EQUAL_UINT(1, code.code[2].c);
+    TEST_ASSERT_EQUAL_DOUBLE(2.5, code.numbers[code.code[1].b]);
+    TEST_ASSERT_EQUAL_STRING("a", code.names[code.code[3].c]);
+    TEST_ASSERT_EQUAL_UINT('X' - 'A', code.code[6].aux);
+    TEST_ASSERT_EQUAL_UINT(0, code.code[6].a);
+    TEST_ASSERT_EQUAL_UINT('Y' - 'A', code.code[8].aux);
+    TEST_ASSERT_TRUE(code.nodes[code.code[4].b] == root->block.statements[1]);
+    free_ast(root);
+}
+
+void test_vm_runs_builtins_on_registers_and_user_calls_on_the_walker(void)
+{
+    init_runtime();
+    ASTNode *root = parse_script_from_string("function f(x) { G1 X[x] }\nf(2)\nlet y = f(1) + atan2(3, 4)");
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(bytecode_compile(&code, root));
+
+    static const Opcode expected[] = {
+        OP_DEFINE, OP_WALK,
+        OP_EVAL, OP_NUMBER, OP_NUMBER, OP_CALL_BUILTIN, OP_ADD, OP_LET, OP_RELEASE,
+        OP_HALT};
+    TEST_ASSERT_EQUAL_UINT(sizeof(expected) / sizeof(expected[0]), code.count);
+    for (uint32_t i = 0; i < code.count; i++)
+        TEST_ASSERT_EQUAL_MESSAGE(expected[i], code.code[i].op, "opcode");
+
+    // atan2's arguments are computed into r1 and r2, its result replaces the first
+    const Instr *call = &code.code[5];
+    TEST_ASSERT_EQUAL_UINT(1, call->a);
+    TEST_ASSERT_EQUAL_UINT(TOKEN_FUNC_ATAN2 - TOKEN_FUNC_ABS + 1, call->b);
+    TEST_ASSERT_EQUAL_UINT(2, call->c);
+    free_ast(root);
+}
+
+void test_vm_caches_loop_invariant_and_repeated_expressions(void)
+{
+    init_runtime();
+    ASTNode *root = parse_script_from_string(
+        "let r = 2\n"
+        "for i = 0..<3 { G1 X[r * 3] Y[i * r + 1] Z[i * r + 1] }\n"
+        "r = 4\n");
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(bytecode_compile(&code, root));
+
+    // r * 3 does not change in the loop; i * r + 1 repeats within the G1 line
+    TEST_ASSERT_EQUAL_UINT(2, code.cache_count);
+    int cached = 0, fills = 0, invalidates = 0;
+    for (uint32_t i = 0; i < code.count; i++)
+    {
+        cached += code.code[i].op == OP_CACHED;
+        fills += code.code[i].op == OP_CACHE_FILL;
+        invalidates += code.code[i].op == OP_INVALIDATE;
+    }
+    TEST_ASSERT_EQUAL_INT(3, cached);
+    TEST_ASSERT_EQUAL_INT(3, fills);
+    // After let r, the loop variable and r = 4
+    TEST_ASSERT_EQUAL_INT(3, invalidates);
+    free_ast(root);
+}
+
+void test_vm_matches_tree_walker_with_cached_expressions(void)
+{
+    // Every write empties the caches that read it, and values computed with an error are not kept
+    assert_engines_agree(
+        "let a = 1\n"
+        "let b = 3\n"
+        "for i = 0..<3 {\n"
+        "  G1 X[a * b + 1] Y[missing * 2] Z[sin(i * b) + sin(i * b)]\n"
+        "  if i == 1 { a = 5 }\n"
+        "  G1 Z[a * b + 1] F[b / (a - a)]\n"
+        "}\n"
+        "let w = 0\n"
+        "while w < a * 2 { w += 1 \n G1 X[w * a] Y[a * b] }\n"
+        "for j = 0..<2 { let a = j * 10 \n G1 X[a * b] }\n"
+        "G1 X[a * b]\n");
+}
+
+void test_vm_matches_tree_walker_on_control_flow(void)
+{
+    assert_engines_agree(
+        "let total = 0\n"
+        "for i = 0..<6 step 2 {\n"
+        "  total += i\n"
+        "  if i == 2 { G1 X[i] Y[total] } else { G0 X[-i] Z[i > 3 ? 1 : 0] }\n"
+        "}\n"
+        "let n = 3\n"
+        "while n > 0 { G1 Z[n * 0.5] \n n -= 1 }\n"
+        "for j = 3..1 { G2 X[j] I[j / 2] }\n"
+        "let k = 0\n"
+        "while k < 5 { k = k + 1 \n if k > 2 { G4 P[k] } }\n"
+        "G1 X[1 / 0] Y[!k] Z[k != 5]\n");
+}
+
+void test_vm_matches_tree_walker_on_calls_arrays_and_notes(void)
+{
+    assert_engines_agree(
+        "function sq(x) { return x * x }\n"
+        "function spiral(r) { for k = 0..2 { G1 X[cos(k) * r] Y[sin(k) * r] } }\n"
+        "let pts = [[1, 2], [3, 4]]\n"
+        "pts[1] = [5, 6]\n"
+        "spiral(2)\n"
+        "G1 X[sq(pts[1][0])] Y[max(pts[0][1], 7)] F[abs(-100)]\n"
+        "note { total [sq(3)] }\n"
+        "let word = \"ab\"\n"
+        "for c in word { note { char [c] } }\n"
+        "let label = \"part\" + 1\n"
+        "note { [label] }\n"
+        "function outer(y) { let r = sq(y) \n G1 X[r] \n return r + 1 }\n"
+        "for i = 0..<3 { G1 Y[outer(i)] }\n");
+}
+
+void test_vm_matches_tree_walker_on_array_builtins(void)
+{
+    // push() and pop() change their array on the walker; the others run on registers
+    assert_engines_agree(
+        "let xs = []\n"
+        "for i = 0..<4 { push(xs, i * 3) \n G1 X[len(xs)] Y[sum(xs)] Z[max(xs)] }\n"
+        "while len(xs) > 1 { G1 X[pop(xs)] Y[min(xs)] }\n"
+        "let ys = reverse(sort([4, 1, 3]))\n"
+        "G1 X[ys[0]] Y[slice(ys, 1, 9)[1]] Z[len(slice(ys, 2, 1))]\n");
+}
+
+void test_vm_matches_tree_walker_on_maps(void)
+{
+    assert_engines_agree(
+        "let glyphs = {\"A\": [1, 0], \"B\": [0, 1]}\n"
+        "glyphs[\"C\"] = [1, 1]\n"
+        "for c in \"ABCD\" {\n"
+        "  if has(glyphs, c) { G1 X[glyphs[c][0]] Y[glyphs[c][1]] Z[len(keys(glyphs))] }\n"
+        "}\n"
+        "G1 X[glyphs[\"missing\"]]\n");
+}
+
+void test_vm_matches_tree_walker_on_match(void)
+{
+    // Arms are reached through OP_MATCH's jump table; a temporary subject is looked up before it is dropped
+    assert_engines_agree(
+        "let names = [\"A\", \"B\", \"Q\"]\n"
+        "for i = -2..7 {\n"
+        "  match i { 0 { G0 Z[5] } 1, 2 { G1 Z[i] } -2 { G2 Z[-2] } 6.5 { G4 P[1] } else { G1 X[i * 2] } }\n"
+        "  match i / 2 { 0.5 { G1 Y[0.5] } 3 { G1 Y[3] } }\n"
+        "  if i >= 0 && i < 3 { match names[i] { \"A\" { G1 F[100] } \"B\" { G1 F[200] } else { G1 F[1] } } }\n"
+        "}\n"
+        "match \"Z\" { \"Z\" { G1 X[26] } }\n");
+}
+
+void test_vm_runs_example_program(void)
+{
+    FILE *file = fopen("GGCODE/Flower of Life basic grid.ggcode", "rb");
+    TEST_ASSERT_NOT_NULL_MESSAGE(file, "example program not found");
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    char *source = calloc((size_t)size + 1, 1);
+    TEST_ASSERT_NOT_NULL(source);
+    TEST_ASSERT_TRUE(fread(source, 1, (size_t)size, file) == (size_t)size);
+    fclose(file);
+
+    assert_engines_agree(source);
+    free(source);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_vm_layout_uses_registers_and_gcode_opcodes);       // 1
+    RUN_TEST(test_vm_runs_builtins_on_registers_and_user_calls_on_the_walker); // 2
+    RUN_TEST(test_vm_caches_loop_invariant_and_repeated_expressions); // 3
+    RUN_TEST(test_vm_matches_tree_walker_with_cached_expressions);    // 4
+    RUN_TEST(test_vm_matches_tree_walker_on_control_flow);           // 5
+    RUN_TEST(test_vm_matches_tree_walker_on_calls_arrays_and_notes); // 6
+    RUN_TEST(test_vm_matches_tree_walker_on_array_builtins);         // 7
+    RUN_TEST(test_vm_matches_tree_walker_on_maps);                   // 8
+    RUN_TEST(test_vm_matches_tree_walker_on_match);                  // 9
+    RUN_TEST(test_vm_runs_example_program);                          // 10
+    return UNITY_END();
+}